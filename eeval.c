@@ -17,6 +17,7 @@
 #include "eeval.h"
 
 #include <math.h>
+#include <fenv.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -27,6 +28,93 @@
 
 
 
+#if eeval_statistics
+#include <time.h>
+#endif
+
+#if eeval_vector_lexer
+#include <emmintrin.h>
+#endif
+
+
+
+// Classes of the characters (see EECharClass):
+// 1 blank, 10 digit, 12 letter or underscore,
+// 16 first character of comparison and logical operators
+
+const uint8_t EEvalCharClasses[ 256 ] =
+{
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  0,  0,  1,  0,  0,   // 00
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 10
+     1, 16,  0,  0,  0,  0, 16,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 20
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10,  0,  0, 16, 16, 16,  0,   // 30
+     0, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,   // 40
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,  0,  0,  0,  0, 12,   // 50
+     0, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,   // 60
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,  0, 16,  0,  0,  0,   // 70
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 80
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 90
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // A0
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // B0
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // C0
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // D0
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // E0
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0    // F0
+};
+
+
+
+// Tokens made of a single character
+// (ETBlk for the other characters); the first character
+// of the operators of two characters (see EEvalOperatorToken())
+
+const EEToken EEvalCharTokens[ 256 ] =
+{
+    [ '\0' ] = ETEof,
+    [ '+' ]  = ETSum,
+    [ '-' ]  = ETSub,
+    [ '*' ]  = ETMul,
+    [ '/' ]  = ETDiv,
+    [ '^' ]  = ETExc,
+    [ '!' ]  = ETFct,
+    [ '(' ]  = ETrbo,
+    [ ')' ]  = ETrbc,
+    [ ',' ]  = ETcom,
+    [ '<' ]  = ETLt,
+    [ '>' ]  = ETGt,
+    [ '=' ]  = ETEq,
+    [ '&' ]  = ETAnd,
+    [ '|' ]  = ETOr
+};
+
+
+
+// Built-in functions and constants at the index given by EEKeywordHash()
+// (empty slots have no name)
+
+const EEKeyword EEvalKeywords[ EEKeywordsCount ] =
+{
+    [  0 ] = { "if",      2, ETFun, EFIf  },
+    [  1 ] = { "acos",    4, ETFun, EFACo },
+    [  2 ] = { "tan",     3, ETFun, EFTan },
+    [  5 ] = { "pi",      2, ETVal, M_PI  },
+    [  6 ] = { "max",     3, ETFun, EFMax },
+    [  8 ] = { "cos",     3, ETFun, EFCos },
+    [  9 ] = { "average", 7, ETFun, EFAvg },
+    [ 11 ] = { "exp",     3, ETFun, EFExp },
+    [ 12 ] = { "log",     3, ETFun, EFLog },
+    [ 15 ] = { "fact",    4, ETFun, EFFac },
+    [ 17 ] = { "asin",    4, ETFun, EFASi },
+    [ 20 ] = { "atan",    4, ETFun, EFATa },
+    [ 21 ] = { "avg",     3, ETFun, EFAvg },
+    [ 22 ] = { "sin",     3, ETFun, EFSin },
+    [ 25 ] = { "e",       1, ETVal, M_E   },
+    [ 28 ] = { "pow",     3, ETFun, EFPow },
+    [ 30 ] = { "min",     3, ETFun, EFMin }
+};
+
+
+
 // Evaluates an expression.
 // The function returns a status of success or failure
 // The result is in `*result`
@@ -34,13 +122,89 @@
 EEvalStatus EEvaluate( EEvaluation *eval,       // the EEvaluation structure
                        const char  *expression, // the expression as a null terminated C string
                        double      *result )    // RETURN: the result of the evaluation
+{
+    return EEvaluateN( eval, expression, strlen( expression ), result );
+}
+
+
+
+// Evaluates an expression of `length` characters that needs not be
+// null terminated (e.g. inside a larger buffer): nothing is read
+// beyond `expression + length`, nothing is copied or allocated.
+// The function returns a status of success or failure
+// The result is in `*result`
+
+EEvalStatus EEvaluateN( EEvaluation *eval,       // the EEvaluation structure
+                        const char  *expression, // the first character of the expression
+                        size_t      length,      // the number of characters of the expression
+                        double      *result )    // RETURN: the result of the evaluation
+{
+    return EEvaluatePolicy( eval, expression, length, EPStrict, result );
+}
+
+
+
+// Evaluates an expression of `length` characters (as EEvaluateN() does)
+// catching floating point exceptions as `policy` says:
+// EPStrict (as EEvaluate() does) checks the result of each operation and
+// fails on the first NaN or infinity, where it occurs;
+// EPDeferred clears the exception flags (see EEvalFlags), performs no checks
+// and fails at the end if any operation raised them;
+// EPOff performs no checks: the result can be NaN or infinite.
+// Division by zero, factorials of negative numbers and numbers too big
+// are errors whatever the policy.
+// The function returns a status of success or failure
+// The result is in `*result`
+
+EEvalStatus EEvaluatePolicy( EEvaluation *eval,       // the EEvaluation structure
+                             const char  *expression, // the first character of the expression
+                             size_t      length,      // the number of characters of the expression
+                             EEvalPolicy policy,      // how floating point exceptions are caught
+                             double      *result )    // RETURN: the result of the evaluation
 {
     eval->expression = eval->cursor = expression;
+    eval->end = expression + length;
     eval->roundBracketsCount = 0;
+    eval->depth = 0;
+    eval->skipping = 0;
+    eval->arguments = 0;
+    eval->policy = policy;
     eval->result = 0;
     eval->error = NULL;
+    eval->symbols = NULL;
+    eval->bindings = NULL;
+    eval->bindingsCount = 0;
+
+    // Deferred: flags raised before are cleared
+    // (tested first: clearing them is much slower)
+
+    #if eeval_catch_fp_exceptions
+        if( policy == EPDeferred && fetestexcept( EEvalFlags ) ) feclearexcept( EEvalFlags );
+    #endif
+
+    #if eeval_statistics
+        memset( &eval->stats, 0, sizeof( EEStats ) );
+        eval->stats.evaluations = 1;
+        eval->stats.totalTime = EEStatsNow();
+    #endif
+
+    eval->result = EEvalExpression( eval );
+
+    // Deferred: a single test at the end
+    // (the error points to the end of the expression)
 
-    eval->result = EEvalAddends( eval, -1, true, false, NULL );
+    #if eeval_catch_fp_exceptions
+        if( policy == EPDeferred && ! eval->error && fetestexcept( EEvalFlags ) )
+        {
+            eval->error = "result is complex or too big";
+            eval->cursor = eval->end;
+        }
+    #endif
+
+    #if eeval_statistics
+        eval->stats.totalTime = EEStatsNow() - eval->stats.totalTime;
+        eval->stats.lexingTime = EEStatsLexing( eval );
+    #endif
 
     *result = eval->result;
 
@@ -66,464 +230,787 @@ EEvalStatus EEvaluate( EEvaluation *eval,       // the EEvaluation structure
 
 void EEPrintError( EEvaluation *eval )
 {
+    size_t length;
+
     if( eval->error && strlen( eval->error ) > 0 )
     {
+        // Expressions evaluated in place are not null terminated
+
+        length = eval->end ? (size_t)( eval->end - eval->expression ) : strlen( eval->expression );
+
         fprintf( stderr, "%s\n", eval->error );
-        fprintf( stderr, "%s\n", eval->expression );
+        fprintf( stderr, "%.*s\n", (int)length, eval->expression );
         fprintf( stderr, "%*c^\n", (int)( eval->cursor - eval->expression ), ' ' );
     }
 }
 
 
 
-// ***********************
-// PRIVATE FUNCTIONS BELOW
-// ***********************
-
-
+// Adds the statistics of an evaluation (or of many)
+// to a total: counters and times are summed,
+// the depth is the deepest of the two.
 
-// Evaluates a single value or expression A0 or
-// sequence of 2 or more addends:
-// A1 - A2 [ + A3 [ - A4 ... ] ]
-// Addends can be a single values or expressions with
-// higher precedence. In the second case the expression is evaluated first.
-// "breakOn" parameters define cases where the function must exit.
-
-double EEvalAddends( EEvaluation *eval,
-                    int64_t breakOnRoundBracketsCount, // If open brackets count goes down to this count then exit;
-                    bool breakOnETEof,                 // exit if the end of the string '\0' is met;
-                    bool breakOnETcom,                 // exit if a comma is met;
-                    EEToken *tokenThatCausedBreak )    // if pointer is not null the token/symbol that caused the function to exit.
+void EEStatsAdd( EEStats *total,        // RETURN: the total
+                 const EEStats *stats ) // the statistics to add
 {
-    EEToken leftOp;
-    EEToken rightOp;
-    double  value;
-    double  result;
+    int k;
 
-    // Let's pretend we already computed
-    // 0 + ...
+    total->evaluations += stats->evaluations;
+    total->tokens      += stats->tokens;
+    total->powers      += stats->powers;
+    total->factorials  += stats->factorials;
+    total->checks      += stats->checks;
+    total->lexingTime  += stats->lexingTime;
+    total->totalTime   += stats->totalTime;
 
-    result = 0;
-    rightOp = ETSum;
+    if( stats->maxDepth > total->maxDepth ) total->maxDepth = stats->maxDepth;
 
-    do
+    for( k = 0; k < EEStatsFunctions; k++ )
     {
-        leftOp = rightOp;
-
-        // [ Each addend A is treated as a (potential and higher-precedence)
-        //   multiplication and evaluated as 1 * A with the function below ]
-        value = EEvalFactors( eval, 1, ETMul, false, &rightOp );
-        if( eval->error ) return 0;
+        total->calls[ k ] += stats->calls[ k ];
+    }
+}
 
-        result = leftOp == ETSum ? ( result + value ) : ( result - value );
 
-        // ...and go on as long there are sums ands subs.
-    }
-    while( rightOp == ETSum || rightOp == ETSub );
 
-    // A round close bracket:
-    // check for negative count.
+// Utility function to print statistics
+// (on stderr, as errors are).
+// Functions never called are omitted.
 
-    if( rightOp == ETrbc )
+void EEPrintStats( const EEStats *stats )
+{
+    int k;
+
+    fprintf( stderr, "evaluations:    %" PRIu64 "\n", stats->evaluations );
+    fprintf( stderr, "tokens:         %" PRIu64 "\n", stats->tokens );
+    fprintf( stderr, "max depth:      %" PRId64 "\n", stats->maxDepth );
+    fprintf( stderr, "powers:         %" PRIu64 "\n", stats->powers );
+    fprintf( stderr, "factorials:     %" PRIu64 "\n", stats->factorials );
+    fprintf( stderr, "checks:         %" PRIu64 "\n", stats->checks );
+    fprintf( stderr, "lexing time:    %" PRIu64 " ns\n", stats->lexingTime );
+    fprintf( stderr, "computing time: %" PRIu64 " ns\n", stats->totalTime - stats->lexingTime );
+
+    for( k = 0; k < EEStatsFunctions; k++ )
     {
-        eval->roundBracketsCount--;
-        if( eval->roundBracketsCount < 0 )
+        if( stats->calls[ k ] == 0 ) continue;
+
+        // The registered functions are counted together
+
+        if( k == EFBuiltInCount )
         {
-            eval->error = "unexpected close round bracket";
-            return 0;
+            fprintf( stderr, "calls of others  %" PRIu64 "\n", stats->calls[ k ] );
+        }
+        else
+        {
+            fprintf( stderr, "calls of %-7s %" PRIu64 "\n", EEFunctions[ k ].name, stats->calls[ k ] );
         }
     }
+}
 
-    // Returns the token that caused the function to exit
 
-    if( tokenThatCausedBreak )
-    {
-        *tokenThatCausedBreak = rightOp;
-    }
 
-    // Check if must exit
+// ***********************
+// PRIVATE FUNCTIONS BELOW
+// ***********************
 
-    if( ( eval->roundBracketsCount == breakOnRoundBracketsCount ) || ( breakOnETEof && rightOp == ETEof ) || ( breakOnETcom && rightOp == ETcom ) )
-    {
-        if( eexception(result) )
-        {
-            eval->error = "result is complex or too big";
-            return 0;
-        }
 
-        return result;
-    }
 
-    // If not it's an error.
+// Evaluates the expression with an explicit stack instead of recursion:
+// deeply nested expressions take no C stack and the nesting is limited
+// (see eeval_max_depth) with an error.
+//
+// The expression is made of levels: the whole expression, the content of
+// a pair of brackets or an argument of a function are sums of addends
+// A1 - A2 [ + A3 [ - A4 ... ] ], each addend a sequence of factors
+// F1 [ * F2  [ / F3 [ * F4 ... ] ] ]; an exponent is a single factor.
+// A factor is a value, a bracket or a function, with an optional sign
+// before and factorial and exponentiation operators after.
+// A bracket, a function or an exponent opens a new level: the state of
+// the current one (sum, product and sign so far) is pushed on the stack
+// and popped once the new level is evaluated.
+// Sums of a level can be compared (S1 < S2, a single comparison) and the
+// comparisons joined by && and || (&& first): the operator and the operand
+// on its left are pushed on the stack while the one on its right is
+// evaluated. The right operand of && (||) is parsed but not computed if
+// the left one is 0 (not 0), so are the branch not taken by if() (see
+// EEvalArgument()): while `eval->skipping` is set, values are 0 and
+// nothing can fail but the syntax.
+//
+// Tokens are read and operations performed in the order of the recursive
+// descent of the grammar (see EECompileAddends() and following, which
+// compile the same grammar): errors are raised at the same point.
 
-    switch( rightOp )
-    {
-        case ETEof:
-            eval->error = "unexpected end of expression";
-            break;
+double EEvalExpression( EEvaluation *eval )
+{
+    EEvalStep  step;
 
-        case ETrbc:
-            eval->error = "unexpected close round bracket";
-            break;
+    EEvalFrame frames[ eeval_max_depth ],
+               *frame;
 
-        case ETcom:
-            eval->error = "unexpeced comma";
-            break;
+    const EEFunction *function;
 
-        default:
-            eval->error = "unexpeced symbol";
-            break;
-    }
+    double     arguments[ eeval_max_arguments ];
 
-    return 0;
-}
+    EEToken    token,
+               nextOp,
+               sumOp,
+               productOp,
+               operator;
 
+    double     sum,
+               product,
+               sign,
+               value;
 
+    bool       done;
 
-// Evaluates a sequence of 1 or more multiplies or divisions
-// F1 [ * F2  [ / F3 [ * F4 ... ] ] ]
-// Where Fn is a value or a higher precedence expression.
+    sum = 0;
+    sumOp = ETSum;
+    product = 1;
+    productOp = ETMul;
+    sign = 1;
+    value = 0;
+    nextOp = ETErr;
+    operator = ETErr;
+    frame = NULL;
 
-double EEvalFactors( EEvaluation *eval,
-                     double      leftValue, // The value (already fetched) on the left to be multiplied(divided);
-                     EEToken     op,        // is it multiply or divide;
-                     bool        isExponent,// is an exponent being evaluated ?
-                     EEToken     *leftOp )  // RETURN: factors are over, this is the next operator (token).
-{
-    EEToken token,
-            nextOp;
+    step = ESFactor;
 
-    double  rightValue;
-    double  sign;
+    // Steps follow each other in order (falling through the cases)
+    // unless they go back or pop a level
 
-    do
+    while( true )
     {
-        rightValue = EEvalToken( eval, &token );
-        if( eval->error ) return 0;
+        switch( step )
+        {
+            case ESFactor:
 
-        // Unary minus or plus ?
-        // store the sign and get the next token
+                value = EEvalToken( eval, &token );
+                if( eval->error ) return 0;
 
-        if( token == ETSub )
-        {
-            sign = -1;
-            rightValue = EEvalToken( eval, &token );
-            if( eval->error ) return 0;
-        }
-        else if( token == ETSum )
-        {
-            sign = 1;
-            rightValue = EEvalToken( eval, &token );
-            if( eval->error ) return 0;
-        }
-        else
-        {
-            sign = 1;
-        }
+                // Unary minus or plus ?
+                // store the sign and get the next token
 
-        // Open round bracket?
-        // The expression between brackets is evaluated.
+                if( token == ETSub )
+                {
+                    sign = -1;
+                    value = EEvalToken( eval, &token );
+                    if( eval->error ) return 0;
+                }
+                else if( token == ETSum )
+                {
+                    sign = 1;
+                    value = EEvalToken( eval, &token );
+                    if( eval->error ) return 0;
+                }
+                else
+                {
+                    sign = 1;
+                }
 
-        if( token == ETrbo )
-        {
-            eval->roundBracketsCount++;
+                // Open round bracket or function ?
+                // A new level: the expression between brackets
+                // or the first argument of the function
 
-            rightValue = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
+                if( token == ETFun || token == ETrbo )
+                {
+                    // Eat the open round bracket of the function
+                    // (`value` is its index)
 
-            token = ETVal;
-        }
+                    if( token == ETFun )
+                    {
+                        EEvalToken( eval, &nextOp );
+                        if( eval->error ) return 0;
 
-        // A function ?
+                        if( nextOp != ETrbo )
+                        {
+                            eval->error = "expected open round bracket after function name";
+                            return 0;
+                        }
 
-        if( token == ETCos || token == ETSin || token == ETTan || token == ETASi || token == ETACo || token == ETATa || token == ETFac || token == ETLog || token == ETExp || token == ETPow || token == ETMax || token == ETMin || token == ETAvg )
-        {
-            rightValue = EEvalFunction( eval, token );
-            if( eval->error ) return 0;
+                        if( ! eval->skipping ) EEStatsCall( eval, (int32_t)value );
+                    }
 
-            token = ETVal;
-        }
+                    eval->roundBracketsCount++;
+
+                    if( ! EEvalEnter( eval ) ) return 0;
+
+                    frame = &frames[ eval->depth - 1 ];
+                    frame->kind      = token;
+                    frame->sumOp     = sumOp;
+                    frame->productOp = productOp;
+                    frame->count     = 0;
+                    frame->function  = token == ETFun ? (int16_t)value : 0;
+                    frame->sum       = sum;
+                    frame->product   = product;
+                    frame->sign      = sign;
+                    frame->value     = 0;
+
+                    sum = 0;
+                    sumOp = ETSum;
+                    product = 1;
+                    productOp = ETMul;
+                    break;
+                }
 
-        // Excluded previous cases then
-        // the token must be a number.
+                // Excluded previous cases then
+                // the token must be a number.
 
-        if( token != ETVal )
-        {
-            eval->error = "expected value";
-            return 0;
-        }
+                if( token != ETVal )
+                {
+                    eval->error = "expected value";
+                    return 0;
+                }
 
-        // Get beforehand the next token
-        // to see if it's an exponential or factorial operator
+                // fall through
 
-        EEvalToken( eval, &nextOp );
-        if( eval->error ) return 0;
+            case ESValue:
 
-        // Unary minus precedence (highest/lowest) affects this section of code
+                // Get beforehand the next token
+                // to see if it's an exponential or factorial operator
 
-        if( nextOp == ETFct )
-        {
-            #if eeval_unary_minus_has_highest_precedence
-                rightValue = EEvalFactorial( eval, rightValue * sign, &nextOp );
-                sign = 1;
-            #else
-                rightValue = EEvalFactorial( eval, rightValue, &nextOp );
-            #endif
-            if( eval->error ) return 0;
-        }
+                EEvalToken( eval, &nextOp );
+                if( eval->error ) return 0;
 
-        if( nextOp == ETExc )
-        {
-            #if eeval_unary_minus_has_highest_precedence
-                rightValue = EEvalExponentiation( eval, rightValue * sign, &nextOp );
-                sign = 1;
-            #else
-                rightValue = EEvalExponentiation( eval, rightValue, &nextOp );
-            #endif
-            if( eval->error ) return 0;
-        }
+                // Unary minus precedence (highest/lowest) affects this section of code
 
-        // multiplication/division is finally
-        // calculated
+                if( nextOp == ETFct )
+                {
+                    #if eeval_unary_minus_has_highest_precedence
+                        value = EEvalFactorial( eval, value * sign, &nextOp );
+                        sign = 1;
+                    #else
+                        value = EEvalFactorial( eval, value, &nextOp );
+                    #endif
+                    if( eval->error ) return 0;
+                }
 
-        if( op == ETMul )
-        {
-            leftValue = leftValue * rightValue * sign;
-        }
-        else
-        {
-            if( rightValue == 0 )
-            {
-                eval->error = "division by zero";
-                return 0;
-            }
-            leftValue = leftValue / rightValue * sign;
-        }
+                // An exponent: a new level of a single factor
+                // (the base is kept in the frame)
 
-        if( eexception( leftValue ) )
-        {
-            eval->error = "result is too big";
-            return 0;
-        }
+                if( nextOp == ETExc )
+                {
+                    if( ! EEvalEnter( eval ) ) return 0;
+
+                    #if eeval_unary_minus_has_highest_precedence
+                        value *= sign;
+                        sign = 1;
+                    #endif
+
+                    frame = &frames[ eval->depth - 1 ];
+                    frame->kind      = ETExc;
+                    frame->sumOp     = sumOp;
+                    frame->productOp = productOp;
+                    frame->count     = 0;
+                    frame->function  = 0;
+                    frame->sum       = sum;
+                    frame->product   = product;
+                    frame->sign      = sign;
+                    frame->value     = value;
+
+                    product = 1;
+                    productOp = ETMul;
+                    step = ESFactor;
+                    break;
+                }
 
-        // The next operator has already been fetched.
+                // fall through
 
-        op = nextOp;
+            case ESProduct:
 
-        // Go on as long multiply or division operators are met...
-        // ...unless an exponent is evaluated
-        // (because exponentiation ^ operator have higher precedence)
-    }
-    while( ( op == ETMul || op == ETDiv ) && ! isExponent );
+                // multiplication/division is finally
+                // calculated
 
+                if( eval->skipping )
+                {
+                    product = 0;
+                }
+                else if( productOp == ETMul )
+                {
+                    product = product * value * sign;
+                }
+                else
+                {
+                    if( value == 0 )
+                    {
+                        eval->error = "division by zero";
+                        return 0;
+                    }
+                    product = product / value * sign;
+                }
 
-    *leftOp = op;
+                if( EEvalException( eval, product ) )
+                {
+                    eval->error = "result is too big";
+                    return 0;
+                }
 
-    return leftValue;
-}
+                // The next operator has already been fetched.
+                // Go on as long multiply or division operators are met...
+                // ...unless an exponent is evaluated
+                // (because exponentiation ^ operator have higher precedence)
 
+                productOp = nextOp;
 
+                if( ( productOp == ETMul || productOp == ETDiv ) && ! ( frame && frame->kind == ETExc ) )
+                {
+                    step = ESFactor;
+                    break;
+                }
 
-// Evaluates the expession(s) (comma separated if multiple)
-// inside the round brackets then computes the function
-// specified by the token `func`.
+                // fall through
 
-double EEvalFunction( EEvaluation *eval, EEToken func )
-{
-    double   result,
-             result2;
+            case ESAddend:
 
-    uint16_t count;
+                // The exponent is over: the power is a factor
+                // of the level below
 
-    EEToken  tokenThatCausedBreak,
-             token;
+                if( frame && frame->kind == ETExc )
+                {
+                    if( eval->skipping )
+                    {
+                        value = 0;
+                    }
+                    else
+                    {
+                        value = pow( frame->value, product );
+                        EEStatsCount( eval, powers );
+                    }
 
-    // Eat an open round bracket and count it
+                    if( EEvalException( eval, value ) )
+                    {
+                        eval->error = "result is complex or too big";
+                        return 0;
+                    }
 
-    EEvalToken( eval, &token );
-    if( eval->error ) return 0;
+                    sumOp     = frame->sumOp;
+                    productOp = frame->productOp;
+                    sum       = frame->sum;
+                    product   = frame->product;
+                    sign      = frame->sign;
 
-    if( token != ETrbo )
-    {
-        eval->error = "expected open round bracket after function name";
-        return 0;
-    }
+                    eval->depth--;
+                    frame = eval->depth ? &frames[ eval->depth - 1 ] : NULL;
 
-    eval->roundBracketsCount++;
+                    step = ESProduct;
+                    break;
+                }
 
-    switch( func )
-    {
-        case ETSin:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            result = sin( result );
-            break;
+                sum = sumOp == ETSum ? ( sum + product ) : ( sum - product );
 
-        case ETCos:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            result = cos( result );
-            break;
+                // ...and go on as long there are sums ands subs.
 
-        case ETTan:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            result = tan( result );
-            break;
+                if( nextOp == ETSum || nextOp == ETSub )
+                {
+                    sumOp = nextOp;
+                    product = 1;
+                    productOp = ETMul;
+                    step = ESFactor;
+                    break;
+                }
 
-        case ETASi:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            result = asin( result );
-            break;
+                // fall through
 
-        case ETACo:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            result = acos( result );
-            break;
+            case ESLogic:
 
-        case ETATa:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            result = atan( result );
-            break;
+                // The sum is an operand of a comparison, && or ||:
+                // checked before it's compared
 
-        case ETFac:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            if( result < 0 )
-            {
-                eval->error = "attempt to evaluate factorial of negative number";
-            }
-            else
-            {
-                result = tgamma( 1 + result );
-            }
-            break;
+                if( ( ( frame && frame->kind >= ETLt && frame->kind <= ETOr ) || ( nextOp >= ETLt && nextOp <= ETOr ) ) && EEvalException( eval, sum ) )
+                {
+                    eval->error = "result is complex or too big";
+                    return 0;
+                }
 
-        case ETExp:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            result = exp( result );
-            break;
+                // The right operand of a comparison is over (a comparison
+                // can't follow: an error once the level is over)...
 
-        case ETPow:
-            result = EEvalAddends( eval, -1, false, true, NULL );
-            if( eval->error ) return 0;
-            result2 = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-            if( eval->error ) return 0;
-            result = pow( result, result2 );
-            break;
+                if( frame && frame->kind >= ETLt && frame->kind <= ETNe )
+                {
+                    sum = EEvalCompare( frame->kind, frame->value, sum );
 
-        case ETLog:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, true, &tokenThatCausedBreak );
-            if( eval->error ) return 0;
-            if( tokenThatCausedBreak == ETrbc )
-            {
-                // log(n) with one parameter
-                result = log( result );
-            }
-            else
-            {
-                result2 = EEvalAddends( eval, eval->roundBracketsCount - 1, false, false, NULL );
-                if( eval->error ) return 0;
-                result = log( result2 ) / log( result );
-            }
-            break;
+                    eval->depth--;
+                    frame = eval->depth ? &frames[ eval->depth - 1 ] : NULL;
+                }
+                else if( nextOp >= ETLt && nextOp <= ETNe )
+                {
+                    operator = nextOp;
+                }
 
-        case ETMax:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, true, &tokenThatCausedBreak );
-            if( eval->error ) return 0;
-            while( tokenThatCausedBreak == ETcom )
-            {
-                result2 = EEvalAddends( eval, eval->roundBracketsCount - 1, false, true, &tokenThatCausedBreak );
-                if( eval->error ) return 0;
+                // ...then the one of && (which precedes ||)...
 
-                if( result2 > result )
+                if( operator == ETErr && frame && frame->kind == ETAnd )
                 {
-                    result = result2;
+                    sum = frame->value != 0 && sum != 0;
+
+                    if( eval->skipping == eval->depth ) eval->skipping = 0;
+                    eval->depth--;
+                    frame = eval->depth ? &frames[ eval->depth - 1 ] : NULL;
                 }
-            }
-            break;
 
-        case ETMin:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, true, &tokenThatCausedBreak );
-            if( eval->error ) return 0;
-            while( tokenThatCausedBreak == ETcom )
-            {
-                result2 = EEvalAddends( eval, eval->roundBracketsCount - 1, false, true, &tokenThatCausedBreak );
-                if( eval->error ) return 0;
+                if( operator == ETErr && nextOp == ETAnd )
+                {
+                    operator = nextOp;
+                }
+
+                // ...then the one of ||
 
-                if( result2 < result )
+                if( operator == ETErr && frame && frame->kind == ETOr )
                 {
-                    result = result2;
+                    sum = frame->value != 0 || sum != 0;
+
+                    if( eval->skipping == eval->depth ) eval->skipping = 0;
+                    eval->depth--;
+                    frame = eval->depth ? &frames[ eval->depth - 1 ] : NULL;
                 }
-            }
-            break;
 
-        case ETAvg:
-            result = EEvalAddends( eval, eval->roundBracketsCount - 1, false, true, &tokenThatCausedBreak );
-            if( eval->error ) return 0;
-            count = 1;
-            while( tokenThatCausedBreak == ETcom )
-            {
-                result2 = EEvalAddends( eval, eval->roundBracketsCount - 1, false, true, &tokenThatCausedBreak );
-                if( eval->error ) return 0;
+                if( operator == ETErr && nextOp == ETOr )
+                {
+                    operator = nextOp;
+                }
 
-                result += result2;
-                count++;
-            }
-            result = result / (double)count;
-            break;
+                // An operator follows: the sum is its left operand,
+                // the right one is evaluated as the rest of the level
+                // (not computed if the left one decides)
 
-        default:
-            result = 0;
-            break;
-    }
+                if( operator != ETErr )
+                {
+                    if( ! EEvalEnter( eval ) ) return 0;
+
+                    frame = &frames[ eval->depth - 1 ];
+                    frame->kind      = operator;
+                    frame->sumOp     = ETSum;
+                    frame->productOp = ETMul;
+                    frame->count     = 0;
+                    frame->function  = 0;
+                    frame->sum       = 0;
+                    frame->product   = 1;
+                    frame->sign      = 1;
+                    frame->value     = sum;
+
+                    if( ! eval->skipping && ( operator == ETAnd ? sum == 0 : operator == ETOr && sum != 0 ) )
+                    {
+                        eval->skipping = eval->depth;
+                    }
 
-    if( eexception( result ) )
-    {
-        eval->error = "result is complex or too big";
-        return 0;
-    }
+                    operator = ETErr;
 
-    return result;
-}
+                    sum = 0;
+                    sumOp = ETSum;
+                    product = 1;
+                    productOp = ETMul;
+                    step = ESFactor;
+                    break;
+                }
 
+                // fall through
 
+            case ESLevel:
 
-// Evaluates an exponentiation.
+                // A round close bracket:
+                // check for negative count.
 
-double EEvalExponentiation( EEvaluation *eval,
-                            double      base,      // The base has already been fetched;
-                            EEToken     *rightOp ) // RETURN: the token (operator) that follows.
-{
-    double exponent,
-           result;
+                if( nextOp == ETrbc )
+                {
+                    eval->roundBracketsCount--;
+                    if( eval->roundBracketsCount < 0 )
+                    {
+                        eval->error = "unexpected close round bracket";
+                        return 0;
+                    }
+                }
 
-    exponent = EEvalFactors( eval, 1, ETMul, true, rightOp );
-    if( eval->error ) return 0;
+                // Check if the level is over: the expression at the end,
+                // brackets at the close bracket, arguments at the close
+                // bracket (if the function has enough) or at a comma
+                // (if the function takes more)
 
-    result = pow( base, exponent );
-    if( eexception( result ) )
-    {
-        eval->error = "result is complex or too big";
-        return 0;
-    }
+                if( ! frame )
+                {
+                    done = nextOp == ETEof;
+                }
+                else if( frame->kind == ETFun )
+                {
+                    function = &EEFunctions[ frame->function ];
 
-    return result;
-}
+                    if( nextOp == ETrbc )
+                    {
+                        done = frame->count + 1 >= function->minimum;
+                    }
+                    else
+                    {
+                        done = nextOp == ETcom && ( function->maximum == EEVariadic || frame->count + 1 < function->maximum );
+                    }
+                }
+                else
+                {
+                    done = nextOp == ETrbc;
+                }
 
+                // If not it's an error.
 
+                if( ! done )
+                {
+                    switch( nextOp )
+                    {
+                        case ETEof:
+                            eval->error = "unexpected end of expression";
+                            break;
 
-// Evaluates a factorial using the Gamma function.
+                        case ETrbc:
+                            eval->error = "unexpected close round bracket";
+                            break;
 
-double EEvalFactorial( EEvaluation *eval,
-                       double      value,     // The value to compute has already been fetched;
-                       EEToken     *rightOp ) // RETURN: the token (operator) that follows.
-{
-    double result;
+                        case ETcom:
+                            eval->error = "unexpeced comma";
+                            break;
+
+                        default:
+                            eval->error = "unexpeced symbol";
+                            break;
+                    }
+
+                    return 0;
+                }
+
+                if( EEvalException( eval, sum ) )
+                {
+                    eval->error = "result is complex or too big";
+                    return 0;
+                }
+
+                if( ! frame ) return sum;
+
+                // The next argument of the function ?
+
+                if( frame->kind == ETFun )
+                {
+                    if( EEvalArgument( eval, frame, sum, nextOp, arguments ) )
+                    {
+                        sum = 0;
+                        sumOp = ETSum;
+                        product = 1;
+                        productOp = ETMul;
+                        step = ESFactor;
+                        break;
+                    }
+
+                    if( eval->error ) return 0;
+
+                    sum = frame->value;
+                }
+
+                // The brackets (function) are the value
+                // of a factor of the level below
+
+                value     = sum;
+                sumOp     = frame->sumOp;
+                productOp = frame->productOp;
+                sum       = frame->sum;
+                product   = frame->product;
+                sign      = frame->sign;
+
+                eval->depth--;
+                frame = eval->depth ? &frames[ eval->depth - 1 ] : NULL;
+
+                step = ESValue;
+                break;
+        }
+    }
+}
+
+
+
+// Takes the value of an argument of the function of `frame`
+// (`token` is the comma or the close bracket after it).
+// Returns true if the function takes another argument, false if the
+// function has been computed: the result is in `frame->value`.
+// The arguments of registered functions are kept in `arguments`
+// (the last `frame->count` ones are those of the function) and
+// passed all together once the last one is known.
+// if() keeps the condition in `frame->value` and skips the argument
+// not taken (see `eval->skipping`), then the value of the one taken.
+// While skipping nothing is computed: the result is 0.
+
+bool EEvalArgument( EEvaluation *eval,
+                    EEvalFrame  *frame,     // the function;
+                    double      value,      // the argument;
+                    EEToken     token,      // the token after the argument;
+                    double      *arguments )// the arguments of the registered functions being called.
+{
+    const EEFunction *function;
+    double           result,
+                     pair[ 2 ];
+
+    function = &EEFunctions[ frame->function ];
+    result = frame->value;
+
+    switch( function->opcode )
+    {
+        case EOMax:
+            if( frame->count++ == 0 || value > result )
+            {
+                result = value;
+            }
+            if( token == ETcom )
+            {
+                frame->value = result;
+                return true;
+            }
+            break;
+
+        case EOMin:
+            if( frame->count++ == 0 || value < result )
+            {
+                result = value;
+            }
+            if( token == ETcom )
+            {
+                frame->value = result;
+                return true;
+            }
+            break;
+
+        case EOAdd:
+            // average()
+            result = frame->count++ == 0 ? value : result + value;
+            if( token == ETcom )
+            {
+                frame->value = result;
+                return true;
+            }
+            result = result / (double)frame->count;
+            break;
+
+        case EOSel:
+            // if(): the condition, then the two branches
+
+            switch( frame->count++ )
+            {
+                case 0:
+                    frame->value = value;
+                    if( value == 0 && ! eval->skipping ) eval->skipping = eval->depth;
+                    return true;
+
+                case 1:
+                    if( result != 0 )
+                    {
+                        frame->value = value;
+                        if( ! eval->skipping ) eval->skipping = eval->depth;
+                    }
+                    else if( eval->skipping == eval->depth )
+                    {
+                        eval->skipping = 0;
+                    }
+                    return true;
+
+                default:
+                    if( eval->skipping == eval->depth )
+                    {
+                        eval->skipping = 0;
+                    }
+                    else
+                    {
+                        result = value;
+                    }
+                    break;
+            }
+            break;
+
+        case EOCall:
+            if( eval->arguments == eeval_max_arguments )
+            {
+                eval->error = "too many arguments";
+                return false;
+            }
+
+            arguments[ eval->arguments++ ] = value;
+            frame->count++;
+
+            if( token == ETcom ) return true;
+
+            eval->arguments -= frame->count;
+            result = eval->skipping ? 0 : function->scalar( arguments + eval->arguments, frame->count );
+            break;
+
+        default:
+            // Functions of one or two arguments (pow(), log()):
+            // the first of two is kept in the frame
+
+            if( token == ETcom )
+            {
+                frame->value = value;
+                frame->count++;
+                return true;
+            }
+
+            if( eval->skipping )
+            {
+                result = 0;
+                break;
+            }
+
+            if( function->opcode == EOFct && value < 0 )
+            {
+                eval->error = "attempt to evaluate factorial of negative number";
+                return false;
+            }
+
+            pair[ 0 ] = result;
+            pair[ 1 ] = value;
+
+            result = frame->count == 0 ? function->scalar( &value, 1 ) : function->scalar( pair, 2 );
+
+            if( function->opcode == EOPow ) EEStatsCount( eval, powers );
+            if( function->opcode == EOFct ) EEStatsCount( eval, factorials );
+            break;
+    }
+
+    if( EEvalException( eval, result ) )
+    {
+        eval->error = "result is complex or too big";
+        return false;
+    }
+
+    frame->value = result;
+
+    return false;
+}
+
+
+
+// Enters a level of nesting of the expression
+// (brackets, function or exponent).
+// Returns false if the expression is nested too deeply.
+
+bool EEvalEnter( EEvaluation *eval )
+{
+    if( ++eval->depth > eeval_max_depth )
+    {
+        eval->error = "expression is too deeply nested";
+        return false;
+    }
+
+    EEStatsDepth( eval );
+
+    return true;
+}
+
+
+
+// Evaluates a factorial using the Gamma function.
+
+double EEvalFactorial( EEvaluation *eval,
+                       double      value,     // The value to compute has already been fetched;
+                       EEToken     *rightOp ) // RETURN: the token (operator) that follows.
+{
+    double result;
+
+    if( eval->skipping )
+    {
+        EEvalToken( eval, rightOp );
+        return 0;
+    }
 
     if( value < 0 )
     {
@@ -533,8 +1020,9 @@ double EEvalFactorial( EEvaluation *eval,
     }
 
     result = tgamma( value + 1 );
+    EEStatsCount( eval, factorials );
 
-    if( eexception( result ) )
+    if( EEvalException( eval, result ) )
     {
         eval->error = "result is complex or too big";
         return 0;
@@ -548,22 +1036,61 @@ double EEvalFactorial( EEvaluation *eval,
 
 
 
+// Compares `a` with `b` by the comparison `op` (ETLt to ETNe).
+// Returns 1 if true, 0 if false.
+
+double EEvalCompare( EEToken op, double a, double b )
+{
+    switch( op )
+    {
+        case ETLt: return a <  b;
+        case ETLe: return a <= b;
+        case ETGt: return a >  b;
+        case ETGe: return a >= b;
+        case ETEq: return a == b;
+        default:   return a != b;
+    }
+}
+
+
+
 // Parses the next token and advances the cursor.
-// The function returns a number if the token is a value or a constant.
+// The function returns a number if the token is a value or a constant,
+// the index of the function in EEFunctions[] if the token is a function,
+// the index of the variable in the symbol table if the token is a variable.
 // Whitespace is ignored.
+// Keywords (functions and constants) must not be followed by letters,
+// digits or underscores: `pi2` is an identifier, not `pi` followed by `2`.
 
 double EEvalToken( EEvaluation *eval,
                    EEToken     *token ) // RETURN: the token.
 {
-    EEToken  t;
-    double   v;
+    EEToken         t;
+    double          v;
+    size_t          length;
+    uint8_t         c;
+    int32_t         index;
+    const EEKeyword *keyword;
+
+    #if eeval_statistics
+        eval->stats.tokens++;
+    #endif
 
     t = ETBlk;
     v = 0;
+    length = 0;
 
     while( t == ETBlk )
     {
-        if( ( *eval->cursor >= '0' && *eval->cursor <= '9' ) || *eval->cursor == '.' )
+        // The end of the expression reads as a null character
+
+        c = eval->cursor < eval->end ? (uint8_t)*eval->cursor : '\0';
+
+        if( EEvalCharClasses[ c ] & ELBlank )
+        {
+            eval->cursor = EEvalSkipBlanks( eval->cursor, eval->end );
+        }
+        else if( ( EEvalCharClasses[ c ] & ELDigit ) || c == '.' )
         {
             v = EEvalValue( eval );
             if( eval->error )
@@ -575,226 +1102,222 @@ double EEvalToken( EEvaluation *eval,
             {
                 t = ETVal;
             }
-            break;
         }
-        else
+        else if( EEvalCharTokens[ c ] == ETSum )
         {
-            switch( *eval->cursor )
+            EEvalPlusToken( eval, &t );
+        }
+        else if( EEvalCharClasses[ c ] & ELOperator )
+        {
+            EEvalOperatorToken( eval, &t );
+        }
+        else if( EEvalCharTokens[ c ] != ETBlk )
+        {
+            t = EEvalCharTokens[ c ];
+            eval->cursor++;
+        }
+        else if( EEvalCharClasses[ c ] & ELLetter )
+        {
+            length = EEvalIdentifierLength( eval->cursor, eval->end );
+            keyword = EEvalKeyword( eval->cursor, length );
+
+            if( keyword )
             {
-                case '\n':
-                case '\r':
-                case '\t':
-                case ' ':
-                    t = ETBlk;
-                    eval->cursor++;
-                    break;
+                t = keyword->token;
+                v = keyword->value;
+                eval->cursor += length;
+            }
+            else
+            {
+                t = ETErr;
+            }
+        }
+        else
+        {
+            t = ETErr;
+        }
+    }
 
-                case '+':
-                    EEvalPlusToken( eval, &t);
-                    break;
+    // An identifier that is not a keyword may be a registered
+    // function or else a variable of the symbol table.
 
-                case '-':
-                    t = ETSub;
-                    eval->cursor++;
-                    break;
+    if( t == ETErr && length > 0 )
+    {
+        index = EEFunctionsCount > EFBuiltInCount ? EEFunctionLookup( eval->cursor, length ) : -1;
 
-                case '*':
-                    t = ETMul;
-                    eval->cursor++;
-                    break;
+        if( index >= 0 )
+        {
+            t = ETFun;
+            v = index;
+            eval->cursor += length;
+        }
+        else
+        {
+            v = EEvalVariable( eval, length, &t );
+        }
+    }
 
-                case '/':
-                    t = ETDiv;
-                    eval->cursor++;
-                    break;
+    if( t == ETErr )
+    {
+        eval->error = "unexpected symbol";
+    }
 
-                case '^':
-                    t = ETExc;
-                    eval->cursor++;
-                    break;
+    *token = t;
 
-                case '!':
-                    t = ETFct;
-                    eval->cursor++;
-                    break;
+    return v;
+}
 
-                case '(':
-                    t = ETrbo;
-                    eval->cursor++;
-                    break;
 
-                case ')':
-                    t = ETrbc;
-                    eval->cursor++;
-                    break;
 
-                case '\0':
-                    t = ETEof;
-                    eval->cursor++;
-                    break;
+// Returns the length of the identifier at `cursor`:
+// a letter or underscore followed by letters, digits or underscores
+// (stops at `end`).
+// Returns 0 if `cursor` does not point to an identifier.
 
-                case ',':
-                    t = ETcom;
-                    eval->cursor++;
-                    break;
+size_t EEvalIdentifierLength( const char *cursor, const char *end )
+{
+    size_t length;
 
-                case 'e':
-                    if( strncmp( eval->cursor, "exp", 3 ) == 0 )
-                    {
-                        t = ETExp;
-                        eval->cursor += 3;
-                    }
-                    else
-                    {
-                        v = exp( 1 );
-                        t = ETVal;
-                        eval->cursor++;
-                    }
-                    break;
+    length = 0;
 
-                case 'f':
-                    if( strncmp( eval->cursor, "fact", 4 ) == 0 )
-                    {
-                        t = ETFac;
-                        eval->cursor += 4;
-                    }
-                    else
-                    {
-                        t = ETErr;
-                    }
-                    break;
+    if( cursor < end && ( EEvalCharClasses[ (uint8_t)cursor[ 0 ] ] & ELLetter ) )
+    {
+        do
+        {
+            length++;
+        }
+        while( cursor + length < end && ( EEvalCharClasses[ (uint8_t)cursor[ length ] ] & ELIdentifier ) );
+    }
 
-                case 'p':
-                    if( strncmp( eval->cursor, "pi", 2 ) == 0 )
-                    {
-                        v = M_PI;
-                        t = ETVal;
-                        eval->cursor += 2;
-                    }
-                    else if( strncmp( eval->cursor, "pow", 3 ) == 0 )
-                    {
-                        t = ETPow;
-                        eval->cursor += 3;
-                    }
-                    else
-                    {
-                        t = ETErr;
-                    }
-                    break;
+    return length;
+}
 
-                case 'c':
-                    if( strncmp( eval->cursor, "cos", 3 ) == 0 )
-                    {
-                        t = ETCos;
-                        eval->cursor += 3;
-                    }
-                    else
-                    {
-                        t = ETErr;
-                    }
-                    break;
 
-                case 's':
-                    if( strncmp( eval->cursor, "sin", 3 ) == 0 )
-                    {
-                        t = ETSin;
-                        eval->cursor += 3;
-                    }
-                    else
-                    {
-                        t = ETErr;
-                    }
-                    break;
 
-                case 't':
-                    if( strncmp( eval->cursor, "tan", 3 ) == 0 )
-                    {
-                        t = ETTan;
-                        eval->cursor += 3;
-                    }
-                    else
-                    {
-                        t = ETErr;
-                    }
-                    break;
+// Looks up the identifier of `length` characters at `cursor`
+// among the keywords: a single probe of the table by hash.
+// Returns NULL if it's not a keyword.
 
-                case 'l':
-                    if( strncmp( eval->cursor, "log", 3 ) == 0 )
-                    {
-                        t = ETLog;
-                        eval->cursor += 3;
-                    }
-                    else
-                    {
-                        t = ETErr;
-                    }
-                    break;
+const EEKeyword *EEvalKeyword( const char *cursor, size_t length )
+{
+    const EEKeyword *keyword;
 
-                case 'm':
-                    if( strncmp( eval->cursor, "max", 3 ) == 0 )
-                    {
-                        t = ETMax;
-                        eval->cursor += 3;
-                    }
-                    else if( strncmp( eval->cursor, "min", 3 ) == 0 )
-                    {
-                        t = ETMin;
-                        eval->cursor += 3;
-                    }
-                    else
-                    {
-                        t = ETErr;
-                    }
-                    break;
+    keyword = &EEvalKeywords[ EEKeywordHash( (uint8_t)cursor[ 0 ], length > 1 ? (uint8_t)cursor[ 1 ] : 0, length ) ];
 
-                case 'a':
-                    if( strncmp( eval->cursor, "asin", 4 ) == 0 )
-                    {
-                        t = ETASi;
-                        eval->cursor += 4;
-                    }
-                    else if( strncmp( eval->cursor, "acos", 4 ) == 0 )
-                    {
-                        t = ETACo;
-                        eval->cursor += 4;
-                    }
-                    else if( strncmp( eval->cursor, "atan", 4 ) == 0 )
-                    {
-                        t = ETATa;
-                        eval->cursor += 4;
-                    }
-                    else if( strncmp( eval->cursor, "average", 7 ) == 0 )
-                    {
-                        t = ETAvg;
-                        eval->cursor += 7;
-                    }
-                    else if( strncmp( eval->cursor, "avg", 3 ) == 0 )
-                    {
-                        t = ETAvg;
-                        eval->cursor += 3;
-                    }
-                    else
-                    {
-                        t = ETErr;
-                    }
-                    break;
+    if( keyword->length == length && memcmp( keyword->name, cursor, length ) == 0 )
+    {
+        return keyword;
+    }
 
+    return NULL;
+}
 
-                default:
-                    t = ETErr;
-                    break;
-            }
+
+
+// Returns the first character from `cursor` that is not blank
+// (or `end`). Blanks are mostly single spaces: longer runs
+// (indentation, line breaks of long generated expressions)
+// are skipped 16 characters at a time.
+
+const char *EEvalSkipBlanks( const char *cursor, const char *end )
+{
+    #if eeval_vector_lexer
+        __m128i  characters,
+                 blanks;
+        unsigned mask;
+    #endif
+
+    if( cursor < end && ( EEvalCharClasses[ (uint8_t)*cursor ] & ELBlank ) ) cursor++;
+
+    #if eeval_vector_lexer
+        while( end - cursor >= 16 )
+        {
+            characters = _mm_loadu_si128( (const __m128i *)cursor );
+
+            blanks = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( characters, _mm_set1_epi8( ' ' ) ),
+                                                 _mm_cmpeq_epi8( characters, _mm_set1_epi8( '\t' ) ) ),
+                                   _mm_or_si128( _mm_cmpeq_epi8( characters, _mm_set1_epi8( '\n' ) ),
+                                                 _mm_cmpeq_epi8( characters, _mm_set1_epi8( '\r' ) ) ) );
+
+            mask = ~(unsigned)_mm_movemask_epi8( blanks ) & 0xFFFF;
+            if( mask ) return cursor + __builtin_ctz( mask );
+
+            cursor += 16;
         }
-    }
+    #endif
 
-    if( t == ETErr )
+    while( cursor < end && ( EEvalCharClasses[ (uint8_t)*cursor ] & ELBlank ) ) cursor++;
+
+    return cursor;
+}
+
+
+
+// Returns the first character from `cursor` that is not
+// a decimal digit (or `end`): long runs of digits
+// are skipped 16 characters at a time.
+
+const char *EEvalSkipDigits( const char *cursor, const char *end )
+{
+    #if eeval_vector_lexer
+        __m128i  characters;
+        unsigned mask;
+
+        while( end - cursor >= 16 )
+        {
+            // Digits are the characters at most 9 above '0'
+
+            characters = _mm_sub_epi8( _mm_loadu_si128( (const __m128i *)cursor ), _mm_set1_epi8( '0' ) );
+            mask = ~(unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( characters, _mm_set1_epi8( 9 ) ), characters ) ) & 0xFFFF;
+            if( mask ) return cursor + __builtin_ctz( mask );
+
+            cursor += 16;
+        }
+    #endif
+
+    while( cursor < end && ( EEvalCharClasses[ (uint8_t)*cursor ] & ELDigit ) ) cursor++;
+
+    return cursor;
+}
+
+
+
+// Looks up the identifier of `length` characters at the cursor
+// among the names bound by the statements compiled so far
+// (see EECompileStatements()), then in the symbol table.
+// If found advances the cursor, sets the token to ETBnd
+// or ETVar and returns the index of the name or of the variable.
+// If not found the token is left unchanged.
+
+double EEvalVariable( EEvaluation *eval,
+                      size_t      length,  // length of the identifier;
+                      EEToken     *token ) // RETURN: the token.
+{
+    int32_t i;
+
+    for( i = 0; i < eval->bindingsCount; i++ )
     {
-        eval->error = "unexpected symbol";
+        if( eval->bindings[ i ].length == length && strncmp( eval->bindings[ i ].name, eval->cursor, length ) == 0 )
+        {
+            *token = ETBnd;
+            eval->cursor += length;
+            return i;
+        }
     }
 
-    *token = t;
+    if( ! eval->symbols ) return 0;
 
-    return v;
+    for( i = 0; i < eval->symbols->count; i++ )
+    {
+        if( strncmp( eval->symbols->variables[ i ].name, eval->cursor, length ) == 0 && eval->symbols->variables[ i ].name[ length ] == '\0' )
+        {
+            *token = ETVar;
+            eval->cursor += length;
+            return i;
+        }
+    }
+
+    return 0;
 }
 
 
@@ -808,12 +1331,9 @@ double EEvalToken( EEvaluation *eval,
 
 double EEvalPlusToken( EEvaluation *eval, EEToken *token )
 {
-    do
-    {
-        eval->cursor++;
-    } while( *eval->cursor == ' ' || *eval->cursor == '\n' || *eval->cursor == '\r' || *eval->cursor == '\t' );
+    eval->cursor = EEvalSkipBlanks( eval->cursor + 1, eval->end );
 
-    if( *eval->cursor == '+' )
+    if( eval->cursor < eval->end && *eval->cursor == '+' )
     {
         *token = ETErr;
     }
@@ -827,27 +1347,73 @@ double EEvalPlusToken( EEvaluation *eval, EEToken *token )
 
 
 
+// Parses a comparison or logical operator (a factorial
+// if `!` is not followed by `=`) and advances the cursor.
+// `=`, `&` and `|` alone are not operators (the cursor stays).
+// Always returns 0.
+
+double EEvalOperatorToken( EEvaluation *eval, EEToken *token )
+{
+    char first,
+         second;
+
+    first = *eval->cursor;
+    second = eval->cursor + 1 < eval->end ? eval->cursor[ 1 ] : '\0';
+
+    *token = EEvalCharTokens[ (uint8_t)first ];
+
+    if( second == '=' && first != '&' && first != '|' )
+    {
+        switch( first )
+        {
+            case '<': *token = ETLe; break;
+            case '>': *token = ETGe; break;
+            case '=': *token = ETEq; break;
+            default:  *token = ETNe; break;
+        }
+        eval->cursor += 2;
+    }
+    else if( second == first && ( first == '&' || first == '|' ) )
+    {
+        eval->cursor += 2;
+    }
+    else if( first == '=' || first == '&' || first == '|' )
+    {
+        *token = ETErr;
+    }
+    else
+    {
+        eval->cursor++;
+    }
+
+    return 0;
+}
+
+
+
 // Parses a number and advances the cursor.
 // The cursor is positioned after an eventually
 // `+` or `-` operator that comes before the value.
 
 double EEvalValue( EEvaluation *eval )
 {
-    char   *endptr;
+    size_t length;
     double value;
 
-    value = strtod( eval->cursor, &endptr );
+    length = EENumberParse( eval->cursor, eval->end, &value );
 
-    if( endptr == eval->cursor )
+    if( length == 0 )
     {
         eval->error = "expected value";
         value = 0;
     }
     else
     {
-        eval->cursor = endptr;
+        eval->cursor += length;
 
-        if( eexception( value ) )
+        // Whatever the policy (not an exception of an operation)
+
+        if( ! isfinite( value ) )
         {
             eval->error = "value is too big";
             return 0;
@@ -855,4 +1421,176 @@ double EEvalValue( EEvaluation *eval )
     }
 
     return value;
-}
\ No newline at end of file
+}
+
+
+
+// Returns the time in nanoseconds taken to read the tokens of an
+// evaluation (or of a compilation) that just ended: from the beginning
+// of the expression to its end, or to the error. Lexing is interleaved
+// with parsing and computing and a clock read costs more than a token,
+// so the tokens are read again as a whole (not counted), with a single
+// clock read before and after them (see EEPrintStats()).
+// Never more than the total time of the evaluation.
+
+uint64_t EEStatsLexing( const EEvaluation *eval )
+{
+    #if eeval_statistics
+        EEvaluation lexer;
+        EEToken     token;
+        size_t      length;
+        uint64_t    start,
+                    elapsed;
+
+        memset( &lexer, 0, sizeof( EEvaluation ) );
+        lexer.expression = lexer.cursor = eval->expression;
+        lexer.end = eval->error && eval->cursor < eval->end ? eval->cursor : eval->end;
+        lexer.symbols = eval->symbols;
+
+        start = EEStatsNow();
+
+        for( ;; )
+        {
+            EEvalToken( &lexer, &token );
+            if( token == ETEof ) break;
+
+            // Names bound by statements and the `=` and `;` of the
+            // statements are not tokens (see EECompileStatements())
+
+            if( token == ETErr )
+            {
+                length = EEvalIdentifierLength( lexer.cursor, lexer.end );
+                lexer.cursor += length ? length : 1;
+                lexer.error = NULL;
+            }
+        }
+
+        elapsed = EEStatsNow() - start;
+
+        return elapsed < eval->stats.totalTime ? elapsed : eval->stats.totalTime;
+    #else
+        return 0;
+    #endif
+}
+
+
+
+// Returns the time in nanoseconds from an arbitrary
+// point in the past (for statistics).
+
+uint64_t EEStatsNow( void )
+{
+    #if eeval_statistics
+        struct timespec now;
+
+        clock_gettime( CLOCK_MONOTONIC, &now );
+
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    #else
+        return 0;
+    #endif
+}
+
+
+
+// Computes `base ^ exponent` in compiled programs as pow() does
+// (EEvaluate() always calls pow()).
+// With strength reduction (opt-in), exponents from 2 to EEPowerMaxExponent
+// are computed by squaring and multiplying (the result may differ from the
+// pow() one by up to 2 ULP for x^4) and exponent 0.5 by sqrt() (correctly
+// rounded, it differs from pow() on -0 and -inf too).
+// Compiled programs with a constant exponent emit the same operations
+// (see EEOptimizeReduce()), so they agree with each other, not with EEvaluate().
+
+double EEPower( double base, double exponent )
+{
+    #if eeval_strength_reduction
+        double power;
+        int    n;
+
+        if( exponent >= 2 && exponent <= EEPowerMaxExponent && exponent == (int)exponent )
+        {
+            power = 1;
+
+            for( n = (int)exponent; n > 0; n >>= 1 )
+            {
+                if( n & 1 ) power *= base;
+                if( n > 1 ) base *= base;
+            }
+
+            return power;
+        }
+
+        if( exponent == 0.5 ) return sqrt( base );
+    #endif
+
+    return pow( base, exponent );
+}
+
+
+
+// n! for n from 0 to 170 (correctly rounded), used by EEFactorial()
+// and the vectorized fact kernels (eeval_vector.h)
+
+const double EEFactorials[ 171 ] =
+{
+    1, 1, 2, 6,
+    24, 120, 720, 5040,
+    40320, 362880, 3628800, 39916800,
+    479001600, 6227020800, 87178291200, 1307674368000,
+    20922789888000, 355687428096000, 6402373705728000, 1.21645100408832e+17,
+    2.43290200817664e+18, 5.109094217170944e+19, 1.1240007277776077e+21, 2.5852016738884978e+22,
+    6.2044840173323941e+23, 1.5511210043330986e+25, 4.0329146112660565e+26, 1.0888869450418352e+28,
+    3.0488834461171387e+29, 8.8417619937397019e+30, 2.6525285981219107e+32, 8.2228386541779224e+33,
+    2.6313083693369352e+35, 8.6833176188118859e+36, 2.9523279903960416e+38, 1.0333147966386145e+40,
+    3.7199332678990125e+41, 1.3763753091226346e+43, 5.2302261746660112e+44, 2.0397882081197444e+46,
+    8.1591528324789768e+47, 3.3452526613163808e+49, 1.40500611775288e+51, 6.0415263063373834e+52,
+    2.6582715747884489e+54, 1.1962222086548019e+56, 5.5026221598120892e+57, 2.5862324151116818e+59,
+    1.2413915592536073e+61, 6.0828186403426752e+62, 3.0414093201713376e+64, 1.5511187532873822e+66,
+    8.0658175170943877e+67, 4.2748832840600255e+69, 2.3084369733924138e+71, 1.2696403353658276e+73,
+    7.1099858780486348e+74, 4.0526919504877214e+76, 2.3505613312828785e+78, 1.3868311854568984e+80,
+    8.3209871127413899e+81, 5.0758021387722484e+83, 3.1469973260387939e+85, 1.9826083154044401e+87,
+    1.2688693218588417e+89, 8.2476505920824715e+90, 5.4434493907744307e+92, 3.6471110918188683e+94,
+    2.4800355424368305e+96, 1.711224524281413e+98, 1.1978571669969892e+100, 8.504785885678623e+101,
+    6.1234458376886085e+103, 4.4701154615126844e+105, 3.3078854415193862e+107, 2.48091408113954e+109,
+    1.8854947016660504e+111, 1.4518309202828587e+113, 1.1324281178206297e+115, 8.9461821307829757e+116,
+    7.1569457046263806e+118, 5.7971260207473678e+120, 4.753643337012842e+122, 3.9455239697206588e+124,
+    3.3142401345653532e+126, 2.8171041143805501e+128, 2.4227095383672734e+130, 2.1077572983795279e+132,
+    1.8548264225739844e+134, 1.650795516090846e+136, 1.4857159644817615e+138, 1.3520015276784029e+140,
+    1.2438414054641308e+142, 1.1567725070816416e+144, 1.0873661566567431e+146, 1.0329978488239059e+148,
+    9.9167793487094965e+149, 9.619275968248212e+151, 9.426890448883248e+153, 9.3326215443944153e+155,
+    9.3326215443944151e+157, 9.4259477598383599e+159, 9.6144667150351271e+161, 9.9029007164861805e+163,
+    1.0299016745145628e+166, 1.081396758240291e+168, 1.1462805637347084e+170, 1.226520203196138e+172,
+    1.324641819451829e+174, 1.4438595832024937e+176, 1.588245541522743e+178, 1.7629525510902446e+180,
+    1.974506857221074e+182, 2.2311927486598138e+184, 2.5435597334721877e+186, 2.925093693493016e+188,
+    3.3931086844518981e+190, 3.9699371608087211e+192, 4.6845258497542909e+194, 5.5745857612076058e+196,
+    6.6895029134491271e+198, 8.0942985252734441e+200, 9.8750442008336011e+202, 1.2146304367025329e+205,
+    1.5061417415111409e+207, 1.8826771768889261e+209, 2.3721732428800469e+211, 3.0126600184576594e+213,
+    3.8562048236258041e+215, 4.9745042224772875e+217, 6.4668554892204741e+219, 8.4715806908788206e+221,
+    1.1182486511960043e+224, 1.4872707060906857e+226, 1.9929427461615188e+228, 2.6904727073180504e+230,
+    3.6590428819525489e+232, 5.012888748274992e+234, 6.9177864726194886e+236, 9.6157231969410894e+238,
+    1.3462012475717526e+241, 1.8981437590761709e+243, 2.6953641378881629e+245, 3.8543707171800731e+247,
+    5.5502938327393044e+249, 8.0479260574719917e+251, 1.1749972043909107e+254, 1.7272458904546389e+256,
+    2.5563239178728654e+258, 3.8089226376305698e+260, 5.7133839564458547e+262, 8.62720977423324e+264,
+    1.3113358856834524e+267, 2.0063439050956823e+269, 3.0897696138473508e+271, 4.7891429014633941e+273,
+    7.4710629262828942e+275, 1.1729568794264145e+278, 1.853271869493735e+280, 2.9467022724950384e+282,
+    4.7147236359920616e+284, 7.590705053947219e+286, 1.2296942187394494e+289, 2.0044015765453026e+291,
+    3.2872185855342959e+293, 5.4239106661315887e+295, 9.0036917057784375e+297, 1.5036165148649991e+300,
+    2.5260757449731984e+302, 4.2690680090047051e+304, 7.257415615307999e+306
+};
+
+
+
+// Computes `value!` in compiled programs as tgamma( value + 1 ) does
+// (EEvaluate() always calls tgamma()).
+// With strength reduction (opt-in), factorials of integers up to 170
+// come from a table (correctly rounded, tgamma() may differ by a few ULP).
+
+double EEFactorial( double value )
+{
+    #if eeval_strength_reduction
+        if( value >= 0 && value <= 170 && value == (int)value ) return EEFactorials[ (int)value ];
+    #endif
+
+    return tgamma( value + 1 );
+}
@@ -20,6 +20,7 @@
 
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <inttypes.h>
 
 
@@ -37,14 +38,155 @@
 // FLOATING POINT EXCEPTIONS CATCHING
 
 // leave to true (default) to catch exceptions on math operations (ex. overflows)
+// (how is chosen for each evaluation, see EEvaluatePolicy())
+// set to false to compile the checks out: results can be NaN or infinite
+#ifndef eeval_catch_fp_exceptions
 #define eeval_catch_fp_exceptions true
+#endif
+
+
+// VECTORIZED MATH IN BATCH EVALUATION
+
+// leave to true (default) to compute functions with vectorized kernels in EEvaluateBatch()
+// (faster, results may differ from the C math library ones by a few ULP - see eeval_vector.c)
+// set to false to compute them with the C math library as EEvaluate() and EEExecute() do
+// (requires GCC or Clang)
+#ifndef eeval_vector_math
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define eeval_vector_math true
+#else
+#define eeval_vector_math false
+#endif
+#endif
+
+
+// NATIVE CODE (JIT)
+
+// leave to true (default) to let EEJitCompile() translate compiled programs into native code
+// set to false to always interpret compiled programs
+// (requires GCC or Clang, x86-64 and a System V platform: Linux, BSD, macOS)
+#ifndef eeval_jit
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && defined( __x86_64__ ) && ( defined( __unix__ ) || defined( __APPLE__ ) )
+#define eeval_jit true
+#else
+#define eeval_jit false
+#endif
+#endif
+
+
+// OPTIMIZATION OF COMPILED PROGRAMS
+
+// leave to true (default) to optimize programs compiled with EECompile() (see eeval_optimize.c)
+// set to false to execute programs as parsed
+#ifndef eeval_optimize
+#define eeval_optimize true
+#endif
+
+
+// COMPILED EXPRESSIONS CACHE
+
+// leave to true (default) to let EEvaluateCached() keep the programs it compiles
+// in a cache shared by the threads of the process (see eeval_cache.c)
+// set to false to compile expressions on each call
+// (requires GCC or Clang and POSIX threads)
+#ifndef eeval_cache
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && ( defined( __unix__ ) || defined( __APPLE__ ) )
+#define eeval_cache true
+#else
+#define eeval_cache false
+#endif
+#endif
+
+// default memory cap of the cache in bytes (see EECacheLimit())
+#ifndef eeval_cache_memory
+#define eeval_cache_memory ( 64 * 1024 * 1024 )
+#endif
+
+
+// MODELS
+
+// leave to true (default) to let EEModelUpdate() recompute independent cells
+// in parallel (see eeval_model.c)
+// set to false to always recompute them in the calling thread
+// (requires POSIX threads)
+#ifndef eeval_model_threads
+#if defined( __unix__ ) || defined( __APPLE__ )
+#define eeval_model_threads true
+#else
+#define eeval_model_threads false
+#endif
+#endif
+
+
+// STRENGTH REDUCTION
+
+// set to true to let compiled programs compute powers with exponents 2, 3, 4 by multiplication,
+// powers with exponent 0.5 by sqrt() and factorials of integers up to 170 from a table
+// (faster, results may differ from the pow() and tgamma() ones, and so from EEvaluate(),
+// by a few ULP - see EEPower())
+// leave to false (default) to always compute them with pow() and tgamma() as EEvaluate() does
+#ifndef eeval_strength_reduction
+#define eeval_strength_reduction false
+#endif
+
+
+// VECTORIZED LEXER
+
+// leave to true (default) to skip runs of blanks and digits 16 characters at a time
+// with SSE2 instructions (faster on long expressions)
+// set to false to skip them one character at a time
+// (requires GCC or Clang and SSE2)
+#ifndef eeval_vector_lexer
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && defined( __SSE2__ )
+#define eeval_vector_lexer true
+#else
+#define eeval_vector_lexer false
+#endif
+#endif
+
+
+// STATISTICS
+
+// set to true to let EEvaluate(), EEvaluateN() and EECompile() count what they do
+// in the `stats` member of EEvaluation (tokens, depth, function calls, time...)
+// leave to false (default) to compile the counters out (see README.md for details)
+// (requires POSIX: time is measured with clock_gettime())
+#ifndef eeval_statistics
+#define eeval_statistics false
+#endif
+
+
+// MAXIMUM NESTING
+
+// the deepest nesting of brackets, function calls and exponents (`2^3^4...`)
+// of an expression: deeper expressions fail with an error instead of exhausting the stack
+// (EEvaluate() keeps a stack of this many levels, 48 bytes each)
+#ifndef eeval_max_depth
+#define eeval_max_depth 1000
+#endif
+
+
+// REGISTERED FUNCTIONS
+
+// the most functions of the registry, built-in ones included (see EERegisterFunction())
+#ifndef eeval_max_functions
+#define eeval_max_functions 256
+#endif
+
+// the most arguments of registered functions collected at once (nested calls included):
+// more fail with an error (EEvaluate() and EEExecute() keep an array of this many doubles)
+#ifndef eeval_max_arguments
+#define eeval_max_arguments 256
+#endif
 
 
 // PRECEDENCE OF UNARY MINUS OPERATOR
 
 // leave to true (default) to give unitary minus highest precedece like in most programming languages
 // set to false to give lowest precedence like in math notation (see README.md for details)
+#ifndef eeval_unary_minus_has_highest_precedence
 #define eeval_unary_minus_has_highest_precedence true
+#endif
 
 
 
@@ -62,28 +204,85 @@ enum EEToken
     ETDiv,   // /
     ETExc,   // ^ exponentiation
     ETFct,   // ! factorial
-    ETSin,   // sin(r)
-    ETCos,   // cos(r)
-    ETTan,   // tan(r)
-    ETASi,   // arcsin(n)
-    ETACo,   // arccos(n)
-    ETATa,   // arctan(n)
-    ETFac,   // fact(n) - factorial, equivalent to n!
-    ETExp,   // exp(n) - equivalent to e^n
-    ETPow,   // pow(b,n) - equivalent to b^n
-    ETLog,   // log(b, n) logarithm of n with base b - or log(n) natural logarithm of n
-    ETMax,   // max(n1, n2, n3...) maximum of 1 or more numbers
-    ETMin,   // min(n1, n2, n3...) minimum of 1 or more numbers
-    ETAvg,   // average(n1, n2, n3...) or avg(n1, ...) average of 1 or more numbers
+    ETFun,   // a function, built-in or registered (its index in EEFunctions[])
     ETrbo,   // round bracket open  (round bracket count increases)
     ETrbc,   // round bracket close (round bracket count decreases)
     ETcom,   // comma - argument separator inside functions
-    ETVal    // a number in scientific notation (1 .1 0.1 1.2E-3) or `e` (euler number) or `pi`
+    ETLt,    // <  comparisons (ETLt...ETNe): 1 if true, 0 if false
+    ETLe,    // <=
+    ETGt,    // >
+    ETGe,    // >=
+    ETEq,    // ==
+    ETNe,    // !=
+    ETAnd,   // && logical and (the right operand only if the left one is not 0)
+    ETOr,    // || logical or  (the right operand only if the left one is 0)
+    ETVal,   // a number in scientific notation (1 .1 0.1 1.2E-3) or `e` (euler number) or `pi`
+    ETVar,   // a variable of the symbol table
+    ETBnd    // a name bound by a statement of the program being compiled (see EECompileStatements())
 };
 typedef enum EEToken EEToken;
 
 
 
+// lexer: classes of characters (bits of EEvalCharClasses[])
+
+enum EECharClass
+{
+    ELBlank      = 1,  // white space, tab, newline, carriage return
+    ELDigit      = 2,  // 0...9
+    ELLetter     = 4,  // first character of identifiers: a...z A...Z _
+    ELIdentifier = 8,  // other characters of identifiers: letters, digits, _
+    ELOperator   = 16  // first character of comparison and logical operators: < > = ! & |
+};
+typedef enum EECharClass EECharClass;
+
+
+
+// functions: the built-in ones at the beginning of the registry
+// (their index in EEFunctions[])
+
+enum EEBuiltIn
+{
+    EFSin,   // sin(r)
+    EFCos,   // cos(r)
+    EFTan,   // tan(r)
+    EFASi,   // arcsin(n)
+    EFACo,   // arccos(n)
+    EFATa,   // arctan(n)
+    EFFac,   // fact(n) - factorial, equivalent to n!
+    EFExp,   // exp(n) - equivalent to e^n
+    EFPow,   // pow(b,n) - equivalent to b^n
+    EFLog,   // log(b, n) logarithm of n with base b - or log(n) natural logarithm of n
+    EFMax,   // max(n1, n2, n3...) maximum of 1 or more numbers
+    EFMin,   // min(n1, n2, n3...) minimum of 1 or more numbers
+    EFAvg,   // average(n1, n2, n3...) or avg(n1, ...) average of 1 or more numbers
+    EFIf,    // if(c, a, b) a if c is not 0, otherwise b (only one of them is computed)
+    EFBuiltInCount
+};
+typedef enum EEBuiltIn EEBuiltIn;
+
+
+
+// lexer: keywords (functions and constants) by hash
+
+struct EEKeyword
+{
+    const char *name;
+    size_t     length;
+    EEToken    token;
+    double     value;  // of constants (ETVal), the index of functions (ETFun)
+};
+typedef struct EEKeyword EEKeyword;
+
+// the hash of a keyword of `length` characters beginning with `first`
+// and `second` (0 if a single character): there are no collisions
+// among the keywords
+
+#define EEKeywordsCount 32
+#define EEKeywordHash( first, second, length ) ( ( 4 * (first) + 3 * (second) + 5 * (length) ) & ( EEKeywordsCount - 1 ) )
+
+
+
 enum EEvalStatus
 {
     EEvalFailure = 0,
@@ -93,46 +292,794 @@ typedef enum EEvalStatus EEvalStatus;
 
 
 
+// floating point exceptions: how they are caught (see EEvaluatePolicy())
+
+enum EEvalPolicy
+{
+    EPStrict,   // the result of each operation is checked: the first NaN or infinity fails, where it occurs
+    EPDeferred, // no checks while evaluating: fails at the end if an operation raised an exception flag
+    EPOff       // no checks: results can be NaN or infinite
+};
+typedef enum EEvalPolicy EEvalPolicy;
+
+
+
+// compiled programs: opcodes
+
+enum EEOpcode
+{
+    EOAdd,   // a + b
+    EOSub,   // a - b
+    EOMul,   // a * b
+    EODiv,   // a / b - fails on division by zero
+    EONeg,   // -a
+    EOPow,   // a ^ b
+    EOFct,   // a! - fails on negative numbers
+    EOSin,   // sin(a)
+    EOCos,   // cos(a)
+    EOTan,   // tan(a)
+    EOASi,   // arcsin(a)
+    EOACo,   // arccos(a)
+    EOATa,   // arctan(a)
+    EOExp,   // exp(a)
+    EOLog,   // log(a) natural logarithm of a
+    EOSqt,   // sqrt(a) - a ^ 0.5 (see EEOptimizeReduce())
+    EOLgb,   // log(a, b) logarithm of b with base a
+    EOMax,   // max(a, b)
+    EOMin,   // min(a, b)
+    EOVar,   // variable bound to the pointer at index a
+    EOSlt,   // variable bound to slot a
+    EOChk,   // a - checks again a value computed once and used twice (see EEProgramOptimize())
+    EOCall,  // registered function a (its index in EEFunctions[]) of the arguments at offset b (see EEProgram)
+    EOLt,    // a < b  - comparisons and logical operators: 1 if true, 0 if false
+    EOLe,    // a <= b
+    EOEq,    // a == b
+    EONe,    // a != b
+    EONot,   // a == 0
+    EOAnd,   // a != 0 && b != 0
+    EOOr,    // a != 0 || b != 0
+    EOSel    // the arguments at offset b: c, x, y - x if c is not 0, otherwise y (see EECompileFunction())
+};
+typedef enum EEOpcode EEOpcode;
+
+
+
+// compiled programs: checks performed on the result of an instruction
+
+enum EECheck
+{
+    ECNone,     // no check
+    ECTooBig,   // fails with "result is too big"
+    ECComplex   // fails with "result is complex or too big"
+};
+typedef enum EECheck EECheck;
+
+
+
+// compiled programs: while compiling, values are identified as follows:
+// constant `k` of the pool is `-1 - k`, the result of instruction `i` is `i`.
+// EEProgramFinalize() turns identifiers into registers.
+
+#define EENoValue INT32_MIN
+
+
+
+// strength reduction: the largest exponent of the powers computed by multiplication
+
+#define EEPowerMaxExponent 4
+
+
+
+// number parser: the powers of ten of the Eisel-Lemire table
+// and the significant digits copied for strtod() in the ambiguous cases
+
+#define EENumberMinExponent -348
+#define EENumberMaxExponent  347
+#define EENumberMaxDigits    800
+
+
+
+// compiled programs: a single instruction
+// `a` and `b` are the registers holding the operands
+// (the pointer index or the slot for variables),
+// the result is stored in the register that follows
+// the constants pool and the previous instructions.
+
+struct EEInstruction
+{
+    uint8_t     opcode;     // EEOpcode
+    uint8_t     check;      // EECheck
+    bool        safe;       // division or factorial that can't fail: the operand is not tested (see EEAnalyzeRanges())
+    int32_t     a;
+    int32_t     b;
+    int32_t     position;   // offset in the expression (to report errors)
+    int32_t     guard;      // the register that tells if the result is needed (-1 if always, see EECompileGuard())
+};
+typedef struct EEInstruction EEInstruction;
+
+
+
+// compiled programs: an expression parsed once and executed many times.
+// Registers are laid out as follows:
+// [ constants pool | result of instruction 0 | result of instruction 1 | ... ]
+// The arguments of each call of a registered function (EOCall) and
+// of each selection (EOSel) are listed in `arguments`: their count
+// followed by their registers.
+// Each statement that is not a `let` is an output (see EECompile()):
+// the result is the last one.
+
+struct EEProgram
+{
+    char            *expression;            // copy of the compiled expression
+    double          *constants;             // constants pool
+    int32_t         constantsCount;
+    int32_t         constantsCapacity;
+    EEInstruction   *instructions;          // instructions stream
+    int32_t         instructionsCount;
+    int32_t         instructionsCapacity;
+    int32_t         result;                 // register holding the result (the last output)
+    int32_t         *outputs;               // registers holding the outputs
+    char            **names;                // names of the outputs (NULL if not named)
+    int32_t         outputsCount;
+    int32_t         outputsCapacity;
+    double          **pointers;             // pointers of the variables bound by pointer
+    int32_t         pointersCount;
+    int32_t         pointersCapacity;
+    int32_t         slotsCount;             // highest slot referred to plus one
+    int32_t         *arguments;             // arguments of the calls of registered functions and of the selections
+    int32_t         argumentsCount;
+    int32_t         argumentsCapacity;
+    void            *native;                // native code generated by EEJitCompile() (NULL if none)
+    size_t          nativeSize;
+    size_t          nativeEntry;            // offset of the function in the native code
+    double          *registers;             // registers of large programs, constants loaded (see EEProgramRegisters())
+    int32_t         registersTaken;         // 1 while an execution uses them
+};
+typedef struct EEProgram EEProgram;
+
+
+
+// batch evaluation: the error of each row
+
+enum EEBatchError
+{
+    EBNone = 0, // success
+    EBDivision, // division by zero
+    EBFactorial,// attempt to evaluate factorial of negative number
+    EBTooBig,   // result is too big
+    EBComplex   // result is complex or too big
+};
+typedef enum EEBatchError EEBatchError;
+
+
+
+// batch evaluation: vectorized math kernels for an instruction set
+
+typedef void (*EEUnaryKernel)  ( const double *a, double *r, size_t m );
+typedef void (*EEBinaryKernel) ( const double *a, const double *b, double *r, size_t m );
+
+struct EEVectorKernels
+{
+    EEUnaryKernel   sin;
+    EEUnaryKernel   cos;
+    EEUnaryKernel   tan;
+    EEUnaryKernel   asin;
+    EEUnaryKernel   acos;
+    EEUnaryKernel   atan;
+    EEUnaryKernel   exp;
+    EEUnaryKernel   log;
+    EEUnaryKernel   fact;   // a! = tgamma(a + 1)
+    EEBinaryKernel  pow;
+    EEBinaryKernel  lgb;    // log(b) / log(a)
+    const char      *name;  // instruction set
+};
+typedef struct EEVectorKernels EEVectorKernels;
+
+
+
+// functions: a function of the registry (see EERegisterFunction())
+// the scalar function computes a single result from `count` arguments,
+// the batch one (optional) `m` results from `count` columns of `m` arguments
+
+#define EEVariadic -1
+
+typedef double (*EEScalarFunction) ( const double *arguments, int32_t count );
+typedef void   (*EEBatchFunction)  ( const double * const *arguments, int32_t count, double *r, size_t m );
+
+struct EEFunction
+{
+    const char          *name;
+    int32_t             minimum;    // arguments taken: from `minimum`...
+    int32_t             maximum;    // ...to `maximum` (EEVariadic if unlimited)
+    EEScalarFunction    scalar;
+    EEBatchFunction     batch;      // NULL to call the scalar function for each row
+    EEOpcode            opcode;     // instruction computing it (EOCall for the registered ones)
+};
+typedef struct EEFunction EEFunction;
+
+
+
+// range analysis: the range of a value (see EEAnalyzeRanges())
+
+struct EERange
+{
+    double min;     // the smallest value (can be -INFINITY)
+    double max;     // the largest value (can be INFINITY)
+    bool   nan;     // can be NaN too
+};
+typedef struct EERange EERange;
+
+// range analysis: a check removed and what it reported
+
+struct EERangeCheck
+{
+    int32_t position;   // offset in the expression (as errors)
+    uint8_t error;      // EEBatchError: the error it can no longer report
+};
+typedef struct EERangeCheck EERangeCheck;
+
+struct EERangeReport
+{
+    int32_t      checks;        // checks of the program (results, divisions, factorials)
+    int32_t      removedCount;  // checks removed
+    EERangeCheck *removed;      // the checks removed in order of execution (to release with free())
+};
+typedef struct EERangeReport EERangeReport;
+
+
+
+// native code: where a value is
+
+enum EEJitAddressKind
+{
+    EJXmm,      // an xmm register
+    EJMemory,   // memory at a base register plus displacement
+    EJPool      // the pool that precedes the code (rip-relative)
+};
+typedef enum EEJitAddressKind EEJitAddressKind;
+
+struct EEJitAddress
+{
+    EEJitAddressKind kind;
+    int              reg;           // xmm register or base register
+    int32_t          displacement;
+};
+typedef struct EEJitAddress EEJitAddress;
+
+
+
+// native code: why an instruction failed
+
+enum EEJitFailureKind
+{
+    EJDivision = 1, // division by zero
+    EJFactorial,    // factorial of negative number
+    EJCheck         // the check of the instruction (too big, complex)
+};
+typedef enum EEJitFailureKind EEJitFailureKind;
+
+struct EEJitFixup
+{
+    size_t  jump;   // offset of the displacement of the jump
+    int32_t code;   // value returned by the native code
+};
+typedef struct EEJitFixup EEJitFixup;
+
+
+
+// native code: the state of the code generator
+
+struct EEJit
+{
+    const EEProgram *program;
+    uint8_t         *code;
+    size_t          size;
+    size_t          capacity;
+    size_t          entry;                  // offset of the function (after the pool)
+    size_t          epilogue;
+    int32_t         *lastUse;               // last instruction reading the result of each instruction
+    int32_t         holder[ 16 ];           // instruction whose result is held by each xmm register (-1 if none)
+    bool            dirty[ 16 ];            // the value is not yet written to memory
+    EEJitFixup      *failures;
+    int32_t         failuresCount;
+    int32_t         failuresCapacity;
+    bool            error;                  // out of memory
+};
+typedef struct EEJit EEJit;
+
+
+
+// a variable of a symbol table: it is bound either
+// to a `double` in memory or to a slot (an index)
+// in the array of values passed on execution
+
+struct EEVariable
+{
+    const char  *name;      // identifier: letters, digits and underscores; can't begin with a digit
+    double      *pointer;   // the value is read from `*pointer`...
+    int32_t     slot;       // ...or, if `pointer` is NULL, from `slots[ slot ]`
+};
+typedef struct EEVariable EEVariable;
+
+
+
+// a symbol table: the variables that expressions can refer to
+
+struct EESymbols
+{
+    const EEVariable *variables;
+    int32_t          count;
+};
+typedef struct EESymbols EESymbols;
+
+
+
+// compiling: a name bound by a statement of a program (see EECompileStatements())
+
+struct EEBinding
+{
+    const char *name;       // in the expression (not null terminated)
+    size_t     length;
+    int32_t    value;       // the identifier of its value
+};
+typedef struct EEBinding EEBinding;
+
+
+
+// an expression with its numbers bound to slots (see EEBindNumbers())
+
+struct EEBound
+{
+    char        *expression;
+    size_t      length;
+    EEVariable  *variables;
+    char        *names;
+    double      *slots;     // the values of the numbers
+    EESymbols   symbols;
+};
+typedef struct EEBound EEBound;
+
+
+
+// evaluation: steps of EEvalExpression()
+
+enum EEvalStep
+{
+    ESFactor,   // a factor begins
+    ESValue,    // the value of a factor is known: factorial or exponent may follow
+    ESProduct,  // the factor is multiplied (divided) to the product of the addend
+    ESAddend,   // the addend is complete: added (subtracted) to the sum
+    ESLogic,    // the sum is complete: compared, and-ed or or-ed with the operand before it
+    ESLevel     // the level is complete (the steps follow in this order)
+};
+typedef enum EEvalStep EEvalStep;
+
+// evaluation: a level of nesting of the expression (see EEvalExpression()),
+// with the state of the level it's nested in
+
+struct EEvalFrame
+{
+    EEToken  kind;      // ETrbo (brackets), ETExc (exponent), ETFun (function) or the operator of a comparison, && or ||
+    EEToken  sumOp;     // the addend and the factor being evaluated by the level below
+    EEToken  productOp;
+    uint16_t count;     // function: arguments evaluated
+    int16_t  function;  // function: its index in EEFunctions[]
+    double   sum;
+    double   product;
+    double   sign;
+    double   value;     // exponent: the base; function: the result so far; operator: the left operand
+};
+typedef struct EEvalFrame EEvalFrame;
+
+
+
+// statistics of evaluations (see EEStatsAdd())
+
+#define EEStatsFunctions ( EFBuiltInCount + 1 )
+
+struct EEStats
+{
+    uint64_t evaluations;                   // evaluations counted
+    uint64_t tokens;                        // tokens lexed
+    int64_t  maxDepth;                      // the deepest nesting (brackets, function calls, exponents)
+    uint64_t calls[ EEStatsFunctions ];     // calls of each built-in function (by index), then of the registered ones
+    uint64_t powers;                        // powers computed: pow() calls
+    uint64_t factorials;                    // factorials computed: tgamma() calls
+    uint64_t checks;                        // results checked by eexception()
+    uint64_t lexingTime;                    // nanoseconds spent lexing
+    uint64_t totalTime;                     // nanoseconds spent evaluating (lexing included)
+};
+typedef struct EEStats EEStats;
+
+
+
 struct EEvaluation
 {
-    const char  *expression;
-    const char  *cursor;
-    double      result;
-    int64_t     roundBracketsCount;
-    const char  *error;
+    const char      *expression;
+    const char      *cursor;
+    const char      *end;
+    double          result;
+    int64_t         roundBracketsCount;
+    int64_t         depth;              // nesting of the expression being parsed (see eeval_max_depth)
+    int64_t         arguments;          // arguments of registered functions being collected (see eeval_max_arguments)
+    int64_t         skipping;           // the level whose operands are parsed but not computed (0 if none, see EEvalExpression())
+    int32_t         guard;              // compiling: the value that tells if the instructions emitted are needed (see EECompileGuard())
+    EEvalPolicy     policy;             // of floating point exceptions
+    const char      *error;
+    const EESymbols *symbols;
+    const EEBinding *bindings;          // compiling: the names bound by the statements so far
+    int32_t         bindingsCount;
+    #if eeval_statistics
+    EEStats         stats;
+    #endif
 };
 typedef struct EEvaluation EEvaluation;
 
 
 
+// compiled expressions cache: a program and its key
+
+struct EECacheEntry
+{
+    struct EECacheEntry *next;          // next entry of the same bucket
+    uint64_t            hash;           // hash of the expression
+    EESymbols           symbols;        // copies of the variables the expression refers to (part of the key)
+    int32_t             *indexes;       // their positions in the symbol table
+    size_t              symbolsSize;    // bytes of the copies
+    EEProgram           program;        // the expression of the program is the key
+    size_t              memory;         // bytes used by the entry
+    int32_t             users;          // references: the cache and the threads executing the program
+    bool                referenced;     // executed since the CLOCK hand passed
+};
+typedef struct EECacheEntry EECacheEntry;
+
+
+
+// compiled expressions cache: a shard (see eeval_cache.c)
+
+#define EECacheShardsCount 16
+
+#if eeval_cache
+#include <pthread.h>
+
+struct EECacheShard
+{
+    pthread_mutex_t     mutex;
+    EECacheEntry        **buckets;      // hash table (entries of a bucket are chained)
+    size_t              bucketsCount;   // a power of 2
+    EECacheEntry        **ring;         // entries in the order of the CLOCK hand
+    size_t              count;
+    size_t              capacity;
+    size_t              hand;
+    size_t              memory;         // bytes used by the entries
+    size_t              limit;          // memory cap
+    uint64_t            hits;
+    uint64_t            misses;
+    uint64_t            evictions;
+};
+typedef struct EECacheShard EECacheShard;
+#endif
+
+
+
+// compiled expressions cache: counters (see EECacheStatistics())
+
+struct EECacheStats
+{
+    uint64_t hits;          // expressions found in the cache
+    uint64_t misses;        // expressions compiled
+    uint64_t evictions;     // programs removed to stay within the memory cap
+    size_t   entries;       // programs in the cache
+    size_t   memory;        // bytes used by the programs in the cache
+    size_t   limit;         // memory cap
+};
+typedef struct EECacheStats EECacheStats;
+
+
+
+// models: a named cell, an input (a value) or a formula (see eeval_model.c)
+
+struct EEModelCell
+{
+    char            *name;
+    char            *formula;               // NULL for inputs
+    EEProgram       program;                // the formula compiled (by EEModelUpdate())
+    int32_t         *references;            // the cells read by the formula (each once)
+    int32_t         referencesCount;
+    int32_t         rank;                   // position in the topological order
+    const char      *error;                 // why the value is not valid (NULL if it is)
+    int32_t         position;               // of the error in the formula
+    bool            changed;                // defined or set since the last update
+    bool            dirty;                  // recomputed by the update in progress
+};
+typedef struct EEModelCell EEModelCell;
+
+
+
+// models: cells that refer to each other by name
+// Cell k is the variable bound to slot k of the formulas:
+// its value is `values[ k ]`.
+
+struct EEModel
+{
+    EEModelCell     *cells;
+    double          *values;                // the value of each cell
+    EEVariable      *variables;             // the symbol table of the formulas (a variable for each cell)
+    int32_t         count;
+    int32_t         capacity;
+    int32_t         *table;                 // hash table of the names: index of the cell plus one (0 if empty)
+    int32_t         *order;                 // the cells in topological order (those read first)
+    int32_t         *starts;                // the cells reading cell k are from dependents[ starts[ k ] ]...
+    int32_t         *dependents;            // ...to dependents[ starts[ k + 1 ] ]
+    int32_t         dependentsCapacity;
+    int32_t         *changed;               // cells defined or set since the last update
+    int32_t         changedCount;
+    int32_t         *scratch;               // the cells to recompute and their groups (see EEModelUpdate())
+    bool            stale;                  // formulas defined since the last update: the graph is rebuilt
+};
+typedef struct EEModel EEModel;
+
+
+
+// models: groups of cells recomputed by many threads (see EEModelWorker())
+
+#if eeval_model_threads
+#include <pthread.h>
+
+struct EEModelJobs
+{
+    pthread_mutex_t     mutex;
+    EEModel             *model;
+    const int32_t       *cells;             // the cells of group k are from cells[ starts[ k ] ]...
+    const int32_t       *starts;            // ...to cells[ starts[ k + 1 ] ]
+    int32_t             groupsCount;
+    int32_t             next;               // the next group to recompute
+};
+typedef struct EEModelJobs EEModelJobs;
+#endif
+
+
+
 // Public
 
 EEvalStatus EEvaluate    ( EEvaluation *eval, const char *expression, double *result );
+EEvalStatus EEvaluateN   ( EEvaluation *eval, const char *expression, size_t length, double *result );
+EEvalStatus EEvaluatePolicy( EEvaluation *eval, const char *expression, size_t length, EEvalPolicy policy, double *result );
 void        EEPrintError ( EEvaluation *eval );
 
+void        EEStatsAdd    ( EEStats *total, const EEStats *stats );
+void        EEPrintStats  ( const EEStats *stats );
+
+EEvalStatus EECompile     ( EEvaluation *eval, const char *expression, const EESymbols *symbols, EEProgram *program );
+EEvalStatus EEExecute     ( EEvaluation *eval, const EEProgram *program, const double *slots, double *result );
+EEvalStatus EEExecuteOutputs( EEvaluation *eval, const EEProgram *program, const double *slots, double *results );
+int32_t     EEFindOutput  ( const EEProgram *program, const char *name );
+void        EEFreeProgram ( EEProgram *program );
+bool        EEBindNumbers ( const char *expression, EEBound *bound );
+void        EEFreeBound   ( EEBound *bound );
+
+EEvalStatus EEvaluateBatch( const EEProgram *program, const double * const *columns, size_t n, double *out, uint8_t *err );
+EEvalStatus EEvaluateBatchOutputs( const EEProgram *program, const double * const *columns, size_t n, double * const *outs, uint8_t *err );
+
+bool        EEJitCompile  ( EEProgram *program );
+
+bool        EERegisterFunction( const char *name, int32_t arity, EEScalarFunction scalar, EEBatchFunction batch );
+
+bool        EEAnalyzeRanges( EEProgram *program, const EESymbols *symbols, const EERange *ranges, EERangeReport *report );
+
+EEvalStatus EEvaluateCached   ( EEvaluation *eval, const char *expression, const EESymbols *symbols, const double *slots, double *result );
+void        EECacheLimit      ( size_t bytes );
+void        EECacheStatistics ( EECacheStats *stats );
+void        EECacheFlush      ( void );
+
+void        EEModelInit   ( EEModel *model );
+EEvalStatus EEModelDefine ( EEvaluation *eval, EEModel *model, const char *name, const char *formula );
+EEvalStatus EEModelSet    ( EEvaluation *eval, EEModel *model, const char *name, double value );
+EEvalStatus EEModelUpdate ( EEvaluation *eval, EEModel *model, int32_t jobs );
+EEvalStatus EEModelValue  ( EEvaluation *eval, const EEModel *model, const char *name, double *value );
+int32_t     EEModelFind   ( const EEModel *model, const char *name );
+void        EEModelFree   ( EEModel *model );
+
 
 
 // Private
 
-double      EEvalAddends        ( EEvaluation *eval, int64_t breakOnRoundBracketsCount, bool breakOnETEof, bool breakOnETcom, EEToken *tokenThatCausedBreak );
-double      EEvalFactors        ( EEvaluation *eval, double leftValue, EEToken op, bool isExponent, EEToken *leftOp );
-double      EEvalFunction       ( EEvaluation *eval, EEToken func );
-double      EEvalExponentiation ( EEvaluation *eval, double base, EEToken *rightOp );
+double      EEvalExpression     ( EEvaluation *eval );
+bool        EEvalArgument       ( EEvaluation *eval, EEvalFrame *frame, double value, EEToken token, double *arguments );
+bool        EEvalEnter          ( EEvaluation *eval );
+double      EEvalCompare        ( EEToken op, double a, double b );
 double      EEvalFactorial      ( EEvaluation *eval, double value, EEToken *rightOp );
 double      EEvalToken          ( EEvaluation *eval, EEToken *token );
 double      EEvalPlusToken      ( EEvaluation *eval, EEToken *token );
+double      EEvalOperatorToken  ( EEvaluation *eval, EEToken *token );
 double      EEvalValue          ( EEvaluation *eval );
+double      EEvalVariable       ( EEvaluation *eval, size_t length, EEToken *token );
+size_t      EEvalIdentifierLength( const char *cursor, const char *end );
+const EEKeyword *EEvalKeyword   ( const char *cursor, size_t length );
+const char  *EEvalSkipBlanks    ( const char *cursor, const char *end );
+const char  *EEvalSkipDigits    ( const char *cursor, const char *end );
+size_t      EENumberParse       ( const char *cursor, const char *end, double *value );
+size_t      EENumberHexadecimal ( const char *cursor, const char *end, double *value );
+bool        EENumberEiselLemire ( uint64_t mantissa, int64_t exponent, double *value );
+double      EENumberFallback    ( const char *cursor, const char *digits, int64_t exponent );
+uint64_t    EENumberMultiply    ( uint64_t a, uint64_t b, uint64_t *high );
+uint64_t    EEStatsLexing       ( const EEvaluation *eval );
+uint64_t    EEStatsNow          ( void );
+double      EEPower             ( double base, double exponent );
+double      EEFactorial         ( double value );
+
+EEvalStatus EEProgramExecute        ( EEvaluation *eval, const EEProgram *program, const double *slots, double *result, double *results );
+void        EECompileStatements     ( EEvaluation *eval, EEProgram *program );
+bool        EECompileName           ( EEvaluation *eval, const char *name, size_t length );
+int32_t     EECompileAddends        ( EEvaluation *eval, EEProgram *program, int64_t breakOnRoundBracketsCount, bool breakOnETEof, bool breakOnETcom, EEToken *tokenThatCausedBreak );
+int32_t     EECompileDisjunction    ( EEvaluation *eval, EEProgram *program, EEToken *rightOp );
+int32_t     EECompileConjunction    ( EEvaluation *eval, EEProgram *program, EEToken *rightOp );
+int32_t     EECompileComparison     ( EEvaluation *eval, EEProgram *program, EEToken *rightOp );
+int32_t     EECompileSum            ( EEvaluation *eval, EEProgram *program, EEToken *rightOp );
+int32_t     EECompileGuard          ( EEvaluation *eval, EEProgram *program, int32_t condition, bool negate );
+int32_t     EECompileFactors        ( EEvaluation *eval, EEProgram *program, int32_t leftValue, EEToken op, bool isExponent, EEToken *leftOp );
+int32_t     EECompileFunction       ( EEvaluation *eval, EEProgram *program, int32_t index );
+int32_t     EECompileExponentiation ( EEvaluation *eval, EEProgram *program, int32_t base, EEToken *rightOp );
+int32_t     EECompileFactorial      ( EEvaluation *eval, EEProgram *program, int32_t value, EEToken *rightOp );
+int32_t     EEProgramConstant       ( EEvaluation *eval, EEProgram *program, double value );
+int32_t     EEProgramEmit           ( EEvaluation *eval, EEProgram *program, EEOpcode opcode, int32_t a, int32_t b, EECheck check );
+int32_t     EEProgramVariable       ( EEvaluation *eval, EEProgram *program, int32_t index );
+int32_t     EEProgramList           ( EEvaluation *eval, EEProgram *program, EEOpcode opcode, int32_t a, const int32_t *values, int32_t count, EECheck check );
+void        EEProgramCheck          ( EEProgram *program, int32_t value, EECheck check );
+void        EEProgramOutput         ( EEvaluation *eval, EEProgram *program, int32_t value, const char *name, size_t length );
+void        EEProgramFinalize       ( EEProgram *program );
+double      *EEProgramRegisters     ( const EEProgram *program );
+void        EEProgramReturn         ( const EEProgram *program );
+int         EEOpcodeOperands        ( EEOpcode opcode );
+bool        EEOpcodeListed          ( EEOpcode opcode );
+
+void        EEProgramOptimize       ( EEvaluation *eval, EEProgram *program );
+bool        EEOptimizeCompute       ( EEOpcode opcode, double a, double b, double *r );
+bool        EEOptimizeIsConstant    ( const EEProgram *program, int32_t value, double constant );
+bool        EEOptimizeAlias         ( EEProgram *program, const int32_t *uses, int32_t i, int32_t x );
+int32_t     EEOptimizeLookup        ( const EEProgram *program, int32_t *table, int32_t mask, const bool *dead, int32_t i );
+int32_t     EEOptimizeConstant      ( const EEProgram *program, int32_t *constants, int32_t mask, int32_t value );
+void        EEOptimizeReduce        ( EEvaluation *eval, EEProgram *program );
+void        EEOptimizeSweep         ( EEvaluation *eval, EEProgram *program, bool *dead );
+
+double      EEBatchLogBase          ( double a, double b );
+
+EERange     EERangeInstruction      ( const EEProgram *program, const EEInstruction *ins, const EERange *range, const EESymbols *symbols, const EERange *ranges );
+EERange     EERangeAny              ( void );
+EERange     EERangeCorners          ( EEOpcode opcode, EERange a, EERange b );
+EERange     EERangeDivision         ( EERange a, EERange b );
+EERange     EERangePower            ( EERange a, EERange b );
+EERange     EERangeLog              ( EERange a );
+EERange     EERangePeriodic         ( EERange a, double (*f)( double ), double peak, double period );
+bool        EERangeContains         ( EERange a, double point, double period );
+EERange     EERangeWiden            ( EERange r );
+
+EEvalStatus EEJitExecute    ( EEvaluation *eval, const EEProgram *program, const double *slots, double *result, double *results );
+void        EEJitRelease    ( EEProgram *program );
+void        EEJitInstruction( EEJit *jit, int32_t i );
+void        EEJitRun        ( EEJit *jit, int32_t first, int32_t last );
+void        EEJitLiveness   ( EEJit *jit );
+int         EEJitTarget     ( EEJit *jit, int32_t i, int32_t first, int32_t second );
+int         EEJitAllocate   ( EEJit *jit, int32_t i, int32_t first, int32_t second );
+void        EEJitSpill      ( EEJit *jit, int32_t i );
+EEJitAddress EEJitOperand   ( EEJit *jit, int32_t reg );
+void        EEJitLoad       ( EEJit *jit, int r, int32_t reg );
+void        EEJitCall       ( EEJit *jit, void *function );
+void        EEJitForget     ( EEJit *jit );
+void        EEJitFailure    ( EEJit *jit, uint8_t condition, int32_t i, EEJitFailureKind kind );
+size_t      EEJitGuard      ( EEJit *jit, int32_t guard );
+int         EEJitBoolean    ( EEJit *jit, int32_t i );
+void        EEJitPatch      ( EEJit *jit, size_t offset, size_t target );
+void        EEJitSSE        ( EEJit *jit, uint8_t prefix, uint8_t opcode, int r, EEJitAddress address );
+EEJitAddress EEJitXmm       ( int r );
+EEJitAddress EEJitMemory    ( int base, int32_t displacement );
+EEJitAddress EEJitPool      ( int32_t offset );
+void        EEJitBytes      ( EEJit *jit, const char *bytes, size_t count );
+void        EEJitByte       ( EEJit *jit, uint8_t value );
+void        EEJitDword      ( EEJit *jit, int32_t value );
+void        EEJitQword      ( EEJit *jit, uint64_t value );
+void        EEJitDouble     ( EEJit *jit, double value );
+
+int32_t     EEFunctionLookup( const char *cursor, size_t length );
+uint32_t    EEFunctionHash  ( const char *cursor, size_t length );
+double      EEFunctionSin   ( const double *arguments, int32_t count );
+double      EEFunctionCos   ( const double *arguments, int32_t count );
+double      EEFunctionTan   ( const double *arguments, int32_t count );
+double      EEFunctionASin  ( const double *arguments, int32_t count );
+double      EEFunctionACos  ( const double *arguments, int32_t count );
+double      EEFunctionATan  ( const double *arguments, int32_t count );
+double      EEFunctionFact  ( const double *arguments, int32_t count );
+double      EEFunctionExp   ( const double *arguments, int32_t count );
+double      EEFunctionPow   ( const double *arguments, int32_t count );
+double      EEFunctionLog   ( const double *arguments, int32_t count );
+double      EEFunctionMax   ( const double *arguments, int32_t count );
+double      EEFunctionMin   ( const double *arguments, int32_t count );
+double      EEFunctionAvg   ( const double *arguments, int32_t count );
+double      EEFunctionIf    ( const double *arguments, int32_t count );
+
+const EEVectorKernels *EEVectorSelect( void );
+bool        EEVectorExceptions      ( const double *r, size_t m );
+
+#if eeval_cache
+void          EECacheInitialize ( void );
+uint64_t      EECacheHash       ( const char *expression );
+EECacheEntry  *EECacheFind      ( EECacheShard *shard, uint64_t hash, const char *expression, const EESymbols *symbols );
+bool          EECacheSameSymbols( const EECacheEntry *entry, const EESymbols *symbols );
+bool          EECacheSymbols    ( EECacheEntry *entry, const char *expression, const EESymbols *symbols );
+void          EECacheTake       ( EECacheEntry *entry );
+void          EECacheFree       ( EECacheEntry *entry );
+bool          EECacheInsert     ( EECacheShard *shard, EECacheEntry *entry );
+void          EECacheEvict      ( EECacheShard *shard, size_t limit );
+void          EECacheRelease    ( EECacheEntry *entry );
+size_t        EECacheMemory     ( const EECacheEntry *entry );
+size_t        EECacheNames      ( const EEProgram *program );
+#endif
+
+int32_t     EEModelAdd      ( EEvaluation *eval, EEModel *model, const char *name );
+bool        EEModelGrow     ( EEModel *model );
+void        EEModelClear    ( EEModel *model, int32_t cell );
+void        EEModelChange   ( EEModel *model, int32_t cell );
+bool        EEModelCompile  ( EEvaluation *eval, EEModel *model, int32_t cell );
+bool        EEModelGraph    ( EEvaluation *eval, EEModel *model );
+int32_t     EEModelDirty    ( EEModel *model );
+int32_t     EEModelGroups   ( EEModel *model, int32_t count );
+int32_t     EEModelRoot     ( int32_t *parent, int32_t cell );
+void        EEModelCompute  ( EEModel *model, int32_t cell );
+int32_t     EEModelPosition ( const EEModel *model, int32_t cell, int32_t reference );
+void        EEModelError    ( EEvaluation *eval, const EEModel *model, int32_t cell );
+int         EEModelRanks    ( const void *a, const void *b );
+#if eeval_model_threads
+void        *EEModelWorker  ( void *argument );
+#endif
+
+extern const uint8_t         EEvalCharClasses[ 256 ];
+extern const EEToken         EEvalCharTokens[ 256 ];
+extern const EEKeyword       EEvalKeywords[ EEKeywordsCount ];
+extern EEFunction            EEFunctions[ eeval_max_functions ];
+extern int32_t               EEFunctionsCount;
+extern const double          EEFactorials[ 171 ];
+extern const double          EENumberExactPowers[ 23 ];
+extern const uint64_t        EENumberPowers[ EENumberMaxExponent - EENumberMinExponent + 1 ][ 2 ];
+extern const EEVectorKernels EEVectorKernelsGeneric;
+extern const EEVectorKernels EEVectorKernelsAVX2;
+extern const EEVectorKernels EEVectorKernelsAVX512;
 
 
 
 // exception catcher
 
 #if eeval_catch_fp_exceptions
-#define eexception(n) (isnan(n)||(n)==HUGE_VAL||(n)==INFINITY||(n)==-HUGE_VAL||(n)==-INFINITY)
+#define eexception(n) (!isfinite(n))
 #else
 #define eexception(n) (false)
 #endif
 
+// the exception flags tested by the deferred policy (see EEvaluatePolicy())
+
+#define EEvalFlags ( FE_INVALID | FE_OVERFLOW | FE_DIVBYZERO )
+
+
+
+// statistics: counting (nothing if compiled out)
+
+#if eeval_statistics
+#define EEStatsCount( eval, counter )   ( (eval)->stats.counter++ )
+#define EEStatsDepth( eval )            ( (eval)->stats.maxDepth = (eval)->depth > (eval)->stats.maxDepth ? (eval)->depth : (eval)->stats.maxDepth )
+#define EEStatsCall( eval, func )       ( (eval)->stats.calls[ (func) < EFBuiltInCount ? (func) : EFBuiltInCount ]++ )
+#else
+#define EEStatsCount( eval, counter )   ( (void)0 )
+#define EEStatsDepth( eval )            ( (void)0 )
+#define EEStatsCall( eval, func )       ( (void)0 )
+#endif
+
+// exception catcher of the strict policy (that counts the checks)
+
+#if eeval_statistics && eeval_catch_fp_exceptions
+#define EEvalException( eval, n )       ( (eval)->policy == EPStrict && ( EEStatsCount( eval, checks ), eexception( n ) ) )
+#else
+#define EEvalException( eval, n )       ( (eval)->policy == EPStrict && eexception( n ) )
+#endif
+
 
 
 // Test suite included ?
@@ -140,5 +1087,32 @@ double      EEvalValue          ( EEvaluation *eval );
 #if eeval_test == true
 void        EEvalExecuteTests ();
 void        EEValTest       ( int lineNumber, EEvalStatus expectedStatus, double expectedResult, char *expression );
+bool        EEValTestSame   ( double result, double expected );
+void        EEValTestVariables( int lineNumber, EEvalStatus expectedStatus, double expectedResult, char *expression, double x );
+void        EEValTestBatch  ( int lineNumber, char *expression );
+void        EEValTestCache  ( int lineNumber, int threadsCount );
+void        EEValTestCacheSymbols( int lineNumber );
+void        EEValTestRegisters( int lineNumber, int threadsCount );
+void        EEValTestBind   ( int lineNumber, char *expression, const char *expected );
+void        EEValTestNesting( int lineNumber, EEvalStatus expectedStatus, double expectedResult, const char *open, const char *value, const char *close, int depth );
+void        EEValTestRanges ( int lineNumber, char *expression, double min, double max, int32_t checks, int32_t removed );
+void        EEValTestPolicy ( int lineNumber, EEvalPolicy policy, EEvalStatus expectedStatus, double expectedResult, char *expression );
+void        EEValTestStats  ( int lineNumber, char *expression, uint64_t tokens, int64_t maxDepth, uint64_t powers, uint64_t factorials );
+void        EEValTestArguments( int lineNumber, EEvalStatus expectedStatus, int count );
+double      EEValTestHypot  ( const double *arguments, int32_t count );
+double      EEValTestSum    ( const double *arguments, int32_t count );
+void        EEValTestSumBatch( const double * const *arguments, int32_t count, double *r, size_t m );
+double      EEValTestCount  ( const double *arguments, int32_t count );
+void        EEValTestCalls  ( int lineNumber, char *expression, int calls );
+void        EEValTestModel  ( int lineNumber );
+void        EEValTestModelStep( int lineNumber, EEvalStatus status );
+void        EEValTestModelUpdate( int lineNumber, EEModel *model, const char *error, int calls );
+void        EEValTestModelCell( int lineNumber, EEModel *model, const char *name, const char *error, double value );
+void        EEValTestModelGroups( int lineNumber, int32_t jobs );
+void        EEValTestOutputs( int lineNumber, EEvalStatus expectedStatus, char *expression, double x, const char *names, const double *expected );
+#if eeval_cache
+void        *EEValTestCacheThread( void *argument );
+void        *EEValTestRegistersThread( void *argument );
+#endif
 #endif
 #endif
\ No newline at end of file
@@ -0,0 +1,1531 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval.hpp
+//
+//  C++ interface (C++17 or later, header only): expressions passed
+//  as std::string_view and constant expressions evaluated at compile time
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#ifndef eeval_main_hpp
+#define eeval_main_hpp
+
+
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+extern "C"
+{
+#include "eeval.h"
+}
+
+
+
+// true while the compiler evaluates a constant expression:
+// EvaluateConstant() then parses the expression by itself,
+// at run time it calls EEvaluatePolicy()
+// (where it can't be told the expression is always parsed by itself)
+
+#if defined( __cpp_lib_is_constant_evaluated )
+#define eeval_constant_evaluated() std::is_constant_evaluated()
+#elif defined( __has_builtin )
+#if __has_builtin( __builtin_is_constant_evaluated )
+#define eeval_constant_evaluated() __builtin_is_constant_evaluated()
+#endif
+#endif
+
+#ifndef eeval_constant_evaluated
+#define eeval_constant_evaluated() true
+#endif
+
+// Constant() and the _eeval literal are consteval where supported (C++20):
+// they are always evaluated at compile time
+
+#if defined( __cpp_consteval )
+#define eeval_consteval consteval
+#else
+#define eeval_consteval constexpr
+#endif
+
+
+
+namespace eeval
+{
+    // The outcome of an evaluation: the value or the error
+    // with the offset of the character where it occurred
+
+    struct Result
+    {
+        double      value;
+        const char  *error;     // nullptr on success
+        size_t      position;   // of the error in the expression
+
+        constexpr explicit operator bool() const { return error == nullptr; }
+    };
+
+
+
+    // Thrown by Constant() (a compile error when evaluated at compile time)
+
+    class Error : public std::runtime_error
+    {
+        public:
+
+            size_t position;    // of the error in the expression
+
+            explicit Error( const Result &result ) : std::runtime_error( result.error ), position( result.position ) {}
+    };
+
+
+
+    // Evaluates an expression as EEvaluatePolicy() does: the characters
+    // are read where they are (no copy, no null termination needed).
+
+    inline Result Evaluate( std::string_view expression, EEvalPolicy policy = EPStrict )
+    {
+        EEvaluation eval;
+        Result      result = { 0, nullptr, 0 };
+
+        if( EEvaluatePolicy( &eval, expression.data(), expression.size(), policy, &result.value ) == EEvalFailure )
+        {
+            result.error = eval.error;
+            result.position = (size_t)( eval.cursor - eval.expression );
+        }
+
+        return result;
+    }
+
+
+
+    namespace detail
+    {
+        // Math at compile time: computed in long double (64 bits of mantissa
+        // on x86) then rounded to double, so results are within a few ULP
+        // of the C math library ones. Nothing may overflow, divide by zero
+        // or be NaN in a constant expression: operations are checked
+        // before being performed.
+
+        // long double values that round to a finite double
+
+        constexpr long double DoubleLimit = std::numeric_limits<long double>::digits > 53 ?
+                                            (long double)std::numeric_limits<double>::max() + 0x1p970L :
+                                            (long double)std::numeric_limits<double>::max();
+
+        constexpr long double PiO2   = 0xc90fdaa22168c235p-63L;     // pi / 2
+        constexpr long double PiO6   = 0x860a91c16b9b2c23p-64L;     // pi / 6
+        constexpr long double Sqrt3  = 0xddb3d742c265539ep-63L;
+        constexpr long double Ln2Hi  = 0x162e42fefa39p-45L;         // ln 2 = Ln2Hi + Ln2Lo,
+        constexpr long double Ln2Lo  = 0xef35793c7673007ep-109L;    // Ln2Hi * n is exact
+        constexpr long double LnPi2  = 0xeb3f8e4325f5a535p-64L;     // ln( 2 * pi ) / 2
+
+        // 2 / pi: 1280 bits (for the reduction of the arguments of sin(), cos() and tan())
+
+        constexpr uint32_t TwoOverPi[ 40 ] =
+        {
+            0xA2F9836E, 0x4E441529, 0xFC2757D1, 0xF534DDC0, 0xDB629599,
+            0x3C439041, 0xFE5163AB, 0xDEBBC561, 0xB7246E3A, 0x424DD2E0,
+            0x06492EEA, 0x09D1921C, 0xFE1DEB1C, 0xB129A73E, 0xE88235F5,
+            0x2EBB4484, 0xE99C7026, 0xB45F7E41, 0x3991D639, 0x835339F4,
+            0x9C845F8B, 0xBDF9283B, 0x1FF897FF, 0xDE05980F, 0xEF2F118B,
+            0x5A0A6D1F, 0x6D367ECF, 0x27CB09B7, 0x4F463F66, 0x9E5FEA2D,
+            0x7527BAC7, 0xEBE5F17B, 0x3D0739F7, 0x8A5292EA, 0x6BFB5FB1,
+            0x1F8D5D08, 0x56033046, 0xFC7B6BAB, 0xF0CFBC20, 0x9AF4361D
+        };
+
+
+
+        constexpr bool Fits( long double x )
+        {
+            return x < DoubleLimit && x > -DoubleLimit;
+        }
+
+        constexpr long double AbsL( long double x )
+        {
+            return x < 0 ? -x : x;
+        }
+
+        // x * 2^e (exact unless the result is tiny)
+
+        constexpr long double ScaleL( long double x, int64_t e )
+        {
+            if( e > 16000 ) e = 16000;
+            if( e < -16400 ) e = -16400;
+
+            for( ; e >= 64; e -= 64 ) x *= 0x1p64L;
+            for( ; e <= -64; e += 64 ) x *= 0x1p-64L;
+            for( ; e > 0; e-- ) x *= 2;
+            for( ; e < 0; e++ ) x /= 2;
+
+            return x;
+        }
+
+        // A positive finite double as m * 2^e (m an integer below 2^53)
+
+        constexpr uint64_t Decompose( double x, int64_t &e )
+        {
+            long double y = x;
+
+            e = 0;
+
+            for( ; y >= 0x1p117L; e += 64 ) y *= 0x1p-64L;
+            for( ; y >= 0x1p53L; e++ ) y /= 2;
+            for( ; y < 0x1p-12L; e -= 64 ) y *= 0x1p64L;
+            for( ; y < 0x1p52L; e-- ) y *= 2;
+
+            return (uint64_t)y;
+        }
+
+        constexpr long double SqrtL( long double x )
+        {
+            long double y = x,
+                        root = 1.5L,
+                        next = 0;
+            int64_t     e = 0;
+
+            if( x <= 0 ) return 0;
+
+            for( ; y >= 0x1p64L; e += 32 ) y *= 0x1p-64L;
+            for( ; y < 0x1p-64L; e -= 32 ) y *= 0x1p64L;
+            for( ; y >= 4; e++ ) y /= 4;
+            for( ; y < 1; e-- ) y *= 4;
+
+            for( int k = 0; k < 10; k++ )
+            {
+                next = ( root + y / root ) / 2;
+                if( next == root ) break;
+                root = next;
+            }
+
+            return ScaleL( root, e );
+        }
+
+        // e^x (|x| within the range of long double)
+
+        constexpr long double ExpL( long double x )
+        {
+            long double k = 0,
+                        r = 0,
+                        term = 1,
+                        sum = 1;
+
+            if( x > 11000 ) x = 11000;
+            if( x < -11400 ) x = -11400;
+
+            k = (long double)(int64_t)( x / ( Ln2Hi + Ln2Lo ) + ( x < 0 ? -0.5L : 0.5L ) );
+            r = ( x - k * Ln2Hi ) - k * Ln2Lo;
+
+            for( int n = 1; n < 40; n++ )
+            {
+                term *= r / n;
+                sum += term;
+                if( AbsL( term ) < 0x1p-66L ) break;
+            }
+
+            return ScaleL( sum, (int64_t)k );
+        }
+
+        // natural logarithm (x > 0)
+
+        constexpr long double LogL( long double x )
+        {
+            long double s = 0,
+                        s2 = 0,
+                        term = 0,
+                        sum = 0;
+            int64_t     e = 0;
+
+            for( ; x >= 0x1p64L; e += 64 ) x *= 0x1p-64L;
+            for( ; x < 0x1p-64L; e -= 64 ) x *= 0x1p64L;
+            for( ; x >= 2; e++ ) x /= 2;
+            for( ; x < 1; e-- ) x *= 2;
+
+            if( x > 0xb504f333f9de6484p-63L ) // sqrt( 2 )
+            {
+                x /= 2;
+                e++;
+            }
+
+            // ln( x ) = 2 atanh( ( x - 1 ) / ( x + 1 ) )
+
+            s = ( x - 1 ) / ( x + 1 );
+            s2 = s * s;
+            term = s;
+            sum = s;
+
+            for( int n = 3; n < 80; n += 2 )
+            {
+                term *= s2;
+                sum += term / n;
+                if( AbsL( term ) < 0x1p-66L ) break;
+            }
+
+            return e * Ln2Hi + ( e * Ln2Lo + 2 * sum );
+        }
+
+        // sin( r ) and cos( r ) for |r| <= pi / 4
+
+        constexpr long double SinL( long double r )
+        {
+            long double term = r,
+                        sum = r;
+
+            for( int n = 2; n < 40; n += 2 )
+            {
+                term *= -r * r / ( n * ( n + 1 ) );
+                sum += term;
+                if( AbsL( term ) < 0x1p-66L ) break;
+            }
+
+            return sum;
+        }
+
+        constexpr long double CosL( long double r )
+        {
+            long double term = 1,
+                        sum = 1;
+
+            for( int n = 1; n < 40; n += 2 )
+            {
+                term *= -r * r / ( n * ( n + 1 ) );
+                sum += term;
+                if( AbsL( term ) < 0x1p-66L ) break;
+            }
+
+            return sum;
+        }
+
+        // Bit `n` of a number of 8 limbs of 32 bits (the first is the lowest)
+
+        constexpr uint32_t Bit( const uint32_t *limbs, int64_t n )
+        {
+            return n >= 0 && n < 256 ? ( limbs[ n / 32 ] >> ( n % 32 ) ) & 1 : 0;
+        }
+
+        // Reduces |x| to r in [ -pi/4, pi/4 ]: |x| = r + q * pi/2 (mod 2 pi).
+        // The multiple of pi/2 is taken with as many bits of 2/pi
+        // as needed (Payne-Hanek), so huge arguments are reduced exactly.
+
+        constexpr long double Reduce( double x, int &q )
+        {
+            uint32_t    window[ 6 ] = { 0 },
+                        product[ 8 ] = { 0 },
+                        limbs[ 2 ] = { 0 };
+            uint64_t    m = 0,
+                        carry = 0;
+            int64_t     e = 0,
+                        first = 0,
+                        point = 0;
+            long double f = 0;
+            bool        negative = false;
+            int         w = 0,
+                        shift = 0,
+                        top = 0;
+
+            if( x < 0 ) x = -x;
+
+            q = 0;
+
+            if( x <= 0x1.921fb54442d18p-1 ) return x;
+
+            // x = m * 2^e: bits of 2/pi of weight above 2^( 1 - e )
+            // only add multiples of 4 to x * 2/pi, the window starts below
+
+            m = Decompose( x, e );
+            first = e >= 2 ? e - 1 : 1;
+
+            w = (int)( ( first - 1 ) / 32 );
+            shift = (int)( ( first - 1 ) % 32 );
+
+            for( int k = 0; k < 6; k++ )
+            {
+                window[ 5 - k ] = shift ? (uint32_t)( ( TwoOverPi[ w + k ] << shift ) | ( TwoOverPi[ w + k + 1 ] >> ( 32 - shift ) ) ) : TwoOverPi[ w + k ];
+            }
+
+            // x * 2/pi = m * window * 2^( e - first - 191 ): `point` bits are the fraction
+
+            limbs[ 0 ] = (uint32_t)m;
+            limbs[ 1 ] = (uint32_t)( m >> 32 );
+
+            for( int i = 0; i < 2; i++ )
+            {
+                carry = 0;
+
+                for( int j = 0; j < 6; j++ )
+                {
+                    carry += (uint64_t)limbs[ i ] * window[ j ] + product[ i + j ];
+                    product[ i + j ] = (uint32_t)carry;
+                    carry >>= 32;
+                }
+
+                product[ i + 6 ] = (uint32_t)carry;
+            }
+
+            point = first + 191 - e;
+
+            // The integer part modulo 4 is the quadrant, the fraction
+            // is left; above one half it is taken from the next integer
+
+            q = (int)( Bit( product, point ) | Bit( product, point + 1 ) << 1 );
+            negative = Bit( product, point - 1 );
+
+            if( negative )
+            {
+                q++;
+
+                carry = 1;
+                for( int k = 0; k < 8; k++ )
+                {
+                    carry += (uint32_t)~product[ k ];
+                    product[ k ] = (uint32_t)carry;
+                    carry >>= 32;
+                }
+            }
+
+            for( int k = 0; k < 8; k++ )
+            {
+                if( k * 32 >= point )               product[ k ] = 0;
+                else if( ( k + 1 ) * 32 > point )   product[ k ] &= (uint32_t)( ( (uint64_t)1 << ( point % 32 ) ) - 1 );
+            }
+
+            for( top = 7; top > 0 && product[ top ] == 0; top-- );
+
+            f = (long double)( ( (uint64_t)product[ top ] << 32 ) | ( top > 0 ? product[ top - 1 ] : 0 ) ) * 0x1p32L + ( top > 1 ? product[ top - 2 ] : 0 );
+            f = ScaleL( f, 32 * ( top - 2 ) - point );
+
+            q &= 3;
+
+            return ( negative ? -f : f ) * PiO2;
+        }
+
+        // arctangent
+
+        constexpr long double AtanL( long double x )
+        {
+            long double term = 0,
+                        sum = 0,
+                        offset = 0;
+            bool        negative = x < 0,
+                        inverse = false;
+
+            if( negative ) x = -x;
+
+            // atan( x ) = pi/2 - atan( 1/x ) = pi/6 + atan( ( x sqrt(3) - 1 ) / ( x + sqrt(3) ) )
+
+            if( x > 1 )
+            {
+                x = 1 / x;
+                inverse = true;
+            }
+
+            if( x > 0x8930a2f4f66ab18ap-65L ) // 2 - sqrt( 3 )
+            {
+                x = ( x * Sqrt3 - 1 ) / ( x + Sqrt3 );
+                offset = PiO6;
+            }
+
+            term = x;
+            sum = x;
+
+            for( int n = 3; n < 100; n += 2 )
+            {
+                term *= -x * x;
+                sum += term / n;
+                if( AbsL( term ) < 0x1p-66L ) break;
+            }
+
+            sum += offset;
+
+            if( inverse ) sum = PiO2 - sum;
+
+            return negative ? -sum : sum;
+        }
+
+        // ln( gamma( z ) ) for z >= 1 (Stirling series)
+
+        constexpr long double LogGammaL( long double z )
+        {
+            long double shift = 0,
+                        w2 = 0,
+                        series = 0;
+
+            for( ; z < 20; z += 1 ) shift += LogL( z );
+
+            w2 = 1 / ( z * z );
+            series = ( 1.0L / 12 + w2 * ( -1.0L / 360 + w2 * ( 1.0L / 1260 + w2 * ( -1.0L / 1680 + w2 * ( 1.0L / 1188 +
+                     w2 * ( -691.0L / 360360 + w2 * ( 1.0L / 156 + w2 * ( -3617.0L / 122400 ) ) ) ) ) ) ) ) / z;
+
+            return ( z - 0.5L ) * LogL( z ) - z + LnPi2 + series - shift;
+        }
+
+
+
+        // a * b and a / b (b not 0), false if the result is too big
+
+        constexpr bool Multiply( double a, double b, double &result )
+        {
+            if( ! Fits( (long double)a * b ) ) return false;
+
+            result = a * b;
+            return true;
+        }
+
+        constexpr bool Divide( double a, double b, double &result )
+        {
+            if( ! Fits( (long double)a / b ) ) return false;
+
+            result = a / b;
+            return true;
+        }
+
+        // A long double result rounded to double, false if too big
+
+        constexpr bool Round( long double value, double &result )
+        {
+            if( ! Fits( value ) ) return false;
+
+            result = (double)value;
+            return true;
+        }
+
+        // Computes `base ^ exponent` as pow() does in EEvaluate().
+        // Returns false if the result is complex or too big.
+
+        constexpr bool Power( double base, double exponent, double &result )
+        {
+            long double magnitude = 0,
+                        logarithm = 0,
+                        square = 0,
+                        integral = 0;
+            bool        isInteger = false,
+                        odd = false;
+
+            // As pow(): special cases first
+
+            if( exponent == 0 || base == 1 )
+            {
+                result = 1;
+                return true;
+            }
+
+            isInteger = AbsL( exponent ) >= 0x1p53L || exponent == (long double)(int64_t)exponent;
+            odd = isInteger && AbsL( exponent ) < 0x1p53L && ( (int64_t)exponent & 1 );
+
+            if( base == 0 )
+            {
+                result = 0;
+                return exponent > 0;
+            }
+
+            if( base < 0 && ! isInteger ) return false;
+
+            magnitude = AbsL( base );
+            logarithm = exponent * LogL( magnitude );
+
+            if( logarithm > 710 ) return false;
+
+            if( logarithm < -746 )
+            {
+                result = 0;
+            }
+            else if( isInteger && AbsL( exponent ) <= 65536 )
+            {
+                square = magnitude;
+                integral = 1;
+
+                for( int64_t n = (int64_t)AbsL( exponent ); n > 0; n >>= 1 )
+                {
+                    if( n & 1 ) integral *= square;
+                    if( n > 1 ) square *= square;
+                }
+
+                if( exponent < 0 ) integral = 1 / integral;
+                if( ! Round( integral, result ) ) return false;
+            }
+            else if( ! Round( ExpL( logarithm ), result ) )
+            {
+                return false;
+            }
+
+            if( base < 0 && odd ) result = -result;
+
+            return true;
+        }
+
+        // Computes `value!` as tgamma( value + 1 ) does in EEvaluate() (value >= 0).
+        // Returns false if the result is too big.
+
+        constexpr bool Factorial( double value, double &result )
+        {
+            long double product = 1;
+
+            if( value <= 170 && value == (int)value )
+            {
+                for( int n = 2; n <= (int)value; n++ ) product *= n;
+
+                return Round( product, result );
+            }
+
+            if( value > 172 ) return false;
+
+            return Round( ExpL( LogGammaL( (long double)( value + 1 ) ) ), result );
+        }
+
+
+
+        // A keyword: a built-in function (its index) or a constant (see EEvalKeywords[]).
+        // Registered functions are not known at compile time (see EERegisterFunction())
+
+        struct Keyword
+        {
+            std::string_view name;
+            EEToken          token;
+            double           value;
+        };
+
+        constexpr Keyword Keywords[] =
+        {
+            { "sin",     ETFun, EFSin },
+            { "cos",     ETFun, EFCos },
+            { "tan",     ETFun, EFTan },
+            { "asin",    ETFun, EFASi },
+            { "acos",    ETFun, EFACo },
+            { "atan",    ETFun, EFATa },
+            { "fact",    ETFun, EFFac },
+            { "exp",     ETFun, EFExp },
+            { "pow",     ETFun, EFPow },
+            { "log",     ETFun, EFLog },
+            { "max",     ETFun, EFMax },
+            { "min",     ETFun, EFMin },
+            { "avg",     ETFun, EFAvg },
+            { "average", ETFun, EFAvg },
+            { "if",      ETFun, EFIf  },
+            { "e",       ETVal, 0x1.5bf0a8b145769p+1 },    // M_E
+            { "pi",      ETVal, 0x1.921fb54442d18p+1 }     // M_PI
+        };
+
+
+
+        // Evaluates an expression in a constant expression: the grammar, the
+        // tokens, the errors and where they are raised are those of
+        // EEvaluate() (see EEvalExpression()), floating point exceptions
+        // are always caught (as EPStrict does).
+        // Levels of nesting are recursive calls: compilers limit their depth
+        // (512 by default with GCC, -fconstexpr-depth changes it).
+
+        class ConstantEvaluation
+        {
+            public:
+
+                constexpr explicit ConstantEvaluation( std::string_view text ) : expression( text )
+                {
+                }
+
+                constexpr Result Evaluate()
+                {
+                    EEToken nextOp = ETErr;
+                    double  value  = Addends( ETEof, 0, 0, nextOp );
+
+                    if( error ) return { 0, error, cursor };
+
+                    return { value, nullptr, 0 };
+                }
+
+            private:
+
+                // The cursor is an offset: as in EEvalToken() the end of
+                // the expression is read as a null character, one past the end
+
+                std::string_view expression;
+                size_t           cursor = 0;
+                int64_t          roundBracketsCount = 0;
+                int64_t          depth = 0;
+                bool             skipping = false;  // parsing an operand not computed (see `eval->skipping`)
+                const char       *error = nullptr;
+
+                constexpr char At( size_t offset ) const
+                {
+                    return offset < expression.size() ? expression[ offset ] : '\0';
+                }
+
+
+
+                constexpr double Fail( const char *description )
+                {
+                    error = description;
+                    return 0;
+                }
+
+                // Enters a level of nesting (see EEvalEnter())
+
+                constexpr bool Enter()
+                {
+                    if( ++depth > eeval_max_depth )
+                    {
+                        Fail( "expression is too deeply nested" );
+                        return false;
+                    }
+
+                    return true;
+                }
+
+                // A level: the whole expression (`kind` is ETEof), brackets (ETrbo)
+                // or the argument `count` of the built-in `function` (ETFun).
+                // Evaluates a disjunction up to the token that ends the level
+                // (in `nextOp`), see steps ESLogic and ESLevel.
+
+                constexpr double Addends( EEToken kind, int32_t function, uint16_t count, EEToken &nextOp )
+                {
+                    double value    = 0;
+                    bool   overflow = false,
+                           done     = false;
+
+                    value = Disjunction( overflow, nextOp );
+                    if( error ) return 0;
+
+                    if( nextOp == ETrbc )
+                    {
+                        if( --roundBracketsCount < 0 ) return Fail( "unexpected close round bracket" );
+                    }
+
+                    switch( kind == ETFun ? function : EFSin )
+                    {
+                        case EFPow:
+                            done = count == 0 ? nextOp == ETcom : nextOp == ETrbc;
+                            break;
+
+                        case EFLog:
+                            done = nextOp == ETrbc || ( count == 0 && nextOp == ETcom );
+                            break;
+
+                        case EFMax:
+                        case EFMin:
+                        case EFAvg:
+                            done = nextOp == ETrbc || nextOp == ETcom;
+                            break;
+
+                        case EFIf:
+                            done = count < 2 ? nextOp == ETcom : nextOp == ETrbc;
+                            break;
+
+                        default:
+                            done = kind == ETEof ? nextOp == ETEof : nextOp == ETrbc;
+                            break;
+                    }
+
+                    if( ! done )
+                    {
+                        switch( nextOp )
+                        {
+                            case ETEof: return Fail( "unexpected end of expression" );
+                            case ETrbc: return Fail( "unexpected close round bracket" );
+                            case ETcom: return Fail( "unexpeced comma" );
+                            default:    return Fail( "unexpeced symbol" );
+                        }
+                    }
+
+                    if( overflow ) return Fail( "result is complex or too big" );
+
+                    return value;
+                }
+
+                // C1 [ || C2 [ || C3 ... ] ]: the right operand is not computed
+                // if the left one is not 0. `overflow` tells if a single sum
+                // is too big (it fails once the level is over), see step ESLogic.
+
+                constexpr double Disjunction( bool &overflow, EEToken &nextOp )
+                {
+                    double value = 0,
+                           right = 0;
+                    bool   skip  = false;
+
+                    value = Conjunction( overflow, nextOp );
+                    if( error ) return 0;
+
+                    while( nextOp == ETOr )
+                    {
+                        if( ! Enter() ) return 0;
+
+                        skip = ! skipping && value != 0;
+                        if( skip ) skipping = true;
+
+                        right = Conjunction( overflow, nextOp );
+                        if( error ) return 0;
+
+                        if( overflow ) return Fail( "result is complex or too big" );
+
+                        if( skip ) skipping = false;
+
+                        depth--;
+
+                        value = value != 0 || right != 0;
+                    }
+
+                    return value;
+                }
+
+                // C1 [ && C2 [ && C3 ... ] ]: the right operand is not computed
+                // if the left one is 0
+
+                constexpr double Conjunction( bool &overflow, EEToken &nextOp )
+                {
+                    double value = 0,
+                           right = 0;
+                    bool   skip  = false;
+
+                    value = Comparison( overflow, nextOp );
+                    if( error ) return 0;
+
+                    while( nextOp == ETAnd )
+                    {
+                        if( ! Enter() ) return 0;
+
+                        skip = ! skipping && value == 0;
+                        if( skip ) skipping = true;
+
+                        right = Comparison( overflow, nextOp );
+                        if( error ) return 0;
+
+                        if( overflow ) return Fail( "result is complex or too big" );
+
+                        if( skip ) skipping = false;
+
+                        depth--;
+
+                        value = value != 0 && right != 0;
+                    }
+
+                    return value;
+                }
+
+                // S1 [ < S2 ]: a sum or the comparison of two sums.
+                // The operands of comparisons, && and || fail as soon as
+                // they are too big.
+
+                constexpr double Comparison( bool &overflow, EEToken &nextOp )
+                {
+                    double  value = 0,
+                            right = 0;
+                    EEToken op    = ETErr;
+
+                    value = Sum( overflow, nextOp );
+                    if( error ) return 0;
+
+                    if( nextOp >= ETLt && nextOp <= ETOr && overflow ) return Fail( "result is complex or too big" );
+
+                    if( nextOp < ETLt || nextOp > ETNe ) return value;
+
+                    op = nextOp;
+
+                    if( ! Enter() ) return 0;
+
+                    right = Sum( overflow, nextOp );
+                    if( error ) return 0;
+
+                    if( overflow ) return Fail( "result is complex or too big" );
+
+                    depth--;
+
+                    switch( op )
+                    {
+                        case ETLt: return value <  right;
+                        case ETLe: return value <= right;
+                        case ETGt: return value >  right;
+                        case ETGe: return value >= right;
+                        case ETEq: return value == right;
+                        default:   return value != right;
+                    }
+                }
+
+                // Sums addends A1 - A2 [ + A3 ... ], see step ESAddend.
+                // `overflow` tells if the sum is too big.
+
+                constexpr double Sum( bool &overflow, EEToken &nextOp )
+                {
+                    double  sum     = 0,
+                            product = 0;
+                    EEToken sumOp   = ETSum;
+
+                    overflow = false;
+
+                    do
+                    {
+                        product = Factors( false, nextOp );
+                        if( error ) return 0;
+
+                        if( ! overflow )
+                        {
+                            overflow = ! Fits( sumOp == ETSum ? (long double)sum + product : (long double)sum - product );
+                            if( ! overflow ) sum = sumOp == ETSum ? ( sum + product ) : ( sum - product );
+                        }
+
+                        sumOp = nextOp;
+                    }
+                    while( nextOp == ETSum || nextOp == ETSub );
+
+                    return sum;
+                }
+
+                // Multiplies (divides) factors F1 [ * F2 [ / F3 ... ] ]
+                // (a single one if an exponent), see steps ESFactor, ESValue
+                // and ESProduct. `nextOp` is the operator that follows.
+
+                constexpr double Factors( bool isExponent, EEToken &nextOp )
+                {
+                    double  product   = 1,
+                            value     = 0,
+                            exponent  = 0,
+                            sign      = 1;
+                    EEToken productOp = ETMul,
+                            token     = ETErr;
+
+                    do
+                    {
+                        value = Token( token );
+                        if( error ) return 0;
+
+                        // Unary minus or plus ?
+
+                        sign = 1;
+
+                        if( token == ETSub || token == ETSum )
+                        {
+                            sign = token == ETSub ? -1 : 1;
+                            value = Token( token );
+                            if( error ) return 0;
+                        }
+
+                        // Open round bracket or function ?
+
+                        if( token == ETFun || token == ETrbo )
+                        {
+                            if( token == ETFun )
+                            {
+                                Token( nextOp );
+                                if( error ) return 0;
+
+                                if( nextOp != ETrbo ) return Fail( "expected open round bracket after function name" );
+                            }
+
+                            roundBracketsCount++;
+
+                            if( ! Enter() ) return 0;
+
+                            value = token == ETrbo ? Addends( ETrbo, 0, 0, nextOp ) : Function( (int32_t)value );
+                            if( error ) return 0;
+
+                            depth--;
+                        }
+                        else if( token != ETVal )
+                        {
+                            return Fail( "expected value" );
+                        }
+
+                        // Factorial or exponent ?
+
+                        Token( nextOp );
+                        if( error ) return 0;
+
+                        if( nextOp == ETFct )
+                        {
+                            #if eeval_unary_minus_has_highest_precedence
+                                value = Factorial( value * sign, nextOp );
+                                sign = 1;
+                            #else
+                                value = Factorial( value, nextOp );
+                            #endif
+                            if( error ) return 0;
+                        }
+
+                        if( nextOp == ETExc )
+                        {
+                            if( ! Enter() ) return 0;
+
+                            #if eeval_unary_minus_has_highest_precedence
+                                value *= sign;
+                                sign = 1;
+                            #endif
+
+                            exponent = Factors( true, nextOp );
+                            if( error ) return 0;
+
+                            if( skipping ) value = 0;
+                            else if( ! Power( value, exponent, value ) ) return Fail( "result is complex or too big" );
+
+                            depth--;
+                        }
+
+                        // multiplication/division (nothing is computed while skipping)
+
+                        if( skipping )
+                        {
+                            product = 0;
+                        }
+                        else if( productOp == ETMul )
+                        {
+                            if( ! Multiply( product, value, product ) ) return Fail( "result is too big" );
+                        }
+                        else
+                        {
+                            if( value == 0 ) return Fail( "division by zero" );
+                            if( ! Divide( product, value, product ) ) return Fail( "result is too big" );
+                        }
+
+                        product *= sign;
+
+                        productOp = nextOp;
+                    }
+                    while( ( productOp == ETMul || productOp == ETDiv ) && ! isExponent );
+
+                    return product;
+                }
+
+                // The arguments of a function (its open bracket is eaten)
+                // then the function itself (see EEvalArgument()).
+                // The branch of if() not taken is skipped.
+
+                constexpr double Function( int32_t function )
+                {
+                    double   value    = 0,
+                             result   = 0,
+                             base     = 0;
+                    EEToken  nextOp   = ETErr;
+                    uint16_t count    = 0;
+                    bool     overflow = false,
+                             ok       = true,
+                             skip     = false;
+
+                    switch( function )
+                    {
+                        case EFPow:
+                            base = Addends( ETFun, function, 0, nextOp );
+                            if( error ) return 0;
+                            value = Addends( ETFun, function, 1, nextOp );
+                            if( error ) return 0;
+                            ok = Power( base, value, result );
+                            break;
+
+                        case EFLog:
+                            value = Addends( ETFun, function, 0, nextOp );
+                            if( error ) return 0;
+
+                            if( nextOp == ETcom )
+                            {
+                                base = value;
+                                value = Addends( ETFun, function, 1, nextOp );
+                                if( error ) return 0;
+
+                                // log( n ) / log( b ): 0 if b is 0, fails if n is 0 or b is 1
+
+                                ok = value > 0 && base >= 0 && base != 1;
+                                if( ok && base > 0 ) ok = Divide( (double)LogL( value ), (double)LogL( base ), result );
+                            }
+                            else
+                            {
+                                ok = value > 0;
+                                if( ok ) result = (double)LogL( value );
+                            }
+                            break;
+
+                        case EFMax:
+                        case EFMin:
+                        case EFAvg:
+                            do
+                            {
+                                value = Addends( ETFun, function, count, nextOp );
+                                if( error ) return 0;
+
+                                if( function == EFMax )
+                                {
+                                    if( count == 0 || value > result ) result = value;
+                                }
+                                else if( function == EFMin )
+                                {
+                                    if( count == 0 || value < result ) result = value;
+                                }
+                                else if( count == 0 )
+                                {
+                                    result = value;
+                                }
+                                else if( ! overflow )
+                                {
+                                    overflow = ! Fits( (long double)result + value );
+                                    if( ! overflow ) result += value;
+                                }
+
+                                count++;
+                            }
+                            while( nextOp == ETcom );
+
+                            if( function == EFAvg )
+                            {
+                                ok = ! overflow && count > 0;
+                                if( ok ) result = result / (double)count;
+                            }
+                            break;
+
+                        case EFIf:
+                            value = Addends( ETFun, function, 0, nextOp );
+                            if( error ) return 0;
+
+                            skip = ! skipping && value == 0;
+                            if( skip ) skipping = true;
+                            base = Addends( ETFun, function, 1, nextOp );
+                            if( error ) return 0;
+                            if( skip ) skipping = false;
+
+                            skip = ! skipping && value != 0;
+                            if( skip ) skipping = true;
+                            result = Addends( ETFun, function, 2, nextOp );
+                            if( error ) return 0;
+                            if( skip ) skipping = false;
+
+                            if( value != 0 ) result = base;
+                            break;
+
+                        default:
+                            value = Addends( ETFun, function, 0, nextOp );
+                            if( error ) return 0;
+
+                            switch( function )
+                            {
+                                case EFSin:
+                                case EFCos:
+                                case EFTan:
+                                    result = (double)Trigonometric( function, value );
+                                    break;
+
+                                case EFASi:
+                                    ok = value >= -1 && value <= 1;
+                                    if( ok ) result = (double)( value == 1 ? PiO2 : value == -1 ? -PiO2 : AtanL( value / SqrtL( ( 1.0L - value ) * ( 1.0L + value ) ) ) );
+                                    break;
+
+                                case EFACo:
+                                    ok = value >= -1 && value <= 1;
+                                    if( ok ) result = (double)( value == -1 ? 2 * PiO2 : 2 * AtanL( SqrtL( ( 1.0L - value ) / ( 1.0L + value ) ) ) );
+                                    break;
+
+                                case EFATa:
+                                    result = (double)AtanL( value );
+                                    break;
+
+                                case EFFac:
+                                    if( value < 0 ) return Fail( "attempt to evaluate factorial of negative number" );
+                                    ok = detail::Factorial( value, result );
+                                    break;
+
+                                case EFExp:
+                                    ok = value < 710 && Round( ExpL( value ), result );
+                                    break;
+
+                                default:
+                                    break;
+                            }
+                            break;
+                    }
+
+                    if( skipping ) return 0;
+
+                    if( ! ok ) return Fail( "result is complex or too big" );
+
+                    return result;
+                }
+
+                // sin(), cos() or tan() of x
+
+                constexpr long double Trigonometric( int32_t function, double x )
+                {
+                    int         q = 0;
+                    long double r = Reduce( x, q ),
+                                s = SinL( r ),
+                                c = CosL( r ),
+                                sine = q == 0 ? s : q == 1 ? c : q == 2 ? -s : -c,
+                                cosine = q == 0 ? c : q == 1 ? -s : q == 2 ? -c : s;
+
+                    if( x < 0 ) sine = -sine;
+
+                    return function == EFSin ? sine : function == EFCos ? cosine : sine / cosine;
+                }
+
+                // The factorial of a value whose `!` has been read,
+                // then the token that follows (see EEvalFactorial())
+
+                constexpr double Factorial( double value, EEToken &rightOp )
+                {
+                    double result = 0;
+
+                    if( skipping )
+                    {
+                        Token( rightOp );
+                        return 0;
+                    }
+
+                    if( value < 0 ) return Fail( "attempt to evaluate factorial of negative number" );
+
+                    if( ! detail::Factorial( value, result ) ) return Fail( "result is complex or too big" );
+
+                    Token( rightOp );
+                    if( error ) return 0;
+
+                    return result;
+                }
+
+                // Reads the next token (see EEvalToken()): returns the value
+                // of numbers and constants
+
+                constexpr double Token( EEToken &token )
+                {
+                    double value  = 0;
+                    size_t length = 0;
+                    char   c      = 0,
+                           second = 0;
+
+                    token = ETBlk;
+
+                    while( token == ETBlk )
+                    {
+                        c = At( cursor );
+
+                        if( Blank( c ) )
+                        {
+                            cursor++;
+                        }
+                        else if( Digit( c ) || c == '.' )
+                        {
+                            value = Value();
+                            if( error )
+                            {
+                                token = ETErr;
+                                return 0;
+                            }
+                            token = ETVal;
+                        }
+                        else if( c == '+' )
+                        {
+                            // Two consecutive plus are not allowed (see EEvalPlusToken())
+
+                            for( cursor++; cursor < expression.size() && Blank( At( cursor ) ); cursor++ );
+
+                            token = At( cursor ) == '+' ? ETErr : ETSum;
+                        }
+                        else if( Letter( c ) )
+                        {
+                            for( length = 1; Letter( At( cursor + length ) ) || Digit( At( cursor + length ) ); length++ );
+
+                            token = ETErr;
+
+                            for( const Keyword &keyword : Keywords )
+                            {
+                                if( keyword.name == expression.substr( cursor, length ) )
+                                {
+                                    token = keyword.token;
+                                    value = keyword.value;
+                                    cursor += length;
+                                    break;
+                                }
+                            }
+                        }
+                        else if( c == '<' || c == '>' || c == '=' || c == '!' || c == '&' || c == '|' )
+                        {
+                            // Comparisons and logical operators (see EEvalOperatorToken())
+
+                            second = At( cursor + 1 );
+
+                            if( second == '=' && c != '&' && c != '|' )
+                            {
+                                token = c == '<' ? ETLe : c == '>' ? ETGe : c == '=' ? ETEq : ETNe;
+                                cursor += 2;
+                            }
+                            else if( second == c && ( c == '&' || c == '|' ) )
+                            {
+                                token = c == '&' ? ETAnd : ETOr;
+                                cursor += 2;
+                            }
+                            else if( c == '<' || c == '>' || c == '!' )
+                            {
+                                token = c == '<' ? ETLt : c == '>' ? ETGt : ETFct;
+                                cursor++;
+                            }
+                            else
+                            {
+                                token = ETErr;
+                            }
+                        }
+                        else
+                        {
+                            switch( c )
+                            {
+                                case '\0': token = ETEof; break;
+                                case '-':  token = ETSub; break;
+                                case '*':  token = ETMul; break;
+                                case '/':  token = ETDiv; break;
+                                case '^':  token = ETExc; break;
+                                case '(':  token = ETrbo; break;
+                                case ')':  token = ETrbc; break;
+                                case ',':  token = ETcom; break;
+                                default:   token = ETErr; break;
+                            }
+
+                            if( token != ETErr ) cursor++;
+                        }
+                    }
+
+                    // There are no variables
+
+                    if( token == ETErr ) Fail( "unexpected symbol" );
+
+                    return value;
+                }
+
+                static constexpr bool Blank( char c )
+                {
+                    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+                }
+
+                static constexpr bool Digit( char c )
+                {
+                    return c >= '0' && c <= '9';
+                }
+
+                static constexpr bool Letter( char c )
+                {
+                    return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || c == '_';
+                }
+
+                // Parses a number (see EENumberParse()): hexadecimal numbers, and
+                // decimal ones of up to 15 digits with an exponent up to 22, are
+                // converted exactly, the others may differ by one ULP.
+
+                constexpr double Value()
+                {
+                    size_t      p           = cursor,
+                                next        = 0;
+                    uint64_t    mantissa    = 0;
+                    int64_t     exponent    = 0,
+                                power       = 0;
+                    int         count       = 0,
+                                digit       = 0;
+                    bool        seen        = false,
+                                truncated   = false,
+                                point       = false,
+                                negative    = false,
+                                hexadecimal = expression.size() - cursor > 2 && At( cursor ) == '0' && ( At( cursor + 1 ) == 'x' || At( cursor + 1 ) == 'X' );
+                    long double exact       = 0,
+                                ten         = 10;
+                    double      value       = 0,
+                                powerOfTen  = 1;
+                    char        c           = 0;
+
+                    // Hexadecimal: 0x, digits, a point, digits and a binary exponent
+                    // (at most 15 significant digits, then a sticky bit)
+
+                    if( hexadecimal )
+                    {
+                        for( p = cursor + 2; p < expression.size(); p++ )
+                        {
+                            c = At( p );
+
+                            if( c == '.' && ! point )
+                            {
+                                point = true;
+                                continue;
+                            }
+
+                            if( Digit( c ) )                 digit = c - '0';
+                            else if( c >= 'a' && c <= 'f' )  digit = c - 'a' + 10;
+                            else if( c >= 'A' && c <= 'F' )  digit = c - 'A' + 10;
+                            else break;
+
+                            seen = true;
+
+                            if( count < 15 )
+                            {
+                                mantissa = mantissa * 16 + (uint64_t)digit;
+                                if( mantissa ) count++;
+                                if( point ) exponent -= 4;
+                            }
+                            else
+                            {
+                                truncated |= digit != 0;
+                                if( ! point ) exponent += 4;
+                            }
+                        }
+
+                        hexadecimal = seen;
+                    }
+
+                    // Decimal: digits, a point and digits
+                    // (at most 19 significant digits)
+
+                    if( ! hexadecimal )
+                    {
+                        mantissa = 0;
+                        exponent = 0;
+                        count = 0;
+                        seen = false;
+                        truncated = false;
+                        point = false;
+
+                        for( p = cursor; p < expression.size(); p++ )
+                        {
+                            c = At( p );
+
+                            if( c == '.' && ! point )
+                            {
+                                point = true;
+                                continue;
+                            }
+
+                            if( ! Digit( c ) ) break;
+
+                            seen = true;
+
+                            if( count < 19 )
+                            {
+                                mantissa = mantissa * 10 + (uint64_t)( c - '0' );
+                                if( mantissa ) count++;
+                                if( point ) exponent--;
+                            }
+                            else
+                            {
+                                truncated |= c != '0';
+                                if( ! point ) exponent++;
+                            }
+                        }
+
+                        if( ! seen ) return Fail( "expected value" );
+                    }
+
+                    // The exponent (decimal or binary)
+
+                    c = At( p );
+
+                    if( hexadecimal ? ( c == 'p' || c == 'P' ) : ( c == 'e' || c == 'E' ) )
+                    {
+                        next = p + 1;
+
+                        if( At( next ) == '+' || At( next ) == '-' )
+                        {
+                            negative = At( next ) == '-';
+                            next++;
+                        }
+
+                        if( Digit( At( next ) ) )
+                        {
+                            for( ; Digit( At( next ) ); next++ )
+                            {
+                                if( power < 1000000 ) power = power * 10 + ( At( next ) - '0' );
+                            }
+
+                            exponent += negative ? -power : power;
+                            p = next;
+                        }
+                    }
+
+                    cursor = p;
+
+                    if( mantissa == 0 )
+                    {
+                        value = 0;
+                    }
+                    else if( hexadecimal )
+                    {
+                        // mantissa * 2^exponent (with the sticky bit): a single rounding
+
+                        if( exponent > 1100 ) return Fail( "value is too big" );
+
+                        exact = truncated ? ScaleL( (long double)( mantissa * 16 + 1 ), exponent - 4 ) : ScaleL( (long double)mantissa, exponent );
+                        if( ! Round( exact, value ) ) return Fail( "value is too big" );
+                    }
+                    else if( ! truncated && mantissa <= ( (uint64_t)1 << 53 ) && exponent >= -22 && exponent <= 22 )
+                    {
+                        // Both the mantissa and the power are exact:
+                        // a single operation, a single rounding
+
+                        for( int64_t k = exponent < 0 ? -exponent : exponent; k > 0; k-- ) powerOfTen *= 10;
+
+                        value = exponent < 0 ? (double)mantissa / powerOfTen : (double)mantissa * powerOfTen;
+                    }
+                    else if( exponent > 330 )
+                    {
+                        return Fail( "value is too big" );
+                    }
+                    else if( exponent >= -400 )
+                    {
+                        // mantissa * 10^exponent in long double
+                        // (powers of ten up to 10^27 are exact)
+
+                        exact = 1;
+
+                        for( int64_t k = exponent < 0 ? -exponent : exponent; k > 0; k >>= 1 )
+                        {
+                            if( k & 1 ) exact *= ten;
+                            if( k > 1 ) ten *= ten;
+                        }
+
+                        exact = exponent < 0 ? (long double)mantissa / exact : (long double)mantissa * exact;
+                        if( ! Round( exact, value ) ) return Fail( "value is too big" );
+                    }
+
+                    return value;
+                }
+        };
+    }
+
+
+
+    // Evaluates an expression as Evaluate() does (with EPStrict), also at
+    // compile time: `constexpr Result r = EvaluateConstant( "2*pi/3" );`.
+    // At compile time functions are computed within a few ULP of the
+    // C math library (see README.md).
+
+    constexpr Result EvaluateConstant( std::string_view expression )
+    {
+        if( ! eeval_constant_evaluated() ) return Evaluate( expression );
+
+        return detail::ConstantEvaluation( expression ).Evaluate();
+    }
+
+
+
+    // The value of a constant expression: a malformed expression or a math
+    // error is a compile error (an Error exception if evaluated at run time,
+    // possible before C++20).
+
+    eeval_consteval double Constant( std::string_view expression )
+    {
+        Result result = EvaluateConstant( expression );
+
+        if( result.error ) throw Error( result );
+
+        return result.value;
+    }
+
+
+
+    namespace literals
+    {
+        // "2*pi/3"_eeval is Constant( "2*pi/3" )
+
+        eeval_consteval double operator""_eeval( const char *expression, size_t length )
+        {
+            return Constant( std::string_view( expression, length ) );
+        }
+    }
+}
+
+
+
+#endif
@@ -0,0 +1,520 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_batch.c
+//
+//  executes a compiled program over
+//  columns of values (many rows at a time)
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+// Number of rows computed by each instruction at a time
+
+#define EEBatchBlock 64
+
+
+
+// Functions are computed by the vectorized kernels (eeval_vector.c)
+// or row by row with the C math library
+
+#if eeval_vector_math
+#define EEBatchUnary( kernel, function )      kernels->kernel( a, r, m )
+#define EEBatchBinary( kernel, function )     kernels->kernel( a, b, r, m )
+#define EEBatchExceptions( r, m )             EEVectorExceptions( r, m )
+#else
+#define EEBatchUnary( kernel, function )      for( j = 0; j < m; j++ ) r[ j ] = function( a[ j ] )
+#define EEBatchBinary( kernel, function )     for( j = 0; j < m; j++ ) r[ j ] = function( a[ j ], b[ j ] )
+#define EEBatchExceptions( r, m )             true
+#endif
+
+
+
+// Executes a program compiled with EECompile() over `n` rows.
+// Variables bound to slot `k` read the row values from `columns[ k ]`
+// (structure of arrays); variables bound by pointer have the same
+// value for all the rows.
+// Each instruction is computed over a block of rows before moving
+// to the next one.
+// Functions are computed by vectorized kernels (unless
+// `eeval_vector_math` is false) whose results may differ by a few ULP
+// from the C math library ones (see eeval_vector.c).
+// Registered functions are called with a block of rows at a time
+// (their batch function) or row by row (their scalar function), on
+// all the rows, those that already failed included.
+// Both branches of if() (and both operands of && and ||) are computed
+// on all the rows, then blended row by row without branches: the
+// errors of a branch are recorded only on the rows that take it.
+// A row that fails (division by zero, overflow...) does not stop
+// the batch: its result is 0 and its error (EEBatchError) is
+// recorded in `err` (if not NULL). Each row reports the first error
+// it meets, the same EEExecute() would report.
+// The function fails only if the program is not compiled, the columns
+// are missing or memory can't be allocated.
+
+EEvalStatus EEvaluateBatch( const EEProgram     *program, // the compiled program
+                            const double *const *columns, // values of the variables bound to slots (can be NULL if none)
+                            size_t              n,        // number of rows
+                            double              *out,     // RETURN: `n` results
+                            uint8_t             *err )    // RETURN: `n` errors, EBNone if the row succeeded (can be NULL)
+{
+    double      **outs;
+    EEvalStatus status;
+
+    if( program->outputsCount <= 1 ) return EEvaluateBatchOutputs( program, columns, n, &out, err );
+
+    // The result is the last output
+
+    outs = calloc( program->outputsCount, sizeof( double * ) );
+    if( ! outs ) return EEvalFailure;
+
+    outs[ program->outputsCount - 1 ] = out;
+
+    status = EEvaluateBatchOutputs( program, columns, n, outs, err );
+
+    free( outs );
+
+    return status;
+}
+
+
+
+// Executes a program compiled with EECompile() over `n` rows as
+// EEvaluateBatch() does and returns all its outputs in one pass:
+// output `k` of each row (see EEExecuteOutputs()) is written in
+// `outs[ k ]` unless it is NULL. The values the statements share
+// are computed once per row. A row that fails has all its outputs 0.
+
+EEvalStatus EEvaluateBatchOutputs( const EEProgram     *program, // the compiled program
+                                   const double *const *columns, // values of the variables bound to slots (can be NULL if none)
+                                   size_t              n,        // number of rows
+                                   double * const      *outs,    // RETURN: `n` values of each output (NULL to skip one)
+                                   uint8_t             *err )    // RETURN: `n` errors, EBNone if the row succeeded (can be NULL)
+{
+    const double        **rows;
+    const double        *arguments[ eeval_max_arguments ];
+    double              values[ eeval_max_arguments ];
+    double              *scratch;
+    int32_t             *lastUse;
+    int32_t             *blockOf;
+    int32_t             *freeBlocks;
+    int32_t             blocksCount,
+                        freeBlocksCount,
+                        count,
+                        dst,
+                        operand,
+                        i,
+                        k;
+    size_t              start,
+                        m,
+                        j;
+    uint8_t             errors[ EEBatchBlock ];
+    uint8_t             code;
+    const EEInstruction *ins;
+    const EEFunction    *function;
+    const int32_t       *call;
+    const double        *a,
+                        *b,
+                        *c,
+                        *g;
+    double              *r;
+#if eeval_vector_math
+    const EEVectorKernels *kernels;
+#endif
+
+    if( ! program->expression ) return EEvalFailure;
+
+    if( program->slotsCount > 0 && ! columns ) return EEvalFailure;
+
+    count = program->constantsCount + program->instructionsCount;
+
+    rows       = malloc( count * sizeof( double * ) );
+    lastUse    = malloc( count * sizeof( int32_t ) );
+    blockOf    = malloc( count * sizeof( int32_t ) );
+    freeBlocks = malloc( count * sizeof( int32_t ) );
+
+    if( ! rows || ! lastUse || ! blockOf || ! freeBlocks )
+    {
+        free( rows );
+        free( lastUse );
+        free( blockOf );
+        free( freeBlocks );
+        return EEvalFailure;
+    }
+
+    // The last instruction that reads each register
+
+    for( k = 0; k < count; k++ )
+    {
+        lastUse[ k ] = -1;
+    }
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        ins = &program->instructions[ i ];
+
+        if( EEOpcodeOperands( ins->opcode ) >= 1 ) lastUse[ ins->a ] = i;
+        if( EEOpcodeOperands( ins->opcode ) == 2 ) lastUse[ ins->b ] = i;
+        if( ins->guard >= 0 ) lastUse[ ins->guard ] = i;
+
+        if( EEOpcodeListed( ins->opcode ) )
+        {
+            call = &program->arguments[ ins->b ];
+            for( k = 1; k <= call[ 0 ]; k++ ) lastUse[ call[ k ] ] = i;
+        }
+    }
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        lastUse[ program->outputs[ k ] ] = program->instructionsCount;
+    }
+
+    // Each register gets a block of rows: constants have their own,
+    // results of instructions share the blocks that are no more used.
+    // Slots are read directly from the columns.
+
+    for( k = 0; k < program->constantsCount; k++ )
+    {
+        blockOf[ k ] = k;
+    }
+
+    blocksCount = program->constantsCount;
+    freeBlocksCount = 0;
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        ins = &program->instructions[ i ];
+        dst = program->constantsCount + i;
+
+        if( ins->opcode == EOSlt )
+        {
+            blockOf[ dst ] = -1;
+        }
+        else
+        {
+            blockOf[ dst ] = freeBlocksCount > 0 ? freeBlocks[ --freeBlocksCount ] : blocksCount++;
+        }
+
+        // Operands read for the last time release their block
+        // (after the result got its own: kernels don't compute in place).
+        // A guard that is an operand too is released once.
+
+        operand = ins->guard;
+
+        if( operand >= program->constantsCount && lastUse[ operand ] == i && blockOf[ operand ] >= 0 )
+        {
+            freeBlocks[ freeBlocksCount++ ] = blockOf[ operand ];
+            lastUse[ operand ] = -1;
+        }
+
+        for( k = 0; k < EEOpcodeOperands( ins->opcode ); k++ )
+        {
+            operand = k == 0 ? ins->a : ins->b;
+
+            if( operand >= program->constantsCount && lastUse[ operand ] == i && blockOf[ operand ] >= 0 && ( k == 0 || ins->b != ins->a ) )
+            {
+                freeBlocks[ freeBlocksCount++ ] = blockOf[ operand ];
+            }
+        }
+
+        // (an argument passed twice is released once)
+
+        if( EEOpcodeListed( ins->opcode ) )
+        {
+            call = &program->arguments[ ins->b ];
+
+            for( k = 1; k <= call[ 0 ]; k++ )
+            {
+                operand = call[ k ];
+
+                if( operand >= program->constantsCount && lastUse[ operand ] == i && blockOf[ operand ] >= 0 )
+                {
+                    freeBlocks[ freeBlocksCount++ ] = blockOf[ operand ];
+                    lastUse[ operand ] = -1;
+                }
+            }
+        }
+    }
+
+    scratch = malloc( (size_t)blocksCount * EEBatchBlock * sizeof( double ) );
+    if( ! scratch && blocksCount > 0 )
+    {
+        free( rows );
+        free( lastUse );
+        free( blockOf );
+        free( freeBlocks );
+        return EEvalFailure;
+    }
+
+    for( k = 0; k < count; k++ )
+    {
+        rows[ k ] = blockOf[ k ] >= 0 ? scratch + blockOf[ k ] * EEBatchBlock : NULL;
+    }
+
+    for( k = 0; k < program->constantsCount; k++ )
+    {
+        for( j = 0; j < EEBatchBlock; j++ )
+        {
+            scratch[ k * EEBatchBlock + j ] = program->constants[ k ];
+        }
+    }
+
+#if eeval_vector_math
+    kernels = EEVectorSelect();
+#endif
+
+    // Execute the program, a block of rows at a time
+
+    for( start = 0; start < n; start += EEBatchBlock )
+    {
+        m = n - start < EEBatchBlock ? n - start : EEBatchBlock;
+
+        memset( errors, EBNone, sizeof( errors ) );
+
+        for( i = 0; i < program->instructionsCount; i++ )
+        {
+            ins = &program->instructions[ i ];
+            dst = program->constantsCount + i;
+
+            if( ins->opcode == EOSlt )
+            {
+                rows[ dst ] = columns[ ins->a ] + start;
+                continue;
+            }
+
+            r = scratch + blockOf[ dst ] * EEBatchBlock;
+            a = EEOpcodeOperands( ins->opcode ) >= 1 ? rows[ ins->a ] : NULL;
+            b = EEOpcodeOperands( ins->opcode ) == 2 ? rows[ ins->b ] : NULL;
+            g = ins->guard >= 0 ? rows[ ins->guard ] : NULL;
+
+            // Rows where the result is not needed (guard 0) don't fail
+
+            #define EEBatchNeeded(j) ( ! g || g[ j ] != 0 )
+
+            switch( ins->opcode )
+            {
+                case EOAdd:
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] + b[ j ];
+                    break;
+
+                case EOSub:
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] - b[ j ];
+                    break;
+
+                case EOMul:
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] * b[ j ];
+                    break;
+
+                case EODiv:
+                    if( ! ins->safe )
+                    {
+                        for( j = 0; j < m; j++ )
+                        {
+                            if( b[ j ] == 0 && ! errors[ j ] && EEBatchNeeded( j ) ) errors[ j ] = EBDivision;
+                        }
+                    }
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] / b[ j ];
+                    break;
+
+                case EONeg:
+                    for( j = 0; j < m; j++ ) r[ j ] = -a[ j ];
+                    break;
+
+                case EOPow:
+                    EEBatchBinary( pow, EEPower );
+                    break;
+
+                case EOFct:
+                    if( ! ins->safe )
+                    {
+                        for( j = 0; j < m; j++ )
+                        {
+                            if( a[ j ] < 0 && ! errors[ j ] && EEBatchNeeded( j ) ) errors[ j ] = EBFactorial;
+                        }
+                    }
+                    EEBatchUnary( fact, EEFactorial );
+                    break;
+
+                case EOSin:
+                    EEBatchUnary( sin, sin );
+                    break;
+
+                case EOCos:
+                    EEBatchUnary( cos, cos );
+                    break;
+
+                case EOTan:
+                    EEBatchUnary( tan, tan );
+                    break;
+
+                case EOASi:
+                    EEBatchUnary( asin, asin );
+                    break;
+
+                case EOACo:
+                    EEBatchUnary( acos, acos );
+                    break;
+
+                case EOATa:
+                    EEBatchUnary( atan, atan );
+                    break;
+
+                case EOExp:
+                    EEBatchUnary( exp, exp );
+                    break;
+
+                case EOLog:
+                    EEBatchUnary( log, log );
+                    break;
+
+                case EOSqt:
+                    for( j = 0; j < m; j++ ) r[ j ] = sqrt( a[ j ] );
+                    break;
+
+                case EOLgb:
+                    EEBatchBinary( lgb, EEBatchLogBase );
+                    break;
+
+                case EOMax:
+                    for( j = 0; j < m; j++ ) r[ j ] = b[ j ] > a[ j ] ? b[ j ] : a[ j ];
+                    break;
+
+                case EOMin:
+                    for( j = 0; j < m; j++ ) r[ j ] = b[ j ] < a[ j ] ? b[ j ] : a[ j ];
+                    break;
+
+                case EOVar:
+                    for( j = 0; j < m; j++ ) r[ j ] = *program->pointers[ ins->a ];
+                    break;
+
+                case EOSlt:
+                    break;
+
+                case EOChk:
+                    memcpy( r, a, m * sizeof( double ) );
+                    break;
+
+                case EOCall:
+                    function = &EEFunctions[ ins->a ];
+                    call = &program->arguments[ ins->b ];
+
+                    for( k = 0; k < call[ 0 ]; k++ ) arguments[ k ] = rows[ call[ k + 1 ] ];
+
+                    if( function->batch )
+                    {
+                        function->batch( arguments, call[ 0 ], r, m );
+                    }
+                    else
+                    {
+                        for( j = 0; j < m; j++ )
+                        {
+                            for( k = 0; k < call[ 0 ]; k++ ) values[ k ] = arguments[ k ][ j ];
+                            r[ j ] = function->scalar( values, call[ 0 ] );
+                        }
+                    }
+                    break;
+
+                case EOLt:
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] < b[ j ];
+                    break;
+
+                case EOLe:
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] <= b[ j ];
+                    break;
+
+                case EOEq:
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] == b[ j ];
+                    break;
+
+                case EONe:
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] != b[ j ];
+                    break;
+
+                case EONot:
+                    for( j = 0; j < m; j++ ) r[ j ] = a[ j ] == 0;
+                    break;
+
+                case EOAnd:
+                    for( j = 0; j < m; j++ ) r[ j ] = ( a[ j ] != 0 ) & ( b[ j ] != 0 );
+                    break;
+
+                case EOOr:
+                    for( j = 0; j < m; j++ ) r[ j ] = ( a[ j ] != 0 ) | ( b[ j ] != 0 );
+                    break;
+
+                case EOSel:
+                    // Both branches are computed: the rows are blended
+                    call = &program->arguments[ ins->b ];
+                    c = rows[ call[ 1 ] ];
+                    a = rows[ call[ 2 ] ];
+                    b = rows[ call[ 3 ] ];
+                    for( j = 0; j < m; j++ ) r[ j ] = c[ j ] != 0 ? a[ j ] : b[ j ];
+                    break;
+            }
+
+            if( ins->check != ECNone && EEBatchExceptions( r, m ) )
+            {
+                code = ins->check == ECTooBig ? EBTooBig : EBComplex;
+
+                for( j = 0; j < m; j++ )
+                {
+                    if( eexception( r[ j ] ) && ! errors[ j ] && EEBatchNeeded( j ) ) errors[ j ] = code;
+                }
+            }
+
+            #undef EEBatchNeeded
+        }
+
+        // Failed rows outputs are 0, the others are never -0 (as with EEExecute())
+
+        for( k = 0; k < program->outputsCount; k++ )
+        {
+            if( ! outs[ k ] ) continue;
+
+            for( j = 0; j < m; j++ )
+            {
+                outs[ k ][ start + j ] = errors[ j ] ? 0 : rows[ program->outputs[ k ] ][ j ] + 0;
+            }
+        }
+
+        if( err )
+        {
+            memcpy( err + start, errors, m );
+        }
+    }
+
+    free( scratch );
+    free( rows );
+    free( lastUse );
+    free( blockOf );
+    free( freeBlocks );
+
+    return EEvalSuccess;
+}
+
+
+
+// Logarithm with base (row by row)
+
+double EEBatchLogBase( double a, double b )
+{
+    return log( b ) / log( a );
+}
@@ -0,0 +1,630 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_bench.c
+//
+//  benchmarks: run with `make bench`
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+
+
+// Time spent on each method for each group of expressions (nanoseconds)
+// and the longest time of a sample (evaluations of an expression
+// repeated to be measurable)
+
+#define EEBenchDuration    300000000.0
+#define EEBenchSampleTime  2000.0
+
+// Largest number of expressions in a group and of samples of a run
+
+#define EEBenchExpressions 16
+#define EEBenchSamples     ( 1 << 20 )
+
+// Largest number of numbers timed by the parsing group
+
+#define EEBenchNumbersCount ( 1 << 16 )
+
+
+
+// The ways of evaluating an expression that are measured
+
+enum EEBenchMethod
+{
+    EBEvaluate,     // EEvaluate()
+    EBEvaluateN,    // EEvaluateN()
+    EBExecute,      // EECompile() once then EEExecute()
+    EBExecuteJit,   // EECompile() and EEJitCompile() once then EEExecute()
+    EBCached,       // EEvaluateCached()
+    EBMethodsCount
+};
+typedef enum EEBenchMethod EEBenchMethod;
+
+const char *EEBenchMethodNames[ EBMethodsCount ] =
+{
+    "EEvaluate",
+    "EEvaluateN",
+    "EEExecute",
+    "EEExecute (JIT)",
+    "EEvaluateCached"
+};
+
+
+
+// The number parsers compared on the numbers of the expressions
+
+enum EEBenchParser
+{
+    EBNumberParse,  // EENumberParse() (used by the lexer)
+    EBStrtod,       // strtod() of the C library
+    EBParsersCount
+};
+typedef enum EEBenchParser EEBenchParser;
+
+const char *EEBenchParserNames[ EBParsersCount ] =
+{
+    "EENumberParse",
+    "strtod"
+};
+
+
+
+// A group of expressions of the same kind
+
+struct EEBenchGroup
+{
+    const char *name;
+    const char *expressions[ EEBenchExpressions ];
+};
+typedef struct EEBenchGroup EEBenchGroup;
+
+
+
+// The results of a method on a group
+
+struct EEBenchResult
+{
+    double nanoseconds;     // per expression
+    double tokensPerSecond;
+    double resultsPerSecond;
+    double p50;             // latency of an expression (nanoseconds)
+    double p99;
+};
+typedef struct EEBenchResult EEBenchResult;
+
+
+
+// A number of an expression: where it begins and where
+// the expression ends (EENumberParse() doesn't read beyond)
+
+struct EEBenchNumber
+{
+    const char *start;
+    const char *end;
+};
+typedef struct EEBenchNumber EEBenchNumber;
+
+
+
+// Keeps the results of the parsers from being optimized away
+
+volatile double EEBenchSink;
+
+
+
+// Returns a monotonic time in nanoseconds
+
+double EEBenchNow( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return now.tv_sec * 1E9 + now.tv_nsec;
+}
+
+
+
+// Returns the number of tokens of an expression,
+// as read by the lexer (the end of the expression is not counted)
+
+long EEBenchTokens( const char *expression )
+{
+    EEvaluation eval;
+    EEToken     token;
+    long        count;
+
+    memset( &eval, 0, sizeof( EEvaluation ) );
+
+    eval.expression = eval.cursor = expression;
+    eval.end = expression + strlen( expression );
+
+    for( count = 0; ; count++ )
+    {
+        EEvalToken( &eval, &token );
+        if( token == ETEof || token == ETErr ) break;
+    }
+
+    return count;
+}
+
+
+
+// Writes into `buffer` an expression of the kind `kind` made of
+// `count` terms (or levels, for nested expressions) and returns it.
+// Numbers come from a fixed sequence: runs measure the same expressions.
+
+const char *EEBenchGenerate( char *buffer, size_t size, const char *kind, int count )
+{
+    const char *functions[] = { "sin", "cos", "atan", "exp", "log", "fact", "asin", "acos", "tan" };
+    uint32_t   seed;
+    size_t     used;
+    int        k;
+
+    seed = 2016;
+    used = 0;
+
+    for( k = 0; k < count && used + 64 < size; k++ )
+    {
+        seed = seed * 1664525 + 1013904223;
+
+        if( strcmp( kind, "brackets" ) == 0 )
+        {
+            used += snprintf( buffer + used, size - used, "(%d+", k % 10 );
+        }
+        else if( strcmp( kind, "functions" ) == 0 )
+        {
+            used += snprintf( buffer + used, size - used, "%s(", functions[ k % 3 ] );
+        }
+        else if( strcmp( kind, "numbers" ) == 0 )
+        {
+            used += snprintf( buffer + used, size - used, "%s%u.%04u*%u.%uE-%u", k ? "+" : "", seed >> 22, ( seed >> 8 ) % 10000, ( seed >> 12 ) % 100, seed % 1000, seed % 7 );
+        }
+        else
+        {
+            used += snprintf( buffer + used, size - used, "%s%s(%u.%u)*%u^2/(1+%u)", k ? "-" : "", functions[ ( seed >> 8 ) % 2 ], seed >> 24, seed % 100, ( seed >> 16 ) % 10, ( seed >> 4 ) % 50 );
+        }
+    }
+
+    if( strcmp( kind, "brackets" ) == 0 || strcmp( kind, "functions" ) == 0 )
+    {
+        used += snprintf( buffer + used, size - used, "1" );
+        for( ; k > 0 && used + 2 < size; k-- ) buffer[ used++ ] = ')';
+        buffer[ used ] = '\0';
+    }
+
+    return buffer;
+}
+
+
+
+// Evaluates an expression `count` times with a method.
+// `program` is the bound expression compiled (for EEExecute()).
+
+void EEBenchRepeat( EEBenchMethod method, const char *expression, size_t length, const EEBound *bound, const EEProgram *program, long count )
+{
+    EEvaluation eval;
+    double      result;
+    long        i;
+
+    for( i = 0; i < count; i++ )
+    {
+        switch( method )
+        {
+            case EBEvaluate:
+                EEvaluate( &eval, expression, &result );
+                break;
+
+            case EBEvaluateN:
+                EEvaluateN( &eval, expression, length, &result );
+                break;
+
+            case EBExecute:
+            case EBExecuteJit:
+                EEExecute( &eval, program, bound->slots, &result );
+                break;
+
+            case EBCached:
+                EEvaluateCached( &eval, bound->expression, &bound->symbols, bound->slots, &result );
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+
+
+// Sorts latencies
+
+int EEBenchCompare( const void *a, const void *b )
+{
+    double x = *(const double *)a,
+           y = *(const double *)b;
+
+    return ( x > y ) - ( x < y );
+}
+
+
+
+// Measures a method on a group of expressions:
+// the expressions are evaluated in turn, each one repeated
+// enough times to take about EEBenchSampleTime, until
+// EEBenchDuration has passed. Each sample gives a latency
+// (its time divided by its evaluations).
+// Returns false if some expression of the group fails.
+
+bool EEBenchRun( EEBenchMethod method, const EEBenchGroup *group, double *samples, EEBenchResult *result )
+{
+    EEvaluation eval;
+    EEProgram   programs[ EEBenchExpressions ];
+    EEBound     bounds[ EEBenchExpressions ];
+    size_t      lengths[ EEBenchExpressions ];
+    long        repeats[ EEBenchExpressions ];
+    long        tokens[ EEBenchExpressions ];
+    long        evaluations,
+                samplesCount,
+                tokensCount;
+    double      value,
+                start,
+                elapsed,
+                total;
+    int         count,
+                k;
+
+    memset( programs, 0, sizeof( programs ) );
+    memset( bounds, 0, sizeof( bounds ) );
+
+    for( count = 0; count < EEBenchExpressions && group->expressions[ count ]; count++ )
+    {
+        if( EEvaluate( &eval, group->expressions[ count ], &value ) == EEvalFailure )
+        {
+            fprintf( stderr, "%s: %s\n", group->name, eval.error );
+            EEPrintError( &eval );
+            return false;
+        }
+
+        lengths[ count ] = strlen( group->expressions[ count ] );
+        tokens[ count ] = EEBenchTokens( group->expressions[ count ] );
+
+        if( ! EEBindNumbers( group->expressions[ count ], &bounds[ count ] ) )
+        {
+            fprintf( stderr, "out of memory\n" );
+            return false;
+        }
+
+        if( method == EBExecute || method == EBExecuteJit )
+        {
+            if( EECompile( &eval, bounds[ count ].expression, &bounds[ count ].symbols, &programs[ count ] ) == EEvalFailure )
+            {
+                fprintf( stderr, "%s: %s\n", group->name, eval.error );
+                EEPrintError( &eval );
+                return false;
+            }
+
+            if( method == EBExecuteJit ) EEJitCompile( &programs[ count ] );
+        }
+
+        // Calibration (also warms up caches and the compiled expressions cache)
+
+        repeats[ count ] = 1;
+
+        do
+        {
+            repeats[ count ] *= 2;
+            start = EEBenchNow();
+            EEBenchRepeat( method, group->expressions[ count ], lengths[ count ], &bounds[ count ], &programs[ count ], repeats[ count ] );
+            elapsed = EEBenchNow() - start;
+        }
+        while( elapsed < EEBenchSampleTime / 2 && repeats[ count ] < ( 1 << 20 ) );
+    }
+
+    evaluations = 0;
+    samplesCount = 0;
+    tokensCount = 0;
+    total = 0;
+
+    while( total < EEBenchDuration && samplesCount + count <= EEBenchSamples )
+    {
+        for( k = 0; k < count; k++ )
+        {
+            start = EEBenchNow();
+            EEBenchRepeat( method, group->expressions[ k ], lengths[ k ], &bounds[ k ], &programs[ k ], repeats[ k ] );
+            elapsed = EEBenchNow() - start;
+
+            samples[ samplesCount++ ] = elapsed / repeats[ k ];
+            evaluations += repeats[ k ];
+            tokensCount += repeats[ k ] * tokens[ k ];
+            total += elapsed;
+        }
+    }
+
+    for( k = 0; k < count; k++ )
+    {
+        if( method == EBExecute || method == EBExecuteJit ) EEFreeProgram( &programs[ k ] );
+        EEFreeBound( &bounds[ k ] );
+    }
+
+    qsort( samples, samplesCount, sizeof( double ), EEBenchCompare );
+
+    result->nanoseconds      = total / evaluations;
+    result->tokensPerSecond  = tokensCount / total * 1E9;
+    result->resultsPerSecond = evaluations / total * 1E9;
+    result->p50              = samples[ samplesCount / 2 ];
+    result->p99              = samples[ samplesCount * 99 / 100 ];
+
+    return true;
+}
+
+
+
+// Writes into `numbers` the numbers of a group of expressions (not `e`
+// and `pi`), from `count` on, up to `size`. Returns the new count,
+// -1 if EENumberParse() and strtod() disagree on a number.
+
+int EEBenchNumbers( const EEBenchGroup *group, EEBenchNumber *numbers, int count, int size )
+{
+    EEvaluation eval;
+    EEToken     token;
+    const char  *start;
+    char        *next;
+    double      value,
+                expected;
+    size_t      length;
+    int         k;
+
+    for( k = 0; k < EEBenchExpressions && group->expressions[ k ]; k++ )
+    {
+        memset( &eval, 0, sizeof( EEvaluation ) );
+
+        eval.expression = eval.cursor = group->expressions[ k ];
+        eval.end = eval.expression + strlen( eval.expression );
+
+        for( ;; )
+        {
+            for( start = eval.cursor; start < eval.end && ( EEvalCharClasses[ (uint8_t)*start ] & ELBlank ); start++ );
+
+            EEvalToken( &eval, &token );
+            if( token == ETEof || token == ETErr ) break;
+
+            if( token != ETVal || ! ( ( EEvalCharClasses[ (uint8_t)*start ] & ELDigit ) || *start == '.' ) ) continue;
+            if( count == size ) return count;
+
+            length = EENumberParse( start, eval.end, &value );
+            expected = strtod( start, &next );
+
+            if( value != expected || start + length != next )
+            {
+                fprintf( stderr, "%s: EENumberParse() and strtod() disagree on %.*s\n", group->name, (int)( eval.cursor - start ), start );
+                return -1;
+            }
+
+            numbers[ count ].start = start;
+            numbers[ count ].end = eval.end;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+
+
+// Measures a parser as EEBenchRun() measures a method:
+// a sample parses all the numbers once
+
+void EEBenchParse( EEBenchParser parser, const EEBenchNumber *numbers, int count, double *samples, EEBenchResult *result )
+{
+    long   evaluations,
+           samplesCount;
+    double value,
+           sum,
+           start,
+           elapsed,
+           total;
+    int    k;
+
+    evaluations = 0;
+    samplesCount = 0;
+    total = 0;
+    sum = 0;
+
+    while( total < EEBenchDuration && samplesCount < EEBenchSamples )
+    {
+        start = EEBenchNow();
+
+        for( k = 0; k < count; k++ )
+        {
+            if( parser == EBNumberParse )
+            {
+                EENumberParse( numbers[ k ].start, numbers[ k ].end, &value );
+            }
+            else
+            {
+                value = strtod( numbers[ k ].start, NULL );
+            }
+
+            sum += value;
+        }
+
+        elapsed = EEBenchNow() - start;
+
+        samples[ samplesCount++ ] = elapsed / count;
+        evaluations += count;
+        total += elapsed;
+    }
+
+    EEBenchSink = sum;
+
+    qsort( samples, samplesCount, sizeof( double ), EEBenchCompare );
+
+    result->nanoseconds      = total / evaluations;
+    result->tokensPerSecond  = evaluations / total * 1E9;
+    result->resultsPerSecond = result->tokensPerSecond;
+    result->p50              = samples[ samplesCount / 2 ];
+    result->p99              = samples[ samplesCount * 99 / 100 ];
+}
+
+
+
+// Prints the results of a method on a group (and writes them
+// to `json` if not NULL; `first` tells if they are the first ones)
+
+void EEBenchPrint( FILE *json, const char *group, const char *method, const EEBenchResult *result, bool *first )
+{
+    printf( "%-10s %-16s %12.1f %14.4g %14.4g %10.1f %10.1f\n",
+            group, method,
+            result->nanoseconds, result->tokensPerSecond, result->resultsPerSecond, result->p50, result->p99 );
+
+    if( json )
+    {
+        fprintf( json, "%s\n    { \"group\": \"%s\", \"method\": \"%s\", \"ns_per_expression\": %.1f, \"tokens_per_second\": %.0f, \"results_per_second\": %.0f, \"p50_ns\": %.1f, \"p99_ns\": %.1f }",
+                 *first ? "" : ",", group, method,
+                 result->nanoseconds, result->tokensPerSecond, result->resultsPerSecond, result->p50, result->p99 );
+        *first = false;
+    }
+}
+
+
+
+// Runs the benchmarks and prints the results.
+// If a file name is passed the results are also written there as JSON.
+
+int main( int argc, const char *argv[] )
+{
+    static char   nested[ 4096 ],
+                  calls[ 4096 ],
+                  numbers[ 8192 ],
+                  numbersLong[ 32768 ],
+                  longest[ 131072 ];
+    EEBenchResult result;
+    EEProgram     program;
+    EEvaluation   eval;
+    EEBenchNumber *inputs;
+    FILE          *json;
+    double        *samples;
+    bool          first;
+    int           count,
+                  g,
+                  m;
+
+    // Expressions from README.md and eeval_test.c, then generated ones
+
+    EEBenchGroup groups[] =
+    {
+        { "short", {
+            "1+2",
+            "2+2",
+            "-(2^.5)",
+            "3!",
+            "12.34",
+            "pi/2",
+            "2-+2",
+            "0xfE" } },
+        { "nested", {
+            "((((((((((1+2)*3)-4)/5)^2)+6)*7)-8)/9)+10)",
+            "-(-(-(-(-(-(-(-(1))))))))",
+            "2^3^4-sin((pi*4!)/0.333)",
+            EEBenchGenerate( nested, sizeof( nested ), "brackets", 100 ),
+            EEBenchGenerate( calls, sizeof( calls ), "functions", 100 ) } },
+        { "functions", {
+            "-.3E2 * sin( -.5 * pi ) - 3 * log( e, e^1E1 ) + 3!",
+            "-.02+pi+(3*sin(average(1,2,3)^-.03E2))",
+            "sin(pi/7)^2*3",
+            "max(1,2,3)-min(4,5,6)+avg(1,2,3)+average(4,5)",
+            "asin(0.5)+acos(0.5)+atan(1)+tan(1)+exp(2)+fact(5)+pow(2,10)+log(2,8)" } },
+        { "numbers", {
+            "1.5e+3*0.000123+98765.4321-1E-7/3.14159265358979",
+            "0.1+0.2+0.3+0.4+0.5+0.6+0.7+0.8+0.9+1.0",
+            "123456789012345678*9.87654321e-10+0.000000000001234",
+            EEBenchGenerate( numbers, sizeof( numbers ), "numbers", 100 ) } },
+        { "long", {
+            EEBenchGenerate( numbersLong, sizeof( numbersLong ), "numbers", 1000 ),
+            EEBenchGenerate( longest, sizeof( longest ), "terms", 2000 ) } }
+    };
+
+    samples = malloc( EEBenchSamples * sizeof( double ) );
+    inputs = malloc( EEBenchNumbersCount * sizeof( EEBenchNumber ) );
+    if( ! samples || ! inputs )
+    {
+        fprintf( stderr, "out of memory\n" );
+        return 1;
+    }
+
+    json = NULL;
+
+    if( argc > 1 )
+    {
+        json = fopen( argv[ 1 ], "w" );
+        if( ! json )
+        {
+            fprintf( stderr, "cannot open %s\n", argv[ 1 ] );
+            return 1;
+        }
+
+        EECompile( &eval, "1", NULL, &program );
+        fprintf( json, "{\n  \"jit\": %s,\n  \"optimize\": %s,\n  \"results\": [", EEJitCompile( &program ) ? "true" : "false", eeval_optimize ? "true" : "false" );
+        EEFreeProgram( &program );
+    }
+
+    printf( "%-10s %-16s %12s %14s %14s %10s %10s\n", "group", "method", "ns/expr", "tokens/s", "results/s", "p50 ns", "p99 ns" );
+
+    first = true;
+
+    for( g = 0; g < (int)( sizeof( groups ) / sizeof( groups[ 0 ] ) ); g++ )
+    {
+        for( m = 0; m < EBMethodsCount; m++ )
+        {
+            if( ! EEBenchRun( m, &groups[ g ], samples, &result ) ) return 1;
+            EEBenchPrint( json, groups[ g ].name, EEBenchMethodNames[ m ], &result, &first );
+        }
+    }
+
+    // The number parsers on the numbers of the number-heavy and long
+    // expressions (one number per "expression")
+
+    count = 0;
+
+    for( g = 0; g < (int)( sizeof( groups ) / sizeof( groups[ 0 ] ) ); g++ )
+    {
+        if( strcmp( groups[ g ].name, "numbers" ) == 0 || strcmp( groups[ g ].name, "long" ) == 0 )
+        {
+            count = EEBenchNumbers( &groups[ g ], inputs, count, EEBenchNumbersCount );
+            if( count < 0 ) return 1;
+        }
+    }
+
+    for( m = 0; m < EBParsersCount; m++ )
+    {
+        EEBenchParse( m, inputs, count, samples, &result );
+        EEBenchPrint( json, "parsing", EEBenchParserNames[ m ], &result, &first );
+    }
+
+    if( json )
+    {
+        fprintf( json, "\n  ]\n}\n" );
+        fclose( json );
+    }
+
+    free( samples );
+    free( inputs );
+
+    return 0;
+}
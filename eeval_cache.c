@@ -0,0 +1,664 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_cache.c
+//
+//  a cache of compiled expressions shared
+//  by all the threads of the process (optional)
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+#if eeval_cache
+
+
+
+// The cache is split in shards, each one with its own lock, hash table
+// and memory cap (the cap of the cache divided by the number of shards):
+// threads looking up expressions of different shards never wait for each other,
+// and a lookup holds the lock only to find the program and take a reference.
+// When a shard goes beyond its cap programs are evicted with the CLOCK
+// policy (an approximation of LRU): the hand goes round the entries,
+// clearing the `referenced` flag of the ones executed since it passed
+// and evicting the first one found without it.
+// Entries are reference counted: the cache holds a reference and each
+// thread executing the program another one, dropped atomically without
+// the lock, so a program evicted while other threads are executing it
+// is freed by the last of them.
+
+EECacheShard   EECacheShards[ EECacheShardsCount ];
+pthread_once_t EECacheOnce = PTHREAD_ONCE_INIT;
+
+
+
+// Evaluates an expression as EECompile() then EEExecute() do,
+// compiling it only the first time: the program is kept in the cache
+// and found again by the expression text and the variables it refers to
+// (their names, positions in the symbol table and bindings): a table
+// that changes them, or another table at the same address, finds another
+// program, while changes to the other variables of the table don't matter.
+// Names bound with `let` are checked against the table only when compiled.
+// The function returns a status of success or failure
+// The result is in `*result`
+// It can be called by many threads at the same time, provided that
+// each one uses its own `EEvaluation`.
+// Expressions that fail to compile are not cached.
+
+EEvalStatus EEvaluateCached( EEvaluation     *eval,       // the EEvaluation structure (to report errors)
+                             const char      *expression, // the expression as a null terminated C string
+                             const EESymbols *symbols,    // the variables the expression can refer to (can be NULL)
+                             const double    *slots,      // values of the variables bound to slots (can be NULL if none)
+                             double          *result )    // RETURN: the result of the evaluation
+{
+    EECacheShard *shard;
+    EECacheEntry *entry,
+                 *other;
+    EEvalStatus  status;
+    uint64_t     hash;
+    size_t       position;
+
+    pthread_once( &EECacheOnce, EECacheInitialize );
+
+    hash = EECacheHash( expression );
+    shard = &EECacheShards[ hash >> 60 ];
+
+    pthread_mutex_lock( &shard->mutex );
+
+    entry = EECacheFind( shard, hash, expression, symbols );
+    if( entry )
+    {
+        EECacheTake( entry );
+        shard->hits++;
+    }
+    else
+    {
+        shard->misses++;
+    }
+
+    pthread_mutex_unlock( &shard->mutex );
+
+    // Not found: compiled out of the lock
+    // (another thread may cache the same expression meanwhile)
+
+    if( ! entry )
+    {
+        entry = calloc( 1, sizeof( EECacheEntry ) );
+        if( ! entry )
+        {
+            eval->expression = eval->cursor = expression;
+            eval->end = NULL;
+            eval->error = "out of memory";
+            *result = 0;
+            return EEvalFailure;
+        }
+
+        if( EECompile( eval, expression, symbols, &entry->program ) == EEvalFailure )
+        {
+            free( entry );
+            *result = 0;
+            return EEvalFailure;
+        }
+
+        if( ! EECacheSymbols( entry, expression, symbols ) )
+        {
+            EECacheFree( entry );
+            eval->expression = eval->cursor = expression;
+            eval->end = NULL;
+            eval->error = "out of memory";
+            *result = 0;
+            return EEvalFailure;
+        }
+
+        entry->hash       = hash;
+        entry->memory     = EECacheMemory( entry );
+        entry->users      = 2;      // the cache and this thread
+        entry->referenced = true;
+
+        pthread_mutex_lock( &shard->mutex );
+
+        other = EECacheFind( shard, hash, expression, symbols );
+        if( other )
+        {
+            EECacheTake( other );
+        }
+        else if( EECacheInsert( shard, entry ) )
+        {
+            EECacheEvict( shard, shard->limit );
+        }
+        else
+        {
+            entry->users = 1;       // not cached
+        }
+
+        pthread_mutex_unlock( &shard->mutex );
+
+        if( other )
+        {
+            EECacheFree( entry );
+            entry = other;
+        }
+    }
+
+    status = EEExecute( eval, &entry->program, slots, result );
+
+    // Errors refer to the expression of the caller
+    // (the program may be freed once released)
+
+    position = (size_t)( eval->cursor - eval->expression );
+    eval->expression = expression;
+    eval->cursor = expression + position;
+
+    EECacheRelease( entry );
+
+    return status;
+}
+
+
+
+// Sets the memory cap of the cache in bytes
+// (evicting programs if the cache is beyond it).
+
+void EECacheLimit( size_t bytes )
+{
+    EECacheShard *shard;
+    int          k;
+
+    pthread_once( &EECacheOnce, EECacheInitialize );
+
+    for( k = 0; k < EECacheShardsCount; k++ )
+    {
+        shard = &EECacheShards[ k ];
+
+        pthread_mutex_lock( &shard->mutex );
+        shard->limit = bytes / EECacheShardsCount;
+        EECacheEvict( shard, shard->limit );
+        pthread_mutex_unlock( &shard->mutex );
+    }
+}
+
+
+
+// Returns the counters of the cache
+
+void EECacheStatistics( EECacheStats *stats ) // RETURN: the counters
+{
+    EECacheShard *shard;
+    int          k;
+
+    pthread_once( &EECacheOnce, EECacheInitialize );
+
+    memset( stats, 0, sizeof( EECacheStats ) );
+
+    for( k = 0; k < EECacheShardsCount; k++ )
+    {
+        shard = &EECacheShards[ k ];
+
+        pthread_mutex_lock( &shard->mutex );
+        stats->hits      += shard->hits;
+        stats->misses    += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->entries   += shard->count;
+        stats->memory    += shard->memory;
+        stats->limit     += shard->limit;
+        pthread_mutex_unlock( &shard->mutex );
+    }
+}
+
+
+
+// Removes all the programs from the cache and resets the counters
+
+void EECacheFlush( void )
+{
+    EECacheShard *shard;
+    int          k;
+
+    pthread_once( &EECacheOnce, EECacheInitialize );
+
+    for( k = 0; k < EECacheShardsCount; k++ )
+    {
+        shard = &EECacheShards[ k ];
+
+        pthread_mutex_lock( &shard->mutex );
+        EECacheEvict( shard, 0 );
+        shard->hits = shard->misses = shard->evictions = 0;
+        pthread_mutex_unlock( &shard->mutex );
+    }
+}
+
+
+
+// ***********************
+// PRIVATE FUNCTIONS BELOW
+// ***********************
+
+
+
+// Initializes the shards (once per process)
+
+void EECacheInitialize( void )
+{
+    int k;
+
+    for( k = 0; k < EECacheShardsCount; k++ )
+    {
+        memset( &EECacheShards[ k ], 0, sizeof( EECacheShard ) );
+        pthread_mutex_init( &EECacheShards[ k ].mutex, NULL );
+        EECacheShards[ k ].limit = eeval_cache_memory / EECacheShardsCount;
+    }
+}
+
+
+
+// FNV-1a hash of the expression text
+// (the highest bits choose the shard, the lowest the bucket)
+
+uint64_t EECacheHash( const char *expression )
+{
+    uint64_t hash;
+
+    hash = 0xCBF29CE484222325u;
+
+    for( ; *expression; expression++ )
+    {
+        hash ^= (uint8_t)*expression;
+        hash *= 0x100000001B3u;
+    }
+
+    return hash ^ ( hash >> 29 );
+}
+
+
+
+// Looks up an expression compiled with the same variables
+// (the lock of the shard is held).
+// Returns NULL if not found.
+
+EECacheEntry *EECacheFind( EECacheShard *shard, uint64_t hash, const char *expression, const EESymbols *symbols )
+{
+    EECacheEntry *entry;
+
+    if( shard->bucketsCount == 0 ) return NULL;
+
+    for( entry = shard->buckets[ hash & ( shard->bucketsCount - 1 ) ]; entry; entry = entry->next )
+    {
+        if( entry->hash == hash && strcmp( entry->program.expression, expression ) == 0 && EECacheSameSymbols( entry, symbols ) )
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+
+
+// Tells if the variables an entry was compiled with are in a symbol
+// table at the same positions, with the same names and bindings
+// (the other variables of the table are not looked at).
+
+bool EECacheSameSymbols( const EECacheEntry *entry, const EESymbols *symbols )
+{
+    const EEVariable *a,
+                     *b;
+    int32_t          k;
+
+    for( k = 0; k < entry->symbols.count; k++ )
+    {
+        if( ! symbols || entry->indexes[ k ] >= symbols->count ) return false;
+
+        a = &entry->symbols.variables[ k ];
+        b = &symbols->variables[ entry->indexes[ k ] ];
+
+        if( a->pointer != b->pointer || ( ! a->pointer && a->slot != b->slot ) || strcmp( a->name, b->name ) != 0 ) return false;
+    }
+
+    return true;
+}
+
+
+
+// Keeps in an entry copies of the variables of the symbol table
+// its expression refers to, with their positions (a single block:
+// the variables, the positions then the names): the caller's table
+// can change or go away once the program is cached.
+// The variables are found reading the tokens of the expression,
+// as EECompile() did.
+// Returns false if out of memory.
+
+bool EECacheSymbols( EECacheEntry *entry, const char *expression, const EESymbols *symbols )
+{
+    EEvaluation eval;
+    EEToken     token;
+    EEVariable  *variables;
+    int32_t     *indexes,
+                *found;
+    char        *names;
+    size_t      size,
+                length;
+    int32_t     count,
+                index,
+                k;
+
+    if( ! symbols || symbols->count == 0 ) return true;
+
+    // An identifier and what follows it take at least 2 characters
+
+    length = strlen( expression );
+    found = malloc( ( length / 2 + 1 ) * sizeof( int32_t ) );
+    if( ! found ) return false;
+
+    memset( &eval, 0, sizeof( EEvaluation ) );
+    eval.expression = eval.cursor = expression;
+    eval.end = expression + length;
+    eval.symbols = symbols;
+
+    count = 0;
+
+    for( ;; )
+    {
+        index = (int32_t)EEvalToken( &eval, &token );
+        if( token == ETEof ) break;
+
+        // Names bound by statements and the `=` and `;` of the
+        // statements are not tokens (see EECompileStatements())
+
+        if( token == ETErr )
+        {
+            length = EEvalIdentifierLength( eval.cursor, eval.end );
+            eval.cursor += length ? length : 1;
+            eval.error = NULL;
+            continue;
+        }
+
+        if( token != ETVar ) continue;
+
+        for( k = 0; k < count && found[ k ] != index; k++ );
+        if( k == count ) found[ count++ ] = index;
+    }
+
+    size = count * ( sizeof( EEVariable ) + sizeof( int32_t ) );
+
+    for( k = 0; k < count; k++ )
+    {
+        size += strlen( symbols->variables[ found[ k ] ].name ) + 1;
+    }
+
+    variables = malloc( size );
+    if( ! variables )
+    {
+        free( found );
+        return false;
+    }
+
+    indexes = (int32_t *)( variables + count );
+    names = (char *)( indexes + count );
+
+    for( k = 0; k < count; k++ )
+    {
+        length = strlen( symbols->variables[ found[ k ] ].name ) + 1;
+        memcpy( names, symbols->variables[ found[ k ] ].name, length );
+
+        variables[ k ] = symbols->variables[ found[ k ] ];
+        variables[ k ].name = names;
+        indexes[ k ] = found[ k ];
+
+        names += length;
+    }
+
+    free( found );
+
+    entry->symbols.variables = variables;
+    entry->symbols.count = count;
+    entry->indexes = indexes;
+    entry->symbolsSize = size;
+
+    return true;
+}
+
+
+
+// Frees an entry: its program and its copies of the variables.
+
+void EECacheFree( EECacheEntry *entry )
+{
+    EEFreeProgram( &entry->program );
+    free( (void *)entry->symbols.variables );
+    free( entry );
+}
+
+
+
+// A thread takes a reference to an entry it found
+// (the lock of the shard is held; references are
+// dropped without it, see EECacheRelease()).
+
+void EECacheTake( EECacheEntry *entry )
+{
+    __atomic_fetch_add( &entry->users, 1, __ATOMIC_RELAXED );
+    entry->referenced = true;
+}
+
+
+
+// Adds an entry to the hash table and to the CLOCK ring
+// (the lock of the shard is held).
+// Returns false if out of memory.
+
+bool EECacheInsert( EECacheShard *shard, EECacheEntry *entry )
+{
+    EECacheEntry **buckets,
+                 **ring,
+                 *other,
+                 *next;
+    size_t       count,
+                 k;
+
+    // At most one entry per bucket on average
+
+    if( shard->count >= shard->bucketsCount )
+    {
+        count = shard->bucketsCount ? shard->bucketsCount * 2 : 64;
+
+        buckets = calloc( count, sizeof( EECacheEntry * ) );
+        if( ! buckets ) return false;
+
+        for( k = 0; k < shard->bucketsCount; k++ )
+        {
+            for( other = shard->buckets[ k ]; other; other = next )
+            {
+                next = other->next;
+                other->next = buckets[ other->hash & ( count - 1 ) ];
+                buckets[ other->hash & ( count - 1 ) ] = other;
+            }
+        }
+
+        free( shard->buckets );
+        shard->buckets = buckets;
+        shard->bucketsCount = count;
+    }
+
+    if( shard->count == shard->capacity )
+    {
+        count = shard->capacity ? shard->capacity * 2 : 64;
+
+        ring = realloc( shard->ring, count * sizeof( EECacheEntry * ) );
+        if( ! ring ) return false;
+
+        shard->ring = ring;
+        shard->capacity = count;
+    }
+
+    k = entry->hash & ( shard->bucketsCount - 1 );
+    entry->next = shard->buckets[ k ];
+    shard->buckets[ k ] = entry;
+
+    shard->ring[ shard->count++ ] = entry;
+    shard->memory += entry->memory;
+
+    return true;
+}
+
+
+
+// Evicts programs until the memory used by the shard is within `limit`
+// (the lock of the shard is held).
+
+void EECacheEvict( EECacheShard *shard, size_t limit )
+{
+    EECacheEntry *entry,
+                 **link;
+
+    while( shard->memory > limit && shard->count > 0 )
+    {
+        if( shard->hand >= shard->count ) shard->hand = 0;
+
+        entry = shard->ring[ shard->hand ];
+
+        // Executed since the hand passed: a second chance
+
+        if( entry->referenced )
+        {
+            entry->referenced = false;
+            shard->hand++;
+            continue;
+        }
+
+        for( link = &shard->buckets[ entry->hash & ( shard->bucketsCount - 1 ) ]; *link != entry; link = &( *link )->next );
+        *link = entry->next;
+
+        shard->ring[ shard->hand ] = shard->ring[ --shard->count ];
+        shard->memory -= entry->memory;
+        shard->evictions++;
+
+        // Freed now unless some thread is executing it
+
+        EECacheRelease( entry );
+    }
+}
+
+
+
+// Drops a reference to an entry (no lock is needed):
+// frees it if it was the last one (the entry was evicted
+// and no other thread is executing its program).
+
+void EECacheRelease( EECacheEntry *entry )
+{
+    if( __atomic_sub_fetch( &entry->users, 1, __ATOMIC_ACQ_REL ) == 0 )
+    {
+        EECacheFree( entry );
+    }
+}
+
+
+
+// Returns the memory used by an entry (its program
+// and its copies of the variables) in bytes
+
+size_t EECacheMemory( const EECacheEntry *entry )
+{
+    const EEProgram *program;
+
+    program = &entry->program;
+
+    return sizeof( EECacheEntry ) +
+           entry->symbolsSize +
+           strlen( program->expression ) + 1 +
+           program->constantsCapacity * sizeof( double ) +
+           program->instructionsCapacity * sizeof( EEInstruction ) +
+           program->pointersCapacity * sizeof( double * ) +
+           program->argumentsCapacity * sizeof( int32_t ) +
+           program->outputsCapacity * ( sizeof( int32_t ) + sizeof( char * ) ) +
+           EECacheNames( program ) +
+           program->nativeSize +
+           ( program->registers ? ( program->constantsCount + program->instructionsCount + ( program->outputsCount > 1 ? program->outputsCount : 0 ) ) * sizeof( double ) : 0 );
+}
+
+
+
+// The memory of the names of the outputs of a program
+
+size_t EECacheNames( const EEProgram *program )
+{
+    size_t  memory;
+    int32_t k;
+
+    memory = 0;
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        if( program->names[ k ] ) memory += strlen( program->names[ k ] ) + 1;
+    }
+
+    return memory;
+}
+
+
+
+#else
+
+
+
+// Without the cache expressions are compiled on each call
+
+EEvalStatus EEvaluateCached( EEvaluation *eval, const char *expression, const EESymbols *symbols, const double *slots, double *result )
+{
+    EEProgram   program;
+    EEvalStatus status;
+    size_t      position;
+
+    *result = 0;
+
+    if( EECompile( eval, expression, symbols, &program ) == EEvalFailure ) return EEvalFailure;
+
+    status = EEExecute( eval, &program, slots, result );
+
+    position = (size_t)( eval->cursor - eval->expression );
+    eval->expression = expression;
+    eval->cursor = expression + position;
+
+    EEFreeProgram( &program );
+
+    return status;
+}
+
+
+
+void EECacheLimit( size_t bytes )
+{
+}
+
+
+
+void EECacheStatistics( EECacheStats *stats )
+{
+    memset( stats, 0, sizeof( EECacheStats ) );
+}
+
+
+
+void EECacheFlush( void )
+{
+}
+
+
+
+#endif
@@ -0,0 +1,297 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_function.c
+//
+//  the registry of functions: the built-in ones
+//  and those registered by the application
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+// The registered functions are found by name in a hash table
+// (open addressing) of twice as many slots as functions:
+// each slot holds the index of a function plus one (0 if empty).
+// Built-in functions are keywords (see EEvalKeywords[]).
+
+#define EEFunctionsTableSize ( 2 * eeval_max_functions )
+
+int32_t EEFunctionsTable[ EEFunctionsTableSize ];
+
+
+
+// The functions: the built-in ones at their index (see EEBuiltIn),
+// then the registered ones in the order of registration.
+// Expressions refer to a function by its index: it is looked up
+// once by the lexer, calls don't compare names.
+// Built-in functions are computed by their own instructions in
+// compiled programs (log() of a single argument by EOLog); EEvaluate()
+// calls the scalar functions of those of one or two arguments and
+// reduces max(), min() and avg() one argument at a time.
+// if() takes the branch as soon as the condition is known
+// (EEvaluate() skips the other one, see EEvalArgument()).
+
+EEFunction EEFunctions[ eeval_max_functions ] =
+{
+    [ EFSin ] = { "sin",  1, 1,          EEFunctionSin,  NULL, EOSin },
+    [ EFCos ] = { "cos",  1, 1,          EEFunctionCos,  NULL, EOCos },
+    [ EFTan ] = { "tan",  1, 1,          EEFunctionTan,  NULL, EOTan },
+    [ EFASi ] = { "asin", 1, 1,          EEFunctionASin, NULL, EOASi },
+    [ EFACo ] = { "acos", 1, 1,          EEFunctionACos, NULL, EOACo },
+    [ EFATa ] = { "atan", 1, 1,          EEFunctionATan, NULL, EOATa },
+    [ EFFac ] = { "fact", 1, 1,          EEFunctionFact, NULL, EOFct },
+    [ EFExp ] = { "exp",  1, 1,          EEFunctionExp,  NULL, EOExp },
+    [ EFPow ] = { "pow",  2, 2,          EEFunctionPow,  NULL, EOPow },
+    [ EFLog ] = { "log",  1, 2,          EEFunctionLog,  NULL, EOLgb },
+    [ EFMax ] = { "max",  1, EEVariadic, EEFunctionMax,  NULL, EOMax },
+    [ EFMin ] = { "min",  1, EEVariadic, EEFunctionMin,  NULL, EOMin },
+    [ EFAvg ] = { "avg",  1, EEVariadic, EEFunctionAvg,  NULL, EOAdd },  // the sum divided by the count
+    [ EFIf  ] = { "if",   3, 3,          EEFunctionIf,   NULL, EOSel }
+};
+
+int32_t EEFunctionsCount = EFBuiltInCount;
+
+
+
+// Registers a function that expressions can call by `name`
+// with `arity` arguments (from 1 to eeval_max_arguments) or
+// with any number of them, at least one (EEVariadic).
+// `scalar` computes a result from the arguments; `batch`, optional,
+// computes the results of many rows at once in EEvaluateBatch()
+// (if NULL `scalar` is called for each row). Both are called on any
+// argument, NaN and infinities included, and can return NaN or
+// infinity to fail with "result is complex or too big".
+// The name must be an identifier that is not a keyword nor a function
+// already registered; registered functions take precedence over
+// variables of the same name. The name is copied.
+// Registered functions are never folded nor merged by the optimizer:
+// they are called as many times as the expression says.
+// Functions are registered for the whole process and can't be removed:
+// register them before evaluating expressions in other threads
+// (registering is not synchronized with evaluations).
+// Returns false if the function can't be registered
+// (invalid arguments, name taken, registry full, out of memory).
+
+bool EERegisterFunction( const char       *name,    // identifier: letters, digits and underscores; can't begin with a digit
+                         int32_t          arity,    // the number of arguments or EEVariadic
+                         EEScalarFunction scalar,   // computes a result
+                         EEBatchFunction  batch )   // computes many results (or NULL)
+{
+    EEFunction *function;
+    char       *copy;
+    size_t     length;
+    uint32_t   slot;
+
+    if( ! name || ! scalar ) return false;
+    if( arity != EEVariadic && ( arity < 1 || arity > eeval_max_arguments ) ) return false;
+    if( EEFunctionsCount == eeval_max_functions ) return false;
+
+    length = strlen( name );
+
+    if( length == 0 || EEvalIdentifierLength( name, name + length ) != length ) return false;
+    if( EEvalKeyword( name, length ) || EEFunctionLookup( name, length ) >= 0 ) return false;
+
+    copy = malloc( length + 1 );
+    if( ! copy ) return false;
+
+    memcpy( copy, name, length + 1 );
+
+    function = &EEFunctions[ EEFunctionsCount ];
+    function->name    = copy;
+    function->minimum = arity == EEVariadic ? 1 : arity;
+    function->maximum = arity;
+    function->scalar  = scalar;
+    function->batch   = batch;
+    function->opcode  = EOCall;
+
+    // The table can't be full: it has twice as many slots as functions
+
+    slot = EEFunctionHash( name, length ) % EEFunctionsTableSize;
+
+    while( EEFunctionsTable[ slot ] ) slot = ( slot + 1 ) % EEFunctionsTableSize;
+
+    EEFunctionsTable[ slot ] = ++EEFunctionsCount;
+
+    return true;
+}
+
+
+
+// ***********************
+// PRIVATE FUNCTIONS BELOW
+// ***********************
+
+
+
+// Looks up the identifier of `length` characters at `cursor`
+// among the registered functions.
+// Returns its index in EEFunctions[] or -1 if not registered.
+
+int32_t EEFunctionLookup( const char *cursor, size_t length )
+{
+    const EEFunction *function;
+    uint32_t         slot;
+
+    slot = EEFunctionHash( cursor, length ) % EEFunctionsTableSize;
+
+    while( EEFunctionsTable[ slot ] )
+    {
+        function = &EEFunctions[ EEFunctionsTable[ slot ] - 1 ];
+
+        if( strncmp( function->name, cursor, length ) == 0 && function->name[ length ] == '\0' )
+        {
+            return EEFunctionsTable[ slot ] - 1;
+        }
+
+        slot = ( slot + 1 ) % EEFunctionsTableSize;
+    }
+
+    return -1;
+}
+
+
+
+// Hashes the `length` characters at `cursor` (FNV-1a).
+
+uint32_t EEFunctionHash( const char *cursor, size_t length )
+{
+    uint32_t hash;
+    size_t   k;
+
+    hash = 2166136261u;
+
+    for( k = 0; k < length; k++ )
+    {
+        hash = ( hash ^ (uint8_t)cursor[ k ] ) * 16777619u;
+    }
+
+    return hash;
+}
+
+
+
+// The built-in functions called by EEvaluate():
+// the checks of the arguments are left to the caller
+// (see EEvalArgument())
+
+double EEFunctionSin( const double *arguments, int32_t count )
+{
+    return sin( arguments[ 0 ] );
+}
+
+double EEFunctionCos( const double *arguments, int32_t count )
+{
+    return cos( arguments[ 0 ] );
+}
+
+double EEFunctionTan( const double *arguments, int32_t count )
+{
+    return tan( arguments[ 0 ] );
+}
+
+double EEFunctionASin( const double *arguments, int32_t count )
+{
+    return asin( arguments[ 0 ] );
+}
+
+double EEFunctionACos( const double *arguments, int32_t count )
+{
+    return acos( arguments[ 0 ] );
+}
+
+double EEFunctionATan( const double *arguments, int32_t count )
+{
+    return atan( arguments[ 0 ] );
+}
+
+double EEFunctionFact( const double *arguments, int32_t count )
+{
+    return tgamma( arguments[ 0 ] + 1 );
+}
+
+double EEFunctionExp( const double *arguments, int32_t count )
+{
+    return exp( arguments[ 0 ] );
+}
+
+double EEFunctionPow( const double *arguments, int32_t count )
+{
+    return pow( arguments[ 0 ], arguments[ 1 ] );
+}
+
+// log(n) natural logarithm of n, log(b, n) logarithm of n with base b
+
+double EEFunctionLog( const double *arguments, int32_t count )
+{
+    return count == 1 ? log( arguments[ 0 ] ) : log( arguments[ 1 ] ) / log( arguments[ 0 ] );
+}
+
+double EEFunctionMax( const double *arguments, int32_t count )
+{
+    double  result;
+    int32_t k;
+
+    result = arguments[ 0 ];
+
+    for( k = 1; k < count; k++ )
+    {
+        if( arguments[ k ] > result ) result = arguments[ k ];
+    }
+
+    return result;
+}
+
+double EEFunctionMin( const double *arguments, int32_t count )
+{
+    double  result;
+    int32_t k;
+
+    result = arguments[ 0 ];
+
+    for( k = 1; k < count; k++ )
+    {
+        if( arguments[ k ] < result ) result = arguments[ k ];
+    }
+
+    return result;
+}
+
+double EEFunctionAvg( const double *arguments, int32_t count )
+{
+    double  result;
+    int32_t k;
+
+    result = arguments[ 0 ];
+
+    for( k = 1; k < count; k++ )
+    {
+        result += arguments[ k ];
+    }
+
+    return result / (double)count;
+}
+
+// if(c, a, b): a if c is not 0 (NaN included), otherwise b
+
+double EEFunctionIf( const double *arguments, int32_t count )
+{
+    return arguments[ 0 ] != 0 ? arguments[ 1 ] : arguments[ 2 ];
+}
@@ -0,0 +1,1155 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_jit.c
+//
+//  translates a compiled program into
+//  native x86-64 code (optional)
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#if eeval_jit
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+
+#if eeval_jit
+
+
+
+// The native code is a function with the System V calling convention:
+//
+//      int32_t native( double *spill, const double *slots, double *result )
+//
+// It returns 0 on success, otherwise `( i << 2 ) | kind` where `i` is
+// the instruction that failed and `kind` an EEJitFailureKind.
+//
+// rbx holds `spill` (the memory of the results of the instructions,
+// followed by the outputs of programs of several), rbp holds `slots`,
+// r13 holds `result`.
+// The results of the instructions are kept in xmm2...xmm15 and written
+// to `spill` only when a register is needed by another value or before
+// calling a math function (calls do not preserve the xmm registers).
+// xmm0 and xmm1 are scratch registers (arguments of the math functions).
+//
+// The code is preceded by a pool holding the masks, the constants used
+// by the checks and the constants pool of the program (read rip-relative).
+//
+// As the interpreter, the code computes only the branches taken: the
+// instructions of a branch not taken (their guard is 0) are jumped over
+// and their results are 0 (see EEJitRun()). if(), && and || then choose
+// with masks between the branch taken and the 0 of the other one.
+
+typedef int32_t (*EEJitFunction)( double *spill, const double *slots, double *result );
+
+// Programs with up to this number of instructions spill on the
+// stack; the larger ones in the registers of the program
+// (see EEProgramRegisters())
+
+#define EEJitStackSpill 256
+
+#define EEJitRAX 0
+#define EEJitRBX 3
+#define EEJitRSP 4
+#define EEJitRBP 5
+
+#define EEJitFirstXmm 2
+#define EEJitXmmCount 16
+
+// Offsets in the pool
+
+#define EEJitSignMask 0
+#define EEJitAbsMask  16
+#define EEJitMaximum  32
+#define EEJitOne      40
+#define EEJitConstants 48
+
+// SSE2 opcodes (after the 0x0F escape)
+
+#define EEJitMovLoad  0x10  // F2: movsd xmm, m64
+#define EEJitMovStore 0x11  // F2: movsd m64, xmm
+#define EEJitMovapd   0x28  // 66: movapd xmm, xmm
+#define EEJitUcomisd  0x2E  // 66: ucomisd xmm, xmm/m64
+#define EEJitSqrtsd   0x51  // F2
+#define EEJitAndpd    0x54  // 66
+#define EEJitAndnpd   0x55  // 66
+#define EEJitOrpd     0x56  // 66
+#define EEJitXorpd    0x57  // 66
+#define EEJitAddsd    0x58  // F2
+#define EEJitMulsd    0x59  // F2
+#define EEJitSubsd    0x5C  // F2
+#define EEJitMinsd    0x5D  // F2
+#define EEJitDivsd    0x5E  // F2
+#define EEJitMaxsd    0x5F  // F2
+#define EEJitCmpsd    0xC2  // F2: cmpsd xmm, xmm, predicate (imm8)
+
+// Predicates of cmpsd: all ones if true, all zeros if false
+// (not equal is true on NaN, the others false)
+
+#define EEJitCmpEq    0
+#define EEJitCmpLt    1
+#define EEJitCmpLe    2
+#define EEJitCmpNeq   4
+
+// Condition codes of jcc rel32 (after the 0x0F escape)
+
+#define EEJitJE       0x84
+#define EEJitJA       0x87
+#define EEJitJP       0x8A
+
+
+
+// Translates a program compiled with EECompile() into native code.
+// Once translated EEExecute() runs the native code instead of
+// interpreting the instructions: results and errors are the same.
+// Returns false (and the program is left as is) if native code
+// can't be generated: EEExecute() keeps interpreting the program.
+// The native code is released by EEFreeProgram().
+
+bool EEJitCompile( EEProgram *program ) // the compiled program
+{
+    EEJit   jit;
+    void    *page;
+    size_t  pageSize,
+            size;
+    int32_t guard,
+            i,
+            last,
+            k;
+
+    if( ! program->expression ) return false;
+
+    if( program->native ) return true;
+
+    memset( &jit, 0, sizeof( EEJit ) );
+
+    jit.program = program;
+    jit.lastUse = malloc( ( program->instructionsCount + 1 ) * sizeof( int32_t ) );
+
+    if( ! jit.lastUse ) return false;
+
+    EEJitLiveness( &jit );
+
+    for( k = 0; k < EEJitXmmCount; k++ )
+    {
+        jit.holder[ k ] = -1;
+    }
+
+    // The pool
+
+    EEJitQword( &jit, 0x8000000000000000ULL );
+    EEJitQword( &jit, 0 );
+    EEJitQword( &jit, 0x7fffffffffffffffULL );
+    EEJitQword( &jit, 0x7fffffffffffffffULL );
+    EEJitDouble( &jit, DBL_MAX );
+    EEJitDouble( &jit, 1 );
+
+    for( k = 0; k < program->constantsCount; k++ )
+    {
+        EEJitDouble( &jit, program->constants[ k ] );
+    }
+
+    while( jit.size % 16 )
+    {
+        EEJitByte( &jit, 0xCC );
+    }
+
+    jit.entry = jit.size;
+
+    // Prologue: push rbx, push rbp, push r13 (the stack is aligned to 16 bytes)
+    // mov rbx, rdi; mov rbp, rsi; mov r13, rdx
+
+    EEJitBytes( &jit, "\x53\x55\x41\x55", 4 );
+    EEJitBytes( &jit, "\x48\x89\xFB\x48\x89\xF5\x49\x89\xD5", 9 );
+
+    // Instructions with a guard in runs of the same guard
+
+    for( i = 0; i < program->instructionsCount; i = last + 1 )
+    {
+        guard = program->instructions[ i ].guard;
+        last  = i;
+
+        if( guard >= 0 )
+        {
+            while( last + 1 < program->instructionsCount && program->instructions[ last + 1 ].guard == guard )
+            {
+                last++;
+            }
+
+            EEJitRun( &jit, i, last );
+        }
+        else
+        {
+            EEJitInstruction( &jit, i );
+        }
+    }
+
+    // The outputs after the results of the instructions (if more than one):
+    // movsd xmm0, output; movsd [rbx + 8 * ( instructionsCount + k )], xmm0
+
+    for( k = 0; k < program->outputsCount && program->outputsCount > 1; k++ )
+    {
+        EEJitLoad( &jit, 0, program->outputs[ k ] );
+        EEJitSSE( &jit, 0xF2, EEJitMovStore, 0, EEJitMemory( EEJitRBX, 8 * ( program->instructionsCount + k ) ) );
+    }
+
+    // The result: movsd xmm0, result; movsd [r13], xmm0; xor eax, eax
+
+    EEJitLoad( &jit, 0, program->result );
+    EEJitSSE( &jit, 0xF2, EEJitMovStore, 0, EEJitMemory( 13, 0 ) );
+    EEJitBytes( &jit, "\x31\xC0", 2 );
+
+    // Epilogue: pop r13, pop rbp, pop rbx, ret
+
+    jit.epilogue = jit.size;
+    EEJitBytes( &jit, "\x41\x5D\x5D\x5B\xC3", 5 );
+
+    // Failures: mov eax, code; jmp epilogue
+
+    for( k = 0; k < jit.failuresCount; k++ )
+    {
+        EEJitPatch( &jit, jit.failures[ k ].jump, jit.size );
+        EEJitByte( &jit, 0xB8 );
+        EEJitDword( &jit, jit.failures[ k ].code );
+        EEJitByte( &jit, 0xE9 );
+        EEJitDword( &jit, 0 );
+        EEJitPatch( &jit, jit.size - 4, jit.epilogue );
+    }
+
+    free( jit.lastUse );
+    free( jit.failures );
+
+    if( jit.error )
+    {
+        free( jit.code );
+        return false;
+    }
+
+    // Copy the code into executable memory (never writable and executable at the same time)
+
+    pageSize = (size_t)sysconf( _SC_PAGESIZE );
+    size = ( jit.size + pageSize - 1 ) / pageSize * pageSize;
+
+    page = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( page == MAP_FAILED )
+    {
+        free( jit.code );
+        return false;
+    }
+
+    memcpy( page, jit.code, jit.size );
+    free( jit.code );
+
+    if( mprotect( page, size, PROT_READ | PROT_EXEC ) != 0 )
+    {
+        munmap( page, size );
+        return false;
+    }
+
+    program->native = page;
+    program->nativeSize = size;
+    program->nativeEntry = jit.entry;
+
+    return true;
+}
+
+
+
+// Executes the native code of a program.
+// Called by EEExecute() (arguments are already checked):
+// the outputs are copied in `results` if not NULL
+// (left as they are if the execution fails).
+
+EEvalStatus EEJitExecute( EEvaluation     *eval,
+                          const EEProgram *program,
+                          const double    *slots,
+                          double          *result,
+                          double          *results )
+{
+    double              stackSpill[ EEJitStackSpill ];
+    double              *spill;
+    EEJitFunction       native;
+    int32_t             code,
+                        count,
+                        k;
+    const EEInstruction *ins;
+
+    count = program->instructionsCount + ( program->outputsCount > 1 ? program->outputsCount : 0 );
+
+    if( count <= EEJitStackSpill )
+    {
+        spill = stackSpill;
+    }
+    else if( ( spill = EEProgramRegisters( program ) ) != NULL )
+    {
+        // After the constants: the registers of the instructions
+
+        spill += program->constantsCount;
+    }
+    else
+    {
+        spill = malloc( count * sizeof( double ) );
+        if( ! spill )
+        {
+            eval->error = "out of memory";
+            return EEvalFailure;
+        }
+    }
+
+    native = (EEJitFunction)( (char *)program->native + program->nativeEntry );
+
+    code = native( spill, slots, result );
+
+    // Never -0, as with EEProgramExecute()
+
+    *result = *result + 0;
+
+    for( k = 0; k < program->outputsCount && results && code == 0; k++ )
+    {
+        results[ k ] = program->outputsCount > 1 ? spill[ program->instructionsCount + k ] + 0 : *result;
+    }
+
+    if( program->registers && spill == program->registers + program->constantsCount )
+    {
+        EEProgramReturn( program );
+    }
+    else if( spill != stackSpill )
+    {
+        free( spill );
+    }
+
+    if( code == 0 )
+    {
+        eval->result = *result;
+        eval->error = "";
+        return EEvalSuccess;
+    }
+
+    ins = &program->instructions[ code >> 2 ];
+
+    switch( code & 3 )
+    {
+        case EJDivision:
+            eval->error = "division by zero";
+            break;
+
+        case EJFactorial:
+            eval->error = "attempt to evaluate factorial of negative number";
+            break;
+
+        default:
+            eval->error = ins->check == ECTooBig ? "result is too big" : "result is complex or too big";
+            break;
+    }
+
+    eval->cursor = program->expression + ins->position;
+
+    *result = 0;
+    return EEvalFailure;
+}
+
+
+
+// Releases the native code of a program.
+
+void EEJitRelease( EEProgram *program )
+{
+    if( program->native )
+    {
+        munmap( program->native, program->nativeSize );
+    }
+
+    program->native = NULL;
+    program->nativeSize = 0;
+    program->nativeEntry = 0;
+}
+
+
+
+// ***********************
+// PRIVATE FUNCTIONS BELOW
+// ***********************
+
+
+
+// Generates the code of instruction `i`.
+
+void EEJitInstruction( EEJit *jit, int32_t i )
+{
+    const EEProgram     *program;
+    const EEInstruction *ins;
+    const int32_t       *call;
+    int32_t             size,
+                        k;
+    int                 r;
+    void                *function;
+
+    program = jit->program;
+    ins = &program->instructions[ i ];
+
+    function = NULL;
+
+    switch( ins->opcode )
+    {
+        case EOSin: function = (void *)sin;         break;
+        case EOCos: function = (void *)cos;         break;
+        case EOTan: function = (void *)tan;         break;
+        case EOASi: function = (void *)asin;        break;
+        case EOACo: function = (void *)acos;        break;
+        case EOATa: function = (void *)atan;        break;
+        case EOExp: function = (void *)exp;         break;
+        case EOLog: function = (void *)log;         break;
+        case EOPow: function = (void *)EEPower;     break;
+        case EOFct: function = (void *)EEFactorial; break;
+        case EOLgb: function = (void *)log;         break;
+        case EOCall: function = (void *)EEFunctions[ ins->a ].scalar; break;
+        default:                                    break;
+    }
+
+    if( function )
+    {
+        // a! fails on negative numbers: xorpd xmm1, xmm1; ucomisd xmm1, a; ja failure
+
+        if( ins->opcode == EOFct && ! ins->safe )
+        {
+            EEJitSSE( jit, 0x66, EEJitXorpd, 1, EEJitXmm( 1 ) );
+            EEJitSSE( jit, 0x66, EEJitUcomisd, 1, EEJitOperand( jit, ins->a ) );
+            EEJitFailure( jit, EEJitJA, i, EJFactorial );
+        }
+
+        // Values still needed after the call must be in memory
+        // (log(a, b) also needs `a` after the first call)
+
+        EEJitSpill( jit, ins->opcode == EOLgb ? i - 1 : i );
+
+        if( ins->opcode == EOLgb )
+        {
+            // log(b) / log(a): log(b) is kept in the spill memory of the result
+
+            EEJitLoad( jit, 0, ins->b );
+            EEJitCall( jit, function );
+            EEJitSSE( jit, 0xF2, EEJitMovStore, 0, EEJitMemory( EEJitRBX, i * 8 ) );
+            EEJitLoad( jit, 0, ins->a );
+            EEJitCall( jit, function );
+            EEJitSSE( jit, 0x66, EEJitMovapd, 1, EEJitXmm( 0 ) );
+            EEJitSSE( jit, 0xF2, EEJitMovLoad, 0, EEJitMemory( EEJitRBX, i * 8 ) );
+            EEJitSSE( jit, 0xF2, EEJitDivsd, 0, EEJitXmm( 1 ) );
+        }
+        else if( ins->opcode == EOCall )
+        {
+            // Registered function: the arguments are copied on the stack
+            // (16 bytes aligned), then function( rsp, count ):
+            // sub rsp, size; movsd [rsp + 8k], argument...;
+            // mov rdi, rsp; mov esi, count; call; add rsp, size
+
+            call = &program->arguments[ ins->b ];
+            size = ( call[ 0 ] * 8 + 15 ) & ~15;
+
+            EEJitBytes( jit, "\x48\x81\xEC", 3 );
+            EEJitDword( jit, size );
+
+            for( k = 0; k < call[ 0 ]; k++ )
+            {
+                EEJitLoad( jit, 0, call[ k + 1 ] );
+                EEJitSSE( jit, 0xF2, EEJitMovStore, 0, EEJitMemory( EEJitRSP, k * 8 ) );
+            }
+
+            EEJitBytes( jit, "\x48\x89\xE7", 3 );
+            EEJitByte( jit, 0xBE );
+            EEJitDword( jit, call[ 0 ] );
+            EEJitCall( jit, function );
+
+            EEJitBytes( jit, "\x48\x81\xC4", 3 );
+            EEJitDword( jit, size );
+        }
+        else
+        {
+            EEJitLoad( jit, 0, ins->a );
+
+            if( ins->opcode == EOPow )
+            {
+                EEJitLoad( jit, 1, ins->b );
+            }
+
+            EEJitCall( jit, function );
+        }
+
+        r = EEJitAllocate( jit, i, -1, -1 );
+        EEJitSSE( jit, 0x66, EEJitMovapd, r, EEJitXmm( 0 ) );
+    }
+    else
+    {
+        switch( ins->opcode )
+        {
+            case EOVar:
+                // mov rax, pointer; movsd r, [rax]
+                r = EEJitAllocate( jit, i, -1, -1 );
+                EEJitBytes( jit, "\x48\xB8", 2 );
+                EEJitQword( jit, (uint64_t)(uintptr_t)program->pointers[ ins->a ] );
+                EEJitSSE( jit, 0xF2, EEJitMovLoad, r, EEJitMemory( EEJitRAX, 0 ) );
+                break;
+
+            case EOSlt:
+                r = EEJitAllocate( jit, i, -1, -1 );
+                EEJitSSE( jit, 0xF2, EEJitMovLoad, r, EEJitMemory( EEJitRBP, ins->a * 8 ) );
+                break;
+
+            case EOChk:
+                r = EEJitTarget( jit, i, ins->a, -1 );
+                break;
+
+            case EOSqt:
+                r = EEJitTarget( jit, i, ins->a, -1 );
+                EEJitSSE( jit, 0xF2, EEJitSqrtsd, r, EEJitXmm( r ) );
+                break;
+
+            case EONeg:
+                r = EEJitTarget( jit, i, ins->a, -1 );
+                EEJitSSE( jit, 0x66, EEJitXorpd, r, EEJitPool( EEJitSignMask ) );
+                break;
+
+            case EODiv:
+                // fails on division by zero: xorpd xmm1, xmm1; ucomisd xmm1, b; jp +6; je failure
+                if( ! ins->safe )
+                {
+                    EEJitSSE( jit, 0x66, EEJitXorpd, 1, EEJitXmm( 1 ) );
+                    EEJitSSE( jit, 0x66, EEJitUcomisd, 1, EEJitOperand( jit, ins->b ) );
+                    EEJitBytes( jit, "\x7A\x06", 2 );
+                    EEJitFailure( jit, EEJitJE, i, EJDivision );
+                }
+                r = EEJitTarget( jit, i, ins->a, ins->b );
+                EEJitSSE( jit, 0xF2, EEJitDivsd, r, EEJitOperand( jit, ins->b ) );
+                break;
+
+            case EOMax:
+            case EOMin:
+                // b > a ? b : a (b < a ? b : a) is maxsd b, a (minsd b, a)
+                r = EEJitTarget( jit, i, ins->b, ins->a );
+                EEJitSSE( jit, 0xF2, ins->opcode == EOMax ? EEJitMaxsd : EEJitMinsd, r, EEJitOperand( jit, ins->a ) );
+                break;
+
+            case EOLt:
+            case EOLe:
+            case EOEq:
+            case EONe:
+                // movsd xmm0, a; movsd xmm1, b; cmpsd xmm0, xmm1, predicate
+                // (operands in registers: the predicate follows the address)
+                EEJitLoad( jit, 0, ins->a );
+                EEJitLoad( jit, 1, ins->b );
+                EEJitSSE( jit, 0xF2, EEJitCmpsd, 0, EEJitXmm( 1 ) );
+                EEJitByte( jit, ins->opcode == EOLt ? EEJitCmpLt : ins->opcode == EOLe ? EEJitCmpLe : ins->opcode == EOEq ? EEJitCmpEq : EEJitCmpNeq );
+                r = EEJitBoolean( jit, i );
+                break;
+
+            case EONot:
+                // movsd xmm0, a; xorpd xmm1, xmm1; cmpsd xmm0, xmm1, eq
+                EEJitLoad( jit, 0, ins->a );
+                EEJitSSE( jit, 0x66, EEJitXorpd, 1, EEJitXmm( 1 ) );
+                EEJitSSE( jit, 0xF2, EEJitCmpsd, 0, EEJitXmm( 1 ) );
+                EEJitByte( jit, EEJitCmpEq );
+                r = EEJitBoolean( jit, i );
+                break;
+
+            case EOAnd:
+            case EOOr:
+                // movsd xmm0, a; xorpd xmm1, xmm1; cmpsd xmm0, xmm1, neq;
+                // movsd r, b; cmpsd r, xmm1, neq; andpd (orpd) r, xmm0; r & 1
+                EEJitLoad( jit, 0, ins->a );
+                EEJitSSE( jit, 0x66, EEJitXorpd, 1, EEJitXmm( 1 ) );
+                EEJitSSE( jit, 0xF2, EEJitCmpsd, 0, EEJitXmm( 1 ) );
+                EEJitByte( jit, EEJitCmpNeq );
+                r = EEJitTarget( jit, i, ins->b, -1 );
+                EEJitSSE( jit, 0xF2, EEJitCmpsd, r, EEJitXmm( 1 ) );
+                EEJitByte( jit, EEJitCmpNeq );
+                EEJitSSE( jit, 0x66, ins->opcode == EOAnd ? EEJitAndpd : EEJitOrpd, r, EEJitXmm( 0 ) );
+                EEJitSSE( jit, 0xF2, EEJitMovLoad, 1, EEJitPool( EEJitOne ) );
+                EEJitSSE( jit, 0x66, EEJitAndpd, r, EEJitXmm( 1 ) );
+                break;
+
+            case EOSel:
+                // The branch not taken was jumped over (it is 0), the mask
+                // of the condition chooses: movsd xmm0, c; xorpd xmm1, xmm1; cmpsd xmm0, xmm1, neq;
+                // movsd xmm1, x; andpd xmm1, xmm0; movsd r, y; andnpd xmm0, r;
+                // orpd xmm0, xmm1; movapd r, xmm0
+                call = &program->arguments[ ins->b ];
+                EEJitLoad( jit, 0, call[ 1 ] );
+                EEJitSSE( jit, 0x66, EEJitXorpd, 1, EEJitXmm( 1 ) );
+                EEJitSSE( jit, 0xF2, EEJitCmpsd, 0, EEJitXmm( 1 ) );
+                EEJitByte( jit, EEJitCmpNeq );
+                EEJitLoad( jit, 1, call[ 2 ] );
+                EEJitSSE( jit, 0x66, EEJitAndpd, 1, EEJitXmm( 0 ) );
+                r = EEJitTarget( jit, i, call[ 3 ], -1 );
+                EEJitSSE( jit, 0x66, EEJitAndnpd, 0, EEJitXmm( r ) );
+                EEJitSSE( jit, 0x66, EEJitOrpd, 0, EEJitXmm( 1 ) );
+                EEJitSSE( jit, 0x66, EEJitMovapd, r, EEJitXmm( 0 ) );
+                break;
+
+            default:
+                r = EEJitTarget( jit, i, ins->a, ins->b );
+                EEJitSSE( jit, 0xF2, ins->opcode == EOAdd ? EEJitAddsd : ins->opcode == EOSub ? EEJitSubsd : EEJitMulsd, r, EEJitOperand( jit, ins->b ) );
+                break;
+        }
+    }
+
+    // eexception(): movapd xmm1, r; andpd xmm1, abs mask; ucomisd xmm1, DBL_MAX; ja failure; jp failure
+
+    if( ins->check != ECNone && eeval_catch_fp_exceptions )
+    {
+        EEJitSSE( jit, 0x66, EEJitMovapd, 1, EEJitXmm( r ) );
+        EEJitSSE( jit, 0x66, EEJitAndpd, 1, EEJitPool( EEJitAbsMask ) );
+        EEJitSSE( jit, 0x66, EEJitUcomisd, 1, EEJitPool( EEJitMaximum ) );
+        EEJitFailure( jit, EEJitJA, i, EJCheck );
+        EEJitFailure( jit, EEJitJP, i, EJCheck );
+    }
+}
+
+
+
+// Generates the code of the instructions `first`...`last`, that have
+// the same guard: the native code jumps over them if the guard is 0
+// (NaN is not), as the interpreter skips them, and then writes 0 as
+// the results that are read after the run. The registers are written
+// to memory and forgotten before and after the run, so that the values
+// are where the code that follows expects them on both paths:
+//
+//          (spill) test guard; je zero
+//          instructions; (spill the results read afterwards) jmp join
+//    zero: xorpd xmm0, xmm0; movsd [rbx + 8 * v], xmm0 (each result read afterwards)
+//    join:
+
+void EEJitRun( EEJit *jit, int32_t first, int32_t last )
+{
+    size_t  skip,
+            join;
+    int32_t i;
+    bool    read;
+
+    EEJitSpill( jit, first - 1 );
+    EEJitForget( jit );
+
+    skip = EEJitGuard( jit, jit->program->instructions[ first ].guard );
+
+    for( i = first; i <= last; i++ )
+    {
+        EEJitInstruction( jit, i );
+    }
+
+    EEJitSpill( jit, last );
+    EEJitForget( jit );
+
+    read = false;
+
+    for( i = first; i <= last && ! read; i++ )
+    {
+        read = jit->lastUse[ i ] > last;
+    }
+
+    if( ! read )
+    {
+        EEJitPatch( jit, skip, jit->size );
+        return;
+    }
+
+    EEJitByte( jit, 0xE9 );
+    EEJitDword( jit, 0 );
+    join = jit->size - 4;
+
+    EEJitPatch( jit, skip, jit->size );
+    EEJitSSE( jit, 0x66, EEJitXorpd, 0, EEJitXmm( 0 ) );
+
+    for( i = first; i <= last; i++ )
+    {
+        if( jit->lastUse[ i ] > last )
+        {
+            EEJitSSE( jit, 0xF2, EEJitMovStore, 0, EEJitMemory( EEJitRBX, i * 8 ) );
+        }
+    }
+
+    EEJitPatch( jit, join, jit->size );
+}
+
+
+
+// Turns the mask in xmm0 (a comparison) into 1 or 0 in the register
+// of the result of instruction `i`:
+// movsd xmm1, 1; andpd xmm0, xmm1; movapd r, xmm0
+// Returns the register.
+
+int EEJitBoolean( EEJit *jit, int32_t i )
+{
+    int r;
+
+    EEJitSSE( jit, 0xF2, EEJitMovLoad, 1, EEJitPool( EEJitOne ) );
+    EEJitSSE( jit, 0x66, EEJitAndpd, 0, EEJitXmm( 1 ) );
+
+    r = EEJitAllocate( jit, i, -1, -1 );
+    EEJitSSE( jit, 0x66, EEJitMovapd, r, EEJitXmm( 0 ) );
+
+    return r;
+}
+
+
+
+// Computes the last instruction that reads each value
+// (the outputs of the program are read at the end).
+// The guard of an instruction is read before it, at the
+// beginning of its run (see EEJitRun()).
+
+void EEJitLiveness( EEJit *jit )
+{
+    const EEProgram     *program;
+    const EEInstruction *ins;
+    int32_t             i,
+                        k,
+                        v;
+
+    program = jit->program;
+
+    for( i = 0; i <= program->instructionsCount; i++ )
+    {
+        jit->lastUse[ i ] = -1;
+    }
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        ins = &program->instructions[ i ];
+
+        v = ins->a - program->constantsCount;
+        if( EEOpcodeOperands( ins->opcode ) >= 1 && v >= 0 ) jit->lastUse[ v ] = i;
+
+        v = ins->b - program->constantsCount;
+        if( EEOpcodeOperands( ins->opcode ) == 2 && v >= 0 ) jit->lastUse[ v ] = i;
+
+        if( EEOpcodeListed( ins->opcode ) )
+        {
+            for( k = 1; k <= program->arguments[ ins->b ]; k++ )
+            {
+                v = program->arguments[ ins->b + k ] - program->constantsCount;
+                if( v >= 0 ) jit->lastUse[ v ] = i;
+            }
+        }
+    }
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        v = program->instructions[ i ].guard - program->constantsCount;
+        if( v >= 0 && jit->lastUse[ v ] < i ) jit->lastUse[ v ] = i;
+    }
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        v = program->outputs[ k ] - program->constantsCount;
+        if( v >= 0 ) jit->lastUse[ v ] = program->instructionsCount;
+    }
+}
+
+
+
+// Returns the xmm register that receives the result of instruction `i`:
+// the register of `first` if it is read for the last time (and `second`
+// is not the same value), otherwise a new register where `first` is copied.
+
+int EEJitTarget( EEJit *jit, int32_t i, int32_t first, int32_t second )
+{
+    int32_t v;
+    int     r;
+
+    v = first - jit->program->constantsCount;
+
+    if( v >= 0 && jit->lastUse[ v ] == i && first != second )
+    {
+        for( r = EEJitFirstXmm; r < EEJitXmmCount; r++ )
+        {
+            if( jit->holder[ r ] == v )
+            {
+                jit->holder[ r ] = i;
+                jit->dirty[ r ] = true;
+                return r;
+            }
+        }
+    }
+
+    r = EEJitAllocate( jit, i, first, second );
+    EEJitLoad( jit, r, first );
+
+    return r;
+}
+
+
+
+// Allocates an xmm register for the result of instruction `i`.
+// Registers of dead values are taken first, otherwise the value read
+// farthest in the future is written to memory (if not already there).
+// The operands `first` and `second` are never evicted.
+
+int EEJitAllocate( EEJit *jit, int32_t i, int32_t first, int32_t second )
+{
+    int32_t v;
+    int     best,
+            r;
+
+    best = -1;
+
+    for( r = EEJitFirstXmm; r < EEJitXmmCount; r++ )
+    {
+        v = jit->holder[ r ];
+
+        if( v < 0 || jit->lastUse[ v ] < i )
+        {
+            best = r;
+            break;
+        }
+
+        if( v + jit->program->constantsCount == first || v + jit->program->constantsCount == second ) continue;
+
+        if( best < 0 || jit->lastUse[ v ] > jit->lastUse[ jit->holder[ best ] ] )
+        {
+            best = r;
+        }
+    }
+
+    v = jit->holder[ best ];
+
+    if( v >= 0 && jit->lastUse[ v ] >= i && jit->dirty[ best ] )
+    {
+        EEJitSSE( jit, 0xF2, EEJitMovStore, best, EEJitMemory( EEJitRBX, v * 8 ) );
+    }
+
+    jit->holder[ best ] = i;
+    jit->dirty[ best ] = true;
+
+    return best;
+}
+
+
+
+// Writes to memory the values held in registers that are
+// read after instruction `i` (before calling a function).
+
+void EEJitSpill( EEJit *jit, int32_t i )
+{
+    int32_t v;
+    int     r;
+
+    for( r = EEJitFirstXmm; r < EEJitXmmCount; r++ )
+    {
+        v = jit->holder[ r ];
+
+        if( v >= 0 && jit->lastUse[ v ] > i && jit->dirty[ r ] )
+        {
+            EEJitSSE( jit, 0xF2, EEJitMovStore, r, EEJitMemory( EEJitRBX, v * 8 ) );
+            jit->dirty[ r ] = false;
+        }
+    }
+}
+
+
+
+// Returns where the value held in `reg` (a register of the program) is:
+// an xmm register, the pool (constants) or the spill memory.
+
+EEJitAddress EEJitOperand( EEJit *jit, int32_t reg )
+{
+    int32_t v;
+    int     r;
+
+    if( reg < jit->program->constantsCount )
+    {
+        return EEJitPool( EEJitConstants + reg * 8 );
+    }
+
+    v = reg - jit->program->constantsCount;
+
+    for( r = EEJitFirstXmm; r < EEJitXmmCount; r++ )
+    {
+        if( jit->holder[ r ] == v ) return EEJitXmm( r );
+    }
+
+    return EEJitMemory( EEJitRBX, v * 8 );
+}
+
+
+
+// Copies the value held in `reg` (a register of the program) into xmm `r`.
+
+void EEJitLoad( EEJit *jit, int r, int32_t reg )
+{
+    EEJitAddress address;
+
+    address = EEJitOperand( jit, reg );
+
+    if( address.kind == EJXmm )
+    {
+        if( address.reg != r )
+        {
+            EEJitSSE( jit, 0x66, EEJitMovapd, r, address );
+        }
+    }
+    else
+    {
+        EEJitSSE( jit, 0xF2, EEJitMovLoad, r, address );
+    }
+}
+
+
+
+// Calls a function of the C math library: mov rax, function; call rax
+// Calls don't preserve the xmm registers: afterwards values are read from memory.
+
+void EEJitCall( EEJit *jit, void *function )
+{
+    EEJitBytes( jit, "\x48\xB8", 2 );
+    EEJitQword( jit, (uint64_t)(uintptr_t)function );
+    EEJitBytes( jit, "\xFF\xD0", 2 );
+
+    EEJitForget( jit );
+}
+
+
+
+// Forgets the values held in the xmm registers:
+// afterwards values are read from memory.
+
+void EEJitForget( EEJit *jit )
+{
+    int r;
+
+    for( r = EEJitFirstXmm; r < EEJitXmmCount; r++ )
+    {
+        jit->holder[ r ] = -1;
+    }
+}
+
+
+
+// Emits a conditional jump to the code that returns the failure
+// of instruction `i` (the jump is patched once the code is emitted).
+
+void EEJitFailure( EEJit *jit, uint8_t condition, int32_t i, EEJitFailureKind kind )
+{
+    EEJitFixup *failures;
+    int32_t    capacity;
+
+    if( jit->failuresCount == jit->failuresCapacity )
+    {
+        capacity = jit->failuresCapacity ? jit->failuresCapacity * 2 : 16;
+        failures = realloc( jit->failures, capacity * sizeof( EEJitFixup ) );
+        if( ! failures )
+        {
+            jit->error = true;
+            return;
+        }
+        jit->failures = failures;
+        jit->failuresCapacity = capacity;
+    }
+
+    EEJitByte( jit, 0x0F );
+    EEJitByte( jit, condition );
+    EEJitDword( jit, 0 );
+
+    jit->failures[ jit->failuresCount ].jump = jit->size - 4;
+    jit->failures[ jit->failuresCount ].code = ( i << 2 ) | kind;
+    jit->failuresCount++;
+}
+
+
+
+// Jumps over a run of instructions if its guard is 0 (NaN is not):
+// xorpd xmm1, xmm1; ucomisd xmm1, guard; jp +6; je rel32
+// Returns the offset of the displacement to patch (see EEJitPatch()).
+
+size_t EEJitGuard( EEJit *jit, int32_t guard )
+{
+    EEJitSSE( jit, 0x66, EEJitXorpd, 1, EEJitXmm( 1 ) );
+    EEJitSSE( jit, 0x66, EEJitUcomisd, 1, EEJitOperand( jit, guard ) );
+    EEJitBytes( jit, "\x7A\x06\x0F\x84", 4 );
+    EEJitDword( jit, 0 );
+
+    return jit->size - 4;
+}
+
+
+
+// Sets the 32 bit displacement at `offset` so that it points to `target`
+
+void EEJitPatch( EEJit *jit, size_t offset, size_t target )
+{
+    int32_t displacement;
+
+    if( jit->error ) return;
+
+    displacement = (int32_t)( target - ( offset + 4 ) );
+    memcpy( jit->code + offset, &displacement, 4 );
+}
+
+
+
+// Emits a SSE2 instruction: prefix, REX (if needed), 0x0F, opcode, ModRM...
+// `r` is the xmm register of the ModRM reg field.
+
+void EEJitSSE( EEJit *jit, uint8_t prefix, uint8_t opcode, int r, EEJitAddress address )
+{
+    uint8_t rex;
+
+    rex = 0;
+    if( r >= 8 ) rex |= 4;
+    if( address.kind != EJPool && address.reg >= 8 ) rex |= 1;
+
+    EEJitByte( jit, prefix );
+    if( rex ) EEJitByte( jit, 0x40 | rex );
+    EEJitByte( jit, 0x0F );
+    EEJitByte( jit, opcode );
+
+    switch( address.kind )
+    {
+        case EJXmm:
+            EEJitByte( jit, 0xC0 | ( r & 7 ) << 3 | ( address.reg & 7 ) );
+            break;
+
+        case EJMemory:
+            EEJitByte( jit, 0x80 | ( r & 7 ) << 3 | ( address.reg & 7 ) );
+            if( ( address.reg & 7 ) == 4 ) EEJitByte( jit, 0x24 );
+            EEJitDword( jit, address.displacement );
+            break;
+
+        case EJPool:
+            // rip-relative: the pool is at the beginning of the code
+            EEJitByte( jit, 0x05 | ( r & 7 ) << 3 );
+            EEJitDword( jit, address.displacement - (int32_t)( jit->size + 4 ) );
+            break;
+    }
+}
+
+
+
+EEJitAddress EEJitXmm( int r )
+{
+    EEJitAddress address = { EJXmm, r, 0 };
+
+    return address;
+}
+
+
+
+EEJitAddress EEJitMemory( int base, int32_t displacement )
+{
+    EEJitAddress address = { EJMemory, base, displacement };
+
+    return address;
+}
+
+
+
+EEJitAddress EEJitPool( int32_t offset )
+{
+    EEJitAddress address = { EJPool, 0, offset };
+
+    return address;
+}
+
+
+
+// Appends bytes to the code
+
+void EEJitBytes( EEJit *jit, const char *bytes, size_t count )
+{
+    uint8_t *code;
+    size_t  capacity;
+
+    if( jit->error ) return;
+
+    if( jit->size + count > jit->capacity )
+    {
+        capacity = jit->capacity ? jit->capacity * 2 : 4096;
+        code = realloc( jit->code, capacity );
+        if( ! code )
+        {
+            jit->error = true;
+            return;
+        }
+        jit->code = code;
+        jit->capacity = capacity;
+    }
+
+    memcpy( jit->code + jit->size, bytes, count );
+    jit->size += count;
+}
+
+
+
+void EEJitByte( EEJit *jit, uint8_t value )
+{
+    EEJitBytes( jit, (const char *)&value, 1 );
+}
+
+
+
+void EEJitDword( EEJit *jit, int32_t value )
+{
+    EEJitBytes( jit, (const char *)&value, 4 );
+}
+
+
+
+void EEJitQword( EEJit *jit, uint64_t value )
+{
+    EEJitBytes( jit, (const char *)&value, 8 );
+}
+
+
+
+void EEJitDouble( EEJit *jit, double value )
+{
+    EEJitBytes( jit, (const char *)&value, 8 );
+}
+
+
+
+#else
+
+
+
+// Native code is not supported on this platform:
+// programs are always interpreted.
+
+bool EEJitCompile( EEProgram *program )
+{
+    return false;
+}
+
+
+
+EEvalStatus EEJitExecute( EEvaluation *eval, const EEProgram *program, const double *slots, double *result, double *results )
+{
+    eval->error = "native code is not supported";
+    *result = 0;
+    return EEvalFailure;
+}
+
+
+
+void EEJitRelease( EEProgram *program )
+{
+}
+
+#endif
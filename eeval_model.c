@@ -0,0 +1,1057 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_model.c
+//
+//  models: named cells, inputs and formulas referring
+//  to each other, recomputed incrementally
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+// A model is a set of cells, each one with a name: an input holds a value,
+// a formula computes it from the other cells (as variables).
+// The formulas are compiled once and the cells they read, found in their
+// programs, are the edges of a graph sorted in topological order.
+// Setting an input or defining a formula marks the cell as changed:
+// EEModelUpdate() recomputes only the formulas downstream of the cells
+// changed, in topological order. Cells that don't read each other
+// (directly or not) form separate groups that threads can recompute
+// at the same time.
+
+#define EEModelNotComputed  "formula not computed"
+#define EEModelFailed       "refers to a cell that failed"
+
+
+
+// Initializes an empty model.
+
+void EEModelInit( EEModel *model )
+{
+    memset( model, 0, sizeof( EEModel ) );
+}
+
+
+
+// Defines (or redefines) the cell `name` as a formula: an expression
+// (statements included, see EECompile()) that can refer to the other
+// cells by name. The formula is copied and compiled by the next
+// EEModelUpdate(), so it can refer to cells defined later.
+// The name must be an identifier that is not a keyword nor a
+// registered function.
+// The function returns a status of success or failure
+// (invalid name, out of memory).
+
+EEvalStatus EEModelDefine( EEvaluation *eval,       // the EEvaluation structure (to report errors)
+                           EEModel     *model,      // the model
+                           const char  *name,       // the name of the cell as a null terminated C string
+                           const char  *formula )   // the expression as a null terminated C string
+{
+    EEModelCell *cell;
+    char        *copy;
+    size_t      length;
+    int32_t     index;
+
+    eval->expression = eval->cursor = name;
+    eval->end = NULL;
+    eval->error = NULL;
+
+    index = EEModelFind( model, name );
+    if( index < 0 ) index = EEModelAdd( eval, model, name );
+    if( index < 0 ) return EEvalFailure;
+
+    length = strlen( formula );
+
+    copy = malloc( length + 1 );
+    if( ! copy )
+    {
+        eval->error = "out of memory";
+        return EEvalFailure;
+    }
+
+    memcpy( copy, formula, length + 1 );
+
+    EEModelClear( model, index );
+
+    cell = &model->cells[ index ];
+    cell->formula = copy;
+    cell->error = EEModelNotComputed;
+    model->values[ index ] = 0;
+    model->stale = true;
+
+    EEModelChange( model, index );
+
+    return EEvalSuccess;
+}
+
+
+
+// Sets the cell `name` as an input of the given value (defining it
+// if new, or replacing its formula). The cells that read it are
+// recomputed by the next EEModelUpdate().
+// Setting an input already defined does not change the graph:
+// the update recomputes the cells downstream only.
+// The function returns a status of success or failure
+// (invalid name, out of memory).
+
+EEvalStatus EEModelSet( EEvaluation *eval,      // the EEvaluation structure (to report errors)
+                        EEModel     *model,     // the model
+                        const char  *name,      // the name of the cell as a null terminated C string
+                        double      value )     // the value of the input
+{
+    int32_t index;
+
+    eval->expression = eval->cursor = name;
+    eval->end = NULL;
+    eval->error = NULL;
+
+    index = EEModelFind( model, name );
+    if( index < 0 ) index = EEModelAdd( eval, model, name );
+    if( index < 0 ) return EEvalFailure;
+
+    if( model->cells[ index ].formula )
+    {
+        EEModelClear( model, index );
+        model->stale = true;
+    }
+
+    model->cells[ index ].error = NULL;
+    model->values[ index ] = value;
+
+    EEModelChange( model, index );
+
+    return EEvalSuccess;
+}
+
+
+
+// Recomputes the formulas downstream of the cells changed since the
+// last update, each one once and after the cells it reads.
+// If formulas were defined the graph is built again first: the formulas
+// not yet compiled are compiled, then the cells are sorted in
+// topological order.
+// With `jobs` greater than 1 the groups of cells that don't read each
+// other are recomputed by up to `jobs` threads (the caller included).
+// The function returns a status of success or failure:
+// - a formula that can't be compiled or that refers to itself (directly
+//   or not, "circular reference") fails the update: no cell is recomputed
+//   and the cells changed are kept for the next update;
+// - a formula that fails on execution has no value: its error (and those of
+//   the cells reading it, "refers to a cell that failed") are kept in the
+//   cells (see EEModelValue()) and the first one (in topological order) is
+//   reported. The other cells are recomputed all the same.
+
+EEvalStatus EEModelUpdate( EEvaluation *eval,   // the EEvaluation structure (to report errors)
+                           EEModel     *model,  // the model
+                           int32_t     jobs )   // the most threads recomputing the cells
+{
+    EEModelCell *cell;
+    int32_t     *dirty;
+    int32_t     count,
+                groups,
+                k;
+    #if eeval_model_threads
+        EEModelJobs jobsState;
+        pthread_t   *threads;
+        int32_t     started;
+    #endif
+
+    eval->expression = eval->cursor = "";
+    eval->end = NULL;
+    eval->error = NULL;
+
+    if( model->stale )
+    {
+        for( k = 0; k < model->changedCount; k++ )
+        {
+            cell = &model->cells[ model->changed[ k ] ];
+
+            if( cell->formula && ! cell->program.expression && ! EEModelCompile( eval, model, model->changed[ k ] ) )
+            {
+                return EEvalFailure;
+            }
+        }
+
+        if( ! EEModelGraph( eval, model ) ) return EEvalFailure;
+
+        model->stale = false;
+    }
+
+    dirty = model->scratch;
+    count = EEModelDirty( model );
+    groups = jobs > 1 && eeval_model_threads ? EEModelGroups( model, count ) : 1;
+
+    if( groups <= 1 )
+    {
+        for( k = 0; k < count; k++ )
+        {
+            EEModelCompute( model, dirty[ k ] );
+        }
+    }
+
+    #if eeval_model_threads
+    else
+    {
+        // The groups are taken one at a time by the threads started
+        // and by the caller: if no thread can be started the caller
+        // recomputes them all
+
+        jobsState.model = model;
+        jobsState.cells = model->scratch + 3 * model->capacity;
+        jobsState.starts = model->scratch + 4 * model->capacity;
+        jobsState.groupsCount = groups;
+        jobsState.next = 0;
+
+        pthread_mutex_init( &jobsState.mutex, NULL );
+
+        if( jobs > groups ) jobs = groups;
+
+        threads = malloc( ( jobs - 1 ) * sizeof( pthread_t ) );
+
+        for( started = 0; threads && started < jobs - 1; started++ )
+        {
+            if( pthread_create( &threads[ started ], NULL, EEModelWorker, &jobsState ) != 0 ) break;
+        }
+
+        EEModelWorker( &jobsState );
+
+        for( k = 0; k < started; k++ )
+        {
+            pthread_join( threads[ k ], NULL );
+        }
+
+        free( threads );
+        pthread_mutex_destroy( &jobsState.mutex );
+    }
+    #endif
+
+    for( k = 0; k < model->changedCount; k++ )
+    {
+        model->cells[ model->changed[ k ] ].changed = false;
+    }
+
+    model->changedCount = 0;
+
+    // The first cell that failed (the cells are in topological order)
+
+    for( k = 0; k < count; k++ )
+    {
+        model->cells[ dirty[ k ] ].dirty = false;
+    }
+
+    for( k = 0; k < count; k++ )
+    {
+        if( model->cells[ dirty[ k ] ].error )
+        {
+            EEModelError( eval, model, dirty[ k ] );
+            return EEvalFailure;
+        }
+    }
+
+    return EEvalSuccess;
+}
+
+
+
+// Reads the value of the cell `name` as computed by the last update.
+// The function returns a status of success or failure (the name is not
+// a cell, the formula failed or is not computed yet: the error is that
+// of the formula).
+// The value is in `*value` (0 on failure).
+
+EEvalStatus EEModelValue( EEvaluation   *eval,      // the EEvaluation structure (to report errors)
+                          const EEModel *model,     // the model
+                          const char    *name,      // the name of the cell as a null terminated C string
+                          double        *value )    // RETURN: the value of the cell
+{
+    int32_t index;
+
+    eval->expression = eval->cursor = name;
+    eval->end = NULL;
+    eval->error = NULL;
+
+    *value = 0;
+
+    index = EEModelFind( model, name );
+    if( index < 0 )
+    {
+        eval->error = "unknown cell";
+        return EEvalFailure;
+    }
+
+    if( model->cells[ index ].error )
+    {
+        EEModelError( eval, model, index );
+        return EEvalFailure;
+    }
+
+    *value = model->values[ index ];
+
+    return EEvalSuccess;
+}
+
+
+
+// Returns the index of the cell `name` (its value is `model->values[ index ]`)
+// or -1 if there is no such cell.
+
+int32_t EEModelFind( const EEModel *model, const char *name )
+{
+    const EEModelCell *cell;
+    uint32_t          slot,
+                      size;
+    size_t            length;
+
+    if( model->count == 0 ) return -1;
+
+    length = strlen( name );
+    size = 2 * model->capacity;
+    slot = EEFunctionHash( name, length ) % size;
+
+    while( model->table[ slot ] )
+    {
+        cell = &model->cells[ model->table[ slot ] - 1 ];
+
+        if( strcmp( cell->name, name ) == 0 ) return model->table[ slot ] - 1;
+
+        slot = ( slot + 1 ) % size;
+    }
+
+    return -1;
+}
+
+
+
+// Releases the memory used by a model (its cells included):
+// the model is empty again.
+
+void EEModelFree( EEModel *model )
+{
+    int32_t k;
+
+    for( k = 0; k < model->count; k++ )
+    {
+        EEModelClear( model, k );
+        free( model->cells[ k ].name );
+    }
+
+    free( model->cells );
+    free( model->values );
+    free( model->variables );
+    free( model->table );
+    free( model->order );
+    free( model->starts );
+    free( model->dependents );
+    free( model->changed );
+    free( model->scratch );
+
+    memset( model, 0, sizeof( EEModel ) );
+}
+
+
+
+// ***********************
+// PRIVATE FUNCTIONS BELOW
+// ***********************
+
+
+
+// Adds a cell named `name` (an input of value 0).
+// Returns its index or -1 on failure (invalid name, out of memory).
+
+int32_t EEModelAdd( EEvaluation *eval, EEModel *model, const char *name )
+{
+    EEModelCell *cell;
+    char        *copy;
+    size_t      length;
+    uint32_t    slot;
+    int32_t     index;
+
+    length = strlen( name );
+
+    if( length == 0 || EEvalIdentifierLength( name, name + length ) != length )
+    {
+        eval->error = "name is not an identifier";
+        return -1;
+    }
+
+    if( EEvalKeyword( name, length ) || EEFunctionLookup( name, length ) >= 0 )
+    {
+        eval->error = "name already in use";
+        return -1;
+    }
+
+    copy = malloc( length + 1 );
+
+    if( ! copy || ( model->count == model->capacity && ! EEModelGrow( model ) ) )
+    {
+        free( copy );
+        eval->error = "out of memory";
+        return -1;
+    }
+
+    memcpy( copy, name, length + 1 );
+
+    index = model->count++;
+
+    cell = &model->cells[ index ];
+    memset( cell, 0, sizeof( EEModelCell ) );
+    cell->name = copy;
+
+    model->values[ index ] = 0;
+    model->variables[ index ] = (EEVariable){ copy, NULL, index };
+
+    // The table can't be full: it has twice as many slots as cells
+
+    slot = EEFunctionHash( name, length ) % ( 2 * model->capacity );
+
+    while( model->table[ slot ] ) slot = ( slot + 1 ) % ( 2 * model->capacity );
+
+    model->table[ slot ] = index + 1;
+
+    // A new cell changes the graph (and the formulas
+    // that failed to compile may refer to it)
+
+    model->stale = true;
+
+    return index;
+}
+
+
+
+// Doubles the capacity of a model (the hash table is filled again).
+// Returns false if out of memory (the model is left as it was).
+
+bool EEModelGrow( EEModel *model )
+{
+    EEModelCell *cells;
+    double      *values;
+    EEVariable  *variables;
+    int32_t     *table,
+                *order,
+                *starts,
+                *changed,
+                *scratch;
+    int32_t     capacity,
+                k;
+    uint32_t    slot;
+
+    capacity = model->capacity ? 2 * model->capacity : 64;
+
+    table = calloc( 2 * capacity, sizeof( int32_t ) );
+    order = malloc( capacity * sizeof( int32_t ) );
+    starts = malloc( ( capacity + 1 ) * sizeof( int32_t ) );
+    changed = malloc( capacity * sizeof( int32_t ) );
+    scratch = malloc( ( 5 * capacity + 1 ) * sizeof( int32_t ) );
+
+    if( ! table || ! order || ! starts || ! changed || ! scratch )
+    {
+        free( table );
+        free( order );
+        free( starts );
+        free( changed );
+        free( scratch );
+        return false;
+    }
+
+    // Arrays grown one by one: if one can't grow those
+    // grown already are only larger than needed
+
+    cells = realloc( model->cells, capacity * sizeof( EEModelCell ) );
+    if( cells ) model->cells = cells;
+
+    values = cells ? realloc( model->values, capacity * sizeof( double ) ) : NULL;
+    if( values ) model->values = values;
+
+    variables = values ? realloc( model->variables, capacity * sizeof( EEVariable ) ) : NULL;
+    if( variables ) model->variables = variables;
+
+    if( ! variables )
+    {
+        free( table );
+        free( order );
+        free( starts );
+        free( changed );
+        free( scratch );
+        return false;
+    }
+
+    for( k = 0; k < model->count; k++ )
+    {
+        slot = EEFunctionHash( model->cells[ k ].name, strlen( model->cells[ k ].name ) ) % ( 2 * capacity );
+
+        while( table[ slot ] ) slot = ( slot + 1 ) % ( 2 * capacity );
+
+        table[ slot ] = k + 1;
+    }
+
+    if( model->changedCount > 0 )
+    {
+        memcpy( changed, model->changed, model->changedCount * sizeof( int32_t ) );
+    }
+
+    free( model->table );
+    free( model->order );
+    free( model->starts );
+    free( model->changed );
+    free( model->scratch );
+
+    model->table = table;
+    model->order = order;
+    model->starts = starts;
+    model->changed = changed;
+    model->scratch = scratch;
+    model->capacity = capacity;
+
+    return true;
+}
+
+
+
+// Removes the formula of a cell (its program and references):
+// the cell is an input.
+
+void EEModelClear( EEModel *model, int32_t cell )
+{
+    EEModelCell *c;
+
+    c = &model->cells[ cell ];
+
+    EEFreeProgram( &c->program );
+
+    free( c->formula );
+    free( c->references );
+
+    c->formula = NULL;
+    c->references = NULL;
+    c->referencesCount = 0;
+}
+
+
+
+// Marks a cell as changed (once) for the next update.
+
+void EEModelChange( EEModel *model, int32_t cell )
+{
+    if( model->cells[ cell ].changed ) return;
+
+    model->cells[ cell ].changed = true;
+    model->changed[ model->changedCount++ ] = cell;
+}
+
+
+
+// Compiles the formula of a cell and finds the cells it reads
+// in the program (the variables bound to slots).
+// Returns false on failure (the error is that of EECompile()).
+
+bool EEModelCompile( EEvaluation *eval, EEModel *model, int32_t cell )
+{
+    EEModelCell         *c;
+    EESymbols           symbols;
+    const EEInstruction *ins;
+    int32_t             *references;
+    int32_t             count,
+                        i,
+                        k;
+
+    c = &model->cells[ cell ];
+
+    symbols.variables = model->variables;
+    symbols.count = model->count;
+
+    if( EECompile( eval, c->formula, &symbols, &c->program ) == EEvalFailure ) return false;
+
+    count = 0;
+
+    for( i = 0; i < c->program.instructionsCount; i++ )
+    {
+        if( c->program.instructions[ i ].opcode == EOSlt ) count++;
+    }
+
+    references = malloc( ( count ? count : 1 ) * sizeof( int32_t ) );
+    if( ! references )
+    {
+        EEFreeProgram( &c->program );
+        eval->error = "out of memory";
+        return false;
+    }
+
+    // The optimizer merges the loads of the same variable:
+    // each cell is read once at most (checked anyway)
+
+    count = 0;
+
+    for( i = 0; i < c->program.instructionsCount; i++ )
+    {
+        ins = &c->program.instructions[ i ];
+
+        if( ins->opcode != EOSlt ) continue;
+
+        for( k = 0; k < count && references[ k ] != ins->a; k++ );
+
+        if( k == count ) references[ count++ ] = ins->a;
+    }
+
+    c->references = references;
+    c->referencesCount = count;
+
+    return true;
+}
+
+
+
+// Builds the graph of the model: the cells reading each cell
+// and the topological order (Kahn's algorithm).
+// Returns false if formulas refer to themselves ("circular reference"):
+// the error is reported at a reference of a cell of the cycle.
+
+bool EEModelGraph( EEvaluation *eval, EEModel *model )
+{
+    EEModelCell *c;
+    int32_t     *dependents,
+                *pending,
+                *order;
+    int32_t     capacity,
+                count,
+                head,
+                cell,
+                next,
+                k,
+                r;
+
+    // Dependents: counted, then placed
+
+    count = 0;
+
+    for( k = 0; k < model->count; k++ )
+    {
+        count += model->cells[ k ].referencesCount;
+    }
+
+    if( count > model->dependentsCapacity )
+    {
+        capacity = count > 2 * model->dependentsCapacity ? count : 2 * model->dependentsCapacity;
+
+        dependents = realloc( model->dependents, capacity * sizeof( int32_t ) );
+        if( ! dependents )
+        {
+            eval->error = "out of memory";
+            return false;
+        }
+
+        model->dependents = dependents;
+        model->dependentsCapacity = capacity;
+    }
+
+    memset( model->starts, 0, ( model->count + 1 ) * sizeof( int32_t ) );
+
+    for( k = 0; k < model->count; k++ )
+    {
+        c = &model->cells[ k ];
+
+        for( r = 0; r < c->referencesCount; r++ ) model->starts[ c->references[ r ] + 1 ]++;
+    }
+
+    for( k = 0; k < model->count; k++ )
+    {
+        model->starts[ k + 1 ] += model->starts[ k ];
+    }
+
+    // The scratch holds the next free place of the dependents
+    // of each cell, then the references not yet sorted
+
+    pending = model->scratch;
+    memcpy( pending, model->starts, model->count * sizeof( int32_t ) );
+
+    for( k = 0; k < model->count; k++ )
+    {
+        c = &model->cells[ k ];
+
+        for( r = 0; r < c->referencesCount; r++ ) model->dependents[ pending[ c->references[ r ] ]++ ] = k;
+    }
+
+    // Cells are sorted once all the cells they read are
+
+    order = model->order;
+    count = 0;
+
+    for( k = 0; k < model->count; k++ )
+    {
+        pending[ k ] = model->cells[ k ].referencesCount;
+        if( pending[ k ] == 0 ) order[ count++ ] = k;
+    }
+
+    for( head = 0; head < count; head++ )
+    {
+        cell = order[ head ];
+        model->cells[ cell ].rank = head;
+
+        for( k = model->starts[ cell ]; k < model->starts[ cell + 1 ]; k++ )
+        {
+            if( --pending[ model->dependents[ k ] ] == 0 ) order[ count++ ] = model->dependents[ k ];
+        }
+    }
+
+    if( count == model->count ) return true;
+
+    // A cycle: each cell not sorted reads another one not sorted.
+    // Following the first one from any of them the walk
+    // is on the cycle after `model->count` steps
+
+    for( cell = 0; pending[ cell ] == 0; cell++ );
+
+    next = cell;
+
+    for( k = 0; k <= model->count; k++ )
+    {
+        cell = next;
+        c = &model->cells[ cell ];
+
+        for( r = 0; pending[ c->references[ r ] ] == 0; r++ );
+
+        next = c->references[ r ];
+    }
+
+    EEModelError( eval, model, cell );
+
+    eval->error = "circular reference";
+    eval->cursor = eval->expression + EEModelPosition( model, cell, next );
+
+    return false;
+}
+
+
+
+// Marks the formulas to recompute: the ones changed and
+// all those downstream of the cells changed.
+// Returns their count: the cells are at the start of the scratch,
+// in topological order.
+
+int32_t EEModelDirty( EEModel *model )
+{
+    EEModelCell *c;
+    int32_t     *dirty;
+    int32_t     count,
+                cell,
+                k,
+                d;
+
+    dirty = model->scratch;
+    count = 0;
+
+    // Formulas changed, then the cells reading them
+    // (a queue: each cell is appended once)
+
+    for( k = 0; k < model->changedCount; k++ )
+    {
+        c = &model->cells[ model->changed[ k ] ];
+
+        if( c->formula && ! c->dirty )
+        {
+            c->dirty = true;
+            dirty[ count++ ] = model->changed[ k ];
+        }
+    }
+
+    for( k = 0; k < model->changedCount; k++ )
+    {
+        cell = model->changed[ k ];
+        if( model->cells[ cell ].formula ) continue;
+
+        for( d = model->starts[ cell ]; d < model->starts[ cell + 1 ]; d++ )
+        {
+            c = &model->cells[ model->dependents[ d ] ];
+
+            if( ! c->dirty )
+            {
+                c->dirty = true;
+                dirty[ count++ ] = model->dependents[ d ];
+            }
+        }
+    }
+
+    for( k = 0; k < count; k++ )
+    {
+        cell = dirty[ k ];
+
+        for( d = model->starts[ cell ]; d < model->starts[ cell + 1 ]; d++ )
+        {
+            c = &model->cells[ model->dependents[ d ] ];
+
+            if( ! c->dirty )
+            {
+                c->dirty = true;
+                dirty[ count++ ] = model->dependents[ d ];
+            }
+        }
+    }
+
+    // Sorted: by the ranks if a few, otherwise
+    // picked from the topological order
+
+    if( count < model->count / 8 )
+    {
+        for( k = 0; k < count; k++ ) dirty[ k ] = model->cells[ dirty[ k ] ].rank;
+
+        qsort( dirty, count, sizeof( int32_t ), EEModelRanks );
+
+        for( k = 0; k < count; k++ ) dirty[ k ] = model->order[ dirty[ k ] ];
+    }
+    else
+    {
+        for( k = 0, d = 0; k < model->count; k++ )
+        {
+            if( model->cells[ model->order[ k ] ].dirty ) dirty[ d++ ] = model->order[ k ];
+        }
+    }
+
+    return count;
+}
+
+
+
+// Splits the `count` cells to recompute (at the start of the scratch)
+// into groups: two cells are in the same group if one reads the other
+// (directly or through other cells to recompute). Groups are the
+// connected components of the graph of the cells to recompute
+// (union-find), so the cells of a group only read cells of the same
+// group or cells that don't change.
+// Returns the count of groups: their cells (in topological order) are
+// from the scratch + 3 * capacity, their starts from the scratch + 4 * capacity.
+
+int32_t EEModelGroups( EEModel *model, int32_t count )
+{
+    const EEModelCell *c;
+    int32_t           *dirty,
+                      *parent,
+                      *group,
+                      *cells,
+                      *starts;
+    int32_t           groups,
+                      cell,
+                      a,
+                      b,
+                      k,
+                      r;
+
+    dirty  = model->scratch;
+    parent = model->scratch + model->capacity;
+    group  = model->scratch + 2 * model->capacity;
+    cells  = model->scratch + 3 * model->capacity;
+    starts = model->scratch + 4 * model->capacity;
+
+    for( k = 0; k < count; k++ )
+    {
+        parent[ dirty[ k ] ] = dirty[ k ];
+    }
+
+    for( k = 0; k < count; k++ )
+    {
+        c = &model->cells[ dirty[ k ] ];
+
+        for( r = 0; r < c->referencesCount; r++ )
+        {
+            if( ! model->cells[ c->references[ r ] ].dirty ) continue;
+
+            a = EEModelRoot( parent, dirty[ k ] );
+            b = EEModelRoot( parent, c->references[ r ] );
+
+            if( a != b ) parent[ a ] = b;
+        }
+    }
+
+    // Groups are numbered in the order of their first cell,
+    // then the cells are placed by group (counting sort)
+
+    for( k = 0; k < count; k++ )
+    {
+        group[ dirty[ k ] ] = -1;
+    }
+
+    groups = 0;
+
+    for( k = 0; k < count; k++ )
+    {
+        cell = EEModelRoot( parent, dirty[ k ] );
+
+        if( group[ cell ] < 0 )
+        {
+            starts[ groups ] = 0;
+            group[ cell ] = groups++;
+        }
+
+        starts[ group[ cell ] ]++;
+    }
+
+    for( k = 0; k < count; k++ )
+    {
+        group[ dirty[ k ] ] = group[ EEModelRoot( parent, dirty[ k ] ) ];
+    }
+
+    for( k = 1; k < groups; k++ )
+    {
+        starts[ k ] += starts[ k - 1 ];
+    }
+
+    // From the end: starts[ g ] goes back from the end
+    // of the group to its start, the order is kept
+
+    for( k = count - 1; k >= 0; k-- )
+    {
+        cells[ --starts[ group[ dirty[ k ] ] ] ] = dirty[ k ];
+    }
+
+    starts[ groups ] = count;
+
+    return groups;
+}
+
+
+
+// Returns the root of the group of a cell (halving the path).
+
+int32_t EEModelRoot( int32_t *parent, int32_t cell )
+{
+    while( parent[ cell ] != cell )
+    {
+        parent[ cell ] = parent[ parent[ cell ] ];
+        cell = parent[ cell ];
+    }
+
+    return cell;
+}
+
+
+
+// Recomputes a formula: the cells it reads are up to date.
+// If one of them failed the formula fails as well.
+
+void EEModelCompute( EEModel *model, int32_t cell )
+{
+    EEModelCell *c;
+    EEvaluation eval;
+    int32_t     r;
+
+    c = &model->cells[ cell ];
+
+    for( r = 0; r < c->referencesCount; r++ )
+    {
+        if( model->cells[ c->references[ r ] ].error )
+        {
+            c->error = EEModelFailed;
+            c->position = EEModelPosition( model, cell, c->references[ r ] );
+            model->values[ cell ] = 0;
+            return;
+        }
+    }
+
+    if( EEExecute( &eval, &c->program, model->values, &model->values[ cell ] ) == EEvalFailure )
+    {
+        c->error = eval.error;
+        c->position = (int32_t)( eval.cursor - eval.expression );
+        return;
+    }
+
+    c->error = NULL;
+}
+
+
+
+// Returns the position in the formula of a cell
+// where it reads the cell `reference`.
+
+int32_t EEModelPosition( const EEModel *model, int32_t cell, int32_t reference )
+{
+    const EEProgram *program;
+    int32_t         i;
+
+    program = &model->cells[ cell ].program;
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        if( program->instructions[ i ].opcode == EOSlt && program->instructions[ i ].a == reference )
+        {
+            return program->instructions[ i ].position;
+        }
+    }
+
+    return 0;
+}
+
+
+
+// Reports the error of a cell: in its formula (the copy
+// kept by the program if compiled) at the position of the error.
+
+void EEModelError( EEvaluation *eval, const EEModel *model, int32_t cell )
+{
+    const EEModelCell *c;
+
+    c = &model->cells[ cell ];
+
+    eval->expression = c->program.expression ? c->program.expression : c->formula;
+    eval->cursor = eval->expression + c->position;
+    eval->end = NULL;
+    eval->error = c->error;
+}
+
+
+
+// Compares two ranks (qsort).
+
+int EEModelRanks( const void *a, const void *b )
+{
+    return *(const int32_t *)a - *(const int32_t *)b;
+}
+
+
+
+#if eeval_model_threads
+
+// A thread recomputing the groups of cells not yet taken:
+// the cells of a group in topological order.
+
+void *EEModelWorker( void *argument )
+{
+    EEModelJobs *jobs;
+    int32_t     group,
+                k;
+
+    jobs = argument;
+
+    while( true )
+    {
+        pthread_mutex_lock( &jobs->mutex );
+        group = jobs->next < jobs->groupsCount ? jobs->next++ : -1;
+        pthread_mutex_unlock( &jobs->mutex );
+
+        if( group < 0 ) break;
+
+        for( k = jobs->starts[ group ]; k < jobs->starts[ group + 1 ]; k++ )
+        {
+            EEModelCompute( jobs->model, jobs->cells[ k ] );
+        }
+    }
+
+    return NULL;
+}
+
+#endif
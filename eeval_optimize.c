@@ -0,0 +1,705 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_optimize.c
+//
+//  optimizes a program after it is parsed
+//  and before it is executed
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+// Optimizes a program just parsed by EECompile() (values are still
+// identified as constants `-1 - k` and instructions `i`);
+// its outputs are renumbered as well.
+//
+// - Powers with a constant exponent are reduced to products or sqrt()
+//   (see EEOptimizeReduce()).
+// - Instructions whose operands are constants are computed once
+//   (constant folding), unless they fail (division by zero, negative
+//   factorial...) or their result is infinite or NaN: those are kept
+//   so that the program fails on execution exactly where it did.
+// - Identities are dropped: x * 1, 1 * x, x / 1, x + 0, 0 + x, x - 0
+//   and x ^ 1 are x (the sign of a zero x may change with `+ 0`).
+// - Nested max() and min() with constant arguments are flattened:
+//   max(max(x, 1), 2) is max(x, 2).
+// - Common sub-expressions are computed once: equal constants are
+//   merged and instructions with the same opcode and operands (in any
+//   order for + and *) are hash-consed, so the program becomes a DAG
+//   where repeated terms such as sin(x*pi/180) are computed once per
+//   execution. A repeated term whose result is checked where the first
+//   one is not becomes an EOChk of the first one.
+//   Registered functions (EOCall) are never merged nor folded: they
+//   are called as many times as the expression says.
+// - if() of a constant condition is the branch taken. Instructions are
+//   merged only with those computed whenever they are (the same guard
+//   or none, see EECompileGuard()).
+//
+// The checks of the instructions that are dropped move to the value
+// that replaces them, so errors are the same and raised in the same order.
+// Folded instructions and unused constants are removed.
+
+void EEProgramOptimize( EEvaluation *eval, EEProgram *program )
+{
+    EEInstruction *ins,
+                  *inner;
+    int32_t       *replace,
+                  *uses,
+                  *table,
+                  *constants,
+                  *constant,
+                  *call;
+    bool          *dead;
+    int32_t       i,
+                  k,
+                  x,
+                  c,
+                  count,
+                  mask,
+                  constantsMask;
+    double        value;
+
+    #if eeval_strength_reduction
+        EEOptimizeReduce( eval, program );
+        if( eval->error ) return;
+    #endif
+
+    count = program->instructionsCount;
+
+    if( count == 0 ) return;
+
+    // The hash tables of the instructions and of the constants (at most half full):
+    // folding adds at most a constant per instruction
+
+    for( mask = 15; mask < count * 2; mask = mask * 2 + 1 );
+    for( constantsMask = 15; constantsMask < ( program->constantsCount + count ) * 2; constantsMask = constantsMask * 2 + 1 );
+
+    replace   = malloc( count * sizeof( int32_t ) );
+    uses      = calloc( count, sizeof( int32_t ) );
+    dead      = calloc( count, sizeof( bool ) );
+    table     = malloc( ( mask + 1 ) * sizeof( int32_t ) );
+    constants = malloc( ( constantsMask + 1 ) * sizeof( int32_t ) );
+    constant  = malloc( ( program->constantsCount + 1 ) * sizeof( int32_t ) );
+
+    if( ! replace || ! uses || ! dead || ! table || ! constants || ! constant )
+    {
+        free( replace );
+        free( uses );
+        free( dead );
+        free( table );
+        free( constants );
+        free( constant );
+        eval->error = "out of memory";
+        return;
+    }
+
+    for( i = 0; i <= mask; i++ )
+    {
+        table[ i ] = -1;
+    }
+
+    for( i = 0; i <= constantsMask; i++ )
+    {
+        constants[ i ] = -1;
+    }
+
+    // Each constant is replaced by the first one equal to it
+
+    for( i = 0; i < program->constantsCount; i++ )
+    {
+        constant[ i ] = EEOptimizeConstant( program, constants, constantsMask, -1 - i );
+    }
+
+    #define EECanonical(value) ( (value) < 0 ? constant[ -1 - (value) ] : replace[ value ] )
+
+    for( i = 0; i < count; i++ )
+    {
+        replace[ i ] = i;
+
+        ins = &program->instructions[ i ];
+        if( EEOpcodeOperands( ins->opcode ) >= 1 && ins->a >= 0 ) uses[ ins->a ]++;
+        if( EEOpcodeOperands( ins->opcode ) == 2 && ins->b >= 0 ) uses[ ins->b ]++;
+        if( ins->guard >= 0 ) uses[ ins->guard ]++;
+
+        if( EEOpcodeListed( ins->opcode ) )
+        {
+            call = &program->arguments[ ins->b ];
+            for( k = 1; k <= call[ 0 ]; k++ ) if( call[ k ] >= 0 ) uses[ call[ k ] ]++;
+        }
+    }
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        if( program->outputs[ k ] >= 0 ) uses[ program->outputs[ k ] ]++;
+    }
+
+    for( i = 0; i < count && ! eval->error; i++ )
+    {
+        ins = &program->instructions[ i ];
+
+        // Operands that have been replaced
+
+        if( EEOpcodeOperands( ins->opcode ) >= 1 ) ins->a = EECanonical( ins->a );
+        if( EEOpcodeOperands( ins->opcode ) == 2 ) ins->b = EECanonical( ins->b );
+
+        // A constant guard not 0 is no guard
+
+        if( ins->guard != EENoValue ) ins->guard = EECanonical( ins->guard );
+        if( ins->guard < 0 && ins->guard != EENoValue && program->constants[ -1 - ins->guard ] != 0 ) ins->guard = EENoValue;
+
+        // Calls and selections: their arguments only,
+        // a selection of a constant condition is the branch taken
+
+        if( EEOpcodeListed( ins->opcode ) )
+        {
+            call = &program->arguments[ ins->b ];
+            for( k = 1; k <= call[ 0 ]; k++ ) call[ k ] = EECanonical( call[ k ] );
+
+            if( ins->opcode == EOSel && call[ 1 ] < 0 )
+            {
+                x = program->constants[ -1 - call[ 1 ] ] != 0 ? call[ 2 ] : call[ 3 ];
+                if( x >= 0 ) uses[ x ] += uses[ i ];
+                replace[ i ] = x;
+                dead[ i ] = true;
+            }
+            continue;
+        }
+
+        // Constant folding
+
+        if( EEOpcodeOperands( ins->opcode ) >= 1 && ins->a < 0 && ( EEOpcodeOperands( ins->opcode ) == 1 || ins->b < 0 ) )
+        {
+            if( EEOptimizeCompute( ins->opcode, program->constants[ -1 - ins->a ], EEOpcodeOperands( ins->opcode ) == 2 ? program->constants[ -1 - ins->b ] : 0, &value ) )
+            {
+                x = EEProgramConstant( eval, program, value );
+                if( eval->error ) break;
+
+                replace[ i ] = EEOptimizeConstant( program, constants, constantsMask, x );
+                dead[ i ] = true;
+            }
+            continue;
+        }
+
+        // Identities
+
+        x = EENoValue;
+
+        switch( ins->opcode )
+        {
+            case EOMul:
+                if( EEOptimizeIsConstant( program, ins->b, 1 ) ) x = ins->a;
+                if( EEOptimizeIsConstant( program, ins->a, 1 ) ) x = ins->b;
+                break;
+
+            case EOAdd:
+                if( EEOptimizeIsConstant( program, ins->b, 0 ) ) x = ins->a;
+                if( EEOptimizeIsConstant( program, ins->a, 0 ) ) x = ins->b;
+                break;
+
+            case EODiv:
+            case EOPow:
+                if( EEOptimizeIsConstant( program, ins->b, 1 ) ) x = ins->a;
+                break;
+
+            case EOSub:
+                if( EEOptimizeIsConstant( program, ins->b, 0 ) ) x = ins->a;
+                break;
+
+            default:
+                break;
+        }
+
+        if( x != EENoValue && EEOptimizeAlias( program, uses, i, x ) )
+        {
+            if( x >= 0 ) uses[ x ] += uses[ i ] - 1;
+            replace[ i ] = x;
+            dead[ i ] = true;
+            continue;
+        }
+
+        // Nested max() and min(): op( op( x, c1 ), c2 ) is op( x, op( c1, c2 ) )
+        // (arguments are checked so they are never NaN: the order does not matter)
+
+        if( ( ins->opcode == EOMax || ins->opcode == EOMin ) && eeval_catch_fp_exceptions )
+        {
+            x = ins->b < 0 ? ins->a : ins->b;
+            c = ins->b < 0 ? ins->b : ins->a;
+
+            if( c < 0 && x >= 0 && uses[ x ] == 1 && program->instructions[ x ].opcode == ins->opcode )
+            {
+                inner = &program->instructions[ x ];
+
+                if( inner->a < 0 || inner->b < 0 )
+                {
+                    EEOptimizeCompute( ins->opcode, program->constants[ -1 - ( inner->b < 0 ? inner->b : inner->a ) ], program->constants[ -1 - c ], &value );
+
+                    ins->a = inner->b < 0 ? inner->a : inner->b;
+                    ins->b = EEProgramConstant( eval, program, value );
+                    if( eval->error ) break;
+
+                    ins->b = EEOptimizeConstant( program, constants, constantsMask, ins->b );
+
+                    if( ins->check == ECNone )
+                    {
+                        ins->check = inner->check;
+                    }
+
+                    dead[ x ] = true;
+                }
+            }
+        }
+
+        // Common sub-expressions
+
+        x = EEOptimizeLookup( program, table, mask, dead, i );
+
+        if( x >= 0 && ins->check != ECNone && program->instructions[ x ].check == ECNone )
+        {
+            // `x` computes the same value without checking it: the check
+            // stays here (nothing can fail in between, errors keep their order)
+
+            ins->opcode = EOChk;
+            ins->a = x;
+            ins->b = 0;
+
+            uses[ x ] += uses[ i ] + 1;
+            replace[ i ] = x;
+        }
+        else if( x >= 0 )
+        {
+            uses[ x ] += uses[ i ];
+            replace[ i ] = x;
+            dead[ i ] = true;
+        }
+    }
+
+    if( ! eval->error )
+    {
+        for( k = 0; k < program->outputsCount; k++ )
+        {
+            program->outputs[ k ] = EECanonical( program->outputs[ k ] );
+        }
+
+        EEOptimizeSweep( eval, program, dead );
+    }
+
+    #undef EECanonical
+
+    free( replace );
+    free( uses );
+    free( dead );
+    free( table );
+    free( constants );
+    free( constant );
+}
+
+
+
+// ***********************
+// PRIVATE FUNCTIONS BELOW
+// ***********************
+
+
+
+// Computes an opcode on constant operands.
+// Returns false if the computation would fail on execution
+// or its result is infinite or NaN.
+
+bool EEOptimizeCompute( EEOpcode opcode, double a, double b, double *r )
+{
+    switch( opcode )
+    {
+        case EOAdd: *r = a + b;                         break;
+        case EOSub: *r = a - b;                         break;
+        case EOMul: *r = a * b;                         break;
+        case EONeg: *r = -a;                            break;
+        case EOPow: *r = EEPower( a, b );               break;
+        case EOSin: *r = sin( a );                      break;
+        case EOCos: *r = cos( a );                      break;
+        case EOTan: *r = tan( a );                      break;
+        case EOASi: *r = asin( a );                     break;
+        case EOACo: *r = acos( a );                     break;
+        case EOATa: *r = atan( a );                     break;
+        case EOExp: *r = exp( a );                      break;
+        case EOLog: *r = log( a );                      break;
+        case EOSqt: *r = sqrt( a );                     break;
+        case EOLgb: *r = log( b ) / log( a );           break;
+        case EOMax: *r = b > a ? b : a;                 break;
+        case EOMin: *r = b < a ? b : a;                 break;
+        case EOLt:  *r = a < b;                         break;
+        case EOLe:  *r = a <= b;                        break;
+        case EOEq:  *r = a == b;                        break;
+        case EONe:  *r = a != b;                        break;
+        case EONot: *r = a == 0;                        break;
+        case EOAnd: *r = a != 0 && b != 0;              break;
+        case EOOr:  *r = a != 0 || b != 0;              break;
+
+        case EODiv:
+            if( b == 0 ) return false;
+            *r = a / b;
+            break;
+
+        case EOFct:
+            if( a < 0 ) return false;
+            *r = EEFactorial( a );
+            break;
+
+        default:
+            return false;
+    }
+
+    return ! eexception( *r );
+}
+
+
+
+// Tells if `value` is the constant `constant`
+
+bool EEOptimizeIsConstant( const EEProgram *program, int32_t value, double constant )
+{
+    return value < 0 && program->constants[ -1 - value ] == constant;
+}
+
+
+
+// Instruction `i` is about to be replaced by the value `x`.
+// Its check moves to `x`: constants are always finite, a check of `x`
+// fires before (as it did); otherwise `x` takes the check and the position
+// of `i` unless `x` may fail on its own (division, factorial), is read
+// by other instructions too or is not computed whenever `i` is (guards).
+// Returns false if the instruction can't be replaced.
+
+bool EEOptimizeAlias( EEProgram *program, const int32_t *uses, int32_t i, int32_t x )
+{
+    EEInstruction *ins,
+                  *target;
+
+    ins = &program->instructions[ i ];
+
+    if( x < 0 || ins->check == ECNone ) return true;
+
+    target = &program->instructions[ x ];
+
+    if( target->check != ECNone ) return true;
+
+    if( target->opcode == EODiv || target->opcode == EOFct || uses[ x ] > 1 || target->guard != ins->guard ) return false;
+
+    target->check = ins->check;
+    target->position = ins->position;
+
+    return true;
+}
+
+
+
+// Looks up in the hash table the constant `k` (an identifier `-1 - k`)
+// by its bits (0 and -0 differ): returns the identifier of the first
+// constant equal to it, or inserts `k` in the table and returns it.
+
+int32_t EEOptimizeConstant( const EEProgram *program, int32_t *constants, int32_t mask, int32_t value )
+{
+    uint64_t bits,
+             other;
+    int32_t  h;
+
+    memcpy( &bits, &program->constants[ -1 - value ], sizeof( bits ) );
+
+    h = (int32_t)( ( bits * 0x9E3779B97F4A7C15u ) >> 32 & (uint64_t)mask );
+
+    for( ; constants[ h ] >= 0; h = ( h + 1 ) & mask )
+    {
+        memcpy( &other, &program->constants[ constants[ h ] ], sizeof( other ) );
+
+        if( other == bits ) return -1 - constants[ h ];
+    }
+
+    constants[ h ] = -1 - value;
+
+    return value;
+}
+
+
+
+// Looks up in the hash table an instruction computing the same value
+// of instruction `i` whenever `i` is computed (the same guard or none):
+// if found (and alive) returns it, otherwise inserts `i` in the table
+// and returns -1.
+// A dead instruction found in the table (a max() or min() flattened into
+// another one) is replaced by `i`.
+
+int32_t EEOptimizeLookup( const EEProgram *program, int32_t *table, int32_t mask, const bool *dead, int32_t i )
+{
+    const EEInstruction *ins,
+                        *other;
+    int32_t             a,
+                        b,
+                        t,
+                        h;
+
+    ins = &program->instructions[ i ];
+
+    // Operands in canonical order (x + y is y + x, x * y is y * x)
+
+    a = EEOpcodeOperands( ins->opcode ) >= 1 || ins->opcode == EOVar || ins->opcode == EOSlt ? ins->a : 0;
+    b = EEOpcodeOperands( ins->opcode ) == 2 ? ins->b : 0;
+
+    if( ( ins->opcode == EOAdd || ins->opcode == EOMul ) && a > b )
+    {
+        t = a;
+        a = b;
+        b = t;
+    }
+
+    h = (int32_t)( ( (uint32_t)ins->opcode * 0x9E3779B1u ^ (uint32_t)a * 0x85EBCA77u ^ (uint32_t)b * 0xC2B2AE3Du ) & (uint32_t)mask );
+
+    for( ; table[ h ] >= 0; h = ( h + 1 ) & mask )
+    {
+        other = &program->instructions[ table[ h ] ];
+
+        if( other->opcode != ins->opcode ) continue;
+
+        if( other->guard != ins->guard && other->guard != EENoValue ) continue;
+
+        if( ! ( ( other->a == a && ( EEOpcodeOperands( ins->opcode ) < 2 || other->b == b ) ) ||
+                ( other->a == b && other->b == a && ( ins->opcode == EOAdd || ins->opcode == EOMul ) ) ) ) continue;
+
+        if( dead[ table[ h ] ] )
+        {
+            table[ h ] = i;
+            return -1;
+        }
+
+        return table[ h ];
+    }
+
+    table[ h ] = i;
+
+    return -1;
+}
+
+
+
+// Strength reduction: powers of a computed value with a constant exponent
+// from 2 to EEPowerMaxExponent become products (x^3 is x2 * x with x2 = x * x,
+// x^4 is x2 * x2) and powers with exponent 0.5 become sqrt(), as EEPower()
+// computes them. The last product takes the check and the position of the power.
+// The outputs are renumbered.
+
+void EEOptimizeReduce( EEvaluation *eval, EEProgram *program )
+{
+    EEInstruction *instructions,
+                  ins;
+    int32_t       *index,
+                  *call;
+    int32_t       i,
+                  j,
+                  k,
+                  n,
+                  first,
+                  count,
+                  power,
+                  square;
+    double        exponent;
+
+    count        = program->instructionsCount;
+    instructions = program->instructions;
+    index        = malloc( ( count + 1 ) * sizeof( int32_t ) );
+
+    if( ! index )
+    {
+        eval->error = "out of memory";
+        return;
+    }
+
+    // The instructions are emitted again in a new stream
+
+    program->instructions         = NULL;
+    program->instructionsCount    = 0;
+    program->instructionsCapacity = 0;
+
+    #define EERenumber(value) ( (value) < 0 ? (value) : index[ value ] )
+
+    for( i = 0; i < count && ! eval->error; i++ )
+    {
+        ins = instructions[ i ];
+
+        if( EEOpcodeOperands( ins.opcode ) >= 1 ) ins.a = EERenumber( ins.a );
+        if( EEOpcodeOperands( ins.opcode ) == 2 ) ins.b = EERenumber( ins.b );
+        if( ins.guard != EENoValue ) ins.guard = EERenumber( ins.guard );
+
+        if( EEOpcodeListed( ins.opcode ) )
+        {
+            call = &program->arguments[ ins.b ];
+            for( k = 1; k <= call[ 0 ]; k++ ) call[ k ] = EERenumber( call[ k ] );
+        }
+
+        first = program->instructionsCount;
+        exponent = ins.opcode == EOPow && ins.b < 0 ? program->constants[ -1 - ins.b ] : 0;
+
+        if( ins.opcode == EOPow && ins.a >= 0 && exponent >= 2 && exponent <= EEPowerMaxExponent && exponent == (int)exponent )
+        {
+            power = EENoValue;
+            square = ins.a;
+
+            for( n = (int)exponent; n > 0 && ! eval->error; n >>= 1 )
+            {
+                if( n & 1 ) power = power == EENoValue ? square : EEProgramEmit( eval, program, EOMul, power, square, ECNone );
+                if( n > 1 ) square = EEProgramEmit( eval, program, EOMul, square, square, ECNone );
+            }
+
+            index[ i ] = power;
+        }
+        else if( ins.opcode == EOPow && ins.a >= 0 && exponent == 0.5 )
+        {
+            index[ i ] = EEProgramEmit( eval, program, EOSqt, ins.a, 0, ECNone );
+        }
+        else
+        {
+            index[ i ] = EEProgramEmit( eval, program, ins.opcode, ins.a, ins.b, ECNone );
+        }
+
+        if( eval->error ) break;
+
+        for( j = first; j < program->instructionsCount; j++ )
+        {
+            program->instructions[ j ].position = ins.position;
+            program->instructions[ j ].guard = ins.guard;
+        }
+
+        program->instructions[ index[ i ] ].check = ins.check;
+    }
+
+    for( k = 0; k < program->outputsCount && ! eval->error; k++ )
+    {
+        program->outputs[ k ] = EERenumber( program->outputs[ k ] );
+    }
+
+    #undef EERenumber
+
+    free( instructions );
+    free( index );
+}
+
+
+
+// Removes the dead instructions and the unused constants
+// then renumbers the values (the outputs too).
+
+void EEOptimizeSweep( EEvaluation *eval, EEProgram *program, bool *dead )
+{
+    EEInstruction *ins;
+    int32_t       *index,
+                  *constant,
+                  *call;
+    int32_t       i,
+                  k,
+                  count,
+                  constants;
+
+    index    = malloc( program->instructionsCount * sizeof( int32_t ) );
+    constant = malloc( ( program->constantsCount + 1 ) * sizeof( int32_t ) );
+
+    if( ! index || ! constant )
+    {
+        free( index );
+        free( constant );
+        eval->error = "out of memory";
+        return;
+    }
+
+    for( k = 0; k < program->constantsCount; k++ )
+    {
+        constant[ k ] = -1;
+    }
+
+    // Constants still used keep their order
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        ins = &program->instructions[ i ];
+
+        if( dead[ i ] ) continue;
+
+        if( EEOpcodeOperands( ins->opcode ) >= 1 && ins->a < 0 ) constant[ -1 - ins->a ] = 0;
+        if( EEOpcodeOperands( ins->opcode ) == 2 && ins->b < 0 ) constant[ -1 - ins->b ] = 0;
+        if( ins->guard < 0 && ins->guard != EENoValue ) constant[ -1 - ins->guard ] = 0;
+
+        if( EEOpcodeListed( ins->opcode ) )
+        {
+            call = &program->arguments[ ins->b ];
+            for( k = 1; k <= call[ 0 ]; k++ ) if( call[ k ] < 0 ) constant[ -1 - call[ k ] ] = 0;
+        }
+    }
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        if( program->outputs[ k ] < 0 ) constant[ -1 - program->outputs[ k ] ] = 0;
+    }
+
+    constants = 0;
+
+    for( k = 0; k < program->constantsCount; k++ )
+    {
+        if( constant[ k ] == 0 )
+        {
+            program->constants[ constants ] = program->constants[ k ];
+            constant[ k ] = -1 - constants++;
+        }
+    }
+
+    program->constantsCount = constants;
+
+    #define EERenumber(value) ( (value) < 0 ? constant[ -1 - (value) ] : index[ value ] )
+
+    count = 0;
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        if( dead[ i ] ) continue;
+
+        ins = &program->instructions[ i ];
+
+        if( EEOpcodeOperands( ins->opcode ) >= 1 ) ins->a = EERenumber( ins->a );
+        if( EEOpcodeOperands( ins->opcode ) == 2 ) ins->b = EERenumber( ins->b );
+        if( ins->guard != EENoValue ) ins->guard = EERenumber( ins->guard );
+
+        if( EEOpcodeListed( ins->opcode ) )
+        {
+            call = &program->arguments[ ins->b ];
+            for( k = 1; k <= call[ 0 ]; k++ ) call[ k ] = EERenumber( call[ k ] );
+        }
+
+        program->instructions[ count ] = *ins;
+        index[ i ] = count++;
+    }
+
+    program->instructionsCount = count;
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        program->outputs[ k ] = EERenumber( program->outputs[ k ] );
+    }
+
+    #undef EERenumber
+
+    free( index );
+    free( constant );
+}
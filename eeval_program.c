@@ -0,0 +1,1760 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_program.c
+//
+//  compiles an expression once into a program
+//  that can be executed many times
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+// Programs with up to this number of registers are executed
+// with registers on the stack; the larger ones get their
+// registers when compiled (see EEProgramRegisters())
+
+#define EEStackRegisters 256
+
+
+
+// Compiles an expression into a program.
+// The expression is parsed once: the program can be
+// executed many times with EEExecute().
+// The expression can be made of statements separated by `;`
+// that share their values (see EECompileStatements()):
+//
+//      let t = x * (1 + rate) ^ t0; price = t / 2; risk = t ^ 2
+//
+// each one that is not a `let` is an output of the program,
+// the last one is its result (see EEExecuteOutputs()).
+// Malformed expressions fail here with the same
+// errors reported by EEvaluate(); errors that depend on
+// the computation (division by zero, overflows...)
+// are reported by EEExecute().
+// The program must be released with EEFreeProgram().
+
+EEvalStatus EECompile( EEvaluation     *eval,       // the EEvaluation structure (to report errors)
+                       const char      *expression, // the expression as a null terminated C string
+                       const EESymbols *symbols,    // the variables the expression can refer to (can be NULL)
+                       EEProgram       *program )   // RETURN: the compiled program
+{
+    memset( program, 0, sizeof( EEProgram ) );
+
+    eval->expression = eval->cursor = expression;
+    eval->end = expression + strlen( expression );
+    eval->roundBracketsCount = 0;
+    eval->depth = 0;
+    eval->arguments = 0;
+    eval->guard = EENoValue;
+    eval->result = 0;
+    eval->error = NULL;
+    eval->symbols = symbols;
+    eval->bindings = NULL;
+    eval->bindingsCount = 0;
+
+    // Compiling counts tokens and lexing time only
+
+    #if eeval_statistics
+        memset( &eval->stats, 0, sizeof( EEStats ) );
+        eval->stats.evaluations = 1;
+        eval->stats.totalTime = EEStatsNow();
+    #endif
+
+    EECompileStatements( eval, program );
+
+    #if eeval_optimize
+    if( ! eval->error )
+    {
+        EEProgramOptimize( eval, program );
+    }
+    #endif
+
+    #if eeval_statistics
+        eval->stats.totalTime = EEStatsNow() - eval->stats.totalTime;
+        eval->stats.lexingTime = EEStatsLexing( eval );
+    #endif
+
+    if( ! eval->error )
+    {
+        program->expression = strdup( expression );
+        if( ! program->expression )
+        {
+            eval->error = "out of memory";
+        }
+    }
+
+    if( eval->error )
+    {
+        EEFreeProgram( program );
+        return EEvalFailure;
+    }
+
+    EEProgramFinalize( program );
+
+    eval->symbols = NULL;
+    eval->error = "";
+    return EEvalSuccess;
+}
+
+
+
+// Executes a program compiled with EECompile().
+// The function returns a status of success or failure
+// The result is in `*result`
+// Variables bound by pointer are read on each execution;
+// variables bound to a slot are read from `slots`.
+// The program is not modified: it can be shared between
+// threads provided that each one uses its own `EEvaluation`.
+
+EEvalStatus EEExecute( EEvaluation     *eval,    // the EEvaluation structure (to report errors)
+                       const EEProgram *program, // the compiled program
+                       const double    *slots,   // values of the variables bound to slots (can be NULL if none)
+                       double          *result ) // RETURN: the result of the execution
+{
+    return EEProgramExecute( eval, program, slots, result, NULL );
+}
+
+
+
+// Executes a program compiled with EECompile() as EEExecute() does
+// and returns all its outputs in one pass: `results` receives
+// `program->outputsCount` values, in the order of the statements
+// (all 0 if the execution fails). The values the statements share
+// are computed once.
+
+EEvalStatus EEExecuteOutputs( EEvaluation     *eval,     // the EEvaluation structure (to report errors)
+                              const EEProgram *program,  // the compiled program
+                              const double    *slots,    // values of the variables bound to slots (can be NULL if none)
+                              double          *results ) // RETURN: the outputs of the execution
+{
+    double result;
+
+    return EEProgramExecute( eval, program, slots, &result, results );
+}
+
+
+
+// Returns the index of the output named `name`
+// in the results of EEExecuteOutputs() (and in the outputs
+// of EEvaluateBatchOutputs()), -1 if there is none.
+
+int32_t EEFindOutput( const EEProgram *program, const char *name )
+{
+    int32_t k;
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        if( program->names[ k ] && strcmp( program->names[ k ], name ) == 0 ) return k;
+    }
+
+    return -1;
+}
+
+
+
+// Releases the memory allocated by EECompile().
+// The program can be compiled again.
+
+void EEFreeProgram( EEProgram *program )
+{
+    int32_t k;
+
+    EEJitRelease( program );
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        free( program->names[ k ] );
+    }
+
+    free( program->expression );
+    free( program->constants );
+    free( program->instructions );
+    free( program->pointers );
+    free( program->arguments );
+    free( program->outputs );
+    free( program->names );
+    free( program->registers );
+
+    memset( program, 0, sizeof( EEProgram ) );
+}
+
+
+
+// Writes into `bound` the expression with its numbers (and `e`, `pi`)
+// replaced by variables `x0`, `x1`... bound to slots holding their values:
+// compiled, it can't be folded to a constant. Used to measure programs
+// (`eeval -b` and eeval_bench.c).
+// Returns false if out of memory; `bound` must be released
+// with EEFreeBound() anyway.
+
+bool EEBindNumbers( const char *expression, EEBound *bound )
+{
+    EEvaluation eval;
+    EEToken     token;
+    const char  *start,
+                *begin;
+    char        *out,
+                *name;
+    size_t      length;
+    double      value;
+    int32_t     count;
+
+    memset( bound, 0, sizeof( EEBound ) );
+    memset( &eval, 0, sizeof( EEvaluation ) );
+
+    // A number takes at least one character, its variable at most 7
+
+    length = strlen( expression );
+    bound->expression = malloc( length * 7 + 1 );
+    bound->variables  = malloc( ( length + 1 ) * sizeof( EEVariable ) );
+    bound->names      = malloc( ( length + 1 ) * 8 );
+    bound->slots      = malloc( ( length + 1 ) * sizeof( double ) );
+
+    if( ! bound->expression || ! bound->variables || ! bound->names || ! bound->slots ) return false;
+
+    eval.expression = eval.cursor = expression;
+    eval.end = expression + length;
+
+    out = bound->expression;
+    name = bound->names;
+    count = 0;
+
+    for( ;; )
+    {
+        start = eval.cursor;
+        value = EEvalToken( &eval, &token );
+        if( token == ETEof || token == ETErr ) break;
+
+        if( token != ETVal )
+        {
+            memcpy( out, start, eval.cursor - start );
+            out += eval.cursor - start;
+            continue;
+        }
+
+        for( begin = start; EEvalCharClasses[ (uint8_t)*begin ] & ELBlank; begin++ );
+
+        memcpy( out, start, begin - start );
+        out += begin - start;
+        out += sprintf( out, "x%d", (int)count );
+
+        sprintf( name, "x%d", (int)count );
+        bound->variables[ count ].name = name;
+        bound->variables[ count ].pointer = NULL;
+        bound->variables[ count ].slot = count;
+        bound->slots[ count ] = value;
+        name += strlen( name ) + 1;
+        count++;
+    }
+
+    // The blanks at the end (the cursor is past the end)
+
+    memcpy( out, start, eval.end - start );
+    out[ eval.end - start ] = '\0';
+
+    bound->length = strlen( bound->expression );
+    bound->symbols.variables = bound->variables;
+    bound->symbols.count = count;
+
+    return true;
+}
+
+
+
+// Releases the memory allocated by EEBindNumbers()
+
+void EEFreeBound( EEBound *bound )
+{
+    free( bound->expression );
+    free( bound->variables );
+    free( bound->names );
+    free( bound->slots );
+
+    memset( bound, 0, sizeof( EEBound ) );
+}
+
+
+
+// ***********************
+// PRIVATE FUNCTIONS BELOW
+// ***********************
+
+
+
+// Executes a program: the result in `*result`,
+// the outputs in `results` if not NULL.
+// See EEExecute() and EEExecuteOutputs().
+
+EEvalStatus EEProgramExecute( EEvaluation     *eval,
+                              const EEProgram *program,
+                              const double    *slots,
+                              double          *result,
+                              double          *results )
+{
+    double              stackRegisters[ EEStackRegisters ];
+    double              *registers;
+    double              *value;
+    double              arguments[ eeval_max_arguments ];
+    double              b,
+                        r;
+    int32_t             count,
+                        i,
+                        k;
+    const int32_t       *call;
+    const EEInstruction *ins;
+
+    eval->expression = eval->cursor = program->expression;
+    eval->end = NULL;
+    eval->roundBracketsCount = 0;
+    eval->depth = 0;
+    eval->result = 0;
+    eval->error = NULL;
+
+    *result = 0;
+
+    for( k = 0; k < program->outputsCount && results; k++ )
+    {
+        results[ k ] = 0;
+    }
+
+    if( ! program->expression )
+    {
+        eval->error = "program is not compiled";
+        return EEvalFailure;
+    }
+
+    if( program->slotsCount > 0 && ! slots )
+    {
+        eval->error = "missing values of variables bound to slots";
+        return EEvalFailure;
+    }
+
+    // Translated into native code ?
+
+    if( program->native )
+    {
+        return EEJitExecute( eval, program, slots, result, results );
+    }
+
+    count = program->constantsCount + program->instructionsCount;
+
+    if( count <= EEStackRegisters )
+    {
+        registers = stackRegisters;
+        if( program->constantsCount )
+        {
+            memcpy( registers, program->constants, program->constantsCount * sizeof( double ) );
+        }
+    }
+    else if( ( registers = EEProgramRegisters( program ) ) == NULL )
+    {
+        registers = malloc( count * sizeof( double ) );
+        if( ! registers )
+        {
+            eval->error = "out of memory";
+            return EEvalFailure;
+        }
+
+        if( program->constantsCount )
+        {
+            memcpy( registers, program->constants, program->constantsCount * sizeof( double ) );
+        }
+    }
+
+    value = registers + program->constantsCount;
+    r = 0;
+
+    for( i = 0; i < program->instructionsCount && ! eval->error; i++ )
+    {
+        ins = &program->instructions[ i ];
+
+        // Not needed (a branch not taken): not computed
+
+        if( ins->guard >= 0 && registers[ ins->guard ] == 0 )
+        {
+            value[ i ] = 0;
+            continue;
+        }
+
+        switch( ins->opcode )
+        {
+            case EOAdd:
+                r = registers[ ins->a ] + registers[ ins->b ];
+                break;
+
+            case EOSub:
+                r = registers[ ins->a ] - registers[ ins->b ];
+                break;
+
+            case EOMul:
+                r = registers[ ins->a ] * registers[ ins->b ];
+                break;
+
+            case EODiv:
+                b = registers[ ins->b ];
+                if( b == 0 && ! ins->safe )
+                {
+                    eval->error = "division by zero";
+                }
+                r = registers[ ins->a ] / b;
+                break;
+
+            case EONeg:
+                r = -registers[ ins->a ];
+                break;
+
+            case EOPow:
+                r = EEPower( registers[ ins->a ], registers[ ins->b ] );
+                break;
+
+            case EOFct:
+                if( registers[ ins->a ] < 0 && ! ins->safe )
+                {
+                    eval->error = "attempt to evaluate factorial of negative number";
+                }
+                r = EEFactorial( registers[ ins->a ] );
+                break;
+
+            case EOSin:
+                r = sin( registers[ ins->a ] );
+                break;
+
+            case EOCos:
+                r = cos( registers[ ins->a ] );
+                break;
+
+            case EOTan:
+                r = tan( registers[ ins->a ] );
+                break;
+
+            case EOASi:
+                r = asin( registers[ ins->a ] );
+                break;
+
+            case EOACo:
+                r = acos( registers[ ins->a ] );
+                break;
+
+            case EOATa:
+                r = atan( registers[ ins->a ] );
+                break;
+
+            case EOExp:
+                r = exp( registers[ ins->a ] );
+                break;
+
+            case EOLog:
+                r = log( registers[ ins->a ] );
+                break;
+
+            case EOSqt:
+                r = sqrt( registers[ ins->a ] );
+                break;
+
+            case EOLgb:
+                r = log( registers[ ins->b ] ) / log( registers[ ins->a ] );
+                break;
+
+            case EOMax:
+                b = registers[ ins->b ];
+                r = b > registers[ ins->a ] ? b : registers[ ins->a ];
+                break;
+
+            case EOMin:
+                b = registers[ ins->b ];
+                r = b < registers[ ins->a ] ? b : registers[ ins->a ];
+                break;
+
+            case EOVar:
+                r = *program->pointers[ ins->a ];
+                break;
+
+            case EOSlt:
+                r = slots[ ins->a ];
+                break;
+
+            case EOChk:
+                r = registers[ ins->a ];
+                break;
+
+            case EOCall:
+                call = &program->arguments[ ins->b ];
+                for( k = 0; k < call[ 0 ]; k++ ) arguments[ k ] = registers[ call[ k + 1 ] ];
+                r = EEFunctions[ ins->a ].scalar( arguments, call[ 0 ] );
+                break;
+
+            case EOLt:
+                r = registers[ ins->a ] < registers[ ins->b ];
+                break;
+
+            case EOLe:
+                r = registers[ ins->a ] <= registers[ ins->b ];
+                break;
+
+            case EOEq:
+                r = registers[ ins->a ] == registers[ ins->b ];
+                break;
+
+            case EONe:
+                r = registers[ ins->a ] != registers[ ins->b ];
+                break;
+
+            case EONot:
+                r = registers[ ins->a ] == 0;
+                break;
+
+            case EOAnd:
+                r = registers[ ins->a ] != 0 && registers[ ins->b ] != 0;
+                break;
+
+            case EOOr:
+                r = registers[ ins->a ] != 0 || registers[ ins->b ] != 0;
+                break;
+
+            case EOSel:
+                call = &program->arguments[ ins->b ];
+                r = registers[ call[ 1 ] ] != 0 ? registers[ call[ 2 ] ] : registers[ call[ 3 ] ];
+                break;
+        }
+
+        if( ! eval->error && ins->check != ECNone && eexception( r ) )
+        {
+            eval->error = ins->check == ECTooBig ? "result is too big" : "result is complex or too big";
+        }
+
+        if( eval->error )
+        {
+            eval->cursor = program->expression + ins->position;
+        }
+
+        value[ i ] = r;
+    }
+
+    // Adding 0 turns -0 into 0: EEvaluate() computes results
+    // as sums starting from 0, so they are never -0
+
+    if( ! eval->error )
+    {
+        *result = eval->result = registers[ program->result ] + 0;
+
+        for( k = 0; k < program->outputsCount && results; k++ )
+        {
+            results[ k ] = registers[ program->outputs[ k ] ] + 0;
+        }
+    }
+
+    if( registers == program->registers )
+    {
+        EEProgramReturn( program );
+    }
+    else if( registers != stackRegisters )
+    {
+        free( registers );
+    }
+
+    if( eval->error )
+    {
+        *result = 0;
+        return EEvalFailure;
+    }
+    else
+    {
+        eval->error = "";
+        return EEvalSuccess;
+    }
+}
+
+
+
+// The functions below parse the grammar EEvalExpression() evaluates
+// in eeval.c (by recursive descent, where EEvalExpression() keeps
+// an explicit stack) but, instead of computing the values, emit
+// the instructions to compute them.
+// Instructions are emitted in the same order the operations
+// are performed by EEvaluate() so errors are raised in the same order.
+// The nesting is limited in the same way (see EEvalEnter()).
+
+
+
+// Compiles the statements of the expression, separated by `;`
+// (the last one can be followed by a `;` too):
+//
+//      let name = expression   binds the name to the value of the expression
+//      name = expression       the same, and the value is an output
+//      expression              an output without a name
+//
+// The statements that follow refer to the value by its name: it is
+// computed once, where it is bound. `let` followed by anything
+// but a name is an identifier as any other (see EECompileName()
+// for the names that can be bound).
+// A statement ends at the next `;` (no token contains one): the end
+// of the expression is moved there while the statement is compiled.
+// A program without outputs fails with "missing output".
+
+void EECompileStatements( EEvaluation *eval, EEProgram *program )
+{
+    EEBinding  *bindings,
+               *grown;
+    const char *end,
+               *next,
+               *cursor,
+               *name;
+    size_t     length;
+    int32_t    capacity,
+               value;
+    bool       let;
+
+    bindings = NULL;
+    capacity = 0;
+    end = eval->end;
+
+    do
+    {
+        next = memchr( eval->cursor, ';', end - eval->cursor );
+        eval->end = next ? next : end;
+
+        // let name = ...  or  name = ... ?
+
+        let = false;
+        name = NULL;
+
+        cursor = EEvalSkipBlanks( eval->cursor, eval->end );
+        length = cursor < eval->end && ( EEvalCharClasses[ (uint8_t)*cursor ] & ELLetter ) ? EEvalIdentifierLength( cursor, eval->end ) : 0;
+
+        if( length == 3 && strncmp( cursor, "let", 3 ) == 0 )
+        {
+            name = EEvalSkipBlanks( cursor + 3, eval->end );
+            let = name < eval->end && ( EEvalCharClasses[ (uint8_t)*name ] & ELLetter );
+            length = let ? EEvalIdentifierLength( name, eval->end ) : 0;
+            if( ! let ) name = NULL;
+        }
+        else if( length > 0 )
+        {
+            name = EEvalSkipBlanks( cursor + length, eval->end );
+            name = name < eval->end && *name == '=' && ( name + 1 == eval->end || name[ 1 ] != '=' ) ? cursor : NULL;
+        }
+
+        if( name )
+        {
+            cursor = EEvalSkipBlanks( name + length, eval->end );
+
+            if( cursor == eval->end || *cursor != '=' || ( cursor + 1 < eval->end && cursor[ 1 ] == '=' ) )
+            {
+                eval->cursor = cursor;
+                eval->error = "expected = after name";
+                break;
+            }
+
+            if( ! EECompileName( eval, name, length ) )
+            {
+                eval->cursor = name;
+                break;
+            }
+
+            eval->cursor = cursor + 1;
+        }
+
+        value = EECompileAddends( eval, program, -1, true, false, NULL );
+        if( eval->error ) break;
+
+        if( name )
+        {
+            if( eval->bindingsCount == capacity )
+            {
+                capacity = capacity ? capacity * 2 : 8;
+                grown = realloc( bindings, capacity * sizeof( EEBinding ) );
+                if( ! grown )
+                {
+                    eval->error = "out of memory";
+                    break;
+                }
+                bindings = grown;
+            }
+
+            bindings[ eval->bindingsCount ].name   = name;
+            bindings[ eval->bindingsCount ].length = length;
+            bindings[ eval->bindingsCount ].value  = value;
+
+            eval->bindings = bindings;
+            eval->bindingsCount++;
+        }
+
+        if( ! let )
+        {
+            EEProgramOutput( eval, program, value, name, length );
+            if( eval->error ) break;
+        }
+
+        if( next ) eval->cursor = next + 1;
+    }
+    while( next && EEvalSkipBlanks( eval->cursor, end ) < end );
+
+    eval->end = end;
+
+    if( ! eval->error && program->outputsCount == 0 )
+    {
+        eval->cursor = end;
+        eval->error = "missing output";
+    }
+
+    free( bindings );
+
+    eval->bindings = NULL;
+    eval->bindingsCount = 0;
+}
+
+
+
+// Tells if a statement can bind `name` (of `length` characters):
+// keywords, registered functions, variables of the symbol table
+// and names already bound can't (fails with "name already in use").
+
+bool EECompileName( EEvaluation *eval, const char *name, size_t length )
+{
+    const EEVariable *variable;
+    int32_t          i;
+    bool             taken;
+
+    taken = EEvalKeyword( name, length ) || EEFunctionLookup( name, length ) >= 0;
+
+    for( i = 0; eval->symbols && i < eval->symbols->count && ! taken; i++ )
+    {
+        variable = &eval->symbols->variables[ i ];
+        taken = strncmp( variable->name, name, length ) == 0 && variable->name[ length ] == '\0';
+    }
+
+    for( i = 0; i < eval->bindingsCount && ! taken; i++ )
+    {
+        taken = eval->bindings[ i ].length == length && strncmp( eval->bindings[ i ].name, name, length ) == 0;
+    }
+
+    if( taken )
+    {
+        eval->error = "name already in use";
+    }
+
+    return ! taken;
+}
+
+
+
+// Compiles the expression of a level: a disjunction
+// (see EECompileDisjunction()) followed by the token that ends
+// the level.
+// See EEvalExpression() (step ESLevel).
+
+int32_t EECompileAddends( EEvaluation *eval,
+                          EEProgram   *program,
+                          int64_t     breakOnRoundBracketsCount, // If open brackets count goes down to this count then exit;
+                          bool        breakOnETEof,              // exit if the end of the string '\0' is met;
+                          bool        breakOnETcom,              // exit if a comma is met;
+                          EEToken     *tokenThatCausedBreak )    // if pointer is not null the token/symbol that caused the function to exit.
+{
+    EEToken rightOp;
+    int32_t result;
+
+    result = EECompileDisjunction( eval, program, &rightOp );
+    if( eval->error ) return EENoValue;
+
+    if( rightOp == ETrbc )
+    {
+        eval->roundBracketsCount--;
+        if( eval->roundBracketsCount < 0 )
+        {
+            eval->error = "unexpected close round bracket";
+            return EENoValue;
+        }
+    }
+
+    if( tokenThatCausedBreak )
+    {
+        *tokenThatCausedBreak = rightOp;
+    }
+
+    if( ( eval->roundBracketsCount == breakOnRoundBracketsCount ) || ( breakOnETEof && rightOp == ETEof ) || ( breakOnETcom && rightOp == ETcom ) )
+    {
+        return result;
+    }
+
+    switch( rightOp )
+    {
+        case ETEof:
+            eval->error = "unexpected end of expression";
+            break;
+
+        case ETrbc:
+            eval->error = "unexpected close round bracket";
+            break;
+
+        case ETcom:
+            eval->error = "unexpeced comma";
+            break;
+
+        default:
+            eval->error = "unexpeced symbol";
+            break;
+    }
+
+    return EENoValue;
+}
+
+
+
+// Compiles a sequence of 1 or more conjunctions
+// C1 [ || C2 [ || C3 ... ] ]
+// The right operand of || is computed only if the left one is 0
+// (see EECompileGuard()).
+// See EEvalExpression() (step ESLogic).
+
+int32_t EECompileDisjunction( EEvaluation *eval,
+                              EEProgram   *program,
+                              EEToken     *rightOp ) // RETURN: the token that follows.
+{
+    int32_t left,
+            right,
+            guard;
+
+    left = EECompileConjunction( eval, program, rightOp );
+    if( eval->error ) return EENoValue;
+
+    while( *rightOp == ETOr )
+    {
+        if( ! EEvalEnter( eval ) ) return EENoValue;
+
+        guard = eval->guard;
+        eval->guard = EECompileGuard( eval, program, left, true );
+        if( eval->error ) return EENoValue;
+
+        right = EECompileConjunction( eval, program, rightOp );
+        eval->guard = guard;
+        if( eval->error ) return EENoValue;
+
+        eval->depth--;
+
+        left = EEProgramEmit( eval, program, EOOr, left, right, ECNone );
+        if( eval->error ) return EENoValue;
+    }
+
+    return left;
+}
+
+
+
+// Compiles a sequence of 1 or more comparisons
+// C1 [ && C2 [ && C3 ... ] ]
+// The right operand of && is computed only if the left one is not 0.
+// See EEvalExpression() (step ESLogic).
+
+int32_t EECompileConjunction( EEvaluation *eval,
+                              EEProgram   *program,
+                              EEToken     *rightOp ) // RETURN: the token that follows.
+{
+    int32_t left,
+            right,
+            guard;
+
+    left = EECompileComparison( eval, program, rightOp );
+    if( eval->error ) return EENoValue;
+
+    while( *rightOp == ETAnd )
+    {
+        if( ! EEvalEnter( eval ) ) return EENoValue;
+
+        guard = eval->guard;
+        eval->guard = EECompileGuard( eval, program, left, false );
+        if( eval->error ) return EENoValue;
+
+        right = EECompileComparison( eval, program, rightOp );
+        eval->guard = guard;
+        if( eval->error ) return EENoValue;
+
+        eval->depth--;
+
+        left = EEProgramEmit( eval, program, EOAnd, left, right, ECNone );
+        if( eval->error ) return EENoValue;
+    }
+
+    return left;
+}
+
+
+
+// Compiles a sum or the comparison of two sums
+// S1 [ < S2 ] (a single one: comparisons are not chained);
+// `>` and `>=` are `<` and `<=` of the swapped operands.
+// See EEvalExpression() (step ESLogic).
+
+int32_t EECompileComparison( EEvaluation *eval,
+                             EEProgram   *program,
+                             EEToken     *rightOp ) // RETURN: the token that follows.
+{
+    EEToken op;
+    int32_t left,
+            right;
+
+    left = EECompileSum( eval, program, rightOp );
+    if( eval->error ) return EENoValue;
+
+    if( *rightOp < ETLt || *rightOp > ETNe ) return left;
+
+    op = *rightOp;
+
+    if( ! EEvalEnter( eval ) ) return EENoValue;
+
+    right = EECompileSum( eval, program, rightOp );
+    if( eval->error ) return EENoValue;
+
+    eval->depth--;
+
+    switch( op )
+    {
+        case ETLt: return EEProgramEmit( eval, program, EOLt, left, right, ECNone );
+        case ETLe: return EEProgramEmit( eval, program, EOLe, left, right, ECNone );
+        case ETGt: return EEProgramEmit( eval, program, EOLt, right, left, ECNone );
+        case ETGe: return EEProgramEmit( eval, program, EOLe, right, left, ECNone );
+        case ETEq: return EEProgramEmit( eval, program, EOEq, left, right, ECNone );
+        default:   return EEProgramEmit( eval, program, EONe, left, right, ECNone );
+    }
+}
+
+
+
+// Compiles a single value or expression A0 or
+// sequence of 2 or more addends:
+// A1 - A2 [ + A3 [ - A4 ... ] ]
+// See EEvalExpression() (step ESAddend).
+
+int32_t EECompileSum( EEvaluation *eval,
+                      EEProgram   *program,
+                      EEToken     *rightOp ) // RETURN: the token that follows.
+{
+    EEToken leftOp;
+    int32_t value;
+    int32_t result;
+    int32_t addends;
+
+    result = EENoValue;
+    *rightOp = ETSum;
+    addends = 0;
+
+    do
+    {
+        leftOp = *rightOp;
+
+        value = EECompileFactors( eval, program, EENoValue, ETMul, false, rightOp );
+        if( eval->error ) return EENoValue;
+
+        // The first addend is the value itself
+
+        if( addends == 0 )
+        {
+            result = value;
+        }
+        else
+        {
+            result = EEProgramEmit( eval, program, leftOp == ETSum ? EOAdd : EOSub, result, value, ECNone );
+            if( eval->error ) return EENoValue;
+        }
+
+        addends++;
+    }
+    while( *rightOp == ETSum || *rightOp == ETSub );
+
+    // A single addend has already been checked
+    // as a factor; a sum is checked when complete.
+
+    if( addends > 1 )
+    {
+        EEProgramCheck( program, result, ECComplex );
+    }
+
+    return result;
+}
+
+
+
+// Returns the guard of the instructions computed only if `condition`
+// is not 0 (0 if `negate`) and if the current guard is not 0:
+// an instruction with a guard is computed only if its guard is not 0
+// (see EEExecute()). The instructions of the guard share the current one.
+
+int32_t EECompileGuard( EEvaluation *eval,
+                        EEProgram   *program,
+                        int32_t     condition, // the value deciding
+                        bool        negate )   // is the value 0 required ?
+{
+    int32_t guard;
+
+    guard = negate ? EEProgramEmit( eval, program, EONot, condition, 0, ECNone ) : condition;
+    if( eval->error ) return EENoValue;
+
+    if( eval->guard != EENoValue )
+    {
+        guard = EEProgramEmit( eval, program, EOAnd, eval->guard, guard, ECNone );
+        if( eval->error ) return EENoValue;
+    }
+
+    return guard;
+}
+
+
+
+// Compiles a sequence of 1 or more multiplies or divisions
+// F1 [ * F2  [ / F3 [ * F4 ... ] ] ]
+// See EEvalExpression() (steps ESFactor, ESValue and ESProduct).
+
+int32_t EECompileFactors( EEvaluation *eval,
+                          EEProgram   *program,
+                          int32_t     leftValue, // The value on the left to be multiplied(divided), EENoValue if none;
+                          EEToken     op,        // is it multiply or divide;
+                          bool        isExponent,// is an exponent being compiled ?
+                          EEToken     *leftOp )  // RETURN: factors are over, this is the next operator (token).
+{
+    EEToken token,
+            nextOp;
+
+    int32_t rightValue;
+    double  value;
+    double  sign;
+
+    do
+    {
+        value = EEvalToken( eval, &token );
+        if( eval->error ) return EENoValue;
+
+        // Unary minus or plus ?
+
+        if( token == ETSub )
+        {
+            sign = -1;
+            value = EEvalToken( eval, &token );
+            if( eval->error ) return EENoValue;
+        }
+        else if( token == ETSum )
+        {
+            sign = 1;
+            value = EEvalToken( eval, &token );
+            if( eval->error ) return EENoValue;
+        }
+        else
+        {
+            sign = 1;
+        }
+
+        rightValue = EENoValue;
+
+        // Open round bracket ?
+
+        if( token == ETrbo )
+        {
+            eval->roundBracketsCount++;
+
+            if( ! EEvalEnter( eval ) ) return EENoValue;
+
+            rightValue = EECompileAddends( eval, program, eval->roundBracketsCount - 1, false, false, NULL );
+            if( eval->error ) return EENoValue;
+
+            eval->depth--;
+
+            token = ETVal;
+        }
+
+        // A function ? (`value` is its index)
+
+        else if( token == ETFun )
+        {
+            rightValue = EECompileFunction( eval, program, (int32_t)value );
+            if( eval->error ) return EENoValue;
+
+            eval->depth--;
+
+            token = ETVal;
+        }
+
+        // A variable ?
+
+        else if( token == ETVar )
+        {
+            rightValue = EEProgramVariable( eval, program, (int32_t)value );
+            if( eval->error ) return EENoValue;
+
+            token = ETVal;
+        }
+
+        // A name bound by a statement ? (its value is already computed)
+
+        else if( token == ETBnd )
+        {
+            rightValue = eval->bindings[ (int32_t)value ].value;
+
+            token = ETVal;
+        }
+
+        // A number ?
+
+        else if( token == ETVal )
+        {
+            rightValue = EEProgramConstant( eval, program, value );
+            if( eval->error ) return EENoValue;
+        }
+
+        if( token != ETVal )
+        {
+            eval->error = "expected value";
+            return EENoValue;
+        }
+
+        // Get beforehand the next token
+        // to see if it's an exponential or factorial operator
+
+        EEvalToken( eval, &nextOp );
+        if( eval->error ) return EENoValue;
+
+        // Unary minus precedence (highest/lowest) affects this section of code
+
+        if( nextOp == ETFct )
+        {
+            #if eeval_unary_minus_has_highest_precedence
+                if( sign < 0 )
+                {
+                    rightValue = EEProgramEmit( eval, program, EONeg, rightValue, 0, ECNone );
+                    if( eval->error ) return EENoValue;
+                    sign = 1;
+                }
+            #endif
+            rightValue = EECompileFactorial( eval, program, rightValue, &nextOp );
+            if( eval->error ) return EENoValue;
+        }
+
+        if( nextOp == ETExc )
+        {
+            #if eeval_unary_minus_has_highest_precedence
+                if( sign < 0 )
+                {
+                    rightValue = EEProgramEmit( eval, program, EONeg, rightValue, 0, ECNone );
+                    if( eval->error ) return EENoValue;
+                    sign = 1;
+                }
+            #endif
+            rightValue = EECompileExponentiation( eval, program, rightValue, &nextOp );
+            if( eval->error ) return EENoValue;
+        }
+
+        // multiplication/division
+        // (multiplying by 1 the first factor is omitted)
+
+        if( op == ETMul )
+        {
+            if( leftValue != EENoValue )
+            {
+                rightValue = EEProgramEmit( eval, program, EOMul, leftValue, rightValue, ECNone );
+            }
+        }
+        else
+        {
+            rightValue = EEProgramEmit( eval, program, EODiv, leftValue, rightValue, ECNone );
+        }
+        if( eval->error ) return EENoValue;
+
+        if( sign < 0 )
+        {
+            rightValue = EEProgramEmit( eval, program, EONeg, rightValue, 0, ECNone );
+            if( eval->error ) return EENoValue;
+        }
+
+        EEProgramCheck( program, rightValue, ECTooBig );
+
+        leftValue = rightValue;
+
+        op = nextOp;
+    }
+    while( ( op == ETMul || op == ETDiv ) && ! isExponent );
+
+
+    *leftOp = op;
+
+    return leftValue;
+}
+
+
+
+// Compiles the expession(s) (comma separated if multiple)
+// inside the round brackets then the function at `index`
+// in EEFunctions[].
+// See EEvalExpression() (step ESLevel) and EEvalArgument().
+
+int32_t EECompileFunction( EEvaluation *eval, EEProgram *program, int32_t index )
+{
+    const EEFunction *function;
+
+    int32_t  *values,
+             result,
+             value,
+             guard;
+
+    uint16_t count;
+
+    EEToken  token;
+
+    function = &EEFunctions[ index ];
+
+    // Eat an open round bracket and count it
+
+    EEvalToken( eval, &token );
+    if( eval->error ) return EENoValue;
+
+    if( token != ETrbo )
+    {
+        eval->error = "expected open round bracket after function name";
+        return EENoValue;
+    }
+
+    eval->roundBracketsCount++;
+
+    if( ! EEvalEnter( eval ) ) return EENoValue;
+
+    // The arguments of registered functions are collected
+    // (as many as they take, at most eeval_max_arguments)
+
+    values = NULL;
+
+    if( EEOpcodeListed( function->opcode ) )
+    {
+        values = malloc( ( function->maximum == EEVariadic ? eeval_max_arguments : function->maximum ) * sizeof( int32_t ) );
+        if( ! values )
+        {
+            eval->error = "out of memory";
+            return EENoValue;
+        }
+    }
+
+    // Arguments end at the close bracket once the function has enough,
+    // a comma is followed by another one if the function takes more.
+    // The branches of if() are guarded by its condition.
+
+    guard = eval->guard;
+    result = EENoValue;
+    count = 0;
+    token = ETcom;
+
+    while( token == ETcom )
+    {
+        value = EECompileAddends( eval, program, count + 1 >= function->minimum ? eval->roundBracketsCount - 1 : -1, false,
+                                  function->maximum == EEVariadic || count + 1 < function->maximum, &token );
+        if( eval->error ) break;
+
+        switch( function->opcode )
+        {
+            case EOMax:
+            case EOMin:
+            case EOAdd:
+                // max(), min() and average(): reduced as they come
+                result = count == 0 ? value : EEProgramEmit( eval, program, function->opcode, result, value, ECNone );
+                break;
+
+            case EOCall:
+                if( eval->arguments == eeval_max_arguments )
+                {
+                    eval->error = "too many arguments";
+                    break;
+                }
+                eval->arguments++;
+                values[ count ] = value;
+                break;
+
+            case EOSel:
+                values[ count ] = value;
+                eval->guard = guard;
+                if( count < 2 ) eval->guard = EECompileGuard( eval, program, values[ 0 ], count == 1 );
+                break;
+
+            default:
+                // The second argument of pow() and log()
+                result = count == 0 ? value : EEProgramEmit( eval, program, function->opcode, result, value, ECComplex );
+                break;
+        }
+        if( eval->error ) break;
+
+        count++;
+    }
+
+    eval->guard = guard;
+
+    if( ! eval->error )
+    {
+        switch( function->opcode )
+        {
+            case EOMax:
+            case EOMin:
+                // max() and min() of a single value return the value itself
+
+                if( count > 1 ) EEProgramCheck( program, result, ECComplex );
+                break;
+
+            case EOAdd:
+                value = EEProgramConstant( eval, program, (double)count );
+                if( eval->error ) break;
+                result = EEProgramEmit( eval, program, EODiv, result, value, ECNone );
+                if( eval->error ) break;
+                EEProgramCheck( program, result, ECComplex );
+                break;
+
+            case EOCall:
+                result = EEProgramList( eval, program, EOCall, index, values, count, ECComplex );
+                eval->arguments -= count;
+                break;
+
+            case EOSel:
+                result = EEProgramList( eval, program, EOSel, 0, values, count, ECNone );
+                break;
+
+            default:
+                // Functions of a single argument (log(n) too)
+
+                if( count == 1 )
+                {
+                    result = EEProgramEmit( eval, program, function->opcode == EOLgb ? EOLog : function->opcode, result, 0, ECComplex );
+                }
+                break;
+        }
+    }
+
+    free( values );
+
+    if( eval->error ) return EENoValue;
+
+    return result;
+}
+
+
+
+// Compiles an exponentiation.
+// See EEvalExpression() (step ESValue).
+
+int32_t EECompileExponentiation( EEvaluation *eval,
+                                 EEProgram   *program,
+                                 int32_t     base,      // The base has already been compiled;
+                                 EEToken     *rightOp ) // RETURN: the token (operator) that follows.
+{
+    int32_t exponent;
+
+    if( ! EEvalEnter( eval ) ) return EENoValue;
+
+    exponent = EECompileFactors( eval, program, EENoValue, ETMul, true, rightOp );
+    if( eval->error ) return EENoValue;
+
+    eval->depth--;
+
+    return EEProgramEmit( eval, program, EOPow, base, exponent, ECComplex );
+}
+
+
+
+// Compiles a factorial.
+// See EEvalFactorial().
+
+int32_t EECompileFactorial( EEvaluation *eval,
+                            EEProgram   *program,
+                            int32_t     value,     // The value has already been compiled;
+                            EEToken     *rightOp ) // RETURN: the token (operator) that follows.
+{
+    int32_t result;
+
+    result = EEProgramEmit( eval, program, EOFct, value, 0, ECComplex );
+    if( eval->error ) return EENoValue;
+
+    EEvalToken( eval, rightOp );
+    if( eval->error ) return EENoValue;
+
+    return result;
+}
+
+
+
+// Adds a value to the constants pool.
+// Returns the identifier of the constant.
+
+int32_t EEProgramConstant( EEvaluation *eval, EEProgram *program, double value )
+{
+    double *constants;
+    int32_t capacity;
+
+    if( program->constantsCount == program->constantsCapacity )
+    {
+        capacity = program->constantsCapacity ? program->constantsCapacity * 2 : 16;
+        constants = realloc( program->constants, capacity * sizeof( double ) );
+        if( ! constants )
+        {
+            eval->error = "out of memory";
+            return EENoValue;
+        }
+        program->constants = constants;
+        program->constantsCapacity = capacity;
+    }
+
+    program->constants[ program->constantsCount ] = value;
+
+    return -1 - program->constantsCount++;
+}
+
+
+
+// Appends an instruction to the program.
+// The current position of the cursor is recorded to report errors.
+// Returns the identifier of the result of the instruction.
+
+int32_t EEProgramEmit( EEvaluation *eval,
+                       EEProgram   *program,
+                       EEOpcode    opcode,
+                       int32_t     a,       // first operand
+                       int32_t     b,       // second operand (ignored by unary opcodes)
+                       EECheck     check )  // check to perform on the result
+{
+    EEInstruction *instructions,
+                  *ins;
+    int32_t       capacity;
+
+    if( program->instructionsCount == program->instructionsCapacity )
+    {
+        capacity = program->instructionsCapacity ? program->instructionsCapacity * 2 : 16;
+        instructions = realloc( program->instructions, capacity * sizeof( EEInstruction ) );
+        if( ! instructions )
+        {
+            eval->error = "out of memory";
+            return EENoValue;
+        }
+        program->instructions = instructions;
+        program->instructionsCapacity = capacity;
+    }
+
+    ins = &program->instructions[ program->instructionsCount ];
+
+    ins->opcode   = opcode;
+    ins->check    = check;
+    ins->safe     = false;
+    ins->a        = a;
+    ins->b        = b;
+    ins->guard    = eval->guard;
+    ins->position = (int32_t)( eval->cursor - eval->expression );
+
+    return program->instructionsCount++;
+}
+
+
+
+// Emits the instruction that reads the variable at `index`
+// in the symbol table.
+// Returns the identifier of the value of the variable.
+
+int32_t EEProgramVariable( EEvaluation *eval, EEProgram *program, int32_t index )
+{
+    const EEVariable *variable;
+    double           **pointers;
+    int32_t          capacity,
+                     i;
+
+    variable = &eval->symbols->variables[ index ];
+
+    if( ! variable->pointer )
+    {
+        if( variable->slot < 0 )
+        {
+            eval->error = "variable bound to a negative slot";
+            return EENoValue;
+        }
+
+        if( variable->slot >= program->slotsCount )
+        {
+            program->slotsCount = variable->slot + 1;
+        }
+
+        return EEProgramEmit( eval, program, EOSlt, variable->slot, 0, ECNone );
+    }
+
+    for( i = 0; i < program->pointersCount; i++ )
+    {
+        if( program->pointers[ i ] == variable->pointer ) break;
+    }
+
+    if( i == program->pointersCount )
+    {
+        if( program->pointersCount == program->pointersCapacity )
+        {
+            capacity = program->pointersCapacity ? program->pointersCapacity * 2 : 8;
+            pointers = realloc( program->pointers, capacity * sizeof( double * ) );
+            if( ! pointers )
+            {
+                eval->error = "out of memory";
+                return EENoValue;
+            }
+            program->pointers = pointers;
+            program->pointersCapacity = capacity;
+        }
+
+        program->pointers[ program->pointersCount++ ] = variable->pointer;
+    }
+
+    return EEProgramEmit( eval, program, EOVar, i, 0, ECNone );
+}
+
+
+
+// Emits an instruction reading a list of `count` values (see
+// EEOpcodeListed()): their identifiers are appended to the list
+// of the arguments of the program, after their count.
+// Returns the identifier of the result of the instruction.
+
+int32_t EEProgramList( EEvaluation   *eval,
+                       EEProgram     *program,
+                       EEOpcode      opcode,
+                       int32_t       a,         // first operand (the function of a call)
+                       const int32_t *values,   // the values
+                       int32_t       count,
+                       EECheck       check )    // check to perform on the result
+{
+    int32_t *arguments;
+    int32_t capacity,
+            offset;
+
+    if( program->argumentsCount + count + 1 > program->argumentsCapacity )
+    {
+        capacity = program->argumentsCapacity ? program->argumentsCapacity * 2 : 16;
+        while( capacity < program->argumentsCount + count + 1 ) capacity *= 2;
+
+        arguments = realloc( program->arguments, capacity * sizeof( int32_t ) );
+        if( ! arguments )
+        {
+            eval->error = "out of memory";
+            return EENoValue;
+        }
+        program->arguments = arguments;
+        program->argumentsCapacity = capacity;
+    }
+
+    offset = program->argumentsCount;
+
+    program->arguments[ offset ] = count;
+    memcpy( &program->arguments[ offset + 1 ], values, count * sizeof( int32_t ) );
+    program->argumentsCount += count + 1;
+
+    return EEProgramEmit( eval, program, opcode, a, offset, check );
+}
+
+
+
+// Requests a check on a value unless it is already checked.
+// Constants are checked when parsed.
+
+void EEProgramCheck( EEProgram *program, int32_t value, EECheck check )
+{
+    if( value >= 0 && program->instructions[ value ].check == ECNone )
+    {
+        program->instructions[ value ].check = check;
+    }
+}
+
+
+
+// Appends the output `value` named `name` (of `length` characters,
+// NULL if not named) to the outputs of the program.
+
+void EEProgramOutput( EEvaluation *eval, EEProgram *program, int32_t value, const char *name, size_t length )
+{
+    int32_t *outputs;
+    char    **names;
+    int32_t capacity;
+
+    if( program->outputsCount == program->outputsCapacity )
+    {
+        capacity = program->outputsCapacity ? program->outputsCapacity * 2 : 4;
+        outputs = realloc( program->outputs, capacity * sizeof( int32_t ) );
+        if( outputs ) program->outputs = outputs;
+        names = realloc( program->names, capacity * sizeof( char * ) );
+        if( names ) program->names = names;
+        if( ! outputs || ! names )
+        {
+            eval->error = "out of memory";
+            return;
+        }
+        program->outputsCapacity = capacity;
+    }
+
+    program->names[ program->outputsCount ] = NULL;
+
+    if( name )
+    {
+        program->names[ program->outputsCount ] = malloc( length + 1 );
+        if( ! program->names[ program->outputsCount ] )
+        {
+            eval->error = "out of memory";
+            return;
+        }
+        memcpy( program->names[ program->outputsCount ], name, length );
+        program->names[ program->outputsCount ][ length ] = '\0';
+    }
+
+    program->outputs[ program->outputsCount++ ] = value;
+}
+
+
+
+// Turns values identifiers into registers:
+// constants occupy the first registers then
+// each instruction stores its result in the next one.
+// The operand of variables (pointer index or slot) is left as is,
+// so are the first operand and the offset of lists (their values
+// are turned into registers). Guards are turned into registers
+// too, -1 if none. The result is the last output.
+
+void EEProgramFinalize( EEProgram *program )
+{
+    EEInstruction *ins;
+    int32_t       *call;
+    int32_t       count,
+                  i,
+                  k;
+
+    #define EERegister(value) ( (value) < 0 ? -1 - (value) : program->constantsCount + (value) )
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        ins = &program->instructions[ i ];
+
+        ins->guard = ins->guard == EENoValue ? -1 : EERegister( ins->guard );
+
+        if( EEOpcodeListed( ins->opcode ) )
+        {
+            call = &program->arguments[ ins->b ];
+            for( k = 1; k <= call[ 0 ]; k++ ) call[ k ] = EERegister( call[ k ] );
+            continue;
+        }
+
+        if( ins->opcode != EOVar && ins->opcode != EOSlt )
+        {
+            ins->a = EERegister( ins->a );
+        }
+        ins->b = EERegister( ins->b );
+    }
+
+    for( k = 0; k < program->outputsCount; k++ )
+    {
+        program->outputs[ k ] = EERegister( program->outputs[ k ] );
+    }
+
+    program->result = program->outputs[ program->outputsCount - 1 ];
+
+    #undef EERegister
+
+    // Registers of large programs (and the spill area of their
+    // native code, see EEJitExecute()), allocated once.
+    // If there is no memory each execution allocates them.
+
+    count = program->constantsCount + program->instructionsCount + ( program->outputsCount > 1 ? program->outputsCount : 0 );
+
+    if( count > EEStackRegisters )
+    {
+        program->registers = malloc( count * sizeof( double ) );
+        if( program->registers && program->constantsCount )
+        {
+            memcpy( program->registers, program->constants, program->constantsCount * sizeof( double ) );
+        }
+    }
+}
+
+
+
+// Takes the registers allocated by EEProgramFinalize() for an execution,
+// constants loaded (instructions don't write them). Programs can be
+// executed by several threads at once: only one execution at a time
+// takes them, the others (and those of programs without registers)
+// get NULL and allocate their own.
+// The registers are given back by EEProgramReturn().
+
+double *EEProgramRegisters( const EEProgram *program )
+{
+    if( ! program->registers ) return NULL;
+
+    #if defined( __GNUC__ ) || defined( __clang__ )
+        if( __atomic_exchange_n( (int32_t *)&program->registersTaken, 1, __ATOMIC_ACQUIRE ) == 0 )
+        {
+            return program->registers;
+        }
+    #endif
+
+    return NULL;
+}
+
+
+
+void EEProgramReturn( const EEProgram *program )
+{
+    #if defined( __GNUC__ ) || defined( __clang__ )
+        __atomic_store_n( (int32_t *)&program->registersTaken, 0, __ATOMIC_RELEASE );
+    #endif
+}
+
+
+
+// Returns the number of registers an opcode reads (0, 1 or 2).
+// Variables read a pointer or a slot, not a register;
+// calls and selections read the registers listed in the arguments
+// of the program (see EEOpcodeListed()).
+
+int EEOpcodeOperands( EEOpcode opcode )
+{
+    switch( opcode )
+    {
+        case EOAdd:
+        case EOSub:
+        case EOMul:
+        case EODiv:
+        case EOPow:
+        case EOLgb:
+        case EOMax:
+        case EOMin:
+        case EOLt:
+        case EOLe:
+        case EOEq:
+        case EONe:
+        case EOAnd:
+        case EOOr:
+            return 2;
+
+        case EOVar:
+        case EOSlt:
+        case EOCall:
+        case EOSel:
+            return 0;
+
+        default:
+            return 1;
+    }
+}
+
+
+
+// Tells if an opcode reads a list of registers: the count then
+// the registers, at offset `b` in the arguments of the program.
+
+bool EEOpcodeListed( EEOpcode opcode )
+{
+    return opcode == EOCall || opcode == EOSel;
+}
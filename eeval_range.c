@@ -0,0 +1,572 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_range.c
+//
+//  range analysis of a compiled program: removes
+//  the checks that can never fail
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+// Results of math functions are widened by this fraction of their
+// value: the C library and the vector kernels (see eeval_vector.c)
+// differ from the exact results by a few ULP
+
+#define EERangeMargin 0x1p-40
+
+// Periodic functions are analyzed on arguments up to this magnitude
+// (beyond the range is the whole image of the function)
+
+#define EERangePeriodicMax 0x1p20
+
+
+
+// Computes the range of each value of a program from the ranges of
+// its variables (interval arithmetic) and removes the checks that
+// can never fail: a result that is always finite is not checked for
+// exceptions, a division whose divisor can't be zero and a factorial
+// whose operand can't be negative don't test their operand.
+// `ranges[ k ]` is the range of `symbols->variables[ k ]`; variables
+// without a symbol table or ranges (NULL) can take any value.
+// A value that passed a check is finite from then on: `sin(x)`
+// is not checked once `x` is.
+// The program must be executed only with values of the variables
+// within their ranges: outside results may be NaN or infinite
+// instead of failing.
+// The checks removed are listed in `*report` (if not NULL): the list
+// must be released with free().
+// If the program was translated into native code it is translated again.
+// Returns false (and the program is left as is) if the program is not
+// compiled or memory can't be allocated.
+
+bool EEAnalyzeRanges( EEProgram       *program, // the compiled program
+                      const EESymbols *symbols, // the symbol table it was compiled with (can be NULL)
+                      const EERange   *ranges,  // the range of each variable of the symbol table (can be NULL)
+                      EERangeReport   *report ) // RETURN: the checks removed (can be NULL)
+{
+    EERange       *range;
+    EERangeCheck  *removed;
+    EEInstruction *ins;
+    EERange       r;
+    int32_t       checks,
+                  count,
+                  i,
+                  k;
+
+    if( report )
+    {
+        memset( report, 0, sizeof( EERangeReport ) );
+    }
+
+    if( ! program->expression ) return false;
+
+    range   = malloc( ( program->constantsCount + program->instructionsCount + 1 ) * sizeof( EERange ) );
+    removed = malloc( ( program->instructionsCount * 2 + 1 ) * sizeof( EERangeCheck ) );
+
+    if( ! range || ! removed )
+    {
+        free( range );
+        free( removed );
+        return false;
+    }
+
+    for( k = 0; k < program->constantsCount; k++ )
+    {
+        range[ k ].min = range[ k ].max = program->constants[ k ];
+        range[ k ].nan = isnan( program->constants[ k ] );
+    }
+
+    checks = count = 0;
+
+    for( i = 0; i < program->instructionsCount; i++ )
+    {
+        ins = &program->instructions[ i ];
+
+        r = EERangeInstruction( program, ins, range, symbols, ranges );
+
+        // Division by zero and factorial of negative numbers
+
+        if( ( ins->opcode == EODiv || ins->opcode == EOFct ) && ! ins->safe )
+        {
+            checks++;
+
+            if( ins->opcode == EODiv ? range[ ins->b ].min > 0 || range[ ins->b ].max < 0 : range[ ins->a ].min >= 0 )
+            {
+                ins->safe = true;
+                removed[ count ].position = ins->position;
+                removed[ count ].error = ins->opcode == EODiv ? EBDivision : EBFactorial;
+                count++;
+            }
+        }
+
+        // Exceptions: once checked the value is finite
+        // (the following instructions are executed only if the check passes)
+
+        if( ins->check != ECNone )
+        {
+            checks++;
+
+            if( ! r.nan && r.min >= -DBL_MAX && r.max <= DBL_MAX && r.min <= r.max )
+            {
+                removed[ count ].position = ins->position;
+                removed[ count ].error = ins->check == ECTooBig ? EBTooBig : EBComplex;
+                count++;
+
+                ins->check = ECNone;
+            }
+            else if( eeval_catch_fp_exceptions && fmax( r.min, -DBL_MAX ) <= fmin( r.max, DBL_MAX ) )
+            {
+                r.min = fmax( r.min, -DBL_MAX );
+                r.max = fmin( r.max, DBL_MAX );
+                r.nan = false;
+
+                // (if checked whenever `a` is computed: the same guard)
+
+                if( ins->opcode == EOChk && ins->guard == program->instructions[ ins->a - program->constantsCount ].guard )
+                {
+                    range[ ins->a ] = r;
+                }
+            }
+        }
+
+        range[ program->constantsCount + i ] = r;
+    }
+
+    free( range );
+
+    // The native code still has the checks
+
+    if( count > 0 && program->native )
+    {
+        EEJitRelease( program );
+        EEJitCompile( program );
+    }
+
+    if( report && count > 0 )
+    {
+        report->checks = checks;
+        report->removedCount = count;
+        report->removed = removed;
+    }
+    else
+    {
+        if( report ) report->checks = checks;
+        free( removed );
+    }
+
+    return true;
+}
+
+
+
+// ***********************
+// PRIVATE FUNCTIONS BELOW
+// ***********************
+
+
+
+// Returns the range of the result of an instruction
+// from the ranges of its operands.
+
+EERange EERangeInstruction( const EEProgram     *program,
+                            const EEInstruction *ins,
+                            const EERange       *range,   // of the values computed so far
+                            const EESymbols     *symbols,
+                            const EERange       *ranges ) // of the variables
+{
+    EERange a,
+            b,
+            r;
+    int32_t k;
+
+    a = EEOpcodeOperands( ins->opcode ) >= 1 ? range[ ins->a ] : EERangeAny();
+    b = EEOpcodeOperands( ins->opcode ) == 2 ? range[ ins->b ] : EERangeAny();
+
+    switch( ins->opcode )
+    {
+        case EOAdd:
+            r.min = a.min + b.min;
+            r.max = a.max + b.max;
+            r.nan = a.nan || b.nan || ( a.max == INFINITY && b.min == -INFINITY ) || ( a.min == -INFINITY && b.max == INFINITY );
+            return EERangeWiden( r );
+
+        case EOSub:
+            r.min = a.min - b.max;
+            r.max = a.max - b.min;
+            r.nan = a.nan || b.nan || ( a.max == INFINITY && b.max == INFINITY ) || ( a.min == -INFINITY && b.min == -INFINITY );
+            return EERangeWiden( r );
+
+        case EOMul:
+            r = EERangeCorners( EOMul, a, b );
+            r.nan = r.nan || ( a.min <= 0 && a.max >= 0 && ( b.min == -INFINITY || b.max == INFINITY ) ) ||
+                             ( b.min <= 0 && b.max >= 0 && ( a.min == -INFINITY || a.max == INFINITY ) );
+            return r;
+
+        case EODiv:
+            return EERangeDivision( a, b );
+
+        case EONeg:
+            r.min = -a.max;
+            r.max = -a.min;
+            r.nan = a.nan;
+            return r;
+
+        case EOPow:
+            return EERangePower( a, b );
+
+        case EOFct:
+            // gamma(a + 1) decreases to 0.8856... at a = 0.4616... then increases
+            // (negative operands fail)
+            a.min = fmax( a.min, 0 );
+            if( a.min > a.max ) return EERangeAny();
+            r.min = a.min >= 0.5 ? EEFactorial( a.min ) : 0.885;
+            r.max = fmax( EEFactorial( a.min ), EEFactorial( a.max ) );
+            r.nan = a.nan;
+            return EERangeWiden( r );
+
+        case EOSin:
+            return EERangePeriodic( a, sin, M_PI / 2, 2 * M_PI );
+
+        case EOCos:
+            return EERangePeriodic( a, cos, 0, 2 * M_PI );
+
+        case EOTan:
+            // Increasing between the poles (π/2 + kπ)
+            r.nan = a.nan || a.min == -INFINITY || a.max == INFINITY;
+            if( ! r.nan && a.max <= EERangePeriodicMax && a.min >= -EERangePeriodicMax && ! EERangeContains( a, M_PI / 2, M_PI ) )
+            {
+                r.min = tan( a.min );
+                r.max = tan( a.max );
+                return EERangeWiden( r );
+            }
+            r.min = -DBL_MAX;
+            r.max = DBL_MAX;
+            return r;
+
+        case EOASi:
+        case EOACo:
+            r.nan = a.nan || a.min < -1 || a.max > 1;
+            a.min = fmax( a.min, -1 );
+            a.max = fmin( a.max, 1 );
+            if( a.min > a.max )
+            {
+                a.min = -1;
+                a.max = 1;
+            }
+            r.min = ins->opcode == EOASi ? asin( a.min ) : acos( a.max );
+            r.max = ins->opcode == EOASi ? asin( a.max ) : acos( a.min );
+            return EERangeWiden( r );
+
+        case EOATa:
+            r.min = atan( a.min );
+            r.max = atan( a.max );
+            r.nan = a.nan;
+            return EERangeWiden( r );
+
+        case EOExp:
+            r.min = exp( a.min );
+            r.max = exp( a.max );
+            r.nan = a.nan;
+            return EERangeWiden( r );
+
+        case EOLog:
+            return EERangeLog( a );
+
+        case EOSqt:
+            r.min = sqrt( fmax( a.min, 0 ) );
+            r.max = sqrt( fmax( a.max, 0 ) );
+            r.nan = a.nan || a.min < 0;
+            return EERangeWiden( r );
+
+        case EOLgb:
+            // log(b) / log(a)
+            a = EERangeLog( a );
+            b = EERangeLog( b );
+            if( a.min <= 0 && a.max >= 0 ) return EERangeAny();
+            return EERangeWiden( EERangeDivision( b, a ) );
+
+        case EOMax:
+        case EOMin:
+            // b > a ? b : a (b < a ? b : a): NaN only if `a` is,
+            // `a` if `b` is NaN
+            r.min = ins->opcode == EOMax ? fmax( a.min, b.min ) : fmin( a.min, b.min );
+            r.max = ins->opcode == EOMax ? fmax( a.max, b.max ) : fmin( a.max, b.max );
+            r.nan = a.nan;
+            if( b.nan )
+            {
+                r.min = fmin( r.min, a.min );
+                r.max = fmax( r.max, a.max );
+            }
+            return r;
+
+        case EOVar:
+        case EOSlt:
+            for( k = 0; symbols && ranges && k < symbols->count; k++ )
+            {
+                if( ins->opcode == EOVar ? symbols->variables[ k ].pointer == program->pointers[ ins->a ]
+                                         : ! symbols->variables[ k ].pointer && symbols->variables[ k ].slot == ins->a )
+                {
+                    return ranges[ k ];
+                }
+            }
+            return EERangeAny();
+
+        case EOChk:
+            return a;
+
+        case EOLt:
+        case EOLe:
+        case EOEq:
+        case EONe:
+        case EONot:
+        case EOAnd:
+        case EOOr:
+            r.min = 0;
+            r.max = 1;
+            r.nan = false;
+            return r;
+
+        case EOSel:
+            // either branch
+            a = range[ program->arguments[ ins->b + 2 ] ];
+            b = range[ program->arguments[ ins->b + 3 ] ];
+            r.min = fmin( a.min, b.min );
+            r.max = fmax( a.max, b.max );
+            r.nan = a.nan || b.nan;
+            return r;
+    }
+
+    return EERangeAny();
+}
+
+
+
+// Any value (NaN included)
+
+EERange EERangeAny( void )
+{
+    EERange r;
+
+    r.min = -INFINITY;
+    r.max = INFINITY;
+    r.nan = true;
+
+    return r;
+}
+
+
+
+// The range of `a` `opcode` `b` (product, quotient or power) where
+// the opcode is monotonic in each operand: the smallest and the largest
+// results at the corners (NaN ones left out).
+
+EERange EERangeCorners( EEOpcode opcode, EERange a, EERange b )
+{
+    EERange r;
+    double  corners[ 4 ];
+    int     k;
+
+    if( opcode == EOMul )
+    {
+        corners[ 0 ] = a.min * b.min;
+        corners[ 1 ] = a.min * b.max;
+        corners[ 2 ] = a.max * b.min;
+        corners[ 3 ] = a.max * b.max;
+    }
+    else if( opcode == EODiv )
+    {
+        corners[ 0 ] = a.min / b.min;
+        corners[ 1 ] = a.min / b.max;
+        corners[ 2 ] = a.max / b.min;
+        corners[ 3 ] = a.max / b.max;
+    }
+    else
+    {
+        corners[ 0 ] = EEPower( a.min, b.min );
+        corners[ 1 ] = EEPower( a.min, b.max );
+        corners[ 2 ] = EEPower( a.max, b.min );
+        corners[ 3 ] = EEPower( a.max, b.max );
+    }
+
+    r.min = INFINITY;
+    r.max = -INFINITY;
+    r.nan = a.nan || b.nan;
+
+    for( k = 0; k < 4; k++ )
+    {
+        r.min = fmin( r.min, corners[ k ] );
+        r.max = fmax( r.max, corners[ k ] );
+    }
+
+    if( r.min > r.max )
+    {
+        r.min = -INFINITY;
+        r.max = INFINITY;
+    }
+
+    return r;
+}
+
+
+
+// The range of `a` / `b`
+// (dividing by zero fails: 0 / 0 is never computed)
+
+EERange EERangeDivision( EERange a, EERange b )
+{
+    EERange r;
+
+    if( b.min <= 0 && b.max >= 0 )
+    {
+        r.min = -INFINITY;
+        r.max = INFINITY;
+        r.nan = a.nan || b.nan;
+    }
+    else
+    {
+        r = EERangeCorners( EODiv, a, b );
+    }
+
+    r.nan = r.nan || ( ( a.min == -INFINITY || a.max == INFINITY ) && ( b.min == -INFINITY || b.max == INFINITY ) );
+
+    return r;
+}
+
+
+
+// The range of `a` ^ `b` (see EEPower())
+
+EERange EERangePower( EERange a, EERange b )
+{
+    EERange r;
+    double  n;
+
+    // Base not negative: b * log(a) is bilinear in b and log(a)
+    // (0 ^ b is infinite for negative b)
+
+    if( a.min >= 0 && ( a.min > 0 || b.min >= 0 ) )
+    {
+        return EERangeWiden( EERangeCorners( EOPow, a, b ) );
+    }
+
+    // Negative base: only integer exponents
+
+    n = b.min;
+
+    if( b.min == b.max && ! b.nan && n == floor( n ) && fabs( n ) < 0x1p53 )
+    {
+        if( n < 0 && a.min <= 0 && a.max >= 0 )
+        {
+            r.min = -INFINITY;
+            r.max = INFINITY;
+            r.nan = a.nan;
+            return r;
+        }
+
+        r.min = fmin( EEPower( a.min, n ), EEPower( a.max, n ) );
+        r.max = fmax( EEPower( a.min, n ), EEPower( a.max, n ) );
+        r.nan = a.nan;
+
+        if( fmod( n, 2 ) == 0 && a.min < 0 && a.max > 0 )
+        {
+            r.min = 0;
+        }
+
+        return EERangeWiden( r );
+    }
+
+    return EERangeAny();
+}
+
+
+
+// The range of log( `a` )
+
+EERange EERangeLog( EERange a )
+{
+    EERange r;
+
+    r.min = a.min > 0 ? log( a.min ) : -INFINITY;
+    r.max = a.max > 0 ? log( a.max ) : -INFINITY;
+    r.nan = a.nan || a.min < 0;
+
+    return EERangeWiden( r );
+}
+
+
+
+// The range of sin( `a` ) or cos( `a` ) (`f`): the values at the ends
+// of `a`, 1 if a peak is within `a` and -1 if a trough is
+// (peaks are at `peak` + 2kπ, troughs half a period after).
+
+EERange EERangePeriodic( EERange a, double (*f)( double ), double peak, double period )
+{
+    EERange r;
+
+    r.nan = a.nan || a.min == -INFINITY || a.max == INFINITY;
+
+    if( r.nan || a.min < -EERangePeriodicMax || a.max > EERangePeriodicMax || a.max - a.min >= period )
+    {
+        r.min = -1;
+        r.max = 1;
+        return EERangeWiden( r );
+    }
+
+    r.min = fmin( f( a.min ), f( a.max ) );
+    r.max = fmax( f( a.min ), f( a.max ) );
+
+    if( EERangeContains( a, peak, period ) ) r.max = 1;
+    if( EERangeContains( a, peak + period / 2, period ) ) r.min = -1;
+
+    return EERangeWiden( r );
+}
+
+
+
+// Tells if `a` may contain `point` + k * `period` for some integer k
+// (with a margin for the rounding of π)
+
+bool EERangeContains( EERange a, double point, double period )
+{
+    double k;
+
+    k = ceil( ( a.min - point ) / period - 1e-6 );
+
+    return point + k * period <= a.max + 1e-6 * period;
+}
+
+
+
+// Widens a range by EERangeMargin of its ends
+// (an undefined end, such as infinity minus infinity, is infinite)
+
+EERange EERangeWiden( EERange r )
+{
+    if( isnan( r.min ) ) r.min = -INFINITY;
+    if( isnan( r.max ) ) r.max = INFINITY;
+
+    if( isfinite( r.min ) ) r.min -= fabs( r.min ) * EERangeMargin;
+    if( isfinite( r.max ) ) r.max += fabs( r.max ) * EERangeMargin;
+
+    return r;
+}
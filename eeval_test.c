@@ -34,9 +34,12 @@
 
 void EEvalExecuteTests()
 {
-    double b,
-           e,
-           r;
+    EEvaluation     eval;
+    double          b,
+                    e,
+                    r,
+                    result;
+    volatile double n;
 
     // Plus and minus (unary/binary) mixing cases
 
@@ -48,6 +51,9 @@ void EEvalExecuteTests()
     EEValTest( __LINE__, EEvalSuccess, 6,       "+2*(+3)" );    //
     EEValTest( __LINE__, EEvalSuccess, -3,      "1*-3" );       //
     EEValTest( __LINE__, EEvalSuccess, 6,       "2*+3" );       //
+    EEValTest( __LINE__, EEvalSuccess, 0,       "-0" );         // +0: sums start from 0, compiled programs too
+    EEValTest( __LINE__, EEvalSuccess, 0,       "0*-3" );       //
+    EEValTest( __LINE__, EEvalSuccess, 0,       "-1e-300*1e-300" ); // underflow
     EEValTest( __LINE__, EEvalFailure, 0,       "-+3" );        // *
     EEValTest( __LINE__, EEvalFailure, 0,       "+-3" );        // *
     EEValTest( __LINE__, EEvalFailure, 0,       "2++2" );       // * two plus as consecutive binary and unary operators not allowed
@@ -66,6 +72,12 @@ void EEvalExecuteTests()
     EEValTest( __LINE__, EEvalSuccess, 0.12,    "12E-2" );
     EEValTest( __LINE__, EEvalSuccess, 12,      "12E0" );
     EEValTest( __LINE__, EEvalSuccess, 254,     "0xfE" );
+    EEValTest( __LINE__, EEvalSuccess, 0.25,    "0.2500000000000000000000000000000000000000000000000000000000000000000000" );
+    EEValTest( __LINE__, EEvalSuccess, 12,      "0x1.8p3" );
+    EEValTest( __LINE__, EEvalSuccess, 9007199254740992.0, "9007199254740993" );   // half-way: to even
+    EEValTest( __LINE__, EEvalSuccess, 2.2250738585072011e-308, "2.2250738585072011e-308" );
+    EEValTest( __LINE__, EEvalSuccess, 0.1,     "0.1000000000000000055511151231257827021181583404541015625000000000000001" );
+    EEValTest( __LINE__, EEvalFailure, 0,       "1e400" );      // * too big
     EEValTest( __LINE__, EEvalFailure, 0,       "12a0" );
     EEValTest( __LINE__, EEvalFailure, 0,       "12E2.5");      // * decimal exponent not allowed
     EEValTest( __LINE__, EEvalFailure, 0,       ".-2" );        // * not a number
@@ -217,6 +229,53 @@ void EEvalExecuteTests()
     EEValTest( __LINE__, EEvalSuccess, -6,  "-3!" );    // -(3!)
     #endif
 
+    // Comparisons, && and || (1 if true, 0 if false) and if():
+    // the operand or the branch not needed is not computed
+
+    EEValTest( __LINE__, EEvalSuccess, 1,   "1<2" );
+    EEValTest( __LINE__, EEvalSuccess, 0,   "2<=1" );
+    EEValTest( __LINE__, EEvalSuccess, 1,   "3>2" );
+    EEValTest( __LINE__, EEvalSuccess, 0,   "3>=4" );
+    EEValTest( __LINE__, EEvalSuccess, 1,   "2==2" );
+    EEValTest( __LINE__, EEvalSuccess, 1,   "5!=3" );           // not equal (not 5! = 3)
+    EEValTest( __LINE__, EEvalSuccess, 1,   "1+2<2*2" );        // + - < comparisons < && < ||
+    EEValTest( __LINE__, EEvalSuccess, 1,   "1<2 && 2<3" );
+    EEValTest( __LINE__, EEvalSuccess, 1,   "0 && 1 || 2" );
+    EEValTest( __LINE__, EEvalSuccess, 1,   "2 || 0 && 0" );
+    EEValTest( __LINE__, EEvalSuccess, -2,  "-(2>1)*2" );
+    EEValTest( __LINE__, EEvalSuccess, 1,   "(1<2)<3" );
+    EEValTest( __LINE__, EEvalSuccess, 2,   "if(1<2, 2, 3)" );
+    EEValTest( __LINE__, EEvalSuccess, 3,   "if(0, 2, 3)" );
+    EEValTest( __LINE__, EEvalSuccess, 4,   "if(1, if(0, 1, 4), 5)" );
+    EEValTest( __LINE__, EEvalSuccess, 2,   "if(1, 2, 1/0)" );  // not computed
+    EEValTest( __LINE__, EEvalSuccess, 3,   "if(0, (-1)!, 3)" );
+    EEValTest( __LINE__, EEvalSuccess, 5,   "if(0, if(1, 1/0, 2), 5)" );
+    EEValTest( __LINE__, EEvalSuccess, 0,   "0 && 1/0" );
+    EEValTest( __LINE__, EEvalSuccess, 1,   "1 || log(0)" );
+    EEValTest( __LINE__, EEvalSuccess, 0,   "0 && (1 || 1/0) && 9^9^9" );
+    EEValTest( __LINE__, EEvalFailure, 0,   "if(1, 1/0, 2)" );  // * division by zero (taken)
+    EEValTest( __LINE__, EEvalFailure, 0,   "1 && 1/0" );       // *
+    EEValTest( __LINE__, EEvalFailure, 0,   "0 && (1" );        // * not computed but parsed
+    EEValTest( __LINE__, EEvalFailure, 0,   "if(0, 1e400, 2)" );// * value is too big
+    EEValTest( __LINE__, EEvalFailure, 0,   "1<2<3" );          // * comparisons are not chained
+    EEValTest( __LINE__, EEvalFailure, 0,   "1=2" );            // *
+    EEValTest( __LINE__, EEvalFailure, 0,   "1&2" );            // *
+    EEValTest( __LINE__, EEvalFailure, 0,   "<1" );             // * expected value
+    EEValTest( __LINE__, EEvalFailure, 0,   "if(1, 2)" );       // * too few parameters
+    EEValTest( __LINE__, EEvalFailure, 0,   "if(1, 2, 3, 4)" ); // * too many parameters
+
+
+    // Nesting up to the limit (brackets, functions, exponents)
+
+    EEValTestNesting( __LINE__, EEvalSuccess, 1, "(",    "1", ")", eeval_max_depth );
+    EEValTestNesting( __LINE__, EEvalFailure, 0, "(",    "1", ")", eeval_max_depth + 1 );     // * too deep
+    EEValTestNesting( __LINE__, EEvalSuccess, 0, "sin(", "0", ")", eeval_max_depth );
+    EEValTestNesting( __LINE__, EEvalFailure, 0, "sin(", "0", ")", eeval_max_depth + 1 );     // *
+    EEValTestNesting( __LINE__, EEvalSuccess, 1, "1^",   "1", "",  eeval_max_depth );
+    EEValTestNesting( __LINE__, EEvalFailure, 0, "1^",   "1", "",  eeval_max_depth + 1 );     // *
+    EEValTestNesting( __LINE__, EEvalSuccess, 2, "(1+max(0,1^", "1", "))", eeval_max_depth / 3 );
+    EEValTestNesting( __LINE__, EEvalFailure, 0, "(",    "1", "",  eeval_max_depth * 10 );    // * too deep before the end
+
 
     // Whitespace (with some of the above)
 
@@ -271,8 +330,295 @@ void EEvalExecuteTests()
     EEValTest( __LINE__, EEvalFailure, 0, "max(-(9^9^9),9^9^9" );                   // * huge
     EEValTest( __LINE__, EEvalFailure, 0, "min(-(9^9^9),9^9^9" );                   // * huge
     EEValTest( __LINE__, EEvalFailure, 0, "pow(9,pow(9,9))" );                      // * huge
+
+    // The same exceptions caught at the end, or not caught
+
+    EEValTestPolicy( __LINE__, EPDeferred, EEvalFailure, 0, "exp(1000)" );          // * huge
+    EEValTestPolicy( __LINE__, EPDeferred, EEvalFailure, 0, "1/exp(1000)" );        // * huge (the result is not)
+    EEValTestPolicy( __LINE__, EPDeferred, EEvalFailure, 0, "log(0)" );             // * huge
+    EEValTestPolicy( __LINE__, EPDeferred, EEvalFailure, 0, "max(1,log(-1))" );     // * complex (the result is not)
+    EEValTestPolicy( __LINE__, EPDeferred, EEvalSuccess, 0, "0.5^1e30+fact(0)-1" );
+    EEValTestPolicy( __LINE__, EPOff,      EEvalSuccess, INFINITY, "exp(1000)" );
+    EEValTestPolicy( __LINE__, EPOff,      EEvalSuccess, 0, "1/exp(1000)" );
+    EEValTestPolicy( __LINE__, EPOff,      EEvalSuccess, 1, "max(1,log(-1))" );
+    EEValTestPolicy( __LINE__, EPDeferred, EEvalSuccess, 1, "1 || exp(1000)" );    // not computed
+    EEValTestPolicy( __LINE__, EPDeferred, EEvalFailure, 0, "0 || exp(1000)" );    // * huge
+    #endif
+
+    EEValTestPolicy( __LINE__, EPStrict,   EEvalSuccess, 5, "2+3" );
+    EEValTestPolicy( __LINE__, EPDeferred, EEvalSuccess, 5, "2+3" );
+    EEValTestPolicy( __LINE__, EPOff,      EEvalSuccess, 5, "2+3" );
+    EEValTestPolicy( __LINE__, EPOff,      EEvalFailure, 0, "1/0" );                // * division by zero (whatever the policy)
+    EEValTestPolicy( __LINE__, EPOff,      EEvalFailure, 0, "(-1)!" );              // * negative factorial
+    EEValTestPolicy( __LINE__, EPOff,      EEvalFailure, 0, "1e400" );              // * value is too big
+
+    // Variables (compiled expressions only): x is bound by pointer,
+    // rate, t0 and pi2 are bound to slots 0, 1 and 2 (.05, 3 and 6.28)
+
+    EEValTestVariables( __LINE__, EEvalSuccess, 6,          "x*3",              2 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 7,          "x*3",              7/3.0 );    // pointer is read on each execution
+    EEValTestVariables( __LINE__, EEvalSuccess, .05*3,      "rate*t0",          0 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 3.14,       "pi2/2",            0 );        // identifier beginning with a constant name
+    EEValTestVariables( __LINE__, EEvalSuccess, sin(1)-1,   "sin(x)-x",         1 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 0,          "x*-3",             0 );        // +0, as EEvaluate() gives
+    EEValTestVariables( __LINE__, EEvalSuccess, 0,          "-x",               0 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 0,          "-x;x*-1",          0 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 3,          "max(x, rate, t0)", 2 );
+    EEValTestVariables( __LINE__, EEvalSuccess, -8,         "-x^3",             2 );
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "y",                0 );        // * unknown identifier
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x1",               0 );        // * unknown identifier
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "2x",               0 );        // *
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "sinx",             0 );        // *
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "1/x",              0 );        // * division by zero
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "(-x)!",            1 );        // * negative factorial
+    #if eeval_catch_fp_exceptions
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x",                INFINITY ); // * huge
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x^2",              NAN );      // * not a number
+    #endif
+
+    EEValTestVariables( __LINE__, EEvalSuccess, 0,          "if(x!=0, 1/x, 0)", 0 );        // not computed (guarded)
+    EEValTestVariables( __LINE__, EEvalSuccess, .5,         "if(x!=0, 1/x, 0)", 2 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 0,          "x>0 && log(x)>1",  -1 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 1,          "x<=0 || fact(x-1)>1", -3 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 6,          "if(x<1, (-x)!, x!)", -3 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 1,          "if(rate<t0 && t0<pi2, 1, 1/0)", 0 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 2,          "if(x, x*2, 1/x)+if(x, x*2, 1/x)-2", 1 );  // merged under the same guard
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "if(x<1, 1/x, x)",  0 );        // * division by zero (taken)
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x || 1/x",         0 );        // * division by zero
+    #if eeval_catch_fp_exceptions
+    EEValTestVariables( __LINE__, EEvalSuccess, 0,          "x<1 && exp(x)>1",  1000 );
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x<1 || exp(x)>1",  1000 );     // * huge
+    #endif
+
+    // Optimized programs: folded constants, dropped identities, flattened
+    // max()/min() and common sub-expressions keep results and errors
+
+    EEValTestVariables( __LINE__, EEvalSuccess, 2*log(8)/log(2)*M_PI/180, "x*log(2,8)*pi/180", 2 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 7,          "x*1+0+4!/4-0",     1 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 5,          "1*x^1/1",          5 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 3,          "max(max(x,1),2,3)", 0 );
+    EEValTestVariables( __LINE__, EEvalSuccess, -1,         "min(3,x,min(1,-1))", 2 );
+    EEValTestVariables( __LINE__, EEvalSuccess, pow(sin(30*M_PI/180),2)+pow(cos(30*M_PI/180),2), "sin(x*pi/180)^2+cos(x*pi/180)^2", 30 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 2*.05+.05*2+2*.05, "x*rate+rate*x+x*rate", 2 );
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x+1/(2-2)",        1 );        // * division by zero (not folded)
+    #if eeval_catch_fp_exceptions
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x*9^9^9",          1 );        // * huge (not folded)
+    #endif
+    #if ! eeval_strength_reduction
+    EEValTest( __LINE__, EEvalSuccess, pow( 3.141592653589793, 4 ), "pi^4" );            // pow() as EEvaluate(), not products
+    EEValTest( __LINE__, EEvalSuccess, pow( 3.141592653589793, 0.5 ), "pi^0.5" );
+    n = 13;
+    EEValTest( __LINE__, EEvalSuccess, tgamma( n ), "12!" );                 // the C library (not folded by the compiler)
+    n = 21;
+    EEValTestVariables( __LINE__, EEvalSuccess, tgamma( n ), "(x+18)!", 2 );
+    EEValTestVariables( __LINE__, EEvalSuccess, pow( 1.1, 3 ) + pow( 1.1, 0.5 ), "x^3+x^0.5", 1.1 );
+    #endif
+    #if eeval_strength_reduction
+    EEValTestVariables( __LINE__, EEvalSuccess, 1.1*1.1*1.1+sqrt(1.1), "x^3+x^0.5", 1.1 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 2432902008176640000.0, "(x+18)!", 2 );
+    #if eeval_catch_fp_exceptions
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x^2+x^4",          1e100 );    // * huge (product)
+    #endif
+    #endif
+    #if eeval_catch_fp_exceptions
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "x*1",              INFINITY ); // * huge
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "(x+0)^1",          NAN );      // * not a number
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "2^x-x*2^x",        INFINITY ); // * huge (checked once computed)
+    #endif
+
+    // Batch evaluation: the same variables as above,
+    // slots are columns of values (some rows fail)
+
+    EEValTestBatch( __LINE__, "rate*t0+pi2" );
+    EEValTestBatch( __LINE__, "1/rate" );                           // division by zero
+    EEValTestBatch( __LINE__, "rate!+fact(pi2)" );                  // negative factorial
+    EEValTestBatch( __LINE__, "log(t0)*sin(x)" );                   // complex
+    EEValTestBatch( __LINE__, "pi2^t0-t0^2" );                      // huge
+    EEValTestBatch( __LINE__, "max(rate,t0,pi2)-avg(rate,t0,x)" );
+    EEValTestBatch( __LINE__, "pow(rate,2)+log(2,pi2+1)/x" );
+    EEValTestBatch( __LINE__, "-rate^2*(rate-t0)/(pi2+t0)" );
+    EEValTestBatch( __LINE__, "sin(rate*t0)^2+t0*rate-sin(t0*rate)" ); // common sub-expressions
+    EEValTestBatch( __LINE__, "t0" );
+    EEValTestBatch( __LINE__, "x" );
+    EEValTestBatch( __LINE__, "2" );
+    EEValTestBatch( __LINE__, "-rate*0" );                          // never -0
+    EEValTestBatch( __LINE__, "if(rate!=0, 1/rate, t0)" );          // both branches, errors of the taken one
+    EEValTestBatch( __LINE__, "if(rate>0, log(rate), (-rate)!)+pi2" );
+    EEValTestBatch( __LINE__, "rate>=0 && t0<0 || 1/rate>t0" );     // division by zero
+    EEValTestBatch( __LINE__, "if(t0>0, 10^t0, 1/rate)" );          // huge, division by zero
+
+    // Statements (compiled expressions only): values bound by `let` or
+    // named are shared by the statements that follow, each statement
+    // that is not a `let` is an output (the last one is the result)
+
+    EEValTestOutputs( __LINE__, EEvalSuccess, "let t = x*2; a = t+1; t-1",          3,  "a -",      (double[]){ 7, 5 } );
+    EEValTestOutputs( __LINE__, EEvalSuccess, "a = x; b = a*rate; c = b+a",         2,  "a b c",    (double[]){ 2, .1, 2.1 } );
+    EEValTestOutputs( __LINE__, EEvalSuccess, "let r = 1+rate; r^t0; r^(t0*2);",    0,  "- -",      (double[]){ pow( 1.05, 3 ), pow( 1.05, 6 ) } );
+    EEValTestOutputs( __LINE__, EEvalSuccess, " x*2 ",                              4,  "-",        (double[]){ 8 } );
+    EEValTestOutputs( __LINE__, EEvalSuccess, "let let = 2; let*x",                 4,  "-",        (double[]){ 8 } );     // `let` not followed by a name
+    EEValTestOutputs( __LINE__, EEvalSuccess, "one = 1; two = one+1; two == 2",     0,  "one two -",(double[]){ 1, 2, 1 } );
+    EEValTestOutputs( __LINE__, EEvalSuccess, "let s = sin(x); s^2+cos(x)^2; s",    1,  "- -",      (double[]){ pow( sin( 1 ), 2 ) + pow( cos( 1 ), 2 ), sin( 1 ) } );
+    EEValTestOutputs( __LINE__, EEvalFailure, "y = 1/x; z = 2",                     0,  "y z",      (double[]){ 0, 0 } );  // * division by zero: no outputs
+    EEValTestOutputs( __LINE__, EEvalFailure, "let a = 1",                          0,  NULL,       NULL );                // * missing output
+    EEValTestOutputs( __LINE__, EEvalFailure, "let a = 1; let a = 2; a",            0,  NULL,       NULL );                // * name already in use
+    EEValTestOutputs( __LINE__, EEvalFailure, "x = 2; x",                           0,  NULL,       NULL );                // * a variable
+    EEValTestOutputs( __LINE__, EEvalFailure, "let pi = 3; pi",                     0,  NULL,       NULL );                // * a constant
+    EEValTestOutputs( __LINE__, EEvalFailure, "let sin = 3; 2",                     0,  NULL,       NULL );                // * a function
+    EEValTestOutputs( __LINE__, EEvalFailure, "let a 3; a",                         0,  NULL,       NULL );                // * expected =
+    EEValTestOutputs( __LINE__, EEvalFailure, "let a == 3; a",                      0,  NULL,       NULL );                // *
+    EEValTestOutputs( __LINE__, EEvalFailure, "let a = (1; a)",                     0,  NULL,       NULL );                // * statements end at `;`
+    EEValTestOutputs( __LINE__, EEvalFailure, "1;;2",                               0,  NULL,       NULL );                // * expected value
+    EEValTestOutputs( __LINE__, EEvalFailure, "b = a; a = 1",                       0,  NULL,       NULL );                // * bound later
+    EEValTestOutputs( __LINE__, EEvalFailure, "",                                   0,  NULL,       NULL );                // * expected value
+
+    // EEvaluate() evaluates a single expression
+
+    if( EEvaluate( &eval, "1;2", &result ) == EEvalSuccess || EEvaluate( &eval, "let a = 1; a", &result ) == EEvalSuccess )
+    {
+        printf( "Test at line number %d failed\n\n", __LINE__ );
+        exit( 1 );
+    }
+
+    EEValTestVariables( __LINE__, EEvalSuccess, 2*9,        "let a = x+1; let b = a*a; b+b", 2 );
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "let a = 1/x; 2",   0 );        // * division by zero (computed anyway)
+    EEValTestVariables( __LINE__, EEvalSuccess, 0,          "let a = x!=0; if(a, 1/x, 0)", 0 );
+
+    EEValTestBatch( __LINE__, "let u = rate*t0; v = u+pi2; w = sin(u)*v; v-w" );
+    EEValTestBatch( __LINE__, "let d = 1/rate; d+t0" );                     // division by zero
+    EEValTestBatch( __LINE__, "a = t0^2; b = if(rate, a/rate, -a); b*x" );
+
+    // Range analysis: checks that can't fail are removed
+    // (results and errors stay the same within the ranges)
+
+    EEValTestRanges( __LINE__, "sin(x)+cos(y)",         0.5,  2,    5, 5 );
+    EEValTestRanges( __LINE__, "1/(x+1)",               0,    10,   4, 4 );
+    EEValTestRanges( __LINE__, "1/(x+1)",               -1,   1,    4, 2 );     // * division by zero
+    EEValTestRanges( __LINE__, "1/sin(x)",              0.5,  2,    4, 4 );
+    EEValTestRanges( __LINE__, "1/sin(x)",              0,    10,   4, 2 );     // * division by zero
+    EEValTestRanges( __LINE__, "fact(x)+y!",            0.5,  2,    6, 6 );
+    EEValTestRanges( __LINE__, "fact(x)+y!",            -1,   1,    6, 4 );     // * negative factorial
+    EEValTestRanges( __LINE__, "exp(x)*y",              0,    10,   3, 3 );
+    EEValTestRanges( __LINE__, "exp(x)*y",              0,    1000, 3, 1 );     // * huge
+    EEValTestRanges( __LINE__, "x^y",                   0,    10,   2, 2 );
+    EEValTestRanges( __LINE__, "x^y",                   -1,   1,    2, 1 );     // * complex
+    EEValTestRanges( __LINE__, "log(2,x)",              0,    10,   2, 1 );     // * huge
+    EEValTestRanges( __LINE__, "x^2+y^3",               -INFINITY, INFINITY, 3, 0 ); // * huge
+    EEValTestRanges( __LINE__, "if(x<y, 1/x, 1/y)",     0.5,  2,    7, 7 );
+    EEValTestRanges( __LINE__, "if(x>0, 1/x, 1)",       -1,   1,    4, 2 );     // division by zero kept (conditions don't narrow x)
+    #if eeval_catch_fp_exceptions
+    EEValTestRanges( __LINE__, "sin(x)+cos(y)",         -INFINITY, INFINITY, 5, 3 ); // x and y checked: finite
+    EEValTestRanges( __LINE__, "tan(x)",                -INFINITY, INFINITY, 2, 1 );
+    EEValTestRanges( __LINE__, "asin(x)+acos(y)",       0.5,  2,    5, 3 );     // * complex
     #endif
 
+    // Compiled expressions cache: threads evaluating the same expressions
+    // while programs are evicted (the cache holds only a few of them)
+
+    EEValTestCache( __LINE__, 4 );
+    EEValTestCacheSymbols( __LINE__ );
+
+    // Programs too large for registers on the stack, shared by threads
+
+    EEValTestRegisters( __LINE__, 4 );
+
+    // Numbers bound to slots (see EEBindNumbers()): nothing left to fold
+
+    EEValTestBind( __LINE__, "1+2",                     "x0+x1" );
+    EEValTestBind( __LINE__, " sin( pi / 2 ) * 1e3 ",   " sin( x0 / x1 ) * x2 " );
+    EEValTestBind( __LINE__, "max(e,3!,-0.5)^2",        "max(x0,x1!,-x2)^x3" );
+    EEValTestBind( __LINE__, "4",                       "x0" );
+
+    // Statistics (if compiled in): tokens, depth, powers and factorials counted
+
+    EEValTestStats( __LINE__, "2^3+fact(3)*(1+2)",  15, 1, 1, 1 );
+    EEValTestStats( __LINE__, "sin(pi)-cos(0)^0.5", 12, 1, 1, 0 );
+    EEValTestStats( __LINE__, "((((1))))",          10, 4, 0, 0 );
+    EEValTestStats( __LINE__, "0&&2^3||fact(3)",    11, 2, 0, 1 );  // the power is not computed
+
+    // Registered functions: hypot(x, y), sum(...) of any number of arguments
+    // (computed in batch by its own function); names must be free identifiers
+
+    if( ! EERegisterFunction( "hypot", 2, EEValTestHypot, NULL ) ||
+        ! EERegisterFunction( "sum", EEVariadic, EEValTestSum, EEValTestSumBatch ) ||
+        EERegisterFunction( "hypot", 1, EEValTestHypot, NULL ) ||            // taken
+        EERegisterFunction( "sin", 1, EEValTestHypot, NULL ) ||              // keyword
+        EERegisterFunction( "pi", 1, EEValTestHypot, NULL ) ||
+        EERegisterFunction( "2x", 1, EEValTestHypot, NULL ) ||               // not an identifier
+        EERegisterFunction( "", 1, EEValTestHypot, NULL ) ||
+        EERegisterFunction( "f", 0, EEValTestHypot, NULL ) ||                // no arguments
+        EERegisterFunction( "f", eeval_max_arguments + 1, EEValTestHypot, NULL ) ||
+        EERegisterFunction( "f", 1, NULL, NULL ) )
+    {
+        printf( "Test at line number %d failed\n\n", __LINE__ );
+        printf( "Unexpected result of EERegisterFunction()\n\n" );
+        exit( 1 );
+    }
+
+    EEValTest( __LINE__, EEvalSuccess, 5,       "hypot(3,4)" );
+    EEValTest( __LINE__, EEvalSuccess, 10,      "sum(1,2,3,4)" );
+    EEValTest( __LINE__, EEvalSuccess, 7,       "sum(7)" );
+    EEValTest( __LINE__, EEvalSuccess, 15,      "sum(hypot(3,4),2*sum(1),pow(2,3))" );   // nested calls
+    EEValTest( __LINE__, EEvalSuccess, 10,      "hypot(6,8)+sum(1,2)-sum(1,2)" );        // not merged
+    EEValTest( __LINE__, EEvalSuccess, 0,       "sum(1,2)-sum(1,2)" );
+    EEValTest( __LINE__, EEvalFailure, 0,       "hypot(1e200,1e200)" );  // * huge
+    EEValTest( __LINE__, EEvalFailure, 0,       "hypot(1/0,1)" );        // * division by zero
+    EEValTest( __LINE__, EEvalFailure, 0,       "hypot(3)" );            // * too few parameters
+    EEValTest( __LINE__, EEvalFailure, 0,       "hypot(3,4,5)" );        // * too many parameters
+    EEValTest( __LINE__, EEvalFailure, 0,       "sum()" );               // * empty function
+    EEValTest( __LINE__, EEvalFailure, 0,       "sum 2" );               // *
+    EEValTest( __LINE__, EEvalFailure, 0,       "hypots(3,4)" );         // * unknown identifier
+
+    EEValTestArguments( __LINE__, EEvalSuccess, eeval_max_arguments );
+    EEValTestArguments( __LINE__, EEvalFailure, eeval_max_arguments + 1 );    // * too many arguments
+
+    EEValTestVariables( __LINE__, EEvalSuccess, 40,         "hypot(x,3)*sum(x,x)",  4 );
+    EEValTestVariables( __LINE__, EEvalSuccess, 8,          "sum(x,t0,rate*20)",    4 );
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "hypot(x,1)",           NAN );  // * not a number
+
+    EEValTestBatch( __LINE__, "sum(rate,t0,pi2)*hypot(rate,x)" );
+    EEValTestBatch( __LINE__, "sum(1/rate,t0)+hypot(t0,t0)" );                // division by zero
+    EEValTestBatch( __LINE__, "hypot(10^t0,1)-sum(pi2,pi2,x)" );              // huge
+
+    // ...and take precedence over variables
+
+    if( ! EERegisterFunction( "pi2", 1, EEValTestSum, NULL ) )
+    {
+        printf( "Test at line number %d failed\n\n", __LINE__ );
+        printf( "Unexpected result of EERegisterFunction()\n\n" );
+        exit( 1 );
+    }
+
+    EEValTestVariables( __LINE__, EEvalSuccess, 8,          "pi2(x)*2",             4 );
+    EEValTestVariables( __LINE__, EEvalFailure, 0,          "pi2/2",                0 );    // * a function
+
+    // Functions are not called in the operands and branches not computed
+    // by EEvaluate(), EEExecute() and native code (batch calls them)
+
+    if( ! EERegisterFunction( "count", 1, EEValTestCount, NULL ) )
+    {
+        printf( "Test at line number %d failed\n\n", __LINE__ );
+        printf( "Unexpected result of EERegisterFunction()\n\n" );
+        exit( 1 );
+    }
+
+    EEValTestCalls( __LINE__, "if(0, count(1), count(2))",      1 );
+    EEValTestCalls( __LINE__, "if(1<2, count(1)*count(2), 3)",  2 );
+    EEValTestCalls( __LINE__, "0 && count(1)",                  0 );
+    EEValTestCalls( __LINE__, "count(0) || count(1) || 2",      2 );
+    EEValTestCalls( __LINE__, "count(1) || count(1) && 2",      1 );
+    EEValTestCalls( __LINE__, "if(count(0), if(1, count(1), 2), count(3)+count(4))", 3 );
+    EEValTestCalls( __LINE__, "if(count(0), if(count(1), count(2), count(3)), count(4))", 2 );
+    EEValTestCalls( __LINE__, "if(count(1), if(count(0), count(2), count(3)), count(4))", 3 );
+    EEValTestCalls( __LINE__, "count(1) && (count(0) || count(1))", 3 );
+    EEValTestCalls( __LINE__, "if(count(0)*2, sin(count(1)), 2^count(3)) + count(4)", 3 );
+
+    // Models: only the formulas downstream of the cells changed are
+    // recomputed (count() calls), by many threads the same values
+
+    EEValTestModel( __LINE__ );
+    EEValTestModelGroups( __LINE__, 1 );
+    EEValTestModelGroups( __LINE__, 4 );
+
     // All tests passed
 
     printf( "All tests passed\n");
@@ -280,21 +626,101 @@ void EEvalExecuteTests()
 
 
 
+// Tells if a result is the expected one, zeros included:
+// results are never -0 (EEvaluate() computes them as sums from 0)
+
+bool EEValTestSame( double result, double expected )
+{
+    return result == expected && signbit( result ) == signbit( expected );
+}
+
+
+
 //
-// Test function: compare expected status and result with those generated by EEvaluate().
+// Test function: compare expected status and result with those generated by EEvaluate(),
+// by EEvaluateN() on the expression followed by more characters (which must not be read)
+// and by the same expression compiled with EECompile() and executed with EEExecute(),
+// interpreted, translated into native code by EEJitCompile() and kept by EEvaluateCached().
 //
 
 void EEValTest( int lineNumber, EEvalStatus expectedStatus, double expectedResult, char *expression )
 {
     EEvaluation eval;
     EEvalStatus status;
+    EEProgram   program;
     double      result;
+    const char  *method;
+    char        text[ 256 ];
+    size_t      length;
 
+    method = "EEvaluate";
     status = EEvaluate( &eval, expression, &result );
 
-    if( status == expectedStatus && result == expectedResult ) return;
+    length = strlen( expression );
 
-    printf( "Test at line number %d failed\n\n", lineNumber );
+    if( status == expectedStatus && EEValTestSame( result, expectedResult ) && length + 8 < sizeof( text ) )
+    {
+        method = "EEvaluateN";
+        memcpy( text, expression, length );
+        memcpy( text + length, "99e9+x(", 8 );
+        status = EEvaluateN( &eval, text, length, &result );
+    }
+
+    // Exceptions caught at the end: the same status and result
+
+    if( status == expectedStatus && EEValTestSame( result, expectedResult ) )
+    {
+        method = "EEvaluatePolicy (deferred)";
+        status = EEvaluatePolicy( &eval, expression, length, EPDeferred, &result );
+    }
+
+    if( status == expectedStatus && EEValTestSame( result, expectedResult ) )
+    {
+        method = "EECompile/EEExecute";
+        status = EECompile( &eval, expression, NULL, &program );
+        if( status == EEvalSuccess )
+        {
+            status = EEExecute( &eval, &program, NULL, &result );
+            EEFreeProgram( &program );
+        }
+        else
+        {
+            result = 0;
+        }
+
+        if( status == expectedStatus && EEValTestSame( result, expectedResult ) )
+        {
+            method = "EECompile/EEJitCompile/EEExecute";
+            status = EECompile( &eval, expression, NULL, &program );
+            if( status == EEvalSuccess )
+            {
+                EEJitCompile( &program );
+                status = EEExecute( &eval, &program, NULL, &result );
+                EEFreeProgram( &program );
+            }
+            else
+            {
+                result = 0;
+            }
+
+            // Twice: compiled then found in the cache
+
+            if( status == expectedStatus && EEValTestSame( result, expectedResult ) )
+            {
+                method = "EEvaluateCached";
+                status = EEvaluateCached( &eval, expression, NULL, NULL, &result );
+
+                if( status == expectedStatus && EEValTestSame( result, expectedResult ) )
+                {
+                    status = EEvaluateCached( &eval, expression, NULL, NULL, &result );
+
+                    if( status == expectedStatus && EEValTestSame( result, expectedResult ) ) return;
+                }
+            }
+        }
+    }
+
+    printf( "Test at line number %d failed (%s)\n\n", lineNumber, method );
     printf( "Expression: %s\n\n", expression );
     printf( "Expected status is: %s\n", expectedStatus == EEvalSuccess ? "success" : "failure" );
     printf( "Test     status is: %s\n\n",       status == EEvalSuccess ? "success" : "failure" );
@@ -309,4 +735,1171 @@ void EEValTest( int lineNumber, EEvalStatus expectedStatus, double expectedResul
 
     exit( 1 );
 }
-#endif
\ No newline at end of file
+
+
+
+//
+// Test function: compiles the expression with a symbol table, sets the variable `x` and executes
+// the program, interpreted then translated into native code. Compare expected status and result
+// with those generated by EEExecute().
+//
+
+void EEValTestVariables( int lineNumber, EEvalStatus expectedStatus, double expectedResult, char *expression, double x )
+{
+    EEvaluation eval;
+    EEvalStatus status;
+    EEProgram   program;
+    double      result;
+    int         jit;
+
+    double      slots[] = { .05, 3, 6.28 };
+
+    EEVariable  variables[] =
+    {
+        { "x",    &x,   0 },
+        { "rate", NULL, 0 },
+        { "t0",   NULL, 1 },
+        { "pi2",  NULL, 2 }
+    };
+
+    EESymbols   symbols = { variables, 4 };
+
+    for( jit = 0; jit < 2; jit++ )
+    {
+        status = EECompile( &eval, expression, &symbols, &program );
+        if( status == EEvalSuccess )
+        {
+            if( jit ) EEJitCompile( &program );
+            status = EEExecute( &eval, &program, slots, &result );
+            EEFreeProgram( &program );
+        }
+        else
+        {
+            result = 0;
+        }
+
+        if( status != expectedStatus || ! EEValTestSame( result, expectedResult ) ) break;
+    }
+
+    if( jit == 2 ) return;
+
+    printf( "Test at line number %d failed%s\n\n", lineNumber, jit ? " (native code)" : "" );
+    printf( "Expression: %s (x = %f)\n\n", expression, x );
+    printf( "Expected status is: %s\n", expectedStatus == EEvalSuccess ? "success" : "failure" );
+    printf( "Test     status is: %s\n\n",       status == EEvalSuccess ? "success" : "failure" );
+    printf( "Expected result is: %f\n", expectedResult );
+    printf( "Test     result is: %f\n\n", result );
+    if( status == EEvalFailure )
+    {
+        printf( "Error:\n" );
+        EEPrintError( &eval );
+        printf( "\n" );
+    }
+
+    exit( 1 );
+}
+
+
+
+//
+// Test function: executes the expression with EEvaluateBatch() over a number
+// of rows then compare status and result of each row with those generated
+// by EEExecute() with the same values.
+//
+
+void EEValTestBatch( int lineNumber, char *expression )
+{
+    EEvaluation eval;
+    EEvalStatus status;
+    EEProgram   program;
+    double      result;
+    double      x;
+    double      slots[ 3 ];
+    double      rate[ 1000 ],
+                t0[ 1000 ],
+                pi2[ 1000 ];
+    double      out[ 1000 ];
+    uint8_t     err[ 1000 ];
+    size_t      i;
+
+    const double *columns[] = { rate, t0, pi2 };
+
+    EEVariable  variables[] =
+    {
+        { "x",    &x,   0 },
+        { "rate", NULL, 0 },
+        { "t0",   NULL, 1 },
+        { "pi2",  NULL, 2 }
+    };
+
+    EESymbols   symbols = { variables, 4 };
+
+    x = 1.5;
+
+    for( i = 0; i < 1000; i++ )
+    {
+        rate[ i ] = (double)( i % 7 ) - 3;
+        t0[ i ]   = i * .5 - 100;
+        pi2[ i ]  = i / 10.0;
+    }
+
+    if( EECompile( &eval, expression, &symbols, &program ) == EEvalFailure ||
+        EEvaluateBatch( &program, columns, 1000, out, err ) == EEvalFailure )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expression: %s\n\n", expression );
+        printf( "Batch evaluation failed\n\n" );
+        exit( 1 );
+    }
+
+    for( i = 0; i < 1000; i++ )
+    {
+        slots[ 0 ] = rate[ i ];
+        slots[ 1 ] = t0[ i ];
+        slots[ 2 ] = pi2[ i ];
+
+        status = EEExecute( &eval, &program, slots, &result );
+
+        // vectorized functions may differ from the C math library by a few ULP
+
+        if( ( status == EEvalSuccess ) != ( err[ i ] == EBNone ) ||
+            ( eeval_vector_math ? fabs( result - out[ i ] ) > 1e-12 * fmax( 1, fabs( result ) ) : result != out[ i ] ) ||
+            ( result == 0 && signbit( result ) != signbit( out[ i ] ) ) )
+        {
+            printf( "Test at line number %d failed\n\n", lineNumber );
+            printf( "Expression: %s (row %zu)\n\n", expression, i );
+            printf( "Expected status is: %s\n", status == EEvalSuccess ? "success" : "failure" );
+            printf( "Batch    status is: %s\n\n", err[ i ] == EBNone ? "success" : "failure" );
+            printf( "Expected result is: %f\n", result );
+            printf( "Batch    result is: %f\n\n", out[ i ] );
+            exit( 1 );
+        }
+    }
+
+    EEFreeProgram( &program );
+}
+
+
+
+//
+// Test function: compiles the expression with the variables `x` (by pointer) and `y` (slot)
+// within [min, max], analyzes the ranges and compares the checks and those removed with the
+// expected ones, then executes the program with and without the analysis (interpreted,
+// native code and in batch) for values of `x` and `y` within the range: results and errors
+// must be the same.
+//
+
+void EEValTestRanges( int lineNumber, char *expression, double min, double max, int32_t checks, int32_t removed )
+{
+    EEvaluation   eval;
+    EEProgram     program,
+                  analyzed;
+    EERangeReport report;
+    EEvalStatus   status,
+                  status2;
+    double        result,
+                  result2,
+                  x,
+                  y,
+                  low,
+                  high;
+    double        column[ 81 ],
+                  out[ 81 ],
+                  out2[ 81 ];
+    uint8_t       err[ 81 ],
+                  err2[ 81 ];
+    int           i,
+                  jit;
+
+    const double  *columns[] = { column };
+
+    EEVariable  variables[] =
+    {
+        { "x", &x,   0 },
+        { "y", NULL, 0 }
+    };
+
+    EESymbols   symbols = { variables, 2 };
+
+    EERange     ranges[] =
+    {
+        { min, max, false },
+        { min, max, false }
+    };
+
+    if( EECompile( &eval, expression, &symbols, &program ) == EEvalFailure ||
+        EECompile( &eval, expression, &symbols, &analyzed ) == EEvalFailure ||
+        ! EEAnalyzeRanges( &analyzed, &symbols, ranges, &report ) )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expression: %s\n\n", expression );
+        printf( "Compilation or analysis failed\n\n" );
+        exit( 1 );
+    }
+
+    if( report.checks != checks || report.removedCount != removed )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expression: %s (x, y in [%g, %g])\n\n", expression, min, max );
+        printf( "Expected checks: %d, removed %d\n", checks, removed );
+        printf( "Test     checks: %d, removed %d\n\n", report.checks, report.removedCount );
+        exit( 1 );
+    }
+
+    free( report.removed );
+
+    // Infinite ends are sampled at finite values
+
+    low  = isfinite( min ) ? min : -1e10;
+    high = isfinite( max ) ? max : 1e10;
+
+    for( jit = 0; jit < 2; jit++ )
+    {
+        if( jit )
+        {
+            EEJitCompile( &program );
+            EEJitCompile( &analyzed );
+        }
+
+        for( i = 0; i < 81; i++ )
+        {
+            x = low + ( high - low ) * ( i / 9 ) / 8;
+            y = low + ( high - low ) * ( i % 9 ) / 8;
+            column[ i ] = y;
+
+            status  = EEExecute( &eval, &program, &y, &result );
+            status2 = EEExecute( &eval, &analyzed, &y, &result2 );
+
+            if( status != status2 || ( result != result2 && ! ( isnan( result ) && isnan( result2 ) ) ) )
+            {
+                printf( "Test at line number %d failed (%s)\n\n", lineNumber, jit ? "native code" : "interpreted" );
+                printf( "Expression: %s (x = %g, y = %g)\n\n", expression, x, y );
+                printf( "Expected status is: %s\n", status == EEvalSuccess ? "success" : "failure" );
+                printf( "Analyzed status is: %s\n\n", status2 == EEvalSuccess ? "success" : "failure" );
+                printf( "Expected result is: %f\n", result );
+                printf( "Analyzed result is: %f\n\n", result2 );
+                exit( 1 );
+            }
+        }
+    }
+
+    // In batch (`x` is the last value)
+
+    EEvaluateBatch( &program, columns, 81, out, err );
+    EEvaluateBatch( &analyzed, columns, 81, out2, err2 );
+
+    if( memcmp( out, out2, sizeof( out ) ) != 0 || memcmp( err, err2, sizeof( err ) ) != 0 )
+    {
+        printf( "Test at line number %d failed (batch)\n\n", lineNumber );
+        printf( "Expression: %s\n\n", expression );
+        exit( 1 );
+    }
+
+    EEFreeProgram( &program );
+    EEFreeProgram( &analyzed );
+}
+
+
+
+//
+// Test function: a number of threads evaluate a set of expressions with EEvaluateCached()
+// under a small memory cap, then compare results, errors and counters with those expected.
+//
+
+#if eeval_cache
+
+void *EEValTestCacheThread( void *argument )
+{
+    EEvaluation eval;
+    EEvalStatus status;
+    double      result,
+                expected;
+    int         i,
+                k;
+    char        expression[ 64 ];
+
+    *(int *)argument = 0;
+
+    for( i = 0; i < 20000; i++ )
+    {
+        // Half of the evaluations use a few hot expressions
+
+        k = i % 2 ? i % 8 : i % 300;
+
+        snprintf( expression, sizeof( expression ), k % 5 ? "sin(%d)*2^%d+1/(%d-7)" : "%d/0+%d*%d", k, k % 7, k % 13 );
+
+        status = EEvaluateCached( &eval, expression, NULL, NULL, &result );
+        expected = k % 5 ? sin( k ) * EEPower( 2, k % 7 ) + 1.0 / ( k % 13 - 7 ) : 0;
+
+        if( status != ( k % 5 && k % 13 != 7 ? EEvalSuccess : EEvalFailure ) ||
+            ( status == EEvalSuccess && result != expected ) ||
+            ( status == EEvalFailure && ( eval.expression != expression || strcmp( eval.error, "division by zero" ) != 0 ) ) )
+        {
+            *(int *)argument = i + 1;
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+#endif
+
+
+
+void EEValTestCache( int lineNumber, int threadsCount )
+{
+#if eeval_cache
+    pthread_t    threads[ 16 ];
+    int          failed[ 16 ];
+    EECacheStats stats;
+    int          k;
+
+    EECacheFlush();
+    EECacheLimit( 16 * 1024 );
+
+    for( k = 0; k < threadsCount; k++ )
+    {
+        pthread_create( &threads[ k ], NULL, EEValTestCacheThread, &failed[ k ] );
+    }
+
+    for( k = 0; k < threadsCount; k++ )
+    {
+        pthread_join( threads[ k ], NULL );
+    }
+
+    EECacheStatistics( &stats );
+
+    for( k = 0; k < threadsCount; k++ )
+    {
+        if( failed[ k ] )
+        {
+            printf( "Test at line number %d failed\n\n", lineNumber );
+            printf( "Thread %d, evaluation %d\n\n", k, failed[ k ] - 1 );
+            exit( 1 );
+        }
+    }
+
+    if( stats.hits + stats.misses != (uint64_t)threadsCount * 20000 || stats.hits == 0 || stats.evictions == 0 || stats.memory > stats.limit )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Counters: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " evictions, %zu bytes (limit %zu)\n\n",
+                stats.hits, stats.misses, stats.evictions, stats.memory, stats.limit );
+        exit( 1 );
+    }
+
+    EECacheLimit( eeval_cache_memory );
+    EECacheFlush();
+#endif
+}
+
+
+
+//
+// Test function: a program with more registers than the stack holds
+// (allocated once, when it's compiled) executed by several threads
+// at once, interpreted then as native code
+//
+
+#if eeval_cache
+
+const EEProgram *EEValTestRegistersProgram;
+
+void *EEValTestRegistersThread( void *argument )
+{
+    EEvaluation eval;
+    double      x,
+                result;
+    int         i;
+
+    x = *(int *)argument;
+    *(int *)argument = 0;
+
+    for( i = 0; i < 20000; i++ )
+    {
+        if( EEExecute( &eval, EEValTestRegistersProgram, &x, &result ) == EEvalFailure || result != x * 11325 )
+        {
+            *(int *)argument = i + 1;
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+#endif
+
+void EEValTestRegisters( int lineNumber, int threadsCount )
+{
+    EEvaluation eval;
+    EEProgram   program;
+    double      x,
+                result;
+    char        expression[ 2048 ];
+    size_t      used;
+    int         failed[ 16 ],
+                jit,
+                k;
+#if eeval_cache
+    pthread_t   threads[ 16 ];
+    int         created;
+#endif
+
+    EEVariable  variables[] = { { "x", NULL, 0 } };
+    EESymbols   symbols = { variables, 1 };
+
+    // x*1+x*2+...+x*150 = 11325 x: 300 instructions
+
+    for( used = 0, k = 1; k <= 150; k++ )
+    {
+        used += snprintf( expression + used, sizeof( expression ) - used, "%sx*%d", k > 1 ? "+" : "", k );
+    }
+
+    for( jit = 0; jit < 2; jit++ )
+    {
+        if( EECompile( &eval, expression, &symbols, &program ) == EEvalFailure || ! program.registers )
+        {
+            printf( "Test at line number %d failed\n\n", lineNumber );
+            printf( "The program has no registers\n\n" );
+            exit( 1 );
+        }
+
+        if( jit ) EEJitCompile( &program );
+
+        // Once alone (the registers are taken and given back), then by threads
+
+        memset( failed, 0, sizeof( failed ) );
+
+        x = 2;
+        if( EEExecute( &eval, &program, &x, &result ) == EEvalFailure || result != x * 11325 || program.registersTaken )
+        {
+            failed[ 0 ] = 1;
+        }
+
+        #if eeval_cache
+            EEValTestRegistersProgram = &program;
+
+            created = failed[ 0 ] ? 0 : threadsCount;
+
+            for( k = 0; k < created; k++ )
+            {
+                failed[ k ] = k + 1;
+                pthread_create( &threads[ k ], NULL, EEValTestRegistersThread, &failed[ k ] );
+            }
+
+            for( k = 0; k < created; k++ )
+            {
+                pthread_join( threads[ k ], NULL );
+            }
+        #endif
+
+        EEFreeProgram( &program );
+
+        for( k = 0; k < 16; k++ )
+        {
+            if( failed[ k ] )
+            {
+                printf( "Test at line number %d failed%s\n\n", lineNumber, jit ? " (native code)" : "" );
+                printf( "Thread %d, execution %d\n\n", k, failed[ k ] - 1 );
+                exit( 1 );
+            }
+        }
+    }
+}
+
+
+
+//
+// Test function: programs are cached by the variables of the symbol table
+// their expression refers to (names, positions and bindings), not by the
+// address of the table: the same table changed between the calls (as a table
+// built on the stack by different functions) finds other programs, unless
+// only the variables the expression doesn't refer to changed.
+//
+
+void EEValTestCacheSymbols( int lineNumber )
+{
+    EEvaluation  eval;
+    EEvalStatus  status;
+    EECacheStats stats;
+    double       result;
+    double       slots[] = { 10, 20 };
+    uint64_t     hits;
+    int          k;
+
+    EEVariable   variables[ 2 ];
+    EESymbols    symbols = { variables, 2 };
+
+    struct { const char *first, *second; int32_t count; EEvalStatus status; double result; bool hit; } steps[] =
+    {
+        { "x", "y", 2, EEvalSuccess, 11, false },
+        { "y", "x", 2, EEvalSuccess, 21, false },   // x bound to another slot
+        { "y", "z", 2, EEvalFailure, 0,  false },   // * x not defined
+        { "x", "y", 1, EEvalSuccess, 11, true },    // one variable less (not x)
+        { "x", "z", 2, EEvalSuccess, 11, true },    // y renamed
+        { "y", "x", 2, EEvalSuccess, 21, true }     // found again
+    };
+
+    EECacheFlush();
+
+    hits = 0;
+
+    for( k = 0; k < (int)( sizeof( steps ) / sizeof( steps[ 0 ] ) ); k++ )
+    {
+        variables[ 0 ] = (EEVariable){ steps[ k ].first, NULL, 0 };
+        variables[ 1 ] = (EEVariable){ steps[ k ].second, NULL, 1 };
+        symbols.count = steps[ k ].count;
+
+        status = EEvaluateCached( &eval, "x+1", &symbols, slots, &result );
+
+        EECacheStatistics( &stats );
+
+        if( status != steps[ k ].status || result != steps[ k ].result || ( eeval_cache && stats.hits != hits + steps[ k ].hit ) )
+        {
+            printf( "Test at line number %d failed\n\n", lineNumber );
+            printf( "Step %d: expected %f (%s), test %f (%s, %s)\n\n", k, steps[ k ].result, steps[ k ].hit ? "hit" : "miss",
+                    result, status == EEvalSuccess ? "success" : eval.error, stats.hits != hits ? "hit" : "miss" );
+            exit( 1 );
+        }
+
+        hits = stats.hits;
+    }
+
+    // Names bound with `let` are not variables: `y` is found after them
+
+    variables[ 0 ] = (EEVariable){ "x", NULL, 0 };
+    variables[ 1 ] = (EEVariable){ "y", NULL, 1 };
+    symbols.count = 2;
+
+    EEvaluateCached( &eval, "let t = x; t + y", &symbols, slots, &result );
+    variables[ 1 ] = (EEVariable){ "y", NULL, 0 };
+    status = EEvaluateCached( &eval, "let t = x; t + y", &symbols, slots, &result );
+
+    if( status != EEvalSuccess || result != 20 )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expected 20, test %f\n\n", result );
+        exit( 1 );
+    }
+
+    EECacheFlush();
+}
+
+
+
+//
+// Test function: binds the numbers of an expression to slots, compares the
+// bound expression with the expected one and its program (which must have no
+// constants) with EEvaluate()
+//
+
+void EEValTestBind( int lineNumber, char *expression, const char *expected )
+{
+    EEvaluation eval;
+    EEBound     bound;
+    EEProgram   program;
+    double      result,
+                expectedResult;
+
+    EEvaluate( &eval, expression, &expectedResult );
+
+    if( ! EEBindNumbers( expression, &bound ) || strcmp( bound.expression, expected ) != 0 )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expected '%s', test '%s'\n\n", expected, bound.expression ? bound.expression : "(out of memory)" );
+        exit( 1 );
+    }
+
+    if( EECompile( &eval, bound.expression, &bound.symbols, &program ) == EEvalFailure ||
+        EEExecute( &eval, &program, bound.slots, &result ) == EEvalFailure ||
+        program.constantsCount != 0 || result != expectedResult )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expression '%s': expected %f, test %f\n\n", bound.expression, expectedResult, result );
+        exit( 1 );
+    }
+
+    EEFreeProgram( &program );
+    EEFreeBound( &bound );
+}
+
+
+
+void EEValTestNesting( int lineNumber, EEvalStatus expectedStatus, double expectedResult, const char *open, const char *value, const char *close, int depth )
+{
+    char   *expression;
+    size_t length;
+    int    k;
+
+    length = depth * ( strlen( open ) + strlen( close ) ) + strlen( value );
+
+    expression = malloc( length + 1 );
+    if( ! expression )
+    {
+        printf( "Test at line number %d failed: out of memory\n\n", lineNumber );
+        exit( 1 );
+    }
+
+    expression[ 0 ] = '\0';
+
+    for( k = 0; k < depth; k++ ) strcat( expression, open );
+    strcat( expression, value );
+    for( k = 0; k < depth; k++ ) strcat( expression, close );
+
+    EEValTest( lineNumber, expectedStatus, expectedResult, expression );
+
+    free( expression );
+}
+
+
+
+void EEValTestPolicy( int lineNumber, EEvalPolicy policy, EEvalStatus expectedStatus, double expectedResult, char *expression )
+{
+    EEvaluation eval;
+    EEvalStatus status;
+    double      result;
+
+    status = EEvaluatePolicy( &eval, expression, strlen( expression ), policy, &result );
+
+    if( status == expectedStatus && result == expectedResult ) return;
+
+    printf( "Test at line number %d failed (%s policy)\n\n", lineNumber, policy == EPStrict ? "strict" : policy == EPDeferred ? "deferred" : "off" );
+    printf( "Expression: %s\n\n", expression );
+    printf( "Expected status is: %s\n", expectedStatus == EEvalSuccess ? "success" : "failure" );
+    printf( "Test     status is: %s\n\n",       status == EEvalSuccess ? "success" : "failure" );
+    printf( "Expected result is: %f\n", expectedResult );
+    printf( "Test     result is: %f\n\n", result );
+    if( status == EEvalFailure )
+    {
+        printf( "Error:\n" );
+        EEPrintError( &eval );
+        printf( "\n" );
+    }
+
+    exit( 1 );
+}
+
+
+
+//
+// Test function: evaluates sum(1, 1, ...) of `count` arguments
+// (see EEValTest()).
+//
+
+void EEValTestArguments( int lineNumber, EEvalStatus expectedStatus, int count )
+{
+    char *expression;
+    int  k;
+
+    expression = malloc( 2 * count + 5 );
+    if( ! expression ) exit( 1 );
+
+    strcpy( expression, "sum(" );
+
+    for( k = 0; k < count; k++ )
+    {
+        strcpy( expression + 4 + 2 * k, k + 1 < count ? "1," : "1)" );
+    }
+
+    EEValTest( lineNumber, expectedStatus, expectedStatus == EEvalSuccess ? count : 0, expression );
+
+    free( expression );
+}
+
+
+
+// Registered functions of the tests: hypot(x, y), sum(...)
+// and its batch version (that adds in the same order)
+
+double EEValTestHypot( const double *arguments, int32_t count )
+{
+    return sqrt( arguments[ 0 ] * arguments[ 0 ] + arguments[ 1 ] * arguments[ 1 ] );
+}
+
+double EEValTestSum( const double *arguments, int32_t count )
+{
+    double  sum;
+    int32_t k;
+
+    sum = 0;
+
+    for( k = 0; k < count; k++ )
+    {
+        sum += arguments[ k ];
+    }
+
+    return sum;
+}
+
+void EEValTestSumBatch( const double * const *arguments, int32_t count, double *r, size_t m )
+{
+    int32_t k;
+    size_t  j;
+
+    for( j = 0; j < m; j++ )
+    {
+        r[ j ] = 0;
+    }
+
+    for( k = 0; k < count; k++ )
+    {
+        for( j = 0; j < m; j++ ) r[ j ] += arguments[ k ][ j ];
+    }
+}
+
+
+
+//
+// Test function: compiles a program of statements and executes it
+// (interpreted, native code and in batch over one row): the status
+// and the outputs (all of them, `expected`) must be those expected.
+// `names` lists the names of the outputs separated by blanks
+// ("-" if not named). The variables are those of EEValTestVariables().
+// Programs that fail to compile have NULL `names` and `expected`.
+//
+
+void EEValTestOutputs( int lineNumber, EEvalStatus expectedStatus, char *expression, double x, const char *names, const double *expected )
+{
+    EEvaluation eval;
+    EEvalStatus status;
+    EEProgram   program;
+    double      results[ 8 ],
+                rows[ 8 ];
+    double      *outs[ 8 ];
+    uint8_t     err;
+    const char  *name;
+    size_t      length;
+    int32_t     k;
+    int         pass;
+
+    double      slots[] = { .05, 3, 6.28 };
+
+    const double *columns[] = { &slots[ 0 ], &slots[ 1 ], &slots[ 2 ] };
+
+    EEVariable  variables[] =
+    {
+        { "x",    &x,   0 },
+        { "rate", NULL, 0 },
+        { "t0",   NULL, 1 },
+        { "pi2",  NULL, 2 }
+    };
+
+    EESymbols   symbols = { variables, 4 };
+
+    status = EECompile( &eval, expression, &symbols, &program );
+
+    if( status == EEvalFailure )
+    {
+        if( ! names && expectedStatus == EEvalFailure ) return;
+
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expression: %s\n\n", expression );
+        printf( "Compilation failed:\n" );
+        EEPrintError( &eval );
+        printf( "\n" );
+        exit( 1 );
+    }
+
+    // The names
+
+    name = names;
+
+    for( k = 0; k < program.outputsCount && name; k++ )
+    {
+        name += strspn( name, " " );
+        length = strcspn( name, " " );
+
+        if( length == 1 && *name == '-' ? program.names[ k ] != NULL :
+            ! program.names[ k ] || strlen( program.names[ k ] ) != length || strncmp( program.names[ k ], name, length ) != 0 ) break;
+
+        if( length > 1 || *name != '-' ? EEFindOutput( &program, program.names[ k ] ) != k : false ) break;
+
+        name += length;
+    }
+
+    if( ! name || k < program.outputsCount || name[ strspn( name, " " ) ] != '\0' || program.outputsCount > 8 )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expression: %s\n\n", expression );
+        printf( "Expected outputs: %s\n\n", names ? names : "(none: compilation fails)" );
+        exit( 1 );
+    }
+
+    // Interpreted, native code, batch
+
+    for( pass = 0; pass < 3; pass++ )
+    {
+        if( pass == 1 ) EEJitCompile( &program );
+
+        if( pass < 2 )
+        {
+            status = EEExecuteOutputs( &eval, &program, slots, results );
+        }
+        else
+        {
+            for( k = 0; k < program.outputsCount; k++ ) outs[ k ] = &rows[ k ];
+
+            if( EEvaluateBatchOutputs( &program, columns, 1, outs, &err ) == EEvalFailure ) break;
+
+            status = err == EBNone ? EEvalSuccess : EEvalFailure;
+            memcpy( results, rows, program.outputsCount * sizeof( double ) );
+        }
+
+        if( status != expectedStatus ) break;
+
+        for( k = 0; k < program.outputsCount; k++ )
+        {
+            if( fabs( results[ k ] - expected[ k ] ) > 1e-12 * fmax( 1, fabs( expected[ k ] ) ) ) break;
+        }
+
+        if( k < program.outputsCount ) break;
+    }
+
+    EEFreeProgram( &program );
+
+    if( pass == 3 ) return;
+
+    printf( "Test at line number %d failed%s\n\n", lineNumber, pass == 1 ? " (native code)" : pass == 2 ? " (batch)" : "" );
+    printf( "Expression: %s (x = %f)\n\n", expression, x );
+    printf( "Expected status is: %s\n", expectedStatus == EEvalSuccess ? "success" : "failure" );
+    printf( "Test     status is: %s\n\n",       status == EEvalSuccess ? "success" : "failure" );
+
+    for( k = 0; k < program.outputsCount; k++ )
+    {
+        printf( "Output %d: expected %f, test %f\n", k, expected[ k ], results[ k ] );
+    }
+
+    printf( "\n" );
+
+    exit( 1 );
+}
+
+
+
+//
+// Test function: counts the calls of count(x) by EEvaluate() and by EEExecute()
+// (interpreted) of the expression.
+//
+
+int EEValTestCounted;
+
+double EEValTestCount( const double *arguments, int32_t count )
+{
+    EEValTestCounted++;
+
+    return arguments[ 0 ];
+}
+
+void EEValTestCalls( int lineNumber, char *expression, int calls )
+{
+    EEvaluation eval;
+    EEProgram   program;
+    double      result;
+    int         compiled;
+
+    for( compiled = 0; compiled < 3; compiled++ )
+    {
+        EEValTestCounted = 0;
+
+        if( compiled )
+        {
+            if( EECompile( &eval, expression, NULL, &program ) != EEvalSuccess ) break;
+            if( compiled == 2 ) EEJitCompile( &program );
+            EEExecute( &eval, &program, NULL, &result );
+            EEFreeProgram( &program );
+        }
+        else
+        {
+            EEvaluate( &eval, expression, &result );
+        }
+
+        if( EEValTestCounted != calls ) break;
+    }
+
+    if( compiled == 3 ) return;
+
+    printf( "Test at line number %d failed%s\n\n", lineNumber, compiled == 2 ? " (native code)" : compiled ? " (compiled)" : "" );
+    printf( "Expression: %s\n\n", expression );
+    printf( "Expected calls: %d\n", calls );
+    printf( "Test     calls: %d\n\n", EEValTestCounted );
+
+    exit( 1 );
+}
+
+
+
+void EEValTestStats( int lineNumber, char *expression, uint64_t tokens, int64_t maxDepth, uint64_t powers, uint64_t factorials )
+{
+#if eeval_statistics
+    EEvaluation eval;
+    EEStats     total;
+    double      result;
+
+    memset( &total, 0, sizeof( EEStats ) );
+
+    EEvaluate( &eval, expression, &result );
+    EEStatsAdd( &total, &eval.stats );
+    EEvaluate( &eval, expression, &result );
+    EEStatsAdd( &total, &eval.stats );
+
+    if( total.evaluations != 2 || total.tokens != 2 * tokens || total.maxDepth != maxDepth || total.powers != 2 * powers || total.factorials != 2 * factorials ||
+        eval.depth != 0 || total.lexingTime > total.totalTime )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Expression: %s\n\n", expression );
+        printf( "Counters: %" PRIu64 " evaluations, %" PRIu64 " tokens, depth %" PRId64 ", %" PRIu64 " powers, %" PRIu64 " factorials\n\n",
+                total.evaluations, total.tokens, total.maxDepth, total.powers, total.factorials );
+        exit( 1 );
+    }
+#endif
+}
+
+
+
+//
+// Test function: a model of a few cells, defined, set and updated
+// step by step: the values (or the errors) of the cells and the
+// count() calls of each update must be those expected.
+//
+
+void EEValTestModel( int lineNumber )
+{
+    EEvaluation eval;
+    EEModel     model;
+
+    EEModelInit( &model );
+
+    // Formulas can refer to cells defined later
+
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "gain", "count(total - x)" ) );
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "total", "let g = (1 + rate)^t0; x*g" ) );
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "x", 100 ) );
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "rate", .05 ) );
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "t0", 2 ) );
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "y", 2 ) );
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "y2", "count(y^2)" ) );
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "mix", "gain + y2*y" ) );
+
+    EEValTestModelCell( __LINE__, &model, "mix", NULL, 0 );             // * not computed yet
+
+    EEValTestModelUpdate( __LINE__, &model, NULL, 2 );
+    EEValTestModelCell( __LINE__, &model, "total", NULL, 100 * 1.05 * 1.05 );
+    EEValTestModelCell( __LINE__, &model, "gain", NULL, 100 * 1.05 * 1.05 - 100 );
+    EEValTestModelCell( __LINE__, &model, "mix", NULL, 100 * 1.05 * 1.05 - 100 + 8 );
+    EEValTestModelCell( __LINE__, &model, "x", NULL, 100 );
+
+    EEValTestModelUpdate( __LINE__, &model, NULL, 0 );                  // nothing changed
+
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "y", 3 ) );
+    EEValTestModelUpdate( __LINE__, &model, NULL, 1 );                  // y2, mix (gain is not recomputed)
+    EEValTestModelCell( __LINE__, &model, "mix", NULL, 100 * 1.05 * 1.05 - 100 + 27 );
+
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "rate", 0 ) );
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "t0", 5 ) );
+    EEValTestModelUpdate( __LINE__, &model, NULL, 1 );                  // total, gain, mix
+    EEValTestModelCell( __LINE__, &model, "mix", NULL, 27 );
+
+    // Execution errors: the cells reading a cell that failed fail as well,
+    // the others are recomputed
+
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "inverse", "1/(x - 100)" ) );
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "twice", "y + inverse*2" ) );
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "y", 1 ) );
+    EEValTestModelUpdate( __LINE__, &model, "division by zero", 1 );
+    EEValTestModelCell( __LINE__, &model, "inverse", "division by zero", 0 );
+    EEValTestModelCell( __LINE__, &model, "twice", "refers to a cell that failed", 0 );
+    EEValTestModelCell( __LINE__, &model, "mix", NULL, 1 );
+
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "x", 104 ) );
+    EEValTestModelUpdate( __LINE__, &model, NULL, 1 );                  // gain (total is 104)
+    EEValTestModelCell( __LINE__, &model, "twice", NULL, 1.5 );
+    EEValTestModelCell( __LINE__, &model, "mix", NULL, 1 );
+
+    // Circular references and formulas that don't compile fail the
+    // update: nothing is recomputed until they are fixed
+
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "a", "b + 1" ) );
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "b", "c*2" ) );
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "c", "a - x" ) );
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "y", 2 ) );
+    EEValTestModelUpdate( __LINE__, &model, "circular reference", 0 );
+    EEValTestModelCell( __LINE__, &model, "y2", NULL, 1 );              // not yet recomputed
+
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "c", "5" ) );
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "d", "d + 1" ) );
+    EEValTestModelUpdate( __LINE__, &model, "circular reference", 0 );  // * itself
+
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "d", "a +" ) );
+    EEValTestModelUpdate( __LINE__, &model, "expected value", 0 );
+
+    EEValTestModelStep( __LINE__, EEModelDefine( &eval, &model, "d", "a + f" ) );
+    EEValTestModelUpdate( __LINE__, &model, "unexpected symbol", 0 );   // * f is not defined
+
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "f", 1 ) );
+    EEValTestModelUpdate( __LINE__, &model, NULL, 1 );                  // y2
+    EEValTestModelCell( __LINE__, &model, "a", NULL, 11 );
+    EEValTestModelCell( __LINE__, &model, "d", NULL, 12 );
+    EEValTestModelCell( __LINE__, &model, "mix", NULL, 8 );
+
+    // A formula replaced by an input
+
+    EEValTestModelStep( __LINE__, EEModelSet( &eval, &model, "y2", 10 ) );
+    EEValTestModelUpdate( __LINE__, &model, NULL, 0 );
+    EEValTestModelCell( __LINE__, &model, "mix", NULL, 20 );
+
+    // Names
+
+    if( EEModelDefine( &eval, &model, "sin", "1" ) == EEvalSuccess ||
+        EEModelSet( &eval, &model, "1a", 1 ) == EEvalSuccess ||
+        EEModelSet( &eval, &model, "", 1 ) == EEvalSuccess )
+    {
+        printf( "Test at line number %d failed\n\n", lineNumber );
+        printf( "Invalid names accepted\n\n" );
+        exit( 1 );
+    }
+
+    EEValTestModelCell( __LINE__, &model, "z", "unknown cell", 0 );
+
+    EEModelFree( &model );
+}
+
+
+
+void EEValTestModelStep( int lineNumber, EEvalStatus status )
+{
+    if( status == EEvalSuccess ) return;
+
+    printf( "Test at line number %d failed\n\n", lineNumber );
+    exit( 1 );
+}
+
+
+
+// The update fails with `error` (NULL if it succeeds) calling count() `calls` times
+
+void EEValTestModelUpdate( int lineNumber, EEModel *model, const char *error, int calls )
+{
+    EEvaluation eval;
+    EEvalStatus status;
+
+    EEValTestCounted = 0;
+    status = EEModelUpdate( &eval, model, 1 );
+
+    if( ( status == EEvalSuccess ) == ( error == NULL ) && ( ! error || strcmp( eval.error, error ) == 0 ) && EEValTestCounted == calls ) return;
+
+    printf( "Test at line number %d failed\n\n", lineNumber );
+    printf( "Expected: %s, %d calls\n", error ? error : "success", calls );
+    printf( "Update:   %s, %d calls\n\n", status == EEvalSuccess ? "success" : eval.error, EEValTestCounted );
+    if( status == EEvalFailure ) EEPrintError( &eval );
+    exit( 1 );
+}
+
+
+
+// The value of a cell is `value`, or it fails with `error`
+// (any error if `error` is NULL and `value` is 0: not computed)
+
+void EEValTestModelCell( int lineNumber, EEModel *model, const char *name, const char *error, double value )
+{
+    EEvaluation eval;
+    EEvalStatus status;
+    double      result;
+
+    status = EEModelValue( &eval, model, name, &result );
+
+    if( error ? status == EEvalFailure && strcmp( eval.error, error ) == 0 && result == 0 :
+        status == EEvalSuccess ? fabs( result - value ) <= 1e-12 * fmax( 1, fabs( value ) ) : value == 0 && result == 0 ) return;
+
+    printf( "Test at line number %d failed\n\n", lineNumber );
+    printf( "Cell %s: expected %s %f\n", name, error ? error : "", value );
+    printf( "Cell %s: test     %s %f\n\n", name, status == EEvalFailure ? eval.error : "", result );
+    exit( 1 );
+}
+
+
+
+//
+// Test function: a model of many cells in groups that don't read each
+// other (chains of 100 cells from 10 inputs, joined in pairs by 5 more
+// cells), updated by `jobs` threads: after each change of the inputs
+// the values must be those of a model built again from scratch.
+//
+
+void EEValTestModelGroups( int lineNumber, int32_t jobs )
+{
+    EEvaluation eval;
+    EEModel     model,
+                fresh;
+    char        name[ 32 ],
+                formula[ 64 ];
+    double      inputs[ 10 ],
+                a,
+                b;
+    int         step,
+                k;
+
+    EEModelInit( &model );
+
+    for( k = 0; k < 10; k++ )
+    {
+        inputs[ k ] = k;
+    }
+
+    // Inputs: all at first, then two of different groups (none at the last step)
+
+    for( step = 0; step < 4; step++ )
+    {
+        EEModelInit( &fresh );
+
+        if( step > 0 && step < 3 )
+        {
+            inputs[ step ] += 0.5;
+            inputs[ step + 4 ] += 0.5;
+        }
+
+        for( k = 0; k < 1015; k++ )
+        {
+            snprintf( name, sizeof( name ), "c%d", k );
+
+            if( k < 10 )
+            {
+                if( step == 0 || ( step < 3 && ( k == step || k == step + 4 ) ) ) EEModelSet( &eval, &model, name, inputs[ k ] );
+                EEModelSet( &eval, &fresh, name, inputs[ k ] );
+                continue;
+            }
+
+            if( k < 1010 ) snprintf( formula, sizeof( formula ), "c%d*1.5 - sin(c%d) + %d", k - 10, k % 10, k );
+            else           snprintf( formula, sizeof( formula ), "c%d + c%d", 1000 + 2 * ( k - 1010 ), 1001 + 2 * ( k - 1010 ) );
+
+            if( step == 0 ) EEModelDefine( &eval, &model, name, formula );
+            EEModelDefine( &eval, &fresh, name, formula );
+        }
+
+        if( EEModelUpdate( &eval, &model, jobs ) == EEvalFailure || EEModelUpdate( &eval, &fresh, 1 ) == EEvalFailure )
+        {
+            printf( "Test at line number %d failed\n\n", lineNumber );
+            EEPrintError( &eval );
+            exit( 1 );
+        }
+
+        for( k = 0; k < 1015; k++ )
+        {
+            snprintf( name, sizeof( name ), "c%d", k );
+
+            if( EEModelValue( &eval, &model, name, &a ) == EEvalFailure || EEModelValue( &eval, &fresh, name, &b ) == EEvalFailure || a != b )
+            {
+                printf( "Test at line number %d failed\n\n", lineNumber );
+                printf( "Step %d, cell %s: %f instead of %f\n\n", step, name, a, b );
+                exit( 1 );
+            }
+        }
+
+        EEModelFree( &fresh );
+    }
+
+    EEModelFree( &model );
+}
+
+
+
+#endif
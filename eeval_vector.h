@@ -0,0 +1,865 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_vector.h
+//
+//  vectorized math kernels: included by eeval_vector.c,
+//  eeval_vector_avx2.c and eeval_vector_avx512.c which
+//  define the vector width, the name of the kernel set
+//  and the target instruction set
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#define EEVectorInline static inline __attribute__(( always_inline ))
+
+// Rounds to the nearest integer numbers smaller than 2^51
+
+#define EEVectorMagic 6755399441055744.0
+
+// Trigonometric functions are reduced by multiples of pi/2 below this value
+
+#define EEVectorTrigRange 1048576.0
+
+
+
+// ***********************
+// VECTORS
+// ***********************
+
+
+
+// Kernels work on vectors of EEVectorWidth doubles (GCC/Clang vector
+// extensions), the width of the registers of the target.
+
+typedef double   EEVectorD __attribute__(( vector_size( EEVectorWidth * sizeof( double ) ) ));
+typedef int64_t  EEVectorI __attribute__(( vector_size( EEVectorWidth * sizeof( int64_t ) ) ));
+typedef uint64_t EEVectorU __attribute__(( vector_size( EEVectorWidth * sizeof( uint64_t ) ) ));
+
+// Vectors are never passed to functions of other translation
+// units (lanes are always inlined)
+
+#if defined( __GNUC__ ) && ! defined( __clang__ )
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+
+
+EEVectorInline EEVectorD EEVectorSplat( double value )
+{
+    EEVectorD vector = { 0 };
+
+    return vector + value;
+}
+
+
+
+// Loads (stores) `w` values, up to EEVectorWidth
+
+EEVectorInline EEVectorD EEVectorLoad( const double *values, size_t w )
+{
+    EEVectorD vector = { 0 };
+
+    if( w == EEVectorWidth )
+    {
+        memcpy( &vector, values, sizeof( vector ) );
+    }
+    else
+    {
+        memcpy( &vector, values, w * sizeof( double ) );
+    }
+
+    return vector;
+}
+
+
+
+EEVectorInline void EEVectorStore( double *values, EEVectorD vector, size_t w )
+{
+    if( w == EEVectorWidth )
+    {
+        memcpy( values, &vector, sizeof( vector ) );
+    }
+    else
+    {
+        memcpy( values, &vector, w * sizeof( double ) );
+    }
+}
+
+
+
+// For each lane: `mask` (all ones or all zeros) ? a : b
+
+EEVectorInline EEVectorD EEVectorBlend( EEVectorI mask, EEVectorD a, EEVectorD b )
+{
+    return (EEVectorD)( ( mask & (EEVectorI)a ) | ( ~mask & (EEVectorI)b ) );
+}
+
+
+
+EEVectorInline EEVectorD EEVectorAbs( EEVectorD x )
+{
+    return (EEVectorD)( (EEVectorU)x & 0x7fffffffffffffffULL );
+}
+
+
+
+// Flips the sign of the lanes where `mask` is all ones
+
+EEVectorInline EEVectorD EEVectorFlip( EEVectorI mask, EEVectorD x )
+{
+    return (EEVectorD)( (EEVectorU)x ^ ( (EEVectorU)mask & 0x8000000000000000ULL ) );
+}
+
+
+
+// 2^k for k from -1022 to 1023
+
+EEVectorInline EEVectorD EEVectorPow2( EEVectorI k )
+{
+    return (EEVectorD)( (EEVectorU)( k + 1023 ) << 52 );
+}
+
+
+
+// Rounds x (|x| < 2^51) to the nearest integer, returned
+// both as double and in `*k` (SSE2 and AVX2 lack the
+// double to int64 conversion)
+
+EEVectorInline EEVectorD EEVectorRound( EEVectorD x, EEVectorI *k )
+{
+    EEVectorD n;
+
+    n = x + EEVectorMagic;
+    *k = (EEVectorI)n - (EEVectorI)EEVectorSplat( EEVectorMagic );
+
+    return n - EEVectorMagic;
+}
+
+
+
+// Converts integers smaller than 2^51 to double
+
+EEVectorInline EEVectorD EEVectorInteger( EEVectorI k )
+{
+    return (EEVectorD)( k + (EEVectorI)EEVectorSplat( EEVectorMagic ) ) - EEVectorMagic;
+}
+
+
+
+// x = 2^k * m with m between sqrt(2)/2 and sqrt(2)
+// (x positive and normal)
+
+EEVectorInline EEVectorD EEVectorSplit( EEVectorD x, EEVectorI *k )
+{
+    EEVectorU bits;
+    EEVectorD m;
+    EEVectorI big;
+
+    bits = (EEVectorU)x;
+    m = (EEVectorD)( ( bits & 0x000fffffffffffffULL ) | 0x3ff0000000000000ULL );
+    big = m > M_SQRT2;
+
+    *k = (EEVectorI)( bits >> 52 ) - 1023 - big;
+
+    return EEVectorBlend( big, m * .5, m );
+}
+
+
+
+// x * y - p exactly, where p is x * y rounded: with the fused
+// multiply-add when the target has it, otherwise splitting x and y
+// in halves (Dekker); NaN if x or y is above 2^996
+
+EEVectorInline EEVectorD EEVectorMulError( EEVectorD x, EEVectorD y, EEVectorD p )
+{
+#if EEVectorFMA || defined( __FP_FAST_FMA )
+    int       i;
+
+    for( i = 0; i < EEVectorWidth; i++ )
+    {
+        x[ i ] = fma( x[ i ], y[ i ], -p[ i ] );
+    }
+
+    return x;
+#else
+    EEVectorD xh,
+              xl,
+              yh,
+              yl;
+
+    xh = x * 134217729.0;
+    xh = xh - ( xh - x );
+    xl = x - xh;
+    yh = y * 134217729.0;
+    yh = yh - ( yh - y );
+    yl = y - yh;
+
+    return ( ( xh * yh - p ) + xh * yl + xl * yh ) + xl * yl;
+#endif
+}
+
+
+
+// Square root, lane by lane: the compiler uses
+// the vector instruction of the target
+
+EEVectorInline EEVectorD EEVectorSqrt( EEVectorD x )
+{
+    int i;
+
+    for( i = 0; i < EEVectorWidth; i++ )
+    {
+        x[ i ] = sqrt( x[ i ] );
+    }
+
+    return x;
+}
+
+
+
+// ***********************
+// LANES
+// ***********************
+
+
+
+// A lane computes a function over a vector; `fast` returns
+// the mask of the lanes it computes correctly
+
+
+
+// e^r - 1 for |r| <= ln(2)/2: Taylor series up to r^13,
+// evaluated with Estrin's scheme (shorter dependency chains)
+
+EEVectorInline EEVectorD EEVectorExpm1Kernel( EEVectorD r )
+{
+    EEVectorD r2,
+              r4,
+              r8;
+
+    r2 = r * r;
+    r4 = r2 * r2;
+    r8 = r4 * r4;
+
+    return r + r2 * ( ( ( 1.0 / 2 + r * ( 1.0 / 6 ) ) + r2 * ( 1.0 / 24 + r * ( 1.0 / 120 ) ) ) +
+                      r4 * ( ( 1.0 / 720 + r * ( 1.0 / 5040 ) ) + r2 * ( 1.0 / 40320 + r * ( 1.0 / 362880 ) ) ) +
+                      r8 * ( ( 1.0 / 3628800 + r * ( 1.0 / 39916800 ) ) + r2 * ( 1.0 / 479001600 + r * ( 1.0 / 6227020800.0 ) ) ) );
+}
+
+
+
+// exp(x) overflows above max, is 0 below min
+
+#define EEVectorExpMax 7.09782712893383973096e+02
+#define EEVectorExpMin -7.45133219101941108420e+02
+
+EEVectorInline EEVectorI EEVectorExpFast( EEVectorD x )
+{
+    return ( x >= EEVectorExpMin ) & ( x <= EEVectorExpMax );
+}
+
+
+
+EEVectorInline EEVectorD EEVectorExpLane( EEVectorD x )
+{
+    const double ln2hi  = 6.93147180369123816490e-01,
+                 ln2lo  = 1.90821492927058770002e-10,
+                 invln2 = 1.44269504088896338700e+00;
+
+    EEVectorD    n,
+                 r,
+                 p;
+    EEVectorI    k,
+                 k1;
+
+    x = EEVectorBlend( EEVectorExpFast( x ), x, EEVectorSplat( 0 ) );
+
+    n = EEVectorRound( x * invln2, &k );
+    r = ( x - n * ln2hi ) - n * ln2lo;
+    p = 1 + EEVectorExpm1Kernel( r );
+
+    // 2^k is applied in two steps: k goes from -1075 to 1024
+
+    EEVectorRound( n * .5, &k1 );
+    p = p * EEVectorPow2( k1 ) * EEVectorPow2( k - k1 );
+
+    // exp(max) must not round to infinity
+
+    return EEVectorBlend( p > DBL_MAX, EEVectorSplat( DBL_MAX ), p );
+}
+
+
+
+EEVectorInline EEVectorI EEVectorLogFast( EEVectorD x )
+{
+    return ( x >= DBL_MIN ) & ( x <= DBL_MAX );
+}
+
+
+
+// log(x) for normal positive numbers (fdlibm e_log.c)
+
+EEVectorInline EEVectorD EEVectorLogLane( EEVectorD x )
+{
+    const double ln2hi = 6.93147180369123816490e-01,
+                 ln2lo = 1.90821492927058770002e-10,
+                 Lg1   = 6.666666666666735130e-01,
+                 Lg2   = 3.999999999940941908e-01,
+                 Lg3   = 2.857142874366239149e-01,
+                 Lg4   = 2.222219843214978396e-01,
+                 Lg5   = 1.818357216161805012e-01,
+                 Lg6   = 1.531383769920937332e-01,
+                 Lg7   = 1.479819860511658591e-01;
+
+    EEVectorD    f,
+                 hfsq,
+                 s,
+                 z,
+                 w,
+                 R,
+                 dk;
+    EEVectorI    k;
+
+    x = EEVectorBlend( EEVectorLogFast( x ), x, EEVectorSplat( 1 ) );
+
+    f = EEVectorSplit( x, &k ) - 1;
+    hfsq = .5 * f * f;
+    s = f / ( 2 + f );
+    z = s * s;
+    w = z * z;
+    R = z * ( Lg1 + w * ( Lg3 + w * ( Lg5 + w * Lg7 ) ) ) + w * ( Lg2 + w * ( Lg4 + w * Lg6 ) );
+    dk = EEVectorInteger( k );
+
+    return dk * ln2hi - ( ( hfsq - ( s * ( hfsq + R ) + dk * ln2lo ) ) - f );
+}
+
+
+
+EEVectorInline EEVectorI EEVectorPowFast( EEVectorD a, EEVectorD b )
+{
+    return EEVectorLogFast( a ) & ( EEVectorAbs( b ) <= DBL_MAX );
+}
+
+
+
+// a^b for normal positive `a` and finite `b`.
+// log(a) is computed in double-double precision, multiplied by `b`
+// then exponentiated. Lanes whose result is too large or too small
+// are NaN (to be recomputed by the C library).
+// The error of log(a) is multiplied by |b log(a)| (up to 708), so
+// its relative error must stay near 2^-62: the leading terms of the
+// series are kept in double-double, only the rest is rounded.
+
+EEVectorInline EEVectorD EEVectorPowLane( EEVectorD a, EEVectorD b )
+{
+    const double ln2hi  = 6.93147180369123816490e-01,
+                 ln2lo  = 1.90821492927058770002e-10,
+                 invln2 = 1.44269504088896338700e+00,
+                 c3hi   = 2.0 / 3,
+                 c3lo   = 3.70074341541718826e-17;      // 2/3 - c3hi
+
+    EEVectorD    f,
+                 d,
+                 dlo,
+                 s,
+                 slo,
+                 z,
+                 zlo,
+                 z2,
+                 z4,
+                 z8,
+                 s3,
+                 s3lo,
+                 t3,
+                 t3lo,
+                 rest,
+                 dk,
+                 A,
+                 B,
+                 hi,
+                 lo,
+                 bb,
+                 Lhi,
+                 Llo,
+                 thi,
+                 tlo,
+                 n,
+                 r;
+    EEVectorI    fast,
+                 k;
+
+    fast = EEVectorPowFast( a, b );
+    a = EEVectorBlend( fast, a, EEVectorSplat( 1 ) );
+    b = EEVectorBlend( fast, b, EEVectorSplat( 0 ) );
+
+    // log(m) = 2 atanh(s) = 2s + 2s^3/3 + 2s^5/5 ...
+    // with s = f / (2 + f), f = m - 1 (exact).
+    // s is computed as s + slo.
+
+    f = EEVectorSplit( a, &k ) - 1;
+    d = 2 + f;
+    dlo = ( 2 - d ) + f;
+    s = f / d;
+    slo = d * s;
+    slo = ( ( ( f - slo ) - EEVectorMulError( d, s, slo ) ) - s * dlo ) / d;
+
+    // 2s^3/3 as t3 + t3lo, the rest (below 2^-14) in double
+
+    z = s * s;
+    zlo = EEVectorMulError( s, s, z );
+    s3 = s * z;
+    s3lo = EEVectorMulError( s, z, s3 ) + s * zlo;
+    t3 = s3 * c3hi;
+    t3lo = EEVectorMulError( s3, EEVectorSplat( c3hi ), t3 ) + ( c3hi * s3lo + c3lo * s3 );
+
+    z2 = z * z;
+    z4 = z2 * z2;
+    z8 = z4 * z4;
+    rest = s * z2 * ( ( ( 2.0 / 5 + z * ( 2.0 / 7 ) ) + z2 * ( 2.0 / 9 + z * ( 2.0 / 11 ) ) ) +
+                      z4 * ( ( 2.0 / 13 + z * ( 2.0 / 15 ) ) + z2 * ( 2.0 / 17 + z * ( 2.0 / 19 ) ) ) +
+                      z8 * ( ( 2.0 / 21 + z * ( 2.0 / 23 ) ) + z2 * ( 2.0 / 25 + z * ( 2.0 / 27 ) ) ) );
+
+    // slo moves 2 atanh(s) by 2 slo / (1 - s^2)
+
+    rest = rest + ( t3lo + 2 * slo * ( 1 + z + z2 ) );
+
+    // log(a) = k ln2 + 2s + t3 + rest as Lhi + Llo
+
+    dk = EEVectorInteger( k );
+    A = dk * ln2hi;
+    B = 2 * s;
+    hi = A + B;
+    bb = hi - A;
+    lo = ( A - ( hi - bb ) ) + ( B - bb );
+    A = hi + t3;
+    bb = A - hi;
+    lo = lo + ( ( hi - ( A - bb ) ) + ( t3 - bb ) );
+    hi = A;
+    lo = lo + ( dk * ln2lo + rest );
+    Lhi = hi + lo;
+    Llo = lo - ( Lhi - hi );
+
+    // t = b log(a) as thi + tlo
+
+    thi = b * Lhi;
+    tlo = EEVectorMulError( b, Lhi, thi ) + b * Llo;
+
+    // e^t = 2^n e^r
+
+    fast = EEVectorAbs( thi ) <= 708;
+    thi = EEVectorBlend( fast, thi, EEVectorSplat( 0 ) );
+    tlo = EEVectorBlend( fast, tlo, EEVectorSplat( 0 ) );
+
+    n = EEVectorRound( thi * invln2, &k );
+    r = ( ( thi - n * ln2hi ) - n * ln2lo ) + tlo;
+
+    return EEVectorBlend( fast, ( 1 + EEVectorExpm1Kernel( r ) ) * EEVectorPow2( k ), EEVectorSplat( NAN ) );
+}
+
+
+
+EEVectorInline EEVectorI EEVectorTrigFast( EEVectorD x )
+{
+    return EEVectorAbs( x ) < EEVectorTrigRange;
+}
+
+
+
+// Reduces x to r between -pi/4 and pi/4, x = r + q pi/2 (fdlibm e_rem_pio2.c
+// constants: pi/2 split in 33 + 33 + 53 bits).
+// Returns r, the quadrant q (0...3) in `*quadrant`
+
+EEVectorInline EEVectorD EEVectorTrigReduce( EEVectorD x, EEVectorI *quadrant )
+{
+    const double invpio2 = 6.36619772367581382433e-01,
+                 pio2_1  = 1.57079632673412561417e+00,
+                 pio2_2  = 6.07710050630396597660e-11,
+                 pio2_2t = 2.02226624879595063154e-21;
+
+    EEVectorD    n;
+
+    x = EEVectorBlend( EEVectorTrigFast( x ), x, EEVectorSplat( 0 ) );
+
+    n = EEVectorRound( x * invpio2, quadrant );
+    *quadrant = *quadrant & 3;
+
+    return ( ( x - n * pio2_1 ) - n * pio2_2 ) - n * pio2_2t;
+}
+
+
+
+// sin(r) for r between -pi/4 and pi/4 (fdlibm k_sin.c)
+
+EEVectorInline EEVectorD EEVectorSinKernel( EEVectorD r )
+{
+    const double S1 = -1.66666666666666324348e-01,
+                 S2 =  8.33333333332248946124e-03,
+                 S3 = -1.98412698298579493134e-04,
+                 S4 =  2.75573137070700676789e-06,
+                 S5 = -2.50507602534068634195e-08,
+                 S6 =  1.58969099521155010221e-10;
+
+    EEVectorD    z;
+
+    z = r * r;
+
+    return r + z * r * ( S1 + z * ( S2 + z * ( S3 + z * ( S4 + z * ( S5 + z * S6 ) ) ) ) );
+}
+
+
+
+// cos(r) for r between -pi/4 and pi/4 (fdlibm k_cos.c)
+
+EEVectorInline EEVectorD EEVectorCosKernel( EEVectorD r )
+{
+    const double C1 =  4.16666666666666019037e-02,
+                 C2 = -1.38888888888741095749e-03,
+                 C3 =  2.48015872894767294178e-05,
+                 C4 = -2.75573143513906633035e-07,
+                 C5 =  2.08757232129817482790e-09,
+                 C6 = -1.13596475577881948265e-11;
+
+    EEVectorD    z,
+                 hz,
+                 w;
+
+    z = r * r;
+    hz = .5 * z;
+    w = 1 - hz;
+
+    return w + ( ( ( 1 - w ) - hz ) + z * z * ( C1 + z * ( C2 + z * ( C3 + z * ( C4 + z * ( C5 + z * C6 ) ) ) ) ) );
+}
+
+
+
+// sin: s, c, -s, -c for quadrants 0...3
+
+EEVectorInline EEVectorD EEVectorSinLane( EEVectorD x )
+{
+    EEVectorD r;
+    EEVectorI q;
+
+    r = EEVectorTrigReduce( x, &q );
+
+    return EEVectorFlip( -( q & 2 ) >> 1, EEVectorBlend( -( q & 1 ), EEVectorCosKernel( r ), EEVectorSinKernel( r ) ) );
+}
+
+
+
+// cos: c, -s, -c, s for quadrants 0...3
+
+EEVectorInline EEVectorD EEVectorCosLane( EEVectorD x )
+{
+    EEVectorD r;
+    EEVectorI q;
+
+    r = EEVectorTrigReduce( x, &q );
+
+    return EEVectorFlip( -( ( q + 1 ) & 2 ) >> 1, EEVectorBlend( -( q & 1 ), EEVectorSinKernel( r ), EEVectorCosKernel( r ) ) );
+}
+
+
+
+// tan: s/c, -c/s, s/c, -c/s for quadrants 0...3
+
+EEVectorInline EEVectorD EEVectorTanLane( EEVectorD x )
+{
+    EEVectorD r,
+              s,
+              c;
+    EEVectorI q;
+
+    r = EEVectorTrigReduce( x, &q );
+    s = EEVectorSinKernel( r );
+    c = EEVectorCosKernel( r );
+
+    return EEVectorBlend( -( q & 1 ), -c / s, s / c );
+}
+
+
+
+// atan(x) (fdlibm s_atan.c): the argument is reduced
+// to |t| < 0.4375 using atan(x) = atan(c) + atan((x - c) / (1 + xc))
+// with c = 0.5, 1, 1.5 or infinity
+
+EEVectorInline EEVectorD EEVectorAtanLane( EEVectorD x )
+{
+    const double aT0  =  3.33333333333329318027e-01,
+                 aT1  = -1.99999999998764832476e-01,
+                 aT2  =  1.42857142725034663711e-01,
+                 aT3  = -1.11111104054623557880e-01,
+                 aT4  =  9.09088713343650656196e-02,
+                 aT5  = -7.69187620504482999495e-02,
+                 aT6  =  6.66107313738753120669e-02,
+                 aT7  = -5.83357013379057348645e-02,
+                 aT8  =  4.97687799461593236017e-02,
+                 aT9  = -3.65315727442169155270e-02,
+                 aT10 =  1.62858201153657823623e-02;
+
+    EEVectorD    ax,
+                 t,
+                 hi,
+                 lo,
+                 N1,
+                 N0,
+                 D0,
+                 D1,
+                 z,
+                 w,
+                 s;
+    EEVectorI    range,
+                 reduced;
+
+    ax = EEVectorAbs( x );
+
+    // t = (N1 ax - N0) / (D0 + D1 ax)
+
+    N1 = EEVectorSplat( 1 );
+    N0 = EEVectorSplat( 0 );
+    D0 = EEVectorSplat( 1 );
+    D1 = EEVectorSplat( 0 );
+    hi = EEVectorSplat( 0 );
+    lo = EEVectorSplat( 0 );
+
+    range = ax >= 0.4375;
+    N1 = EEVectorBlend( range, EEVectorSplat( 2 ), N1 );
+    N0 = EEVectorBlend( range, EEVectorSplat( 1 ), N0 );
+    D0 = EEVectorBlend( range, EEVectorSplat( 2 ), D0 );
+    D1 = EEVectorBlend( range, EEVectorSplat( 1 ), D1 );
+    hi = EEVectorBlend( range, EEVectorSplat( 4.63647609000806093515e-01 ), hi );
+    lo = EEVectorBlend( range, EEVectorSplat( 2.26987774529616870924e-17 ), lo );
+    reduced = range;
+
+    range = ax >= 0.6875;
+    N1 = EEVectorBlend( range, EEVectorSplat( 1 ), N1 );
+    D0 = EEVectorBlend( range, EEVectorSplat( 1 ), D0 );
+    hi = EEVectorBlend( range, EEVectorSplat( 7.85398163397448278999e-01 ), hi );
+    lo = EEVectorBlend( range, EEVectorSplat( 3.06161699786838301793e-17 ), lo );
+
+    range = ax >= 1.1875;
+    N0 = EEVectorBlend( range, EEVectorSplat( 1.5 ), N0 );
+    D1 = EEVectorBlend( range, EEVectorSplat( 1.5 ), D1 );
+    hi = EEVectorBlend( range, EEVectorSplat( 9.82793723247329054082e-01 ), hi );
+    lo = EEVectorBlend( range, EEVectorSplat( 1.39033110312309984516e-17 ), lo );
+
+    range = ax >= 2.4375;
+    hi = EEVectorBlend( range, EEVectorSplat( 1.57079632679489655800e+00 ), hi );
+    lo = EEVectorBlend( range, EEVectorSplat( 6.12323399573676603587e-17 ), lo );
+
+    t = EEVectorBlend( range, -1 / ax, ( N1 * ax - N0 ) / ( D0 + D1 * ax ) );
+
+    z = t * t;
+    w = z * z;
+    s = z * ( aT0 + w * ( aT2 + w * ( aT4 + w * ( aT6 + w * ( aT8 + w * aT10 ) ) ) ) ) + w * ( aT1 + w * ( aT3 + w * ( aT5 + w * ( aT7 + w * aT9 ) ) ) );
+
+    t = EEVectorBlend( reduced, hi - ( ( t * s - lo ) - t ), t - t * s );
+
+    return EEVectorFlip( x < 0, t );
+}
+
+
+
+// asin(x) = atan(x / sqrt(1 - x^2)).
+// The argument of atan() is computed as y + ylo (the rounding errors
+// of 1 - x^2, the square root and the division would add up to
+// 1.25 ULP) and atan(y + ylo) = atan(y) + ylo / (1 + y^2).
+
+EEVectorInline EEVectorD EEVectorAsinLane( EEVectorD x )
+{
+    EEVectorD u,
+              ulo,
+              v,
+              vlo,
+              w,
+              wlo,
+              q,
+              qlo,
+              y,
+              ylo,
+              p;
+
+    // 1 - x^2 = (1 - x)(1 + x) as w + wlo (|x| <= 1)
+
+    u = 1 - x;
+    ulo = ( 1 - u ) - x;
+    v = 1 + x;
+    vlo = ( 1 - v ) + x;
+    w = u * v;
+    wlo = EEVectorMulError( u, v, w ) + ( u * vlo + ulo * v );
+
+    q = EEVectorSqrt( w );
+    p = q * q;
+    qlo = ( ( ( w - p ) - EEVectorMulError( q, q, p ) ) + wlo ) / ( 2 * q );
+
+    y = x / q;
+    p = y * q;
+    ylo = ( ( ( x - p ) - EEVectorMulError( y, q, p ) ) - y * qlo ) / q;
+    ylo = EEVectorBlend( EEVectorAbs( x ) < 1, ylo / ( 1 + y * y ), EEVectorSplat( 0 ) );
+
+    return EEVectorAtanLane( y ) + ylo;
+}
+
+
+
+// acos(x) = 2 atan(sqrt((1 - x) / (1 + x))), with the argument
+// of atan() computed as y + ylo as in EEVectorAsinLane()
+
+EEVectorInline EEVectorD EEVectorAcosLane( EEVectorD x )
+{
+    EEVectorD u,
+              ulo,
+              v,
+              vlo,
+              w,
+              wlo,
+              y,
+              ylo,
+              p;
+
+    u = 1 - x;
+    ulo = ( 1 - u ) - x;
+    v = 1 + x;
+    vlo = ( 1 - v ) + x;
+    w = u / v;
+    p = w * v;
+    wlo = ( ( ( u - p ) - EEVectorMulError( w, v, p ) ) + ( ulo - w * vlo ) ) / v;
+
+    y = EEVectorSqrt( w );
+    p = y * y;
+    ylo = ( ( ( w - p ) - EEVectorMulError( y, y, p ) ) + wlo ) / ( 2 * y );
+    ylo = EEVectorBlend( ( x > -1 ) & ( x < 1 ), ylo / ( 1 + y * y ), EEVectorSplat( 0 ) );
+
+    return 2 * ( EEVectorAtanLane( y ) + ylo );
+}
+
+
+
+EEVectorInline EEVectorI EEVectorFactFast( EEVectorD x )
+{
+    EEVectorI k;
+
+    return ( x >= 0 ) & ( x <= 170 ) & ( x == EEVectorRound( x, &k ) );
+}
+
+
+
+// x! for integers from 0 to 170
+
+EEVectorInline EEVectorD EEVectorFactLane( EEVectorD x )
+{
+    EEVectorD r = { 0 };
+    EEVectorI k;
+    int       i;
+
+    x = EEVectorBlend( EEVectorFactFast( x ), x, EEVectorSplat( 0 ) );
+    EEVectorRound( x, &k );
+
+    for( i = 0; i < EEVectorWidth; i++ )
+    {
+        r[ i ] = EEFactorials[ k[ i ] ];
+    }
+
+    return r;
+}
+
+
+
+EEVectorInline EEVectorI EEVectorAlways( EEVectorD x )
+{
+    return ( x == x ) | ( x != x );
+}
+
+
+
+#define EEVectorLogBaseFast( a, b ) ( EEVectorLogFast( a ) & EEVectorLogFast( b ) )
+#define EEVectorLogBaseLane( a, b ) ( EEVectorLogLane( b ) / EEVectorLogLane( a ) )
+
+
+
+// ***********************
+// KERNELS
+// ***********************
+
+
+
+// A kernel computes `lane` over `m` values, a vector at a time,
+// then recomputes with `fallback` the values for which `fast` is false
+// (a binary kernel also recomputes the NaN results).
+
+#define EEVectorUnaryKernel( name, lane, fast, fallback )                        \
+    static void EEVector##name( const double *a, double *r, size_t m )          \
+    {                                                                           \
+        EEVectorD x,                                                            \
+                  y;                                                            \
+        EEVectorI ok;                                                           \
+        size_t    j,                                                            \
+                  w,                                                            \
+                  i;                                                            \
+                                                                                \
+        for( j = 0; j < m; j += w )                                             \
+        {                                                                       \
+            w = m - j < EEVectorWidth ? m - j : EEVectorWidth;                  \
+            x = EEVectorLoad( a + j, w );                                       \
+            y = lane( x );                                                      \
+            ok = fast( x );                                                     \
+            for( i = 0; i < w; i++ )                                            \
+            {                                                                   \
+                if( ! ok[ i ] ) y[ i ] = fallback( x[ i ] );                    \
+            }                                                                   \
+            EEVectorStore( r + j, y, w );                                       \
+        }                                                                       \
+    }
+
+#define EEVectorBinaryKernel( name, lane, fast, fallback )                       \
+    static void EEVector##name( const double *a, const double *b, double *r, size_t m ) \
+    {                                                                           \
+        EEVectorD x,                                                            \
+                  z,                                                            \
+                  y;                                                            \
+        EEVectorI ok;                                                           \
+        size_t    j,                                                            \
+                  w,                                                            \
+                  i;                                                            \
+                                                                                \
+        for( j = 0; j < m; j += w )                                             \
+        {                                                                       \
+            w = m - j < EEVectorWidth ? m - j : EEVectorWidth;                  \
+            x = EEVectorLoad( a + j, w );                                       \
+            z = EEVectorLoad( b + j, w );                                       \
+            y = lane( x, z );                                                   \
+            ok = fast( x, z ) & ( y == y );                                     \
+            for( i = 0; i < w; i++ )                                            \
+            {                                                                   \
+                if( ! ok[ i ] ) y[ i ] = fallback( x[ i ], z[ i ] );            \
+            }                                                                   \
+            EEVectorStore( r + j, y, w );                                       \
+        }                                                                       \
+    }
+
+EEVectorUnaryKernel(  Sin,  EEVectorSinLane,     EEVectorTrigFast,    sin )
+EEVectorUnaryKernel(  Cos,  EEVectorCosLane,     EEVectorTrigFast,    cos )
+EEVectorUnaryKernel(  Tan,  EEVectorTanLane,     EEVectorTrigFast,    tan )
+EEVectorUnaryKernel(  Asin, EEVectorAsinLane,    EEVectorAlways,      asin )
+EEVectorUnaryKernel(  Acos, EEVectorAcosLane,    EEVectorAlways,      acos )
+EEVectorUnaryKernel(  Atan, EEVectorAtanLane,    EEVectorAlways,      atan )
+EEVectorUnaryKernel(  Exp,  EEVectorExpLane,     EEVectorExpFast,     exp )
+EEVectorUnaryKernel(  Log,  EEVectorLogLane,     EEVectorLogFast,     log )
+EEVectorUnaryKernel(  Fact, EEVectorFactLane,    EEVectorFactFast,    EEFactorial )
+EEVectorBinaryKernel( Pow,  EEVectorPowLane,     EEVectorPowFast,     EEPower )
+EEVectorBinaryKernel( Lgb,  EEVectorLogBaseLane, EEVectorLogBaseFast, EEBatchLogBase )
+
+const EEVectorKernels EEVectorKernelSet =
+{
+    EEVectorSin,  EEVectorCos,  EEVectorTan,
+    EEVectorAsin, EEVectorAcos, EEVectorAtan,
+    EEVectorExp,  EEVectorLog,  EEVectorFact,
+    EEVectorPow,  EEVectorLgb,
+    EEVectorName
+};
@@ -0,0 +1,54 @@
+//
+//  eeval
+//  version 1.0
+//
+//  a math expression evaluator
+//
+//  eeval_vector_avx2.c
+//
+//  vectorized math kernels for AVX2 and FMA
+//  (selected at runtime by EEVectorSelect())
+//
+//  Copyright (c) 2016 Paolo Bertani - Kalei S.r.l.
+//  Licensed under the FreeBSD 2-clause license
+//
+
+
+
+#include "eeval.h"
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+
+
+#if eeval_vector_math && defined( __x86_64__ )
+
+
+
+// The whole translation unit is compiled for AVX2 and FMA
+
+#if defined( __clang__ )
+#pragma clang attribute push( __attribute__(( target( "avx2,fma" ) )), apply_to = function )
+#else
+#pragma GCC target( "avx2,fma" )
+#endif
+
+#define EEVectorWidth     4
+#define EEVectorFMA       true
+#define EEVectorKernelSet EEVectorKernelsAVX2
+#define EEVectorName      "AVX2"
+
+#include "eeval_vector.h"
+
+#if defined( __clang__ )
+#pragma clang attribute pop
+#endif
+
+#endif
@@ -16,10 +16,29 @@
 
 #include "eeval.h"
 
+#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined( __unix__ ) || defined( __APPLE__ )
+#define EEStreamThreads true
+#define EEStreamMapped  true
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define EEStreamThreads false
+#define EEStreamMapped  false
+#endif
+
+
+
+// Bytes read at a time from the input (and buffered on output)
+// when expressions are streamed
+
+#define EEStreamBuffer ( 1 << 20 )
+
 
 
 // Sample (dead) code that shows how to embed `eeval` in your program
@@ -52,6 +71,564 @@ void demo()
 
 
 
+// Returns the average time (nanoseconds) of an evaluation with `EEvaluate()`
+// (if `program` is NULL) or of an execution of `program` with `slots`.
+// Evaluations are repeated for at least a quarter of second.
+
+double EEBenchmarkTime( const char *expression, const EEProgram *program, const double *slots )
+{
+    EEvaluation eval;
+    double      result;
+    clock_t     start,
+                elapsed;
+    long        count,
+                i;
+
+    count = 16;
+
+    do
+    {
+        count *= 2;
+
+        start = clock();
+
+        for( i = 0; i < count; i++ )
+        {
+            if( program )
+            {
+                EEExecute( &eval, program, slots, &result );
+            }
+            else
+            {
+                EEvaluate( &eval, expression, &result );
+            }
+        }
+
+        elapsed = clock() - start;
+    }
+    while( elapsed < CLOCKS_PER_SEC / 4 );
+
+    return (double)elapsed / CLOCKS_PER_SEC * 1E9 / count;
+}
+
+
+
+// Measures the time taken to evaluate an expression with `EEvaluate()`
+// then with the program compiled from it, interpreted and translated
+// into native code; prints the times and how much faster the program is.
+// The program is compiled with the numbers of the expression bound to
+// slots (see EEBindNumbers()): otherwise it would be folded into a
+// constant and its execution would compute nothing.
+
+void EEBenchmark( const char *expression )
+{
+    EEvaluation eval;
+    EEBound     bound;
+    EEProgram   program;
+    EEProgram   native;
+    double      result;
+    double      evaluate,
+                interpreted,
+                jit;
+
+    if( EEvaluate( &eval, expression, &result ) == EEvalFailure )
+    {
+        EEPrintError( &eval );
+        exit( 1 );
+    }
+
+    if( ! EEBindNumbers( expression, &bound ) )
+    {
+        fprintf( stderr, "out of memory\n" );
+        exit( 1 );
+    }
+
+    if( EECompile( &eval, bound.expression, &bound.symbols, &program ) == EEvalFailure ||
+        EECompile( &eval, bound.expression, &bound.symbols, &native ) == EEvalFailure )
+    {
+        EEPrintError( &eval );
+        exit( 1 );
+    }
+
+    if( EEExecute( &eval, &program, bound.slots, &result ) == EEvalFailure )
+    {
+        EEPrintError( &eval );
+        exit( 1 );
+    }
+
+    evaluate = EEBenchmarkTime( expression, NULL, NULL );
+    interpreted = EEBenchmarkTime( expression, &program, bound.slots );
+
+    printf( "EEvaluate          %12.1f ns\n", evaluate );
+    printf( "EEExecute          %12.1f ns  %6.1fx faster\n", interpreted, evaluate / interpreted );
+
+    if( EEJitCompile( &native ) )
+    {
+        jit = EEBenchmarkTime( expression, &native, bound.slots );
+        printf( "EEExecute (JIT)    %12.1f ns  %6.1fx faster\n", jit, evaluate / jit );
+    }
+    else
+    {
+        printf( "EEExecute (JIT)    not available\n" );
+    }
+
+    EEFreeProgram( &program );
+    EEFreeProgram( &native );
+    EEFreeBound( &bound );
+}
+
+
+
+// Expressions are streamed in chunks of whole lines: each chunk holds
+// the lines read and the lines printed for them (results or errors).
+// With more jobs the chunks are evaluated by worker threads, each one
+// with its own EEvaluation, while the main thread reads the input and
+// prints the chunks in their original order (a chunk evaluated early
+// waits in the ring for the ones before it). At most 2 chunks per job
+// are in the ring, so memory is bounded whatever the size of the input.
+// A regular file is mapped in memory instead of read: chunks refer to
+// their lines in the mapping, which are evaluated in place (no copies).
+
+struct EEChunk
+{
+    const char *lines;          // lines to evaluate (the last newline may be missing)
+    size_t  linesSize;
+    char    *input;             // lines read
+    size_t  inputSize;
+    size_t  inputCapacity;
+    char    *output;            // lines to print
+    size_t  outputSize;
+    size_t  outputCapacity;
+    long    failures;           // expressions that failed
+    EEStats stats;              // statistics of the evaluations (if compiled in)
+    bool    done;               // evaluated
+};
+typedef struct EEChunk EEChunk;
+
+struct EEStream
+{
+    FILE            *file;
+    int             precision;
+    EEvalPolicy     policy;             // of floating point exceptions
+    const char      *mapping;           // the file mapped in memory (or NULL if read)
+    size_t          mappingSize;
+    size_t          mapped;             // bytes of the mapping already in chunks
+    char            *carry;             // incomplete line at the end of the last chunk read
+    size_t          carrySize;
+    size_t          carryCapacity;
+    bool            eof;
+    EEChunk         *chunks;            // ring of the chunks in flight
+    long            chunksCount;
+    long            submitted;          // chunks read
+    long            claimed;            // chunks taken by a worker
+    long            written;            // chunks printed
+    bool            finished;           // no more chunks to read
+    EEStats         stats;              // statistics of the chunks printed
+    #if EEStreamThreads
+    pthread_mutex_t mutex;
+    pthread_cond_t  available;          // a chunk was read (or the input is finished)
+    pthread_cond_t  completed;          // a chunk was evaluated
+    #endif
+};
+typedef struct EEStream EEStream;
+
+
+
+// Grows `*buffer` to hold at least `size` bytes
+
+void EEStreamReserve( char **buffer, size_t *capacity, size_t size )
+{
+    char *grown;
+
+    if( size <= *capacity ) return;
+
+    grown = realloc( *buffer, size );
+    if( ! grown )
+    {
+        fprintf( stderr, "out of memory\n" );
+        exit( 1 );
+    }
+
+    *buffer = grown;
+    *capacity = size;
+}
+
+
+
+// Fills a chunk with whole lines read from the input: the incomplete
+// line at the end is carried over to the next chunk (a line longer than
+// the chunk makes it grow).
+// Returns false when there is nothing left to read.
+
+bool EEStreamRead( EEStream *stream, EEChunk *chunk )
+{
+    const char *newline;
+    size_t     length,
+               last;
+
+    // Mapped: the chunk ends at the first newline after EEStreamBuffer bytes
+
+    if( stream->mapping )
+    {
+        length = stream->mappingSize - stream->mapped;
+
+        if( length > EEStreamBuffer )
+        {
+            newline = memchr( stream->mapping + stream->mapped + EEStreamBuffer, '\n', length - EEStreamBuffer );
+            if( newline ) length = (size_t)( newline + 1 - ( stream->mapping + stream->mapped ) );
+        }
+
+        chunk->lines = stream->mapping + stream->mapped;
+        chunk->linesSize = length;
+        stream->mapped += length;
+
+        return length > 0;
+    }
+
+    EEStreamReserve( &chunk->input, &chunk->inputCapacity, stream->carrySize + EEStreamBuffer );
+
+    memcpy( chunk->input, stream->carry, stream->carrySize );
+    chunk->inputSize = stream->carrySize;
+    stream->carrySize = 0;
+
+    while( true )
+    {
+        if( ! stream->eof )
+        {
+            if( chunk->inputSize >= chunk->inputCapacity - 1 )
+            {
+                EEStreamReserve( &chunk->input, &chunk->inputCapacity, chunk->inputCapacity * 2 );
+            }
+
+            length = fread( chunk->input + chunk->inputSize, 1, chunk->inputCapacity - chunk->inputSize - 1, stream->file );
+            chunk->inputSize += length;
+            stream->eof = length == 0;
+        }
+
+        for( last = chunk->inputSize; last > 0 && chunk->input[ last - 1 ] != '\n'; last-- );
+
+        if( last > 0 && ! stream->eof )
+        {
+            EEStreamReserve( &stream->carry, &stream->carryCapacity, chunk->inputSize - last );
+
+            stream->carrySize = chunk->inputSize - last;
+            memcpy( stream->carry, chunk->input + last, stream->carrySize );
+            chunk->inputSize = last;
+            break;
+        }
+
+        if( stream->eof ) break;
+    }
+
+    if( ferror( stream->file ) )
+    {
+        fprintf( stderr, "error reading the expressions\n" );
+        exit( 1 );
+    }
+
+    chunk->lines = chunk->input;
+    chunk->linesSize = chunk->inputSize;
+
+    return chunk->inputSize > 0;
+}
+
+
+
+// Evaluates the lines of a chunk in place, printing into its output
+// the result or the error of each one.
+// Carriage returns before newlines are ignored.
+
+void EEStreamEvaluate( EEChunk *chunk, int precision, EEvalPolicy policy )
+{
+    EEvaluation eval;
+    double      result;
+    const char  *line,
+                *newline,
+                *end,
+                *last;
+    int         length;
+
+    chunk->outputSize = 0;
+    chunk->failures = 0;
+    memset( &chunk->stats, 0, sizeof( EEStats ) );
+
+    line = chunk->lines;
+    last = chunk->lines + chunk->linesSize;
+
+    while( line < last )
+    {
+        // The last line may have no newline
+
+        newline = memchr( line, '\n', last - line );
+        if( ! newline ) newline = last;
+
+        end = newline;
+        if( end > line && end[ -1 ] == '\r' ) end--;
+
+        // Results are at most 310 digits before the decimal point,
+        // errors a few tens of characters
+
+        EEStreamReserve( &chunk->output, &chunk->outputCapacity, chunk->outputSize + 400 );
+
+        if( EEvaluatePolicy( &eval, line, (size_t)( end - line ), policy, &result ) == EEvalSuccess )
+        {
+            length = snprintf( chunk->output + chunk->outputSize, 400, "%.*f\n", precision, result );
+        }
+        else
+        {
+            length = snprintf( chunk->output + chunk->outputSize, 400, "error: %s at character %d\n", eval.error, (int)( eval.cursor - eval.expression ) + 1 );
+            chunk->failures++;
+        }
+
+        #if eeval_statistics
+        EEStatsAdd( &chunk->stats, &eval.stats );
+        #endif
+
+        chunk->outputSize += length;
+
+        line = newline + 1;
+    }
+}
+
+
+
+#if EEStreamThreads
+
+// Worker thread: evaluates the chunks in the order they were read
+// until the input is finished
+
+void *EEStreamWorker( void *argument )
+{
+    EEStream *stream;
+    EEChunk  *chunk;
+
+    stream = argument;
+
+    pthread_mutex_lock( &stream->mutex );
+
+    while( true )
+    {
+        while( stream->claimed == stream->submitted && ! stream->finished )
+        {
+            pthread_cond_wait( &stream->available, &stream->mutex );
+        }
+
+        if( stream->claimed == stream->submitted ) break;
+
+        chunk = &stream->chunks[ stream->claimed++ % stream->chunksCount ];
+
+        pthread_mutex_unlock( &stream->mutex );
+
+        EEStreamEvaluate( chunk, stream->precision, stream->policy );
+
+        pthread_mutex_lock( &stream->mutex );
+
+        chunk->done = true;
+        pthread_cond_broadcast( &stream->completed );
+    }
+
+    pthread_mutex_unlock( &stream->mutex );
+
+    return NULL;
+}
+
+
+
+// Prints the oldest chunk in the ring once evaluated.
+// Returns the number of its expressions that failed.
+
+long EEStreamWrite( EEStream *stream )
+{
+    EEChunk *chunk;
+
+    chunk = &stream->chunks[ stream->written % stream->chunksCount ];
+
+    pthread_mutex_lock( &stream->mutex );
+    while( ! chunk->done )
+    {
+        pthread_cond_wait( &stream->completed, &stream->mutex );
+    }
+    pthread_mutex_unlock( &stream->mutex );
+
+    fwrite( chunk->output, 1, chunk->outputSize, stdout );
+    EEStatsAdd( &stream->stats, &chunk->stats );
+
+    stream->written++;
+
+    return chunk->failures;
+}
+
+#endif
+
+
+
+
+// Reads newline-delimited expressions from `file` and evaluates them
+// with `jobs` threads, printing one line per expression in the same
+// order: the result or, if the evaluation fails, the error (the following
+// lines are evaluated anyway).
+// Returns the number of expressions that failed.
+
+long EEvaluateStream( FILE        *file,
+                      int         precision,
+                      int         jobs,
+                      EEvalPolicy policy, // of floating point exceptions
+                      EEStats     *stats ) // RETURN: the statistics of all the expressions
+{
+    EEStream stream;
+    EEChunk  *chunk;
+    long     failures,
+             k;
+
+    #if EEStreamThreads
+    pthread_t *threads;
+    #endif
+
+    #if EEStreamMapped
+    struct stat info;
+    void        *mapping;
+    #endif
+
+    memset( &stream, 0, sizeof( EEStream ) );
+
+    stream.file = file;
+    stream.precision = precision;
+    stream.policy = policy;
+    stream.chunksCount = jobs > 1 ? 2 * jobs : 1;
+    stream.chunks = calloc( stream.chunksCount, sizeof( EEChunk ) );
+
+    if( ! stream.chunks )
+    {
+        fprintf( stderr, "out of memory\n" );
+        exit( 1 );
+    }
+
+    failures = 0;
+
+    // Regular files are mapped (read sequentially, once);
+    // pipes, terminals or a failed mapping fall back to reading
+
+    #if EEStreamMapped
+    if( fstat( fileno( file ), &info ) == 0 && S_ISREG( info.st_mode ) && info.st_size > 0 && ftell( file ) == 0 )
+    {
+        mapping = mmap( NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fileno( file ), 0 );
+
+        if( mapping != MAP_FAILED )
+        {
+            madvise( mapping, (size_t)info.st_size, MADV_SEQUENTIAL );
+
+            stream.mapping = mapping;
+            stream.mappingSize = (size_t)info.st_size;
+        }
+    }
+    #endif
+
+    setvbuf( stdout, NULL, _IOFBF, EEStreamBuffer );
+
+    // A single job: each chunk is evaluated then printed
+
+    if( jobs <= 1 || ! EEStreamThreads )
+    {
+        chunk = &stream.chunks[ 0 ];
+
+        while( EEStreamRead( &stream, chunk ) )
+        {
+            EEStreamEvaluate( chunk, precision, policy );
+            fwrite( chunk->output, 1, chunk->outputSize, stdout );
+            EEStatsAdd( &stream.stats, &chunk->stats );
+            failures += chunk->failures;
+        }
+    }
+
+    #if EEStreamThreads
+    else
+    {
+        threads = malloc( jobs * sizeof( pthread_t ) );
+        if( ! threads )
+        {
+            fprintf( stderr, "out of memory\n" );
+            exit( 1 );
+        }
+
+        pthread_mutex_init( &stream.mutex, NULL );
+        pthread_cond_init( &stream.available, NULL );
+        pthread_cond_init( &stream.completed, NULL );
+
+        for( k = 0; k < jobs; k++ )
+        {
+            if( pthread_create( &threads[ k ], NULL, EEStreamWorker, &stream ) != 0 )
+            {
+                fprintf( stderr, "cannot create threads\n" );
+                exit( 1 );
+            }
+        }
+
+        // Chunks are read while the ring has room, otherwise
+        // the oldest one is printed first
+
+        while( true )
+        {
+            if( stream.submitted - stream.written == stream.chunksCount )
+            {
+                failures += EEStreamWrite( &stream );
+            }
+
+            chunk = &stream.chunks[ stream.submitted % stream.chunksCount ];
+
+            if( ! EEStreamRead( &stream, chunk ) ) break;
+
+            pthread_mutex_lock( &stream.mutex );
+            chunk->done = false;
+            stream.submitted++;
+            pthread_cond_signal( &stream.available );
+            pthread_mutex_unlock( &stream.mutex );
+        }
+
+        pthread_mutex_lock( &stream.mutex );
+        stream.finished = true;
+        pthread_cond_broadcast( &stream.available );
+        pthread_mutex_unlock( &stream.mutex );
+
+        while( stream.written < stream.submitted )
+        {
+            failures += EEStreamWrite( &stream );
+        }
+
+        for( k = 0; k < jobs; k++ )
+        {
+            pthread_join( threads[ k ], NULL );
+        }
+
+        pthread_mutex_destroy( &stream.mutex );
+        pthread_cond_destroy( &stream.available );
+        pthread_cond_destroy( &stream.completed );
+
+        free( threads );
+    }
+    #endif
+
+    fflush( stdout );
+
+    *stats = stream.stats;
+
+    for( k = 0; k < stream.chunksCount; k++ )
+    {
+        free( stream.chunks[ k ].input );
+        free( stream.chunks[ k ].output );
+    }
+
+    free( stream.chunks );
+    free( stream.carry );
+
+    #if EEStreamMapped
+    if( stream.mapping ) munmap( (void *)stream.mapping, stream.mappingSize );
+    #endif
+
+    return failures;
+}
+
+
+
 // Evaluates the expressin passed as parameter
 // or perform self-test if invoked with "-t".
 
@@ -62,19 +639,51 @@ int main(int argc, const char * argv[])
 
     long int    precision;
     char        *endptr;
+    const char  *expression;
+    FILE        *input;
+    long        failures;
+    long int    jobs;
+    bool        statistics;
+    EEStats     stats;
+    EEvalPolicy policy;
+    int         i;
 
     precision = 3; // default
+    jobs = 1;
+    policy = EPStrict;
+    statistics = false;
 
     const char *usage =
     "\n"
     "usage:\n"
     "\n"
-    "eeval [[-p prec] 'expr']\n"
+    "eeval [[-p prec] [-e policy] [--stats] 'expr']\n"
+    "eeval [-p prec] [-e policy] [--jobs n] [--stats] --stdin\n"
+    "eeval [-p prec] [-e policy] [--jobs n] [--stats] -f file\n"
+    "eeval -b 'expr'\n"
     "\n"
     "where expr is the expression to evaluate\n"
     "and optional prec is the number of decimal digits\n"
     "to be printed in the output (between 0 and 20 included)\n"
     "\n"
+    "with --stdin or -f expressions are read one per line from the standard\n"
+    "input or from file: results are printed one per line in the same order,\n"
+    "a failed expression prints its error in place of the result\n"
+    "(the exit status is 1 if any expression failed)\n"
+    "with --jobs the expressions are evaluated by n threads\n"
+    "\n"
+    "with -e floating point exceptions (overflows, NaN) are caught\n"
+    "as policy says: strict checks each operation (default), deferred\n"
+    "checks the exception flags once at the end, off doesn't check\n"
+    "(results can be inf or nan)\n"
+    "\n"
+    "with --stats statistics of the evaluations (tokens, depth, calls\n"
+    "of the functions, time...) are printed on the standard error\n"
+    "(must have been built with statistics)\n"
+    "\n"
+    "with -b the time taken to evaluate the expression is measured\n"
+    "and compared with the compiled expression (interpreted and native code)\n"
+    "\n"
     "when invoked from the shell it's recomended\n"
     "to place the expression between 'single' quotes\n"
     "\n"
@@ -88,6 +697,8 @@ int main(int argc, const char * argv[])
     "/ division\n"
     "^ exponentiation\n"
     "! factorial (using Gamma function)\n"
+    "< <= > >= == != comparisons (1 if true, 0 if false)\n"
+    "&& || logical and, or (the right operand computed only if needed)\n"
     "\n"
     "supported function are:\n"
     "\n"
@@ -106,6 +717,7 @@ int main(int argc, const char * argv[])
     "min(n1, n2, n3, ...) minimum of one or more numbers\n"
     "average(n1, n2, ...) average of one or more numbers\n"
     "avg(n1, n2, ...) abbreviated form of the above\n"
+    "if(c, a, b) a if c is not 0, otherwise b (only one is computed)\n"
     "\n"
     "numbers can be expressed as follows:\n"
     "\n"
@@ -153,69 +765,153 @@ int main(int argc, const char * argv[])
     "-------------------------------------------------------------------------------\n"
     "\n";
 
-    if( argc == 2 || argc == 4 )
+    // Requested benchmark ? Execute and exit.
+
+    if( argc == 3 && strncmp( argv[1], "-b", 3 ) == 0 )
+    {
+        EEBenchmark( argv[ 2 ] );
+        exit( 0 );
+    }
+
+    // Requested self-test ? Execute and exit.
+
+    if( argc == 2 && strncmp( argv[1], "-t", 3 ) == 0 )
     {
-        // Three arguments are passed so it is expected to find `-p` option
-        // followed by the required precision.
+        if( eeval_test )
+        {
+            #if eeval_test == true
+            EEvalExecuteTests();
+            #endif
+            exit( 0 );
+        }
+        else
+        {
+            printf( "Test unit not available\n" );
+            exit( 1 );
+        }
+    }
+
+    // Options: `-p` followed by the required precision, `-e` followed by
+    // the policy of floating point exceptions, then either
+    // the expression or where to read the expressions from
+    // (`--stdin` or `-f` followed by the name of a file).
 
-        if( argc == 4 )
+    expression = NULL;
+    input = NULL;
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( strncmp( argv[ i ], "-p", 3 ) == 0 && i + 1 < argc )
         {
-            if( strncmp( argv[1], "-p", 3 ) == 0)
+            i++;
+            precision = strtol( argv[ i ], &endptr, 10 );
+            if( endptr == argv[ i ] || *endptr != '\0' )
             {
-                precision = strtol( argv[ 2 ], &endptr, 10 );
-                if( endptr == argv[2] || *endptr != '\0' )
-                {
-                    fprintf( stderr, "value specified for precision parameter is not a integer number\n" );
-                    exit( 1 );
-                }
-                if( precision < 0 || precision > 20 )
-                {
-                    fprintf( stderr, "value specified for precision parameter must be between 0 and 20 (included)\n" );
-                    exit( 1 );
-                }
+                fprintf( stderr, "value specified for precision parameter is not a integer number\n" );
+                exit( 1 );
             }
-            else
+            if( precision < 0 || precision > 20 )
             {
-                fprintf( stderr, "%s", usage );
+                fprintf( stderr, "value specified for precision parameter must be between 0 and 20 (included)\n" );
                 exit( 1 );
             }
         }
-
-        // Requested self-test ? Execute and exit.
-
-        if( strncmp( argv[1], "-t", 3 ) == 0 )
+        else if( strncmp( argv[ i ], "--jobs", 7 ) == 0 && i + 1 < argc )
         {
-            if( eeval_test )
+            i++;
+            jobs = strtol( argv[ i ], &endptr, 10 );
+            if( endptr == argv[ i ] || *endptr != '\0' || jobs < 1 || jobs > 1024 )
             {
-                #if eeval_test == true
-                EEvalExecuteTests();
-                #endif
-                exit( 0 );
+                fprintf( stderr, "value specified for jobs parameter must be an integer number between 1 and 1024 (included)\n" );
+                exit( 1 );
             }
+        }
+        else if( strncmp( argv[ i ], "-e", 3 ) == 0 && i + 1 < argc )
+        {
+            i++;
+            if( strcmp( argv[ i ], "strict" ) == 0 ) policy = EPStrict;
+            else if( strcmp( argv[ i ], "deferred" ) == 0 ) policy = EPDeferred;
+            else if( strcmp( argv[ i ], "off" ) == 0 ) policy = EPOff;
             else
             {
-                printf( "Test unit not available\n" );
+                fprintf( stderr, "value specified for policy parameter must be strict, deferred or off\n" );
                 exit( 1 );
             }
         }
-
-        // The passed expression is evaluated.
-        // If evaluation succeeds the result is printed.
-        // If fails then prints the error.
-
-        if( EEvaluate( &eval, argv[ argc - 1 ], &result ) == EEvalSuccess )
+        else if( strncmp( argv[ i ], "--stats", 8 ) == 0 )
+        {
+            statistics = true;
+        }
+        else if( strncmp( argv[ i ], "--stdin", 8 ) == 0 && ! expression && ! input )
+        {
+            input = stdin;
+        }
+        else if( strncmp( argv[ i ], "-f", 3 ) == 0 && i + 1 < argc && ! expression && ! input )
+        {
+            i++;
+            input = fopen( argv[ i ], "rb" );
+            if( ! input )
+            {
+                fprintf( stderr, "cannot open %s\n", argv[ i ] );
+                exit( 1 );
+            }
+        }
+        else if( ! expression && ! input )
         {
-            printf( "%.*f\n", (int)precision, result );
+            expression = argv[ i ];
         }
         else
         {
-            EEPrintError( &eval );
+            fprintf( stderr, "%s", usage );
             exit( 1 );
         }
     }
-    else
+
+    if( statistics && ! eeval_statistics )
+    {
+        fprintf( stderr, "Statistics not available\n" );
+        exit( 1 );
+    }
+
+    // Expressions are streamed: failed ones don't stop the others
+
+    if( input )
+    {
+        failures = EEvaluateStream( input, (int)precision, (int)jobs, policy, &stats );
+
+        if( input != stdin ) fclose( input );
+
+        if( statistics ) EEPrintStats( &stats );
+
+        exit( failures > 0 ? 1 : 0 );
+    }
+
+    if( ! expression )
     {
         fprintf( stderr, "%s", usage );
         exit( 1 );
     }
-}
\ No newline at end of file
+
+    // The passed expression is evaluated.
+    // If evaluation succeeds the result is printed.
+    // If fails then prints the error.
+
+    if( EEvaluatePolicy( &eval, expression, strlen( expression ), policy, &result ) == EEvalSuccess )
+    {
+        printf( "%.*f\n", (int)precision, result );
+    }
+    else
+    {
+        EEPrintError( &eval );
+    }
+
+    #if eeval_statistics
+    if( statistics )
+    {
+        fflush( stdout );
+        EEPrintStats( &eval.stats );
+    }
+    #endif
+
+    exit( eval.error[ 0 ] ? 1 : 0 );
+}